@@ -0,0 +1,118 @@
+/*
+ * Build and teardown time and memory per node of a tree with nodes from malloc against nodes
+ * from a tree_arena_t
+ *
+ * usage: arena-bench [num_nodes [fanout]]
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include "bench-helpers.h"
+
+/* resident set size, 0 if unknown */
+static long rss_bytes(void)
+{
+    FILE *statm = fopen("/proc/self/statm", "r");
+    long size = 0;
+    long resident = 0;
+
+    if (statm == NULL)
+    {
+        return 0;
+    }
+
+    if (fscanf(statm, "%ld %ld", &size, &resident) != 2)
+    {
+        resident = 0;
+    }
+
+    fclose(statm);
+
+    return resident * sysconf(_SC_PAGESIZE);
+}
+
+/* returns 0 if the tree cannot be built */
+static int run(const char *label, int num_nodes, int fanout, int use_arena)
+{
+    tree_arena_t *arena = use_arena ? tree_arena_create() : NULL;
+    tree_t tree;
+    long rss_before = rss_bytes();
+    long rss_built = 0;
+    double start = 0;
+    double built = 0;
+    double cleared = 0;
+
+    tree_init(&tree);
+    start = bench_now();
+
+    if ((use_arena && (arena == NULL)) || !bench_build_tree_in(&tree, num_nodes, fanout, arena))
+    {
+        fprintf(stderr, "failed to build the tree\n");
+        return 0;
+    }
+
+    built = bench_now();
+    rss_built = rss_bytes();
+    tree_clear(&tree);
+    cleared = bench_now();
+
+    printf(
+        "%8s %12.3f %12.3f %16.1f %16ld %8d\n",
+        label,
+        built - start,
+        cleared - built,
+        (double)(rss_built - rss_before) / num_nodes,
+        rss_bytes() - rss_before,
+        tree_arena_num_slabs(arena));
+
+    tree_arena_dispose(arena);
+    bench_dispose_names();
+
+    return 1;
+}
+
+/* in a process of its own, so that memory freed by one run does not feed the other */
+static int run_forked(const char *label, int num_nodes, int fanout, int use_arena)
+{
+    pid_t pid = 0;
+    int status = 0;
+
+    fflush(stdout);
+    pid = fork();
+
+    if (pid == 0)
+    {
+        exit(run(label, num_nodes, fanout, use_arena) ? 0 : 1);
+    }
+
+    if ((pid < 0) || (waitpid(pid, &status, 0) != pid))
+    {
+        return 0;
+    }
+
+    return WIFEXITED(status) && (WEXITSTATUS(status) == 0);
+}
+
+int main(int argc, char **argv)
+{
+    int num_nodes = (argc > 1) ? atoi(argv[1]) : 5000000;
+    int fanout = (argc > 2) ? atoi(argv[2]) : 4;
+
+    printf("%d nodes, fanout %d\n", num_nodes, fanout);
+    printf(
+        "%8s %12s %12s %16s %16s %8s\n",
+        "",
+        "build s",
+        "clear s",
+        "rss B per node",
+        "rss B left",
+        "slabs");
+
+    if (!run_forked("malloc", num_nodes, fanout, 0) || !run_forked("arena", num_nodes, fanout, 1))
+    {
+        return 1;
+    }
+
+    return 0;
+}
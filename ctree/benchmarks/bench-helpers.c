@@ -0,0 +1,141 @@
+#include "bench-helpers.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define BENCH_NAME_SIZE 16
+
+static int int_compare(void *a, void *b)
+{
+    int a_ = *(int *)a;
+    int b_ = *(int *)b;
+
+    return (a_ > b_) - (a_ < b_);
+}
+
+static int int_to_json(void *value, char *buffer, int buffer_size)
+{
+    return snprintf(buffer, buffer_size, "%d", *(int *)value);
+}
+
+static void int_dispose(void *value)
+{
+    (void)value;
+}
+
+static int int_to_binary(void *value, char *buffer, int buffer_size)
+{
+    if (buffer_size >= (int)sizeof(int))
+    {
+        memcpy(buffer, value, sizeof(int));
+    }
+
+    return sizeof(int);
+}
+
+/* values are loaded, not borrowed, dispose of them with free() */
+static int int_from_binary(const char *data, int size, void **value)
+{
+    *value = (size == sizeof(int)) ? malloc(sizeof(int)) : NULL;
+
+    if (*value != NULL)
+    {
+        memcpy(*value, data, sizeof(int));
+    }
+
+    return (*value != NULL);
+}
+
+static value_handlers_t g_handlers = {int_compare, int_to_json, int_dispose, int_to_binary, int_from_binary, NULL};
+value_handlers_t *BENCH_INT = &g_handlers;
+
+static char *g_names;
+static int *g_values;
+
+double bench_now(void)
+{
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    return now.tv_sec + now.tv_nsec / 1e9;
+}
+
+const char *bench_node_name(int n)
+{
+    return &g_names[(size_t)n * BENCH_NAME_SIZE];
+}
+
+int bench_build_tree(tree_t *tree, int num_nodes, int fanout)
+{
+    return bench_build_tree_in(tree, num_nodes, fanout, NULL);
+}
+
+int bench_build_tree_in(tree_t *tree, int num_nodes, int fanout, tree_arena_t *arena)
+{
+    int *parents = malloc(num_nodes * sizeof(int));
+    int built = 0;
+    int n = 0;
+
+    if (parents == NULL)
+    {
+        return 0;
+    }
+
+    for (n = 1; n < num_nodes; ++n)
+    {
+        parents[n] = (n - 1) / fanout;
+    }
+
+    built = bench_build_tree_from(tree, parents, num_nodes, arena);
+    free(parents);
+
+    return built;
+}
+
+int bench_build_tree_from(tree_t *tree, const int *parents, int num_nodes, tree_arena_t *arena)
+{
+    node_t **nodes = malloc(num_nodes * sizeof(node_t *));
+    const char **parent_names = malloc(num_nodes * sizeof(const char *));
+    int built = 0;
+    int n = 0;
+
+    bench_dispose_names();
+    g_names = malloc((size_t)num_nodes * BENCH_NAME_SIZE);
+    g_values = malloc(num_nodes * sizeof(int));
+
+    if ((nodes == NULL) || (parent_names == NULL) || (g_names == NULL) || (g_values == NULL))
+    {
+        free(nodes);
+        free(parent_names);
+        return 0;
+    }
+
+    for (n = 0; n < num_nodes; ++n)
+    {
+        snprintf(&g_names[(size_t)n * BENCH_NAME_SIZE], BENCH_NAME_SIZE, "n%d", n);
+        g_values[n] = n;
+    }
+
+    for (n = 0; n < num_nodes; ++n)
+    {
+        nodes[n] = node_create_in(arena, BENCH_INT, bench_node_name(n), &g_values[n]);
+        parent_names[n] = (n == 0) ? NULL : bench_node_name(parents[n]);
+    }
+
+    built = (tree_build(tree, nodes, parent_names, num_nodes, NULL) == TREE_BUILD_OK);
+
+    free(nodes);
+    free(parent_names);
+
+    return built;
+}
+
+void bench_dispose_names(void)
+{
+    free(g_names);
+    free(g_values);
+    g_names = NULL;
+    g_values = NULL;
+}
@@ -0,0 +1,42 @@
+#ifndef BENCH_HELPERS_H_
+#define BENCH_HELPERS_H_
+
+#include "ctree.h"
+
+extern value_handlers_t *BENCH_INT;
+
+/**
+ * Seconds from an arbitrary point, monotonic
+ */
+double bench_now(void);
+
+/**
+ * Name of the n-th node of bench_build_tree()
+ */
+const char *bench_node_name(int n);
+
+/**
+ * Build a tree where node n is a child of node (n - 1) / fanout
+ *
+ * @return 0 if memory cannot be allocated, 1 otherwise
+ */
+int bench_build_tree(tree_t *tree, int num_nodes, int fanout);
+
+/**
+ * Same as bench_build_tree() with nodes from an arena, see node_create_in()
+ */
+int bench_build_tree_in(tree_t *tree, int num_nodes, int fanout, tree_arena_t *arena);
+
+/**
+ * Build a tree where node n is a child of node parents[n], parents[0] is ignored, node 0 is the root
+ *
+ * @return 0 if memory cannot be allocated or parents do not form a tree, 1 otherwise
+ */
+int bench_build_tree_from(tree_t *tree, const int *parents, int num_nodes, tree_arena_t *arena);
+
+/**
+ * Free the names and values of bench_build_tree(), after the tree is cleared
+ */
+void bench_dispose_names(void);
+
+#endif /* BENCH_HELPERS_H_ */
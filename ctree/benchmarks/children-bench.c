@@ -0,0 +1,204 @@
+/*
+ * Traversal time of trees with realistic fan-outs, with children kept in the nodes, see
+ * NODE_INLINE_CHILDREN, against every node with children having a table of its own
+ *
+ * usage: children-bench [num_nodes [rounds]]
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include "bench-helpers.h"
+
+#define BENCH_MAX_FANOUT 16
+
+/* percent of nodes with 0, 1, 2, 3 and 4 children, the rest has 5 to BENCH_MAX_FANOUT */
+typedef struct
+{
+    const char *label;
+    int percent[5];
+} bench_distribution_t;
+
+static const bench_distribution_t g_distributions[] =
+{
+    {"binary", {0, 0, 100, 0, 0}},
+    {"small", {40, 25, 15, 10, 5}},
+    {"leafy", {60, 10, 10, 10, 5}},
+    {"wide", {30, 10, 10, 10, 10}}
+};
+
+static int draw_fanout(const bench_distribution_t *distribution, unsigned int *seed)
+{
+    int percent = rand_r(seed) % 100;
+    int fanout = 0;
+
+    for (; fanout < 5; ++fanout)
+    {
+        percent -= distribution->percent[fanout];
+
+        if (percent < 0)
+        {
+            return fanout;
+        }
+    }
+
+    return 5 + rand_r(seed) % (BENCH_MAX_FANOUT - 4);
+}
+
+/* level order, every node draws its number of children, a dying tree is kept growing */
+static void fill_parents(int *parents, int num_nodes, const bench_distribution_t *distribution)
+{
+    unsigned int seed = 42;
+    int head = 0;
+    int n = 1;
+    int fanout = 0;
+
+    while (n < num_nodes)
+    {
+        fanout = draw_fanout(distribution, &seed);
+
+        if ((fanout == 0) && (head + 1 == n))
+        {
+            fanout = 1;
+        }
+
+        for (; (fanout > 0) && (n < num_nodes); --fanout)
+        {
+            parents[n++] = head;
+        }
+
+        ++head;
+    }
+}
+
+/* what most walks do, follow the children pointers */
+static long long walk(node_t *node)
+{
+    long long sum = *(int *)node->value;
+    int i = 0;
+
+    for (; i < node->num_children; ++i)
+    {
+        sum += walk(node->children[i]);
+    }
+
+    return sum;
+}
+
+static int count_node(node_t *node, void *ctx)
+{
+    (void)node;
+    ++*(int *)ctx;
+    return 0;
+}
+
+static void run(const char *label, tree_t *tree, int rounds)
+{
+    double start = 0;
+    double walked = 0;
+    double iterated = 0;
+    long long sum = 0;
+    int num_visited = 0;
+    int num_inline = 0;
+    int num_tables = 0;
+    int num_nodes = tree->num_nodes + 1;
+    int i = 0;
+
+    for (i = 0; i < tree->num_nodes; ++i)
+    {
+        num_inline += (tree->nodes[i]->children == tree->nodes[i]->inline_children);
+        num_tables += (tree->nodes[i]->capacity > 0) &&
+                      (tree->nodes[i]->children != tree->nodes[i]->inline_children);
+    }
+
+    start = bench_now();
+
+    for (i = 0; i < rounds; ++i)
+    {
+        sum += walk(tree->root);
+    }
+
+    walked = bench_now();
+
+    for (i = 0; i < rounds; ++i)
+    {
+        tree_for_each(tree, TREE_ITER_PRE_ORDER, count_node, &num_visited);
+    }
+
+    iterated = bench_now();
+
+    printf(
+        "%-16s %12.2f %12.2f %10d %10d %s\n",
+        label,
+        (walked - start) * 1e9 / ((double)rounds * num_nodes),
+        (iterated - walked) * 1e9 / ((double)rounds * num_nodes),
+        num_inline,
+        num_tables,
+        ((sum > 0) && (num_visited == rounds * num_nodes)) ? "" : "(?)");
+}
+
+/* the layout before NODE_INLINE_CHILDREN, every node with children has a table of its own */
+static int spill_children(tree_t *tree)
+{
+    int i = 0;
+
+    for (; i < tree->num_nodes; ++i)
+    {
+        if ((tree->nodes[i]->children == tree->nodes[i]->inline_children) &&
+            !node_reserve_children(tree->nodes[i], NODE_INLINE_CHILDREN + 1))
+        {
+            return 0;
+        }
+    }
+
+    return (tree->root->children != tree->root->inline_children) ||
+           node_reserve_children(tree->root, NODE_INLINE_CHILDREN + 1);
+}
+
+int main(int argc, char **argv)
+{
+    int num_nodes = (argc > 1) ? atoi(argv[1]) : 1000000;
+    int rounds = (argc > 2) ? atoi(argv[2]) : 10;
+    int *parents = malloc(num_nodes * sizeof(int));
+    char label[64];
+    tree_t tree;
+    size_t d = 0;
+
+    if ((parents == NULL) || (num_nodes < 2) || (rounds < 1))
+    {
+        fprintf(stderr, "usage: children-bench [num_nodes [rounds]]\n");
+        return 1;
+    }
+
+    printf("%d nodes, %d rounds, %d inline children\n", num_nodes, rounds, NODE_INLINE_CHILDREN);
+    printf("%-16s %12s %12s %10s %10s\n", "", "walk ns/node", "iter ns/node", "inline", "tables");
+
+    for (; d < sizeof(g_distributions) / sizeof(g_distributions[0]); ++d)
+    {
+        fill_parents(parents, num_nodes, &g_distributions[d]);
+        tree_init(&tree);
+
+        if (!bench_build_tree_from(&tree, parents, num_nodes, NULL))
+        {
+            fprintf(stderr, "failed to build the tree\n");
+            return 1;
+        }
+
+        snprintf(label, sizeof(label), "%s inline", g_distributions[d].label);
+        run(label, &tree, rounds);
+
+        if (!spill_children(&tree))
+        {
+            fprintf(stderr, "failed to allocate children tables\n");
+            return 1;
+        }
+
+        snprintf(label, sizeof(label), "%s tables", g_distributions[d].label);
+        run(label, &tree, rounds);
+
+        tree_clear(&tree);
+        bench_dispose_names();
+    }
+
+    free(parents);
+
+    return 0;
+}
@@ -0,0 +1,169 @@
+/*
+ * Size of a tree and time per node to encode and decode it, in the compact binary form against
+ * JSON lines
+ *
+ * usage: compact-bench [num_nodes [fanout [rounds]]]
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "bench-helpers.h"
+#include "ccompact.h"
+#include "cjson.h"
+
+/* decoded values are loaded, dispose of them with free() */
+static value_handlers_t g_loaded;
+
+typedef struct
+{
+    char *data;
+    int size;
+    int capacity;
+} bench_buffer_t;
+
+static int append(const char *data, int size, void *ctx)
+{
+    bench_buffer_t *buffer = ctx;
+    char *grown = NULL;
+
+    if (buffer->size + size > buffer->capacity)
+    {
+        buffer->capacity = 2 * (buffer->size + size);
+        grown = realloc(buffer->data, buffer->capacity);
+
+        if (grown == NULL)
+        {
+            return 1;
+        }
+
+        buffer->data = grown;
+    }
+
+    memcpy(buffer->data + buffer->size, data, size);
+    buffer->size += size;
+
+    return 0;
+}
+
+static void *int_from_json(const char *json, int size)
+{
+    int *value = malloc(sizeof(int));
+    char text[16];
+
+    if ((value == NULL) || (size >= (int)sizeof(text)))
+    {
+        free(value);
+        return NULL;
+    }
+
+    memcpy(text, json, size);
+    text[size] = '\0';
+    *value = atoi(text);
+
+    return value;
+}
+
+static void int_free(void *value)
+{
+    free(value);
+}
+
+static void report(const char *label, int size, double encode, double decode, int num_nodes, int rounds)
+{
+    printf(
+        "%-12s %12d %12.2f %12.1f %12.1f\n",
+        label,
+        size,
+        (double)size / num_nodes,
+        encode * 1e9 / ((double)num_nodes * rounds),
+        decode * 1e9 / ((double)num_nodes * rounds));
+}
+
+int main(int argc, char **argv)
+{
+    int num_nodes = (argc > 1) ? atoi(argv[1]) : 1000000;
+    int fanout = (argc > 2) ? atoi(argv[2]) : 4;
+    int rounds = (argc > 3) ? atoi(argv[3]) : 10;
+    bench_buffer_t json = {NULL, 0, 0};
+    double start = 0;
+    double encode = 0;
+    double decode = 0;
+    char *compact = NULL;
+    int size = 0;
+    int ok = 1;
+    int i = 0;
+    tree_t tree;
+    tree_t decoded;
+
+    g_loaded = *BENCH_INT;
+    g_loaded.dispose_fun = int_free;
+    g_loaded.from_json_fun = int_from_json;
+
+    tree_init(&tree);
+    tree_init(&decoded);
+
+    if ((num_nodes < 1) || (fanout < 1) || (rounds < 1) || !bench_build_tree(&tree, num_nodes, fanout))
+    {
+        fprintf(stderr, "failed to build the tree\n");
+        return 1;
+    }
+
+    printf("%d nodes, fanout %d, %d rounds\n", num_nodes, fanout, rounds);
+    printf("%-12s %12s %12s %12s %12s\n", "", "bytes", "per node", "encode ns", "decode ns");
+
+    size = tree_to_compact(&tree, NULL, 0);
+    compact = malloc(size);
+    start = bench_now();
+
+    for (i = 0; (i < rounds) && ok; ++i)
+    {
+        ok = (compact != NULL) && (tree_to_compact(&tree, compact, size) == size);
+    }
+
+    encode = bench_now() - start;
+    start = bench_now();
+
+    for (i = 0; (i < rounds) && ok; ++i)
+    {
+        tree_clear(&decoded);
+        ok = tree_from_compact(&decoded, &g_loaded, compact, size);
+    }
+
+    decode = bench_now() - start;
+    ok = ok && (decoded.num_nodes == tree.num_nodes);
+    report("compact", size, encode, decode, num_nodes, rounds);
+    start = bench_now();
+
+    for (i = 0; (i < rounds) && ok; ++i)
+    {
+        json.size = 0;
+        ok = tree_to_json_lines(&tree, append, &json);
+    }
+
+    encode = bench_now() - start;
+    start = bench_now();
+
+    for (i = 0; (i < rounds) && ok; ++i)
+    {
+        tree_clear(&decoded);
+        ok = tree_from_json(&decoded, &g_loaded, json.data, json.size);
+    }
+
+    decode = bench_now() - start;
+    ok = ok && (decoded.num_nodes == tree.num_nodes);
+    report("json lines", json.size, encode, decode, num_nodes, rounds);
+
+    tree_clear(&decoded);
+    tree_clear(&tree);
+    bench_dispose_names();
+    free(compact);
+    free(json.data);
+
+    if (!ok)
+    {
+        fprintf(stderr, "failed to encode or decode the tree\n");
+        return 1;
+    }
+
+    return 0;
+}
@@ -0,0 +1,135 @@
+/*
+ * Read throughput of tree_concurrent_t against a tree_t behind one global mutex
+ *
+ * usage: concurrent-bench [num_nodes [seconds_per_run [max_threads]]]
+ */
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include "bench-helpers.h"
+#include "cconcurrent.h"
+
+typedef struct
+{
+    tree_concurrent_t *tree;
+    pthread_mutex_t *global_mutex; /* NULL to use tree_concurrent_t */
+    int num_nodes;
+    unsigned int seed;
+    int *stop;
+    long long num_ops;
+} reader_t;
+
+static void *reader_main(void *arg)
+{
+    reader_t *self = arg;
+    const char *a = NULL;
+    const char *b = NULL;
+    long long num_ops = 0;
+
+    while (!__atomic_load_n(self->stop, __ATOMIC_RELAXED))
+    {
+        a = bench_node_name(rand_r(&self->seed) % self->num_nodes);
+        b = bench_node_name(rand_r(&self->seed) % self->num_nodes);
+
+        if (self->global_mutex != NULL)
+        {
+            pthread_mutex_lock(self->global_mutex);
+            tree_get_node(&self->tree->tree, a);
+            tree_is_ancestor(&self->tree->tree, a, b);
+            pthread_mutex_unlock(self->global_mutex);
+        }
+        else
+        {
+            tree_concurrent_get_node(self->tree, a);
+            tree_concurrent_is_ancestor(self->tree, a, b);
+        }
+
+        num_ops += 2;
+    }
+
+    self->num_ops = num_ops;
+
+    return NULL;
+}
+
+/* returns operations per second */
+static double run(
+    tree_concurrent_t *tree,
+    pthread_mutex_t *global_mutex,
+    int num_nodes,
+    int num_threads,
+    double seconds)
+{
+    pthread_t threads[num_threads];
+    reader_t readers[num_threads];
+    int stop = 0;
+    long long num_ops = 0;
+    double start = 0;
+    int i = 0;
+
+    start = bench_now();
+
+    for (i = 0; i < num_threads; ++i)
+    {
+        readers[i].tree = tree;
+        readers[i].global_mutex = global_mutex;
+        readers[i].num_nodes = num_nodes;
+        readers[i].seed = i + 1;
+        readers[i].stop = &stop;
+        readers[i].num_ops = 0;
+        pthread_create(&threads[i], NULL, reader_main, &readers[i]);
+    }
+
+    usleep((useconds_t)(seconds * 1e6));
+    __atomic_store_n(&stop, 1, __ATOMIC_RELAXED);
+
+    for (i = 0; i < num_threads; ++i)
+    {
+        pthread_join(threads[i], NULL);
+        num_ops += readers[i].num_ops;
+    }
+
+    return num_ops / (bench_now() - start);
+}
+
+int main(int argc, char **argv)
+{
+    int num_nodes = (argc > 1) ? atoi(argv[1]) : 100000;
+    double seconds = (argc > 2) ? atof(argv[2]) : 1.0;
+    int max_threads = (argc > 3) ? atoi(argv[3]) : 32;
+    pthread_mutex_t global_mutex = PTHREAD_MUTEX_INITIALIZER;
+    tree_concurrent_t tree;
+    double rwlock_ops = 0;
+    double mutex_ops = 0;
+    int num_threads = 0;
+
+    if (!tree_concurrent_init(&tree) || !bench_build_tree(&tree.tree, num_nodes, 4))
+    {
+        fprintf(stderr, "failed to build the tree\n");
+        return 1;
+    }
+
+    /* label once up front, so that both variants only read */
+    tree_update_labels(&tree.tree);
+
+    printf("%d nodes, %.1f s per run, lookup + is_ancestor per 2 ops\n", num_nodes, seconds);
+    printf("%8s %16s %16s %8s\n", "threads", "rwlock ops/s", "mutex ops/s", "ratio");
+
+    for (num_threads = 1; num_threads <= max_threads; num_threads *= 2)
+    {
+        rwlock_ops = run(&tree, NULL, num_nodes, num_threads, seconds);
+        mutex_ops = run(&tree, &global_mutex, num_nodes, num_threads, seconds);
+        printf(
+            "%8d %16.0f %16.0f %8.2f\n",
+            num_threads,
+            rwlock_ops,
+            mutex_ops,
+            rwlock_ops / mutex_ops);
+    }
+
+    tree_concurrent_dispose(&tree);
+    bench_dispose_names();
+
+    return 0;
+}
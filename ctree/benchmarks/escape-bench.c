@@ -0,0 +1,119 @@
+/*
+ * Throughput of node_json_escape() with every scan the CPU supports, for path-like names of
+ * several lengths, clean ones and ones with something to escape every 64 bytes
+ *
+ * usage: escape-bench [num_names [rounds]]
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "bench-helpers.h"
+
+static const char *g_scan_labels[] = {"auto", "scalar", "sse2", "avx2"};
+
+/* /srv/data/0001/0002/..., a quote every 64 bytes if dirty */
+static char *make_names(int num_names, int length, int dirty)
+{
+    char *names = malloc((size_t)num_names * (length + 1));
+    char *name = NULL;
+    int n = 0;
+    int i = 0;
+
+    for (; (names != NULL) && (n < num_names); ++n)
+    {
+        name = names + (size_t)n * (length + 1);
+        i = snprintf(name, length + 1, "/srv/data/%d", n);
+
+        for (; i < length; ++i)
+        {
+            name[i] = (i % 5 == 0) ? '/' : (char)('a' + (n + i) % 26);
+            name[i] = (dirty && (i % 64 == 63)) ? '"' : name[i];
+        }
+
+        name[length] = '\0';
+    }
+
+    return names;
+}
+
+static void run(const char *names, int num_names, int length, int rounds, char *buffer, int buffer_size)
+{
+    long long num_chars = 0;
+    double start = 0;
+    double seconds = 0;
+    int scan = NODE_JSON_SCAN_SCALAR;
+    int i = 0;
+    int n = 0;
+
+    for (; scan <= NODE_JSON_SCAN_AVX2; ++scan)
+    {
+        if (node_json_set_scan((node_json_scan_t)scan) != (node_json_scan_t)scan)
+        {
+            continue;
+        }
+
+        num_chars = 0;
+        start = bench_now();
+
+        for (i = 0; i < rounds; ++i)
+        {
+            for (n = 0; n < num_names; ++n)
+            {
+                num_chars += node_json_escape(names + (size_t)n * (length + 1), buffer, buffer_size);
+            }
+        }
+
+        seconds = bench_now() - start;
+
+        printf(
+            " %8s %8.2f GB/s %8.2f ns/name%s",
+            g_scan_labels[scan],
+            (double)length * num_names * rounds / seconds / 1e9,
+            seconds * 1e9 / ((double)num_names * rounds),
+            (num_chars > 0) ? "" : "(?)");
+    }
+
+    printf("\n");
+}
+
+int main(int argc, char **argv)
+{
+    static const int lengths[] = {16, 64, 256, 1024};
+    int num_names = (argc > 1) ? atoi(argv[1]) : 10000;
+    int rounds = (argc > 2) ? atoi(argv[2]) : 100;
+    int buffer_size = 6 * lengths[sizeof(lengths) / sizeof(lengths[0]) - 1] + 3;
+    char *buffer = malloc(buffer_size);
+    char *names = NULL;
+    size_t l = 0;
+    int dirty = 0;
+
+    if ((buffer == NULL) || (num_names < 1) || (rounds < 1))
+    {
+        fprintf(stderr, "usage: escape-bench [num_names [rounds]]\n");
+        return 1;
+    }
+
+    printf("%d names, %d rounds, auto picks %s\n", num_names, rounds, g_scan_labels[node_json_set_scan(NODE_JSON_SCAN_AUTO)]);
+
+    for (; l < sizeof(lengths) / sizeof(lengths[0]); ++l)
+    {
+        for (dirty = 0; dirty < 2; ++dirty)
+        {
+            names = make_names(num_names, lengths[l], dirty);
+
+            if (names == NULL)
+            {
+                fprintf(stderr, "failed to allocate names\n");
+                return 1;
+            }
+
+            printf("%5d bytes %-6s", lengths[l], dirty ? "dirty" : "clean");
+            run(names, num_names, lengths[l], rounds, buffer, buffer_size);
+            free(names);
+        }
+    }
+
+    free(buffer);
+
+    return 0;
+}
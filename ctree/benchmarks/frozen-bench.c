@@ -0,0 +1,205 @@
+/*
+ * Walk and lookup time of a tree_t against the same tree frozen with tree_freeze(), and the time
+ * it takes to get a tree back from a tree_save_binary() snapshot
+ *
+ * usage: frozen-bench [num_nodes [fanout [rounds [snapshot_path]]]]
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "bench-helpers.h"
+#include "cfrozen.h"
+
+/* the analytics walk, sum of the values of the subtree */
+static long long walk(node_t *node)
+{
+    long long sum = *(int *)node->value;
+    int i = 0;
+
+    for (; i < node->num_children; ++i)
+    {
+        sum += walk(node->children[i]);
+    }
+
+    return sum;
+}
+
+static int add_value(node_t *node, void *ctx)
+{
+    *(long long *)ctx += *(int *)node->value;
+    return 0;
+}
+
+static int free_value(node_t *node, void *ctx)
+{
+    (void)ctx;
+    free(node->value);
+    return 0;
+}
+
+static int add_frozen_value(const tree_frozen_t *frozen, int node, void *ctx)
+{
+    *(long long *)ctx += *(int *)frozen->values[node];
+    return 0;
+}
+
+static int add_mapped_value(const tree_frozen_t *frozen, int node, void *ctx)
+{
+    int value = 0;
+
+    memcpy(&value, tree_frozen_value_data(frozen, node, NULL), sizeof(int));
+    *(long long *)ctx += value;
+    return 0;
+}
+
+static void report(const char *label, double seconds, long long num_ops, long long check)
+{
+    printf("%-24s %12.2f %s\n", label, seconds * 1e9 / num_ops, (check != 0) ? "" : "(?)");
+}
+
+int main(int argc, char **argv)
+{
+    int num_nodes = (argc > 1) ? atoi(argv[1]) : 1000000;
+    int fanout = (argc > 2) ? atoi(argv[2]) : 4;
+    int rounds = (argc > 3) ? atoi(argv[3]) : 10;
+    const char *path = (argc > 4) ? argv[4] : "frozen-bench.bin";
+    long long num_ops = (long long)num_nodes * rounds;
+    long long sum = 0;
+    long long found = 0;
+    tree_frozen_t *frozen = NULL;
+    tree_frozen_t *mapped = NULL;
+    tree_t tree;
+    double start = 0;
+    long long op = 0;
+    int i = 0;
+
+    tree_init(&tree);
+
+    if ((num_nodes < 1) || (fanout < 1) || (rounds < 1) || !bench_build_tree(&tree, num_nodes, fanout))
+    {
+        fprintf(stderr, "failed to build the tree\n");
+        return 1;
+    }
+
+    printf("%d nodes, fanout %d, %d rounds\n", num_nodes, fanout, rounds);
+    printf("%-24s %12s\n", "", "ns per node");
+
+    start = bench_now();
+
+    for (i = 0; i < rounds; ++i)
+    {
+        sum += walk(tree.root);
+    }
+
+    report("tree walk", bench_now() - start, num_ops, sum);
+    sum = 0;
+    start = bench_now();
+
+    for (i = 0; i < rounds; ++i)
+    {
+        tree_for_each(&tree, TREE_ITER_PRE_ORDER, add_value, &sum);
+    }
+
+    report("tree_for_each", bench_now() - start, num_ops, sum);
+    start = bench_now();
+
+    for (op = 0; op < num_ops; ++op)
+    {
+        found += (tree_get_node(&tree, bench_node_name(op % num_nodes)) != NULL);
+    }
+
+    report("tree_get_node", bench_now() - start, num_ops, found);
+    start = bench_now();
+
+    if (!tree_save_binary(&tree, path))
+    {
+        fprintf(stderr, "failed to save %s\n", path);
+        return 1;
+    }
+
+    report("tree_save_binary", bench_now() - start, num_nodes, 1);
+    start = bench_now();
+    frozen = tree_freeze(&tree);
+
+    if (frozen == NULL)
+    {
+        fprintf(stderr, "failed to freeze the tree\n");
+        return 1;
+    }
+
+    report("tree_freeze", bench_now() - start, num_nodes, 1);
+    sum = 0;
+    start = bench_now();
+
+    for (i = 0; i < rounds; ++i)
+    {
+        tree_frozen_for_each(frozen, 0, add_frozen_value, &sum);
+    }
+
+    report("tree_frozen_for_each", bench_now() - start, num_ops, sum);
+    found = 0;
+    start = bench_now();
+
+    for (op = 0; op < num_ops; ++op)
+    {
+        found += (tree_frozen_find(frozen, bench_node_name(op % num_nodes)) != -1);
+    }
+
+    report("tree_frozen_find", bench_now() - start, num_ops, found);
+    start = bench_now();
+
+    if (!tree_thaw(frozen, &tree))
+    {
+        fprintf(stderr, "failed to thaw the tree\n");
+        return 1;
+    }
+
+    report("tree_thaw", bench_now() - start, num_nodes, 1);
+    tree_clear(&tree);
+
+    /* what a restart takes, the first query included */
+    start = bench_now();
+    mapped = tree_map_binary(path, BENCH_INT);
+
+    if ((mapped == NULL) || (tree_frozen_find(mapped, bench_node_name(num_nodes - 1)) == -1))
+    {
+        fprintf(stderr, "failed to map %s\n", path);
+        return 1;
+    }
+
+    printf("%-24s %12.2f ms total\n", "tree_map_binary", (bench_now() - start) * 1e3);
+    sum = 0;
+    start = bench_now();
+
+    for (i = 0; i < rounds; ++i)
+    {
+        tree_frozen_for_each(mapped, 0, add_mapped_value, &sum);
+    }
+
+    report("mapped for_each", bench_now() - start, num_ops, sum);
+    found = 0;
+    start = bench_now();
+
+    for (op = 0; op < num_ops; ++op)
+    {
+        found += (tree_frozen_find(mapped, bench_node_name(op % num_nodes)) != -1);
+    }
+
+    report("mapped find", bench_now() - start, num_ops, found);
+    start = bench_now();
+
+    /* loaded values are malloc'ed, the tree keeps borrowing them */
+    if (!tree_thaw(mapped, &tree))
+    {
+        fprintf(stderr, "failed to thaw %s\n", path);
+        return 1;
+    }
+
+    report("mapped tree_thaw", bench_now() - start, num_nodes, 1);
+    tree_for_each(&tree, TREE_ITER_PRE_ORDER, free_value, NULL);
+    tree_clear(&tree);
+    remove(path);
+    bench_dispose_names();
+
+    return 0;
+}
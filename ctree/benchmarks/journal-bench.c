@@ -0,0 +1,186 @@
+/*
+ * Changes per second committed to a journal by threads which share syncs, and time per node to
+ * recover a tree by replaying its journal against adding the nodes one by one
+ *
+ * usage: journal-bench [path [num_nodes [max_threads]]]
+ */
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include "bench-helpers.h"
+#include "cjournal.h"
+
+#define BENCH_CHANGES_PER_THREAD 2000
+
+/* replayed values are loaded, dispose of them with free() */
+static value_handlers_t g_loaded;
+
+/* value of all the nodes which are not replayed */
+static int g_value = 1;
+
+typedef struct
+{
+    tree_t *tree;
+    tree_journal_t *journal;
+    pthread_mutex_t *tree_mutex;
+    int id;
+    int num_committed;
+} writer_t;
+
+static void int_free(void *value)
+{
+    free(value);
+}
+
+/* a chain of nodes under the root, one commit per change */
+static void *writer_main(void *arg)
+{
+    writer_t *self = arg;
+    char name[32];
+    char parent[32] = "n0";
+    int i = 0;
+
+    for (; i < BENCH_CHANGES_PER_THREAD; ++i)
+    {
+        snprintf(name, sizeof(name), "t%d/%d", self->id, i);
+
+        pthread_mutex_lock(self->tree_mutex);
+        tree_add_node(self->tree, node_create(BENCH_INT, name, &g_value), parent);
+        pthread_mutex_unlock(self->tree_mutex);
+
+        self->num_committed += tree_journal_commit(self->journal);
+        snprintf(parent, sizeof(parent), "%s", name);
+    }
+
+    return NULL;
+}
+
+/* returns changes per second, 0 if a commit fails */
+static double run_writers(const char *path, int num_threads)
+{
+    pthread_t threads[num_threads];
+    writer_t writers[num_threads];
+    pthread_mutex_t tree_mutex = PTHREAD_MUTEX_INITIALIZER;
+    tree_journal_t *journal = NULL;
+    double start = 0;
+    double seconds = 0;
+    int num_committed = 0;
+    int i = 0;
+    tree_t tree;
+
+    tree_init(&tree);
+    remove(path);
+    journal = tree_journal_open(path);
+
+    if ((journal == NULL) || !bench_build_tree(&tree, 1, 1))
+    {
+        tree_journal_dispose(journal);
+        return 0;
+    }
+
+    tree_set_journal(&tree, journal);
+    start = bench_now();
+
+    for (i = 0; i < num_threads; ++i)
+    {
+        writers[i].tree = &tree;
+        writers[i].journal = journal;
+        writers[i].tree_mutex = &tree_mutex;
+        writers[i].id = i;
+        writers[i].num_committed = 0;
+        pthread_create(&threads[i], NULL, writer_main, &writers[i]);
+    }
+
+    for (i = 0; i < num_threads; ++i)
+    {
+        pthread_join(threads[i], NULL);
+        num_committed += writers[i].num_committed;
+    }
+
+    seconds = bench_now() - start;
+
+    tree_clear(&tree);
+    tree_journal_dispose(journal);
+    bench_dispose_names();
+
+    return (num_committed == num_threads * BENCH_CHANGES_PER_THREAD) ? num_committed / seconds : 0;
+}
+
+int main(int argc, char **argv)
+{
+    const char *path = (argc > 1) ? argv[1] : "journal-bench.log";
+    int num_nodes = (argc > 2) ? atoi(argv[2]) : 100000;
+    int max_threads = (argc > 3) ? atoi(argv[3]) : 8;
+    tree_journal_t *journal = NULL;
+    double start = 0;
+    double one_by_one = 0;
+    double replay = 0;
+    double changes_per_second = 0;
+    int ok = 1;
+    int n = 0;
+    tree_t tree;
+    tree_t recovered;
+
+    g_loaded = *BENCH_INT;
+    g_loaded.dispose_fun = int_free;
+
+    if ((num_nodes < 1) || (max_threads < 1))
+    {
+        fprintf(stderr, "invalid arguments\n");
+        return 1;
+    }
+
+    printf("%-8s %16s\n", "threads", "changes/s");
+
+    for (n = 1; (n <= max_threads) && ok; n *= 2)
+    {
+        changes_per_second = run_writers(path, n);
+        ok = (changes_per_second > 0);
+        printf("%-8d %16.0f\n", n, changes_per_second);
+    }
+
+    /* names of the nodes, the tree itself is not needed */
+    tree_init(&tree);
+    tree_init(&recovered);
+    ok = ok && bench_build_tree(&tree, num_nodes, 4);
+    tree_clear(&tree);
+
+    remove(path);
+    journal = tree_journal_open(path);
+    ok = ok && (journal != NULL);
+    tree_set_journal(&tree, journal);
+    start = bench_now();
+
+    for (n = 0; (n < num_nodes) && ok; ++n)
+    {
+        ok = (tree_add_node(
+                  &tree,
+                  node_create(BENCH_INT, bench_node_name(n), &g_value),
+                  (n == 0) ? NULL : bench_node_name((n - 1) / 4)) != NULL);
+    }
+
+    one_by_one = bench_now() - start;
+    ok = ok && tree_journal_commit(journal);
+    start = bench_now();
+    ok = ok && (tree_replay_journal(&recovered, &g_loaded, path) == num_nodes);
+    replay = bench_now() - start;
+    ok = ok && (recovered.num_nodes == tree.num_nodes);
+
+    printf("\n%d nodes, fanout 4\n", num_nodes);
+    printf("%-16s %8.1f ns/node\n", "add one by one", one_by_one * 1e9 / num_nodes);
+    printf("%-16s %8.1f ns/node\n", "replay", replay * 1e9 / num_nodes);
+
+    tree_clear(&recovered);
+    tree_clear(&tree);
+    tree_journal_dispose(journal);
+    bench_dispose_names();
+    remove(path);
+
+    if (!ok)
+    {
+        fprintf(stderr, "failed to commit or replay the journal\n");
+        return 1;
+    }
+
+    return 0;
+}
@@ -0,0 +1,153 @@
+/*
+ * Time per node of node_to_json() against the snprintf based one it replaced, with and without
+ * node_json_size() to size the buffer exactly
+ *
+ * usage: json-bench [num_nodes [fanout [rounds]]]
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include "bench-helpers.h"
+
+#define BENCH_BUFFER_SIZE 4096
+
+/* node_to_json() as it was, names are not escaped */
+#define ERROR_OR_NEXT()\
+    if (char_cnt < 0)\
+    {\
+        return 0;\
+    }\
+    \
+    if (char_cnt >= size_left)\
+    {\
+        return char_pos + char_cnt;\
+    }\
+    \
+    char_pos += char_cnt;\
+    size_left -= char_cnt;\
+
+static int snprintf_node_to_json(node_t *self, char *buffer, int buffer_size)
+{
+    int i = 0;
+    int char_pos = 0;
+    int char_cnt = 0;
+    int size_left = buffer_size;
+
+    if ((self == NULL) || (buffer == NULL))
+    {
+        return 0;
+    }
+
+    char_cnt = snprintf(buffer, size_left, "{\"object_name\":\"%s\",\"value\":", self->object_name);
+
+    ERROR_OR_NEXT();
+
+    if (self->value_handlers->to_json_fun == NULL)
+    {
+        return 0;
+    }
+
+    char_cnt = self->value_handlers->to_json_fun(self->value, &buffer[char_pos], size_left);
+
+    ERROR_OR_NEXT();
+
+    if (self->parent == NULL)
+    {
+        char_cnt = snprintf(&buffer[char_pos], size_left, ",\"parent\":null,\"children\":[");
+    }
+    else
+    {
+        char_cnt = snprintf(
+            &buffer[char_pos],
+            size_left,
+            ",\"parent\":\"%s\",\"children\":[",
+            self->parent->object_name);
+    }
+
+    ERROR_OR_NEXT();
+
+    for (; i < self->num_children; ++i)
+    {
+        char_cnt = snprintf(&buffer[char_pos], size_left, "\"%s\",", self->children[i]->object_name);
+
+        ERROR_OR_NEXT();
+
+        if (i == self->num_children - 1)
+        {
+            /* remove last comma */
+            --char_pos;
+            ++size_left;
+        }
+    }
+
+    char_cnt = snprintf(&buffer[char_pos], size_left, "]}");
+
+    ERROR_OR_NEXT();
+
+    return char_pos;
+}
+
+typedef int (*to_json_fun_t)(node_t *self, char *buffer, int buffer_size);
+
+static int sized_node_to_json(node_t *self, char *buffer, int buffer_size)
+{
+    int size = node_json_size(self);
+
+    return (size < buffer_size) ? node_to_json(self, buffer, size + 1) : 0;
+}
+
+static void run(const char *label, tree_t *tree, to_json_fun_t to_json_fun, int rounds)
+{
+    char buffer[BENCH_BUFFER_SIZE];
+    long long num_chars = 0;
+    double start = bench_now();
+    double seconds = 0;
+    int num_nodes = tree->num_nodes + 1;
+    int i = 0;
+    int n = 0;
+
+    for (; i < rounds; ++i)
+    {
+        num_chars += (*to_json_fun)(tree->root, buffer, sizeof(buffer));
+
+        for (n = 0; n < tree->num_nodes; ++n)
+        {
+            num_chars += (*to_json_fun)(tree->nodes[n], buffer, sizeof(buffer));
+        }
+    }
+
+    seconds = bench_now() - start;
+
+    printf(
+        "%-24s %12.2f %12.2f\n",
+        label,
+        seconds * 1e9 / ((double)rounds * num_nodes),
+        num_chars / seconds / 1e6);
+}
+
+int main(int argc, char **argv)
+{
+    int num_nodes = (argc > 1) ? atoi(argv[1]) : 1000000;
+    int fanout = (argc > 2) ? atoi(argv[2]) : 4;
+    int rounds = (argc > 3) ? atoi(argv[3]) : 10;
+    tree_t tree;
+
+    tree_init(&tree);
+
+    if ((num_nodes < 1) || (fanout < 1) || (rounds < 1) || !bench_build_tree(&tree, num_nodes, fanout))
+    {
+        fprintf(stderr, "failed to build the tree\n");
+        return 1;
+    }
+
+    printf("%d nodes, fanout %d, %d rounds\n", num_nodes, fanout, rounds);
+    printf("%-24s %12s %12s\n", "", "ns per node", "MB/s");
+
+    run("snprintf", &tree, snprintf_node_to_json, rounds);
+    run("node_to_json", &tree, node_to_json, rounds);
+    run("node_json_size + to_json", &tree, sized_node_to_json, rounds);
+
+    tree_clear(&tree);
+    bench_dispose_names();
+
+    return 0;
+}
@@ -0,0 +1,198 @@
+/*
+ * Lookup throughput of lock-free readers of a tree_t with an epoch against tree_concurrent_t,
+ * optionally while a writer keeps adding and removing nodes
+ *
+ * usage: lockfree-bench [num_nodes [seconds_per_run [max_threads [with_writer]]]]
+ */
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include "bench-helpers.h"
+#include "cconcurrent.h"
+
+#define BENCH_NUM_WRITER_NAMES 1024
+#define BENCH_WRITER_NAME_SIZE 16
+
+typedef struct
+{
+    tree_concurrent_t *tree;
+    int lock_free; /* 0 to use tree_concurrent_t */
+    int num_nodes;
+    unsigned int seed;
+    int *stop;
+    long long num_ops;
+} bench_thread_t;
+
+static char g_writer_names[BENCH_NUM_WRITER_NAMES][BENCH_WRITER_NAME_SIZE];
+static int g_writer_value = -1;
+
+static void *reader_main(void *arg)
+{
+    bench_thread_t *self = arg;
+    epoch_reader_t *reader = self->lock_free ? epoch_register(self->tree->tree.epoch) : NULL;
+    const char *name = NULL;
+    long long num_ops = 0;
+
+    while (!__atomic_load_n(self->stop, __ATOMIC_RELAXED))
+    {
+        name = bench_node_name(rand_r(&self->seed) % self->num_nodes);
+
+        if (self->lock_free)
+        {
+            epoch_enter(reader);
+            tree_get_node(&self->tree->tree, name);
+            epoch_exit(reader);
+        }
+        else
+        {
+            tree_concurrent_get_node(self->tree, name);
+        }
+
+        ++num_ops;
+    }
+
+    epoch_unregister(reader);
+    self->num_ops = num_ops;
+
+    return NULL;
+}
+
+/* adds a node under a random one and removes it again */
+static void *writer_main(void *arg)
+{
+    bench_thread_t *self = arg;
+    const char *parent_name = NULL;
+    const char *name = NULL;
+    node_t *node = NULL;
+    node_t *added = NULL;
+    long long num_ops = 0;
+
+    while (!__atomic_load_n(self->stop, __ATOMIC_RELAXED))
+    {
+        parent_name = bench_node_name(rand_r(&self->seed) % self->num_nodes);
+        name = g_writer_names[num_ops % BENCH_NUM_WRITER_NAMES];
+        node = node_create(BENCH_INT, name, &g_writer_value);
+
+        if (self->lock_free)
+        {
+            added = tree_add_node(&self->tree->tree, node, parent_name);
+            tree_remove_node(&self->tree->tree, name);
+        }
+        else
+        {
+            added = tree_concurrent_add_node(self->tree, node, parent_name);
+            tree_concurrent_remove_node(self->tree, name);
+        }
+
+        if (added == NULL)
+        {
+            node_dispose(node);
+        }
+
+        ++num_ops;
+    }
+
+    self->num_ops = num_ops;
+
+    return NULL;
+}
+
+/* returns lookups per second */
+static double run(
+    tree_concurrent_t *tree,
+    int lock_free,
+    int num_nodes,
+    int num_threads,
+    int with_writer,
+    double seconds)
+{
+    pthread_t threads[num_threads + 1];
+    bench_thread_t contexts[num_threads + 1];
+    int stop = 0;
+    long long num_ops = 0;
+    double start = 0;
+    int i = 0;
+
+    start = bench_now();
+
+    for (i = 0; i < num_threads + with_writer; ++i)
+    {
+        contexts[i].tree = tree;
+        contexts[i].lock_free = lock_free;
+        contexts[i].num_nodes = num_nodes;
+        contexts[i].seed = i + 1;
+        contexts[i].stop = &stop;
+        contexts[i].num_ops = 0;
+        pthread_create(&threads[i], NULL, (i < num_threads) ? reader_main : writer_main, &contexts[i]);
+    }
+
+    usleep((useconds_t)(seconds * 1e6));
+    __atomic_store_n(&stop, 1, __ATOMIC_RELAXED);
+
+    for (i = 0; i < num_threads + with_writer; ++i)
+    {
+        pthread_join(threads[i], NULL);
+
+        if (i < num_threads)
+        {
+            num_ops += contexts[i].num_ops;
+        }
+    }
+
+    epoch_synchronize(tree->tree.epoch);
+
+    return num_ops / (bench_now() - start);
+}
+
+int main(int argc, char **argv)
+{
+    int num_nodes = (argc > 1) ? atoi(argv[1]) : 100000;
+    double seconds = (argc > 2) ? atof(argv[2]) : 1.0;
+    int max_threads = (argc > 3) ? atoi(argv[3]) : 32;
+    int with_writer = (argc > 4) ? (atoi(argv[4]) != 0) : 0;
+    epoch_t *epoch = epoch_create();
+    tree_concurrent_t tree;
+    double lock_free_ops = 0;
+    double rwlock_ops = 0;
+    int num_threads = 0;
+    int i = 0;
+
+    for (; i < BENCH_NUM_WRITER_NAMES; ++i)
+    {
+        snprintf(g_writer_names[i], BENCH_WRITER_NAME_SIZE, "w%d", i);
+    }
+
+    /* both variants use the same tree, tree_concurrent_t does not mind the epoch */
+    if ((epoch == NULL) || !tree_concurrent_init(&tree) ||
+        !bench_build_tree(&tree.tree, num_nodes, 4) || !tree_set_epoch(&tree.tree, epoch))
+    {
+        fprintf(stderr, "failed to build the tree\n");
+        return 1;
+    }
+
+    printf(
+        "%d nodes, %.1f s per run, lookups %s\n",
+        num_nodes,
+        seconds,
+        with_writer ? "while one writer adds and removes nodes" : "only");
+    printf("%8s %16s %16s %8s\n", "threads", "lock-free ops/s", "rwlock ops/s", "ratio");
+
+    for (num_threads = 1; num_threads <= max_threads; num_threads *= 2)
+    {
+        lock_free_ops = run(&tree, 1, num_nodes, num_threads, with_writer, seconds);
+        rwlock_ops = run(&tree, 0, num_nodes, num_threads, with_writer, seconds);
+        printf(
+            "%8d %16.0f %16.0f %8.2f\n",
+            num_threads,
+            lock_free_ops,
+            rwlock_ops,
+            lock_free_ops / rwlock_ops);
+    }
+
+    tree_concurrent_dispose(&tree);
+    epoch_dispose(epoch);
+    bench_dispose_names();
+
+    return 0;
+}
@@ -0,0 +1,166 @@
+#include "callocator.h"
+#include <malloc.h>
+#include <stdlib.h>
+
+static void *tree_std_malloc(void *ctx, size_t size)
+{
+    (void)ctx;
+    return malloc(size);
+}
+
+static void *tree_std_realloc(void *ctx, void *ptr, size_t size)
+{
+    (void)ctx;
+    return realloc(ptr, size);
+}
+
+static void tree_std_free(void *ctx, void *ptr)
+{
+    (void)ctx;
+    free(ptr);
+}
+
+static size_t tree_std_size(void *ctx, void *ptr)
+{
+    (void)ctx;
+    return malloc_usable_size(ptr);
+}
+
+static tree_allocator_t g_std_allocator = {tree_std_malloc, tree_std_realloc, tree_std_free, tree_std_size, NULL, 0, 0, 0, 0};
+static tree_allocator_t *g_default_allocator = &g_std_allocator;
+
+tree_allocator_t *tree_allocator_init(
+    tree_allocator_t *allocator,
+    tree_malloc_fun_t malloc_fun,
+    tree_realloc_fun_t realloc_fun,
+    tree_free_fun_t free_fun,
+    void *ctx)
+{
+    if ((allocator == NULL) || (malloc_fun == NULL) || (realloc_fun == NULL) || (free_fun == NULL))
+    {
+        return NULL;
+    }
+
+    allocator->malloc_fun = malloc_fun;
+    allocator->realloc_fun = realloc_fun;
+    allocator->free_fun = free_fun;
+    allocator->size_fun = NULL;
+    allocator->ctx = ctx;
+    allocator->counting = 0;
+    allocator->num_allocs = 0;
+    allocator->num_frees = 0;
+    allocator->num_bytes = 0;
+    return allocator;
+}
+
+void tree_allocator_set_size_fun(tree_allocator_t *allocator, tree_size_fun_t size_fun)
+{
+    if (allocator != NULL)
+    {
+        allocator->size_fun = size_fun;
+    }
+}
+
+void tree_allocator_count(tree_allocator_t *allocator, int counting)
+{
+    if (allocator == NULL)
+    {
+        return;
+    }
+
+    if (counting)
+    {
+        __atomic_store_n(&allocator->num_allocs, 0, __ATOMIC_RELAXED);
+        __atomic_store_n(&allocator->num_frees, 0, __ATOMIC_RELAXED);
+        __atomic_store_n(&allocator->num_bytes, 0, __ATOMIC_RELAXED);
+    }
+
+    __atomic_store_n(&allocator->counting, counting != 0, __ATOMIC_RELAXED);
+}
+
+void tree_allocator_set_default(tree_allocator_t *allocator)
+{
+    g_default_allocator = (allocator != NULL) ? allocator : &g_std_allocator;
+}
+
+tree_allocator_t *tree_allocator_default(void)
+{
+    return g_default_allocator;
+}
+
+/* trees of different threads can share an allocator */
+static void tree_allocator_add(long long *counter, long long value)
+{
+    __atomic_add_fetch(counter, value, __ATOMIC_RELAXED);
+}
+
+/* 0 without size_fun, so num_bytes stays 0 */
+static long long tree_allocator_size(tree_allocator_t *allocator, void *ptr)
+{
+    return ((ptr != NULL) && (allocator->size_fun != NULL)) ? (long long)(*allocator->size_fun)(allocator->ctx, ptr) : 0;
+}
+
+void *tree_malloc(tree_allocator_t *allocator, size_t size)
+{
+    void *ptr = NULL;
+
+    allocator = (allocator != NULL) ? allocator : g_default_allocator;
+    ptr = (*allocator->malloc_fun)(allocator->ctx, size);
+
+    if ((ptr != NULL) && __atomic_load_n(&allocator->counting, __ATOMIC_RELAXED))
+    {
+        tree_allocator_add(&allocator->num_allocs, 1);
+        tree_allocator_add(&allocator->num_bytes, tree_allocator_size(allocator, ptr));
+    }
+
+    return ptr;
+}
+
+void *tree_realloc(tree_allocator_t *allocator, void *ptr, size_t size)
+{
+    void *new_ptr = NULL;
+    long long old_size = 0;
+    int counting = 0;
+
+    allocator = (allocator != NULL) ? allocator : g_default_allocator;
+    counting = __atomic_load_n(&allocator->counting, __ATOMIC_RELAXED);
+
+    /* ptr cannot be asked once it is reallocated */
+    if (counting)
+    {
+        old_size = tree_allocator_size(allocator, ptr);
+    }
+
+    new_ptr = (*allocator->realloc_fun)(allocator->ctx, ptr, size);
+
+    if ((new_ptr != NULL) && counting)
+    {
+        tree_allocator_add(&allocator->num_allocs, (ptr == NULL) ? 1 : 0);
+        tree_allocator_add(&allocator->num_bytes, tree_allocator_size(allocator, new_ptr) - old_size);
+    }
+
+    return new_ptr;
+}
+
+void tree_free(tree_allocator_t *allocator, void *ptr)
+{
+    if (ptr == NULL)
+    {
+        return;
+    }
+
+    allocator = (allocator != NULL) ? allocator : g_default_allocator;
+
+    if (__atomic_load_n(&allocator->counting, __ATOMIC_RELAXED))
+    {
+        tree_allocator_add(&allocator->num_frees, 1);
+        tree_allocator_add(&allocator->num_bytes, -tree_allocator_size(allocator, ptr));
+    }
+
+    (*allocator->free_fun)(allocator->ctx, ptr);
+}
+
+void tree_free_with(void *ptr, void *ctx)
+{
+    tree_free(ctx, ptr);
+}
@@ -0,0 +1,145 @@
+#ifndef CALLOCATOR_H_
+#define CALLOCATOR_H_
+
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif /* __cplusplus */
+
+/**
+ * Allocates size bytes, should return NULL on failure, like malloc()
+ */
+typedef void *(*tree_malloc_fun_t)(void *ctx, size_t size);
+
+/**
+ * Resizes a block, ptr can be NULL, should return NULL and keep ptr on failure, like realloc()
+ */
+typedef void *(*tree_realloc_fun_t)(void *ctx, void *ptr, size_t size);
+
+/**
+ * Frees a block, ptr can be NULL, like free()
+ */
+typedef void (*tree_free_fun_t)(void *ctx, void *ptr);
+
+/**
+ * Size of a block, at least the size it was allocated with, like malloc_usable_size()
+ */
+typedef size_t (*tree_size_fun_t)(void *ctx, void *ptr);
+
+/**
+ * Memory of nodes and trees: node structs, names, children tables, nodes tables, hash indexes
+ * and the buffers tree operations need on the way
+ *
+ * Nodes use the default allocator at the time they are created, see node_create_with() for
+ * others, and trees the default one at tree_init(), see tree_set_allocator(). An allocator has to
+ * outlive all nodes and trees which use it.
+ */
+typedef struct
+{
+    tree_malloc_fun_t malloc_fun;
+    tree_realloc_fun_t realloc_fun;
+    tree_free_fun_t free_fun;
+    tree_size_fun_t size_fun; /**< can be NULL, see tree_allocator_set_size_fun() */
+    void *ctx; /**< passed to the functions as is */
+    int counting; /**< if not 0, the counters below are kept up to date, atomically */
+    long long num_allocs; /**< blocks allocated, realloc() of NULL included */
+    long long num_frees; /**< blocks freed, num_allocs - num_frees blocks are in use */
+    long long num_bytes; /**< bytes of the blocks in use by size_fun, 0 without size_fun */
+} tree_allocator_t;
+
+/**
+ * Initialize tree_allocator_t, counting is off and there is no size_fun
+ *
+ * @param[in] allocator - the allocator to initialize
+ * @param[in] malloc_fun - allocates memory
+ * @param[in] realloc_fun - resizes memory
+ * @param[in] free_fun - frees memory
+ * @param[in] ctx - passed to the functions as is, can be NULL
+ *
+ * @return NULL if allocator or any of the functions is NULL, allocator otherwise
+ */
+tree_allocator_t *tree_allocator_init(
+    tree_allocator_t *allocator,
+    tree_malloc_fun_t malloc_fun,
+    tree_realloc_fun_t realloc_fun,
+    tree_free_fun_t free_fun,
+    void *ctx);
+
+/**
+ * Set the function which gives sizes of blocks, so that num_bytes counts the bytes in use
+ *
+ * The default allocator has one, malloc_usable_size().
+ *
+ * @param[in,out] allocator - the allocator, function does nothing if allocator is NULL
+ * @param[in] size_fun - sizes of blocks of the allocator, NULL for none
+ */
+void tree_allocator_set_size_fun(tree_allocator_t *allocator, tree_size_fun_t size_fun);
+
+/**
+ * Start or stop keeping the counters of an allocator, starting resets them
+ *
+ * Blocks allocated before counting starts and freed after are subtracted all the same, so start
+ * it before the trees to attribute memory to are built.
+ *
+ * @param[in,out] allocator - the allocator, function does nothing if allocator is NULL
+ * @param[in] counting - 0 to stop, anything else to start
+ */
+void tree_allocator_count(tree_allocator_t *allocator, int counting);
+
+/**
+ * Set the allocator of nodes and trees created from now on
+ *
+ * @param[in] allocator - the new default, NULL to go back to malloc(), realloc() and free()
+ *
+ * @note Not thread safe, meant to be called once at startup
+ */
+void tree_allocator_set_default(tree_allocator_t *allocator);
+
+/**
+ * Get the allocator of nodes and trees created from now on
+ *
+ * @return the default allocator, never NULL
+ */
+tree_allocator_t *tree_allocator_default(void);
+
+/**
+ * Allocate memory
+ *
+ * @param[in,out] allocator - the allocator, NULL for the default one
+ * @param[in] size - number of bytes
+ *
+ * @return NULL if memory cannot be allocated, the block otherwise
+ */
+void *tree_malloc(tree_allocator_t *allocator, size_t size);
+
+/**
+ * Resize memory
+ *
+ * @param[in,out] allocator - the allocator ptr came from, NULL for the default one
+ * @param[in] ptr - the block, NULL to allocate a new one
+ * @param[in] size - new number of bytes
+ *
+ * @return NULL if memory cannot be allocated and ptr is left as is, the block otherwise
+ */
+void *tree_realloc(tree_allocator_t *allocator, void *ptr, size_t size);
+
+/**
+ * Free memory
+ *
+ * @param[in,out] allocator - the allocator ptr came from, NULL for the default one
+ * @param[in] ptr - the block, function does nothing if ptr is NULL
+ */
+void tree_free(tree_allocator_t *allocator, void *ptr);
+
+/**
+ * Same as tree_free(), ctx is the allocator, for epoch_retire_with()
+ */
+void tree_free_with(void *ptr, void *ctx);
+
+#ifdef __cplusplus
+} /* extern "C" */
+#endif /* __cplusplus */
+
+#endif /* CALLOCATOR_H_ */
@@ -0,0 +1,188 @@
+#include "carena.h"
+#include <stdint.h>
+#include <stdlib.h>
+#include "cnode.h"
+
+#define TREE_ARENA_SLAB_SIZE ((size_t)64 * 1024) /* also the alignment of slabs */
+#define TREE_ARENA_ALIGN __alignof__(node_t)
+
+typedef struct tree_arena_slab_s
+{
+    tree_arena_t *arena;
+    struct tree_arena_slab_s *prev;
+    struct tree_arena_slab_s *next;
+    size_t size;
+    size_t used; /* bytes handed out, header included */
+    int num_live; /* blocks in use */
+} tree_arena_slab_t;
+
+struct tree_arena_s
+{
+    tree_arena_slab_t *slabs; /* list of all slabs */
+    tree_arena_slab_t *current; /* allocations are bumped from here, NULL if none yet */
+    int num_slabs;
+};
+
+#define TREE_ARENA_HEADER_SIZE \
+    ((sizeof(tree_arena_slab_t) + TREE_ARENA_ALIGN - 1) / TREE_ARENA_ALIGN * TREE_ARENA_ALIGN)
+
+tree_arena_t *tree_arena_create(void)
+{
+    return calloc(1, sizeof(tree_arena_t));
+}
+
+void tree_arena_dispose(tree_arena_t *self)
+{
+    tree_arena_slab_t *slab = NULL;
+    tree_arena_slab_t *next = NULL;
+
+    if (self == NULL)
+    {
+        return;
+    }
+
+    for (slab = self->slabs; slab != NULL; slab = next)
+    {
+        next = slab->next;
+        free(slab);
+    }
+
+    free(self);
+}
+
+static void tree_arena_release_slab(tree_arena_slab_t *slab)
+{
+    tree_arena_t *arena = slab->arena;
+
+    if (slab->prev != NULL)
+    {
+        slab->prev->next = slab->next;
+    }
+    else
+    {
+        arena->slabs = slab->next;
+    }
+
+    if (slab->next != NULL)
+    {
+        slab->next->prev = slab->prev;
+    }
+
+    --arena->num_slabs;
+    free(slab);
+}
+
+static tree_arena_slab_t *tree_arena_add_slab(tree_arena_t *self, size_t size)
+{
+    tree_arena_slab_t *slab = NULL;
+    void *memory = NULL;
+
+    /* blocks find their slab by rounding their address down, see tree_arena_free() */
+    if (posix_memalign(&memory, TREE_ARENA_SLAB_SIZE, size) != 0)
+    {
+        return NULL;
+    }
+
+    slab = memory;
+    slab->arena = self;
+    slab->prev = NULL;
+    slab->next = self->slabs;
+    slab->size = size;
+    slab->used = TREE_ARENA_HEADER_SIZE;
+    slab->num_live = 0;
+
+    if (self->slabs != NULL)
+    {
+        self->slabs->prev = slab;
+    }
+
+    self->slabs = slab;
+    ++self->num_slabs;
+
+    return slab;
+}
+
+void *tree_arena_alloc(tree_arena_t *self, size_t size)
+{
+    tree_arena_slab_t *slab = NULL;
+    tree_arena_slab_t *full = NULL;
+
+    if ((self == NULL) || (size == 0))
+    {
+        return NULL;
+    }
+
+    size = (size + TREE_ARENA_ALIGN - 1) / TREE_ARENA_ALIGN * TREE_ARENA_ALIGN;
+    slab = self->current;
+
+    if ((slab == NULL) || (slab->used + size > slab->size))
+    {
+        full = slab;
+
+        /* too big for a shared slab, the current one stays */
+        if (TREE_ARENA_HEADER_SIZE + size > TREE_ARENA_SLAB_SIZE)
+        {
+            slab = tree_arena_add_slab(self, TREE_ARENA_HEADER_SIZE + size);
+
+            if (slab == NULL)
+            {
+                return NULL;
+            }
+
+            slab->used = slab->size;
+            ++slab->num_live;
+            return (char *)slab + TREE_ARENA_HEADER_SIZE;
+        }
+
+        slab = tree_arena_add_slab(self, TREE_ARENA_SLAB_SIZE);
+
+        if (slab == NULL)
+        {
+            return NULL;
+        }
+
+        self->current = slab;
+
+        /* nothing left in use and nothing more to come */
+        if ((full != NULL) && (full->num_live == 0))
+        {
+            tree_arena_release_slab(full);
+        }
+    }
+
+    ++slab->num_live;
+    slab->used += size;
+
+    return (char *)slab + slab->used - size;
+}
+
+void tree_arena_free(void *ptr)
+{
+    tree_arena_slab_t *slab = NULL;
+
+    if (ptr == NULL)
+    {
+        return;
+    }
+
+    slab = (tree_arena_slab_t *)((uintptr_t)ptr & ~(uintptr_t)(TREE_ARENA_SLAB_SIZE - 1));
+
+    if (--slab->num_live > 0)
+    {
+        return;
+    }
+
+    /* the current slab is reused from the start instead */
+    if (slab == slab->arena->current)
+    {
+        slab->used = TREE_ARENA_HEADER_SIZE;
+        return;
+    }
+
+    tree_arena_release_slab(slab);
+}
+
+int tree_arena_num_slabs(tree_arena_t *self)
+{
+    return (self == NULL) ? 0 : self->num_slabs;
+}
@@ -0,0 +1,68 @@
+#ifndef CARENA_H_
+#define CARENA_H_
+
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif /* __cplusplus */
+
+/**
+ * Slab allocator for nodes, opaque
+ *
+ * Memory is carved from large aligned slabs by bumping a pointer. Every slab counts the blocks
+ * still in use and goes back to the system as a whole once the count drops to zero, so disposing
+ * of a tree or of a sub tree built in one go releases whole slabs instead of single blocks.
+ * Not thread safe, with an epoch it is used by the writer only, see tree_set_epoch().
+ */
+typedef struct tree_arena_s tree_arena_t;
+
+/**
+ * Create an empty arena, slabs are allocated on demand
+ *
+ * @return NULL if memory cannot be allocated, new arena otherwise
+ */
+tree_arena_t *tree_arena_create(void);
+
+/**
+ * Free all slabs and the arena itself
+ *
+ * @param[in,out] self - the arena, function does nothing if self is NULL
+ *
+ * @warning Memory still in use is freed too, dispose of the nodes first.
+ */
+void tree_arena_dispose(tree_arena_t *self);
+
+/**
+ * Allocate a block from the current slab, or from a new one if it is full
+ *
+ * @param[in,out] self - the arena
+ * @param[in] size - size of the block, blocks which do not fit a slab get a slab of their own
+ *
+ * @return NULL if self is NULL, size is 0 or memory cannot be allocated,
+ *         block aligned for node_t otherwise
+ */
+void *tree_arena_alloc(tree_arena_t *self, size_t size);
+
+/**
+ * Give a block back, its slab is released when none of its blocks is in use any more
+ *
+ * @param[in] ptr - block from tree_arena_alloc(), function does nothing if ptr is NULL
+ */
+void tree_arena_free(void *ptr);
+
+/**
+ * Get the number of slabs the arena holds
+ *
+ * @param[in] self - the arena
+ *
+ * @return 0 if self is NULL, number of slabs otherwise
+ */
+int tree_arena_num_slabs(tree_arena_t *self);
+
+#ifdef __cplusplus
+} /* extern "C" */
+#endif /* __cplusplus */
+
+#endif /* CARENA_H_ */
@@ -0,0 +1,95 @@
+#include "cbinary.h"
+#include <fcntl.h>
+#include <string.h>
+#include <unistd.h>
+
+int tree_varint_encode(unsigned int number, unsigned char *bytes)
+{
+    int size = 0;
+
+    while (number >= 0x80u)
+    {
+        bytes[size++] = (unsigned char)(number | 0x80u);
+        number >>= 7;
+    }
+
+    bytes[size++] = (unsigned char)number;
+
+    return size;
+}
+
+int tree_varint_decode(const unsigned char **data, const unsigned char *end, unsigned int *number)
+{
+    const unsigned char *next = *data;
+    unsigned int shift = 0;
+    unsigned int byte = 0;
+
+    *number = 0;
+
+    do
+    {
+        /* the 5th byte holds the 4 highest bits and ends the varint */
+        if ((next == end) || (shift > 28) || ((shift == 28) && (*next > 0x0fu)))
+        {
+            return 0;
+        }
+
+        byte = *next++;
+        *number |= (byte & 0x7fu) << shift;
+        shift += 7;
+    }
+    while (byte & 0x80u);
+
+    *data = next;
+    return 1;
+}
+
+int value_binary_size(value_handlers_t *value_handlers, void *value)
+{
+    value_to_binary_fun_t to_binary_fun = value_handlers->to_binary_fun;
+    int size = (to_binary_fun != NULL) ? (*to_binary_fun)(value, NULL, 0) : -1;
+
+    return (size < 0) ? -1 : size;
+}
+
+int value_binary_write(value_handlers_t *value_handlers, void *value, char *buffer, int size)
+{
+    /* same size as measured, the value must not change in between */
+    return (size == 0) || ((*value_handlers->to_binary_fun)(value, buffer, size) == size);
+}
+
+int tree_sync_dir(tree_allocator_t *allocator, const char *path)
+{
+    const char *slash = strrchr(path, '/');
+    size_t dir_size = (slash == NULL) ? 0 : (slash == path) ? 1 : (size_t)(slash - path);
+    char *dir = tree_malloc(allocator, dir_size + 2);
+    int fd = -1;
+    int synced = 0;
+
+    if (dir == NULL)
+    {
+        return 0;
+    }
+
+    if (slash == NULL)
+    {
+        strcpy(dir, ".");
+    }
+    else
+    {
+        memcpy(dir, path, dir_size);
+        dir[dir_size] = '\0';
+    }
+
+    fd = open(dir, O_RDONLY | O_DIRECTORY);
+    synced = (fd >= 0) && (fsync(fd) == 0);
+
+    if (fd >= 0)
+    {
+        close(fd);
+    }
+
+    tree_free(allocator, dir);
+
+    return synced;
+}
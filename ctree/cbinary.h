@@ -0,0 +1,74 @@
+#ifndef CBINARY_H_
+#define CBINARY_H_
+
+#include "cnode.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif /* __cplusplus */
+
+/**
+ * Most bytes of a varint, enough for 32 bits
+ */
+#define TREE_VARINT_MAX_SIZE 5
+
+/**
+ * Encode a number as an unsigned LEB128 varint, the form of ccompact.h and cjournal.h
+ *
+ * @param[in] number - the number
+ * @param[out] bytes - at least TREE_VARINT_MAX_SIZE bytes
+ *
+ * @return number of bytes written
+ */
+int tree_varint_encode(unsigned int number, unsigned char *bytes);
+
+/**
+ * Decode a varint of up to 32 bits, see tree_varint_encode()
+ *
+ * @param[in,out] data - the input, moved past the varint on success
+ * @param[in] end - end of the input
+ * @param[out] number - the number
+ *
+ * @return 0 if the input ends or the number does not fit in 32 bits, 1 otherwise
+ */
+int tree_varint_decode(const unsigned char **data, const unsigned char *end, unsigned int *number);
+
+/**
+ * Measure the payload of a value, see value_to_binary_fun_t
+ *
+ * @param[in] value_handlers - handlers of the value
+ * @param[in] value - the value
+ *
+ * @return -1 if there is no to_binary_fun or it fails, size of the payload otherwise
+ */
+int value_binary_size(value_handlers_t *value_handlers, void *value);
+
+/**
+ * Write the payload of a value measured by value_binary_size()
+ *
+ * @param[in] value_handlers - handlers of the value
+ * @param[in] value - the value
+ * @param[out] buffer - the buffer to write to, of size bytes
+ * @param[in] size - size measured by value_binary_size()
+ *
+ * @return 0 if the payload is not of the measured size any more, 1 otherwise
+ */
+int value_binary_write(value_handlers_t *value_handlers, void *value, char *buffer, int size);
+
+/**
+ * Sync the directory which holds a file, a rename is only durable once it is synced too
+ *
+ * @param[in] allocator - allocator of the directory path, NULL for the default one
+ * @param[in] path - path of the file
+ *
+ * @return 0 if memory cannot be allocated or the directory cannot be opened or synced,
+ *         1 otherwise
+ */
+int tree_sync_dir(tree_allocator_t *allocator, const char *path);
+
+#ifdef __cplusplus
+} /* extern "C" */
+#endif /* __cplusplus */
+
+#endif /* CBINARY_H_ */
@@ -0,0 +1,355 @@
+#include "ccompact.h"
+#include "cbinary.h"
+#include <limits.h>
+#include <string.h>
+
+#define TREE_COMPACT_MAGIC "CTRC"
+#define TREE_COMPACT_MAGIC_SIZE 4
+#define TREE_COMPACT_HEADER_SIZE (TREE_COMPACT_MAGIC_SIZE + 1)
+
+/* the smallest node: parent distance, shared prefix, suffix length and value size */
+#define TREE_COMPACT_MIN_NODE_SIZE 4
+
+/* counts everything, writes only what fits, like node_json_writer_t */
+typedef struct
+{
+    char *buffer;
+    int size;
+    int pos;
+    int failed;
+} tree_compact_writer_t;
+
+/* input left to decode */
+typedef struct
+{
+    const unsigned char *data;
+    const unsigned char *end;
+} tree_compact_reader_t;
+
+static void tree_compact_put(tree_compact_writer_t *writer, const void *data, int size)
+{
+    if (size > INT_MAX - writer->pos)
+    {
+        writer->failed = 1;
+        return;
+    }
+
+    if ((size > 0) && (size <= writer->size - writer->pos))
+    {
+        memcpy(writer->buffer + writer->pos, data, size);
+    }
+
+    writer->pos += size;
+}
+
+static void tree_compact_put_varint(tree_compact_writer_t *writer, unsigned int number)
+{
+    unsigned char bytes[TREE_VARINT_MAX_SIZE];
+
+    tree_compact_put(writer, bytes, tree_varint_encode(number, bytes));
+}
+
+/* size first, then the payload in place if it fits */
+static void tree_compact_put_value(tree_compact_writer_t *writer, node_t *node)
+{
+    int size = value_binary_size(node->value_handlers, node->value);
+
+    if (size < 0)
+    {
+        writer->failed = 1;
+        return;
+    }
+
+    tree_compact_put_varint(writer, (unsigned int)size);
+
+    if (size > INT_MAX - writer->pos)
+    {
+        writer->failed = 1;
+        return;
+    }
+
+    if ((size <= writer->size - writer->pos) &&
+        !value_binary_write(node->value_handlers, node->value, writer->buffer + writer->pos, size))
+    {
+        writer->failed = 1;
+        return;
+    }
+
+    writer->pos += size;
+}
+
+static int tree_compact_shared_prefix(const char *a, const char *b)
+{
+    int i = 0;
+
+    while ((a[i] != '\0') && (a[i] == b[i]))
+    {
+        ++i;
+    }
+
+    return i;
+}
+
+/* the nodes of the subtree of root in pre-order, parents are found on a stack of ancestors */
+static int tree_compact_encode(tree_t *tree, node_t *root, int num_nodes, char *buffer, int buffer_size)
+{
+    static const char version = TREE_COMPACT_VERSION;
+    tree_compact_writer_t writer;
+    const char *previous_name = "";
+    node_t **ancestors = NULL;
+    int *positions = NULL;
+    int num_ancestors = 0;
+    int depth = tree_depth(tree);
+    node_t *node = NULL;
+    int prefix = 0;
+    int suffix = 0;
+    int i = 0;
+
+    writer.buffer = buffer;
+    writer.size = buffer_size;
+    writer.pos = 0;
+    writer.failed = 0;
+
+    tree_compact_put(&writer, TREE_COMPACT_MAGIC, TREE_COMPACT_MAGIC_SIZE);
+    tree_compact_put(&writer, &version, 1);
+    tree_compact_put_varint(&writer, (unsigned int)num_nodes);
+
+    if (num_nodes == 0)
+    {
+        return writer.pos;
+    }
+
+    /* no path is longer than the tree is deep */
+    ancestors = tree_malloc(tree->allocator, depth * sizeof(node_t *));
+    positions = tree_malloc(tree->allocator, depth * sizeof(int));
+    writer.failed = (ancestors == NULL) || (positions == NULL) ||
+                    !tree_iter_start(&tree->scratch, root, TREE_ITER_PRE_ORDER);
+
+    while (!writer.failed && ((node = tree_iter_next(&tree->scratch)) != NULL))
+    {
+        while ((num_ancestors > 0) && (ancestors[num_ancestors - 1] != node->parent))
+        {
+            --num_ancestors;
+        }
+
+        prefix = tree_compact_shared_prefix(previous_name, node->object_name);
+        suffix = (int)strlen(node->object_name + prefix);
+
+        tree_compact_put_varint(&writer, (num_ancestors > 0) ? (unsigned int)(i - positions[num_ancestors - 1]) : 0);
+        tree_compact_put_varint(&writer, (unsigned int)prefix);
+        tree_compact_put_varint(&writer, (unsigned int)suffix);
+        tree_compact_put(&writer, node->object_name + prefix, suffix);
+        tree_compact_put_value(&writer, node);
+
+        if (num_ancestors == depth)
+        {
+            writer.failed = 1;
+            break;
+        }
+
+        ancestors[num_ancestors] = node;
+        positions[num_ancestors++] = i++;
+        previous_name = node->object_name;
+    }
+
+    writer.failed = writer.failed || tree->scratch.out_of_memory || (i != num_nodes);
+
+    tree_free(tree->allocator, positions);
+    tree_free(tree->allocator, ancestors);
+
+    return writer.failed ? 0 : writer.pos;
+}
+
+int tree_to_compact(tree_t *tree, char *buffer, int buffer_size)
+{
+    if ((tree == NULL) || ((buffer == NULL) && (buffer_size != 0)) || (buffer_size < 0))
+    {
+        return 0;
+    }
+
+    return tree_compact_encode(tree, tree->root, (tree->root != NULL) ? tree->num_nodes + 1 : 0, buffer, buffer_size);
+}
+
+int tree_subtree_to_compact(tree_t *tree, const char *sub_tree_root_name, char *buffer, int buffer_size)
+{
+    node_t *root = NULL;
+    int num_nodes = 0;
+
+    if ((tree == NULL) || (sub_tree_root_name == NULL) || ((buffer == NULL) && (buffer_size != 0)) ||
+        (buffer_size < 0))
+    {
+        return 0;
+    }
+
+    root = tree_get_node(tree, sub_tree_root_name);
+
+    /* counted in a walk of its own, the labels would cost a walk of the whole tree */
+    if ((root == NULL) || !tree_iter_start(&tree->scratch, root, TREE_ITER_PRE_ORDER))
+    {
+        return 0;
+    }
+
+    while (tree_iter_next(&tree->scratch) != NULL)
+    {
+        ++num_nodes;
+    }
+
+    if (tree->scratch.out_of_memory)
+    {
+        return 0;
+    }
+
+    return tree_compact_encode(tree, root, num_nodes, buffer, buffer_size);
+}
+
+/* a number which is also a size or position, so it has to fit in an int */
+static int tree_compact_get_int(tree_compact_reader_t *reader, int *number)
+{
+    unsigned int value = 0;
+
+    if (!tree_varint_decode(&reader->data, reader->end, &value) || (value > INT_MAX))
+    {
+        return 0;
+    }
+
+    *number = (int)value;
+    return 1;
+}
+
+/* the next node, its name is the previous one cut to the shared prefix, plus the suffix */
+static node_t *tree_compact_get_node(
+    tree_compact_reader_t *reader,
+    tree_t *tree,
+    value_handlers_t *value_handlers,
+    char **name,
+    int *name_capacity,
+    int *name_size)
+{
+    node_t *node = NULL;
+    char *grown = NULL;
+    void *value = NULL;
+    int prefix = 0;
+    int suffix = 0;
+    int value_size = 0;
+
+    if (!tree_compact_get_int(reader, &prefix) || (prefix > *name_size) ||
+        !tree_compact_get_int(reader, &suffix) || (suffix > reader->end - reader->data) ||
+        (memchr(reader->data, '\0', suffix) != NULL))
+    {
+        return NULL;
+    }
+
+    if (prefix + suffix + 1 > *name_capacity)
+    {
+        grown = tree_realloc(NULL, *name, prefix + suffix + 1);
+
+        if (grown == NULL)
+        {
+            return NULL;
+        }
+
+        *name = grown;
+        *name_capacity = prefix + suffix + 1;
+    }
+
+    memcpy(*name + prefix, reader->data, suffix);
+    *name_size = prefix + suffix;
+    (*name)[*name_size] = '\0';
+    reader->data += suffix;
+
+    if (!tree_compact_get_int(reader, &value_size) || (value_size > reader->end - reader->data))
+    {
+        return NULL;
+    }
+
+    if (!(*value_handlers->from_binary_fun)((const char *)reader->data, value_size, &value))
+    {
+        return NULL;
+    }
+
+    reader->data += value_size;
+
+    node = node_create_with(tree->allocator, value_handlers, *name, value);
+
+    if ((node == NULL) && (value_handlers->dispose_fun != NULL))
+    {
+        (*value_handlers->dispose_fun)(value);
+    }
+
+    return node;
+}
+
+int tree_from_compact(tree_t *tree, value_handlers_t *value_handlers, const char *data, int size)
+{
+    tree_compact_reader_t reader;
+    node_t **nodes = NULL;
+    const char **parent_names = NULL;
+    char *name = NULL;
+    int name_capacity = 0;
+    int name_size = 0;
+    int num_nodes = 0;
+    int distance = 0;
+    int built = 0;
+    int i = 0;
+
+    if ((tree == NULL) || (tree->root != NULL) || (value_handlers == NULL) ||
+        (value_handlers->from_binary_fun == NULL) || (data == NULL) || (size < TREE_COMPACT_HEADER_SIZE) ||
+        (memcmp(data, TREE_COMPACT_MAGIC, TREE_COMPACT_MAGIC_SIZE) != 0) ||
+        (data[TREE_COMPACT_MAGIC_SIZE] != TREE_COMPACT_VERSION))
+    {
+        return 0;
+    }
+
+    reader.data = (const unsigned char *)data + TREE_COMPACT_HEADER_SIZE;
+    reader.end = (const unsigned char *)data + size;
+
+    /* the count is checked against the input before anything is allocated for it */
+    if (!tree_compact_get_int(&reader, &num_nodes) ||
+        (num_nodes > (reader.end - reader.data) / TREE_COMPACT_MIN_NODE_SIZE))
+    {
+        return 0;
+    }
+
+    if (num_nodes == 0)
+    {
+        return reader.data == reader.end;
+    }
+
+    nodes = tree_malloc(NULL, num_nodes * sizeof(node_t *));
+    parent_names = tree_malloc(NULL, num_nodes * sizeof(const char *));
+
+    for (; (nodes != NULL) && (parent_names != NULL) && (i < num_nodes); ++i)
+    {
+        /* parents come before their children, only the root has none */
+        if (!tree_compact_get_int(&reader, &distance) || (distance > i) || ((distance == 0) != (i == 0)))
+        {
+            break;
+        }
+
+        nodes[i] = tree_compact_get_node(&reader, tree, value_handlers, &name, &name_capacity, &name_size);
+
+        if (nodes[i] == NULL)
+        {
+            break;
+        }
+
+        parent_names[i] = (distance > 0) ? nodes[i - distance]->object_name : NULL;
+    }
+
+    built = (i == num_nodes) && (reader.data == reader.end) &&
+            (tree_build(tree, nodes, parent_names, num_nodes, NULL) == TREE_BUILD_OK);
+
+    if (!built)
+    {
+        while (i > 0)
+        {
+            node_dispose(nodes[--i]);
+        }
+    }
+
+    tree_free(NULL, name);
+    tree_free(NULL, parent_names);
+    tree_free(NULL, nodes);
+
+    return built;
+}
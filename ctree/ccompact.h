@@ -0,0 +1,73 @@
+#ifndef CCOMPACT_H_
+#define CCOMPACT_H_
+
+#include "ctree.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif /* __cplusplus */
+
+/**
+ * Version of the encoding, the byte after the magic "CTRC"
+ */
+#define TREE_COMPACT_VERSION 1
+
+/**
+ * Encode a whole tree in the compact binary form, to ship it to another process
+ *
+ * After the magic and the version comes the number of nodes, then the nodes in pre-order. Each
+ * node is the distance back to its parent, 0 for the root, the length of the prefix its name
+ * shares with the name of the node before it, the rest of the name and the value payload of
+ * value_to_binary_fun_t with its size in front. All numbers are unsigned LEB128 varints, so the
+ * form does not depend on the byte order, values aside.
+ *
+ * Follows the snprintf convention: writes as much as fits in buffer and returns the size of the
+ * whole encoding, so tree_to_compact(tree, NULL, 0) gives the size of the buffer to pass.
+ *
+ * @param[in] tree - the tree to encode, it is left as is
+ * @param[out] buffer - the buffer to write to (can be NULL if buffer_size is 0)
+ * @param[in] buffer_size - size of the buffer
+ *
+ * @return 0 if tree is NULL, buffer is NULL and buffer_size is not 0, a value has no
+ *         to_binary_fun or it fails, memory cannot be allocated or the encoding would be larger
+ *         than INT_MAX, size of the whole encoding otherwise
+ */
+int tree_to_compact(tree_t *tree, char *buffer, int buffer_size);
+
+/**
+ * Encode the subtree rooted in a node in the compact binary form, see tree_to_compact()
+ *
+ * The root of the subtree is encoded as the root, tree_from_compact() builds a tree of it.
+ *
+ * @param[in] tree - the tree, it is left as is
+ * @param[in] sub_tree_root_name - name of the root of the subtree
+ * @param[out] buffer - the buffer to write to (can be NULL if buffer_size is 0)
+ * @param[in] buffer_size - size of the buffer
+ *
+ * @return 0 if tree or sub_tree_root_name is NULL, buffer is NULL and buffer_size is not 0, the
+ *         node is not found, a value has no to_binary_fun or it fails, memory cannot be allocated
+ *         or the encoding would be larger than INT_MAX, size of the whole encoding otherwise
+ */
+int tree_subtree_to_compact(tree_t *tree, const char *sub_tree_root_name, char *buffer, int buffer_size);
+
+/**
+ * Build a tree from the compact binary form, see tree_to_compact() and tree_build()
+ *
+ * @param[in,out] tree - empty tree to build, the nodes come from its allocator
+ * @param[in] value_handlers - handlers of the values of all nodes, values are created with
+ *                             value_from_binary_fun_t and can be NULL
+ * @param[in] data - the encoding
+ * @param[in] size - size of the encoding, the encoding has to take all of it
+ *
+ * @return 0 if any pointer is NULL, tree is not empty, there is no from_binary_fun or it fails,
+ *         the encoding is not valid or memory cannot be allocated, in which case the tree is
+ *         left as is, 1 otherwise
+ */
+int tree_from_compact(tree_t *tree, value_handlers_t *value_handlers, const char *data, int size);
+
+#ifdef __cplusplus
+} /* extern "C" */
+#endif /* __cplusplus */
+
+#endif /* CCOMPACT_H_ */
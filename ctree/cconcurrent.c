@@ -0,0 +1,453 @@
+#include "cconcurrent.h"
+#include <string.h>
+
+int tree_rwlock_init(tree_rwlock_t *self)
+{
+    if (self == NULL)
+    {
+        return 0;
+    }
+
+    memset(self, 0, sizeof(tree_rwlock_t));
+
+    if (pthread_mutex_init(&self->mutex, NULL) != 0)
+    {
+        return 0;
+    }
+
+    if (pthread_cond_init(&self->readers_cond, NULL) != 0)
+    {
+        pthread_mutex_destroy(&self->mutex);
+        return 0;
+    }
+
+    if (pthread_cond_init(&self->writers_cond, NULL) != 0)
+    {
+        pthread_cond_destroy(&self->readers_cond);
+        pthread_mutex_destroy(&self->mutex);
+        return 0;
+    }
+
+    if (pthread_cond_init(&self->drained_cond, NULL) != 0)
+    {
+        pthread_cond_destroy(&self->writers_cond);
+        pthread_cond_destroy(&self->readers_cond);
+        pthread_mutex_destroy(&self->mutex);
+        return 0;
+    }
+
+    return 1;
+}
+
+void tree_rwlock_dispose(tree_rwlock_t *self)
+{
+    if (self == NULL)
+    {
+        return;
+    }
+
+    pthread_cond_destroy(&self->drained_cond);
+    pthread_cond_destroy(&self->writers_cond);
+    pthread_cond_destroy(&self->readers_cond);
+    pthread_mutex_destroy(&self->mutex);
+}
+
+void tree_rwlock_lock_shared(tree_rwlock_t *self)
+{
+    if (self == NULL)
+    {
+        return;
+    }
+
+    for (;;)
+    {
+        /*
+         * Announce the reader first, then look for a writer. The writer does it the other way
+         * round, so at least one of them sees the other.
+         */
+        if (!__atomic_load_n(&self->writer, __ATOMIC_SEQ_CST))
+        {
+            __atomic_add_fetch(&self->num_readers, 1, __ATOMIC_SEQ_CST);
+
+            if (!__atomic_load_n(&self->writer, __ATOMIC_SEQ_CST))
+            {
+                return;
+            }
+
+            /* a writer came in between, get out of its way */
+            tree_rwlock_unlock_shared(self);
+        }
+
+        pthread_mutex_lock(&self->mutex);
+
+        while (__atomic_load_n(&self->writer, __ATOMIC_SEQ_CST) || (self->num_writers_waiting > 0))
+        {
+            pthread_cond_wait(&self->readers_cond, &self->mutex);
+        }
+
+        pthread_mutex_unlock(&self->mutex);
+    }
+}
+
+void tree_rwlock_unlock_shared(tree_rwlock_t *self)
+{
+    if (self == NULL)
+    {
+        return;
+    }
+
+    if ((__atomic_sub_fetch(&self->num_readers, 1, __ATOMIC_SEQ_CST) == 0) &&
+        __atomic_load_n(&self->writer, __ATOMIC_SEQ_CST))
+    {
+        /* the writer checks num_readers under the mutex, so it cannot miss this */
+        pthread_mutex_lock(&self->mutex);
+        pthread_cond_signal(&self->drained_cond);
+        pthread_mutex_unlock(&self->mutex);
+    }
+}
+
+void tree_rwlock_lock_exclusive(tree_rwlock_t *self)
+{
+    if (self == NULL)
+    {
+        return;
+    }
+
+    pthread_mutex_lock(&self->mutex);
+
+    /* from now on new readers wait */
+    ++self->num_writers_waiting;
+
+    while (__atomic_load_n(&self->writer, __ATOMIC_SEQ_CST))
+    {
+        pthread_cond_wait(&self->writers_cond, &self->mutex);
+    }
+
+    --self->num_writers_waiting;
+    __atomic_store_n(&self->writer, 1, __ATOMIC_SEQ_CST);
+
+    while (__atomic_load_n(&self->num_readers, __ATOMIC_SEQ_CST) > 0)
+    {
+        pthread_cond_wait(&self->drained_cond, &self->mutex);
+    }
+
+    pthread_mutex_unlock(&self->mutex);
+}
+
+void tree_rwlock_unlock_exclusive(tree_rwlock_t *self)
+{
+    if (self == NULL)
+    {
+        return;
+    }
+
+    pthread_mutex_lock(&self->mutex);
+
+    __atomic_store_n(&self->writer, 0, __ATOMIC_SEQ_CST);
+
+    if (self->num_writers_waiting > 0)
+    {
+        /* writers go first, readers keep waiting */
+        pthread_cond_signal(&self->writers_cond);
+    }
+    else
+    {
+        pthread_cond_broadcast(&self->readers_cond);
+    }
+
+    pthread_mutex_unlock(&self->mutex);
+}
+
+int tree_concurrent_init(tree_concurrent_t *self)
+{
+    if (self == NULL)
+    {
+        return 0;
+    }
+
+    tree_init(&self->tree);
+
+    return tree_rwlock_init(&self->lock);
+}
+
+void tree_concurrent_dispose(tree_concurrent_t *self)
+{
+    if (self == NULL)
+    {
+        return;
+    }
+
+    tree_clear(&self->tree);
+    tree_rwlock_dispose(&self->lock);
+}
+
+tree_t *tree_concurrent_read_lock(tree_concurrent_t *self)
+{
+    if (self == NULL)
+    {
+        return NULL;
+    }
+
+    tree_rwlock_lock_shared(&self->lock);
+
+    return &self->tree;
+}
+
+void tree_concurrent_read_unlock(tree_concurrent_t *self)
+{
+    if (self == NULL)
+    {
+        return;
+    }
+
+    tree_rwlock_unlock_shared(&self->lock);
+}
+
+tree_t *tree_concurrent_write_lock(tree_concurrent_t *self)
+{
+    if (self == NULL)
+    {
+        return NULL;
+    }
+
+    tree_rwlock_lock_exclusive(&self->lock);
+
+    return &self->tree;
+}
+
+void tree_concurrent_write_unlock(tree_concurrent_t *self)
+{
+    if (self == NULL)
+    {
+        return;
+    }
+
+    tree_rwlock_unlock_exclusive(&self->lock);
+}
+
+/*
+ * Labels are re-calculated by the first query after a change, which needs the lock exclusive.
+ * Returns 1 if the lock was taken exclusive.
+ */
+static int tree_concurrent_lock_labelled(tree_concurrent_t *self, int needs_jumps)
+{
+    tree_rwlock_lock_shared(&self->lock);
+
+    if (self->tree.labels_valid && (!needs_jumps || self->tree.jumps_valid))
+    {
+        return 0;
+    }
+
+    tree_rwlock_unlock_shared(&self->lock);
+    tree_rwlock_lock_exclusive(&self->lock);
+
+    return 1;
+}
+
+static void tree_concurrent_unlock_labelled(tree_concurrent_t *self, int exclusive)
+{
+    if (exclusive)
+    {
+        tree_rwlock_unlock_exclusive(&self->lock);
+    }
+    else
+    {
+        tree_rwlock_unlock_shared(&self->lock);
+    }
+}
+
+node_t *tree_concurrent_get_node(tree_concurrent_t *self, const char *node_name)
+{
+    node_t *node = NULL;
+
+    if (self == NULL)
+    {
+        return NULL;
+    }
+
+    tree_rwlock_lock_shared(&self->lock);
+    node = tree_get_node(&self->tree, node_name);
+    tree_rwlock_unlock_shared(&self->lock);
+
+    return node;
+}
+
+node_t *tree_concurrent_add_node(
+    tree_concurrent_t *self,
+    node_t *new_node,
+    const char *parent_node_name)
+{
+    node_t *node = NULL;
+
+    if (self == NULL)
+    {
+        return NULL;
+    }
+
+    tree_rwlock_lock_exclusive(&self->lock);
+    node = tree_add_node(&self->tree, new_node, parent_node_name);
+    tree_rwlock_unlock_exclusive(&self->lock);
+
+    return node;
+}
+
+node_t *tree_concurrent_add_tree(
+    tree_concurrent_t *self,
+    tree_t *sub_tree,
+    const char *parent_node_name)
+{
+    node_t *node = NULL;
+
+    if (self == NULL)
+    {
+        return NULL;
+    }
+
+    tree_rwlock_lock_exclusive(&self->lock);
+    node = tree_add_tree(&self->tree, sub_tree, parent_node_name);
+    tree_rwlock_unlock_exclusive(&self->lock);
+
+    return node;
+}
+
+int tree_concurrent_remove_node(tree_concurrent_t *self, const char *node_name)
+{
+    int removed = 0;
+
+    if (self == NULL)
+    {
+        return 0;
+    }
+
+    tree_rwlock_lock_exclusive(&self->lock);
+    removed = tree_remove_node(&self->tree, node_name);
+    tree_rwlock_unlock_exclusive(&self->lock);
+
+    return removed;
+}
+
+int tree_concurrent_remove_tree(tree_concurrent_t *self, const char *sub_tree_root_name)
+{
+    int removed_cnt = 0;
+
+    if (self == NULL)
+    {
+        return 0;
+    }
+
+    tree_rwlock_lock_exclusive(&self->lock);
+    removed_cnt = tree_remove_tree(&self->tree, sub_tree_root_name);
+    tree_rwlock_unlock_exclusive(&self->lock);
+
+    return removed_cnt;
+}
+
+int tree_concurrent_depth(tree_concurrent_t *self)
+{
+    int depth = 0;
+
+    if (self == NULL)
+    {
+        return 0;
+    }
+
+    tree_rwlock_lock_shared(&self->lock);
+    depth = tree_depth(&self->tree);
+    tree_rwlock_unlock_shared(&self->lock);
+
+    return depth;
+}
+
+int tree_concurrent_is_ancestor(
+    tree_concurrent_t *self,
+    const char *ancestor_name,
+    const char *descendant_name)
+{
+    int exclusive = 0;
+    int is_ancestor = 0;
+
+    if (self == NULL)
+    {
+        return 0;
+    }
+
+    exclusive = tree_concurrent_lock_labelled(self, 0);
+    is_ancestor = tree_is_ancestor(&self->tree, ancestor_name, descendant_name);
+    tree_concurrent_unlock_labelled(self, exclusive);
+
+    return is_ancestor;
+}
+
+int tree_concurrent_subtree_size(tree_concurrent_t *self, const char *sub_tree_root_name)
+{
+    int exclusive = 0;
+    int size = 0;
+
+    if (self == NULL)
+    {
+        return 0;
+    }
+
+    exclusive = tree_concurrent_lock_labelled(self, 0);
+    size = tree_subtree_size(&self->tree, sub_tree_root_name);
+    tree_concurrent_unlock_labelled(self, exclusive);
+
+    return size;
+}
+
+node_t *tree_concurrent_lca(
+    tree_concurrent_t *self,
+    const char *node_name_a,
+    const char *node_name_b)
+{
+    int exclusive = 0;
+    node_t *lca = NULL;
+
+    if (self == NULL)
+    {
+        return NULL;
+    }
+
+    exclusive = tree_concurrent_lock_labelled(self, 1);
+    lca = tree_lca(&self->tree, node_name_a, node_name_b);
+    tree_concurrent_unlock_labelled(self, exclusive);
+
+    return lca;
+}
+
+node_t *tree_concurrent_kth_ancestor(tree_concurrent_t *self, const char *node_name, int k)
+{
+    int exclusive = 0;
+    node_t *ancestor = NULL;
+
+    if (self == NULL)
+    {
+        return NULL;
+    }
+
+    exclusive = tree_concurrent_lock_labelled(self, 1);
+    ancestor = tree_kth_ancestor(&self->tree, node_name, k);
+    tree_concurrent_unlock_labelled(self, exclusive);
+
+    return ancestor;
+}
+
+int tree_concurrent_for_each(
+    tree_concurrent_t *self,
+    tree_iter_mode_t mode,
+    tree_visit_fun_t visit_fun,
+    void *ctx)
+{
+    int visited_cnt = 0;
+
+    if (self == NULL)
+    {
+        return -1;
+    }
+
+    tree_rwlock_lock_shared(&self->lock);
+    visited_cnt = tree_for_each(&self->tree, mode, visit_fun, ctx);
+    tree_rwlock_unlock_shared(&self->lock);
+
+    return visited_cnt;
+}
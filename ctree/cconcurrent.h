@@ -0,0 +1,186 @@
+#ifndef CCONCURRENT_H_
+#define CCONCURRENT_H_
+
+#include <pthread.h>
+#include "ctree.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif /* __cplusplus */
+
+/**
+ * Writer preferring reader-writer lock
+ *
+ * Readers only touch num_readers while no writer is around, so they do not queue up behind
+ * each other on the mutex. A writer which is waiting keeps new readers out.
+ */
+typedef struct
+{
+    pthread_mutex_t mutex; /**< protects num_writers_waiting and the condition variables */
+    pthread_cond_t readers_cond; /**< signalled when writers are gone */
+    pthread_cond_t writers_cond; /**< signalled when the lock is free for the next writer */
+    pthread_cond_t drained_cond; /**< signalled when the last reader leaves a writer's way */
+    int num_readers; /**< readers holding the lock, atomic */
+    int writer; /**< 1 while a writer holds the lock or waits for readers to leave, atomic */
+    int num_writers_waiting;
+} tree_rwlock_t;
+
+/**
+ * tree_t which can be used from many threads at once
+ *
+ * Lookups and walks take the lock shared, changes take it exclusive. Queries which need the
+ * labels of the tree (tree_is_ancestor() and the like) re-take the lock exclusive for the first
+ * call after a change, after that they run shared.
+ */
+typedef struct
+{
+    tree_t tree;
+    tree_rwlock_t lock;
+} tree_concurrent_t;
+
+/**
+ * Initialize a lock
+ *
+ * @param[in,out] self - pointer to the lock
+ *
+ * @return 0 if self is NULL or the lock cannot be initialized, 1 otherwise
+ */
+int tree_rwlock_init(tree_rwlock_t *self);
+
+/**
+ * Destroy a lock, which must not be held
+ *
+ * @param[in,out] self - pointer to the lock, function does nothing if self is NULL
+ */
+void tree_rwlock_dispose(tree_rwlock_t *self);
+
+/**
+ * Lock and unlock functions, do nothing if self is NULL
+ */
+void tree_rwlock_lock_shared(tree_rwlock_t *self);
+void tree_rwlock_unlock_shared(tree_rwlock_t *self);
+void tree_rwlock_lock_exclusive(tree_rwlock_t *self);
+void tree_rwlock_unlock_exclusive(tree_rwlock_t *self);
+
+/**
+ * Initialize an empty tree
+ *
+ * @param[in,out] self - pointer to the tree
+ *
+ * @return 0 if self is NULL or the lock cannot be initialized, 1 otherwise
+ */
+int tree_concurrent_init(tree_concurrent_t *self);
+
+/**
+ * Dispose of all nodes and destroy the lock, no other thread may use the tree any more
+ *
+ * @param[in,out] self - pointer to the tree, function does nothing if self is NULL
+ */
+void tree_concurrent_dispose(tree_concurrent_t *self);
+
+/**
+ * Take the lock shared and get the tree for a sequence of reads
+ *
+ * @param[in] self - pointer to the tree
+ *
+ * @return NULL if self is NULL, the wrapped tree otherwise, which must only be read until
+ *         tree_concurrent_read_unlock() (queries which may label the tree do not count as reads)
+ */
+tree_t *tree_concurrent_read_lock(tree_concurrent_t *self);
+void tree_concurrent_read_unlock(tree_concurrent_t *self);
+
+/**
+ * Take the lock exclusive and get the tree for a sequence of any operations
+ *
+ * @param[in] self - pointer to the tree
+ *
+ * @return NULL if self is NULL, the wrapped tree otherwise, valid until
+ *         tree_concurrent_write_unlock()
+ */
+tree_t *tree_concurrent_write_lock(tree_concurrent_t *self);
+void tree_concurrent_write_unlock(tree_concurrent_t *self);
+
+/**
+ * Same as tree_get_node(), shared
+ *
+ * @warning The node can be removed by another thread as soon as this returns, use
+ *          tree_concurrent_read_lock() to keep it.
+ */
+node_t *tree_concurrent_get_node(tree_concurrent_t *self, const char *node_name);
+
+/**
+ * Same as tree_add_node(), exclusive
+ */
+node_t *tree_concurrent_add_node(
+    tree_concurrent_t *self,
+    node_t *new_node,
+    const char *parent_node_name);
+
+/**
+ * Same as tree_add_tree(), exclusive, sub_tree must not be shared with other threads
+ */
+node_t *tree_concurrent_add_tree(
+    tree_concurrent_t *self,
+    tree_t *sub_tree,
+    const char *parent_node_name);
+
+/**
+ * Same as tree_remove_node(), exclusive
+ */
+int tree_concurrent_remove_node(tree_concurrent_t *self, const char *node_name);
+
+/**
+ * Same as tree_remove_tree(), exclusive
+ */
+int tree_concurrent_remove_tree(tree_concurrent_t *self, const char *sub_tree_root_name);
+
+/**
+ * Same as tree_depth(), shared
+ */
+int tree_concurrent_depth(tree_concurrent_t *self);
+
+/**
+ * Same as tree_is_ancestor(), shared unless the tree needs labelling
+ */
+int tree_concurrent_is_ancestor(
+    tree_concurrent_t *self,
+    const char *ancestor_name,
+    const char *descendant_name);
+
+/**
+ * Same as tree_subtree_size(), shared unless the tree needs labelling
+ */
+int tree_concurrent_subtree_size(tree_concurrent_t *self, const char *sub_tree_root_name);
+
+/**
+ * Same as tree_lca(), shared unless the tree needs labelling
+ *
+ * @warning See tree_concurrent_get_node()
+ */
+node_t *tree_concurrent_lca(
+    tree_concurrent_t *self,
+    const char *node_name_a,
+    const char *node_name_b);
+
+/**
+ * Same as tree_kth_ancestor(), shared unless the tree needs labelling
+ *
+ * @warning See tree_concurrent_get_node()
+ */
+node_t *tree_concurrent_kth_ancestor(tree_concurrent_t *self, const char *node_name, int k);
+
+/**
+ * Same as tree_for_each(), shared, visit_fun must not change the tree
+ */
+int tree_concurrent_for_each(
+    tree_concurrent_t *self,
+    tree_iter_mode_t mode,
+    tree_visit_fun_t visit_fun,
+    void *ctx);
+
+#ifdef __cplusplus
+} /* extern "C" */
+#endif /* __cplusplus */
+
+#endif /* CCONCURRENT_H_ */
@@ -0,0 +1,298 @@
+#include "cepoch.h"
+#include <sched.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define EPOCH_RECLAIM_INTERVAL 256
+#define EPOCH_CACHE_LINE 64
+
+struct epoch_reader_s
+{
+    unsigned int state; /* (epoch << 1) | 1 while inside, 0 outside, atomic */
+    int in_use; /* atomic */
+    epoch_t *domain;
+    epoch_reader_t *next; /* never changes once published */
+    char padding[EPOCH_CACHE_LINE]; /* keep readers off each other's cache lines */
+};
+
+typedef struct
+{
+    void *ptr;
+    epoch_free_fun_t free_fun; /* either this */
+    epoch_free_with_fun_t free_with_fun; /* or this one with ctx */
+    void *ctx;
+    unsigned int epoch; /* global epoch when retired */
+} epoch_garbage_t;
+
+struct epoch_s
+{
+    unsigned int global_epoch; /* advanced by the writer only, atomic */
+    epoch_reader_t *readers; /* list head, readers are only added, atomic */
+    epoch_garbage_t *garbage; /* retired, oldest first, writer only */
+    int num_garbage;
+    int capacity;
+    int reclaim_at; /* num_garbage which triggers the next epoch_reclaim() */
+};
+
+static void epoch_free_garbage(epoch_garbage_t *garbage)
+{
+    if (garbage->free_fun != NULL)
+    {
+        (*garbage->free_fun)(garbage->ptr);
+    }
+    else
+    {
+        (*garbage->free_with_fun)(garbage->ptr, garbage->ctx);
+    }
+}
+
+epoch_t *epoch_create(void)
+{
+    epoch_t *self = calloc(1, sizeof(epoch_t));
+
+    if (self == NULL)
+    {
+        return NULL;
+    }
+
+    self->reclaim_at = EPOCH_RECLAIM_INTERVAL;
+
+    return self;
+}
+
+void epoch_dispose(epoch_t *self)
+{
+    epoch_reader_t *reader = NULL;
+    epoch_reader_t *next = NULL;
+    int i = 0;
+
+    if (self == NULL)
+    {
+        return;
+    }
+
+    for (; i < self->num_garbage; ++i)
+    {
+        epoch_free_garbage(&self->garbage[i]);
+    }
+
+    for (reader = self->readers; reader != NULL; reader = next)
+    {
+        next = reader->next;
+        free(reader);
+    }
+
+    free(self->garbage);
+    free(self);
+}
+
+epoch_reader_t *epoch_register(epoch_t *self)
+{
+    epoch_reader_t *reader = NULL;
+    int not_in_use = 0;
+
+    if (self == NULL)
+    {
+        return NULL;
+    }
+
+    /* reuse a record given back earlier */
+    for (reader = __atomic_load_n(&self->readers, __ATOMIC_ACQUIRE); reader != NULL; reader = reader->next)
+    {
+        not_in_use = 0;
+
+        if (__atomic_compare_exchange_n(
+                &reader->in_use, &not_in_use, 1, 0, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED))
+        {
+            return reader;
+        }
+    }
+
+    reader = calloc(1, sizeof(epoch_reader_t));
+
+    if (reader == NULL)
+    {
+        return NULL;
+    }
+
+    reader->in_use = 1;
+    reader->domain = self;
+    reader->next = __atomic_load_n(&self->readers, __ATOMIC_RELAXED);
+
+    while (!__atomic_compare_exchange_n(
+        &self->readers, &reader->next, reader, 1, __ATOMIC_RELEASE, __ATOMIC_RELAXED))
+    {
+        /* reader->next got the new head */
+    }
+
+    return reader;
+}
+
+void epoch_unregister(epoch_reader_t *reader)
+{
+    if (reader == NULL)
+    {
+        return;
+    }
+
+    __atomic_store_n(&reader->state, 0, __ATOMIC_RELEASE);
+    __atomic_store_n(&reader->in_use, 0, __ATOMIC_RELEASE);
+}
+
+void epoch_enter(epoch_reader_t *reader)
+{
+    unsigned int epoch = 0;
+
+    if (reader == NULL)
+    {
+        return;
+    }
+
+    epoch = __atomic_load_n(&reader->domain->global_epoch, __ATOMIC_RELAXED);
+    __atomic_store_n(&reader->state, (epoch << 1) | 1u, __ATOMIC_RELAXED);
+
+    /* the writer has to see the reader inside before the reader loads any shared pointer */
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+}
+
+void epoch_exit(epoch_reader_t *reader)
+{
+    if (reader == NULL)
+    {
+        return;
+    }
+
+    __atomic_store_n(&reader->state, 0, __ATOMIC_RELEASE);
+}
+
+/* all readers inside have seen the current epoch, so the next one can begin */
+static int epoch_try_advance(epoch_t *self)
+{
+    unsigned int epoch = self->global_epoch;
+    unsigned int state = 0;
+    epoch_reader_t *reader = NULL;
+
+    /* pairs with the fence in epoch_enter() */
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+
+    for (reader = __atomic_load_n(&self->readers, __ATOMIC_ACQUIRE); reader != NULL; reader = reader->next)
+    {
+        state = __atomic_load_n(&reader->state, __ATOMIC_ACQUIRE);
+
+        if ((state & 1u) && ((state >> 1) != (epoch & (~0u >> 1))))
+        {
+            return 0;
+        }
+    }
+
+    __atomic_store_n(&self->global_epoch, epoch + 1, __ATOMIC_RELEASE);
+
+    return 1;
+}
+
+int epoch_reclaim(epoch_t *self)
+{
+    int num_freed = 0;
+    int i = 0;
+
+    if (self == NULL)
+    {
+        return 0;
+    }
+
+    epoch_try_advance(self);
+
+    /* readers inside now entered at least one epoch after these were retired */
+    while ((num_freed < self->num_garbage) &&
+           (self->global_epoch - self->garbage[num_freed].epoch >= 2))
+    {
+        ++num_freed;
+    }
+
+    for (; i < num_freed; ++i)
+    {
+        epoch_free_garbage(&self->garbage[i]);
+    }
+
+    memmove(self->garbage, &self->garbage[num_freed], (self->num_garbage - num_freed) * sizeof(epoch_garbage_t));
+    self->num_garbage -= num_freed;
+    self->reclaim_at = self->num_garbage + EPOCH_RECLAIM_INTERVAL;
+
+    return num_freed;
+}
+
+void epoch_synchronize(epoch_t *self)
+{
+    if (self == NULL)
+    {
+        return;
+    }
+
+    while (self->num_garbage > 0)
+    {
+        if (epoch_reclaim(self) == 0)
+        {
+            sched_yield();
+        }
+    }
+}
+
+static void epoch_add_garbage(epoch_t *self, epoch_garbage_t *retired)
+{
+    epoch_garbage_t *garbage = NULL;
+    int capacity = 0;
+
+    if (self->num_garbage == self->capacity)
+    {
+        capacity = (self->capacity > 0) ? 2 * self->capacity : EPOCH_RECLAIM_INTERVAL;
+        garbage = realloc(self->garbage, capacity * sizeof(epoch_garbage_t));
+
+        /* failed to reallocate memory, no reader can be using ptr after this */
+        if (garbage == NULL)
+        {
+            epoch_synchronize(self);
+            epoch_free_garbage(retired);
+            return;
+        }
+
+        self->garbage = garbage;
+        self->capacity = capacity;
+    }
+
+    retired->epoch = self->global_epoch;
+    self->garbage[self->num_garbage++] = *retired;
+
+    if (self->num_garbage >= self->reclaim_at)
+    {
+        epoch_reclaim(self);
+    }
+}
+
+void epoch_retire(epoch_t *self, void *ptr, epoch_free_fun_t free_fun)
+{
+    epoch_garbage_t retired = {ptr, free_fun, NULL, NULL, 0};
+
+    if ((self == NULL) || (ptr == NULL) || (free_fun == NULL))
+    {
+        return;
+    }
+
+    epoch_add_garbage(self, &retired);
+}
+
+void epoch_retire_with(epoch_t *self, void *ptr, epoch_free_with_fun_t free_fun, void *ctx)
+{
+    epoch_garbage_t retired = {ptr, NULL, free_fun, ctx, 0};
+
+    if ((self == NULL) || (ptr == NULL) || (free_fun == NULL))
+    {
+        return;
+    }
+
+    epoch_add_garbage(self, &retired);
+}
+
+int epoch_num_pending(epoch_t *self)
+{
+    return (self == NULL) ? 0 : self->num_garbage;
+}
@@ -0,0 +1,135 @@
+#ifndef CEPOCH_H_
+#define CEPOCH_H_
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif /* __cplusplus */
+
+/**
+ * Epoch based reclamation for one writer and any number of lock-free readers, opaque
+ *
+ * The writer unlinks memory from shared data and retires it instead of freeing it. Readers
+ * access shared data only between epoch_enter() and epoch_exit(). Retired memory is freed once
+ * every reader which could have seen it has left, which the writer learns by advancing the
+ * global epoch: that is only possible when all readers inside have entered in the current one.
+ */
+typedef struct epoch_s epoch_t;
+
+/**
+ * Per reader thread record, opaque
+ */
+typedef struct epoch_reader_s epoch_reader_t;
+
+/**
+ * Frees retired memory
+ */
+typedef void (*epoch_free_fun_t)(void *);
+
+/**
+ * Frees retired memory, gets the context given to epoch_retire_with()
+ */
+typedef void (*epoch_free_with_fun_t)(void *ptr, void *ctx);
+
+/**
+ * Create a reclamation domain
+ *
+ * @return NULL if memory cannot be allocated, new domain otherwise
+ */
+epoch_t *epoch_create(void);
+
+/**
+ * Free all retired memory and reader records, and the domain itself
+ *
+ * @param[in,out] self - the domain, function does nothing if self is NULL
+ *
+ * @warning No reader may be inside any more.
+ */
+void epoch_dispose(epoch_t *self);
+
+/**
+ * Get a record for a reader thread, records of unregistered readers are reused
+ *
+ * @param[in,out] self - the domain
+ *
+ * @return NULL if self is NULL or memory cannot be allocated, the record otherwise
+ *
+ * @note Thread safe, one record must only be used by one thread at a time
+ */
+epoch_reader_t *epoch_register(epoch_t *self);
+
+/**
+ * Give a record back, it must not be inside
+ *
+ * @param[in,out] reader - the record, function does nothing if reader is NULL
+ */
+void epoch_unregister(epoch_reader_t *reader);
+
+/**
+ * Start reading shared data, nothing retired from now on is freed until epoch_exit()
+ *
+ * @param[in,out] reader - the record of the calling thread, function does nothing if NULL
+ *
+ * @note Does not nest, wait-free
+ */
+void epoch_enter(epoch_reader_t *reader);
+
+/**
+ * Stop reading shared data, pointers obtained inside must not be used any more
+ *
+ * @param[in,out] reader - the record of the calling thread, function does nothing if NULL
+ */
+void epoch_exit(epoch_reader_t *reader);
+
+/**
+ * Free memory once no reader can be using it, writer only
+ *
+ * @param[in,out] self - the domain
+ * @param[in] ptr - memory which readers cannot reach any more, function does nothing if NULL
+ * @param[in] free_fun - called with ptr when it is safe, function does nothing if NULL
+ *
+ * @note Tries to reclaim every now and then. If the memory cannot even be remembered, waits
+ *       for the readers with epoch_synchronize() and frees it right away.
+ */
+void epoch_retire(epoch_t *self, void *ptr, epoch_free_fun_t free_fun);
+
+/**
+ * Same as epoch_retire(), free_fun gets ctx as well
+ *
+ * @param[in,out] self - the domain
+ * @param[in] ptr - memory which readers cannot reach any more, function does nothing if NULL
+ * @param[in] free_fun - called with ptr and ctx when it is safe, function does nothing if NULL
+ * @param[in] ctx - passed to free_fun as is
+ */
+void epoch_retire_with(epoch_t *self, void *ptr, epoch_free_with_fun_t free_fun, void *ctx);
+
+/**
+ * Try to advance the epoch and free what is safe to free, writer only
+ *
+ * @param[in,out] self - the domain
+ *
+ * @return number of freed pointers, 0 if self is NULL
+ */
+int epoch_reclaim(epoch_t *self);
+
+/**
+ * Wait for the readers and free everything retired so far, writer only
+ *
+ * @param[in,out] self - the domain, function does nothing if self is NULL
+ */
+void epoch_synchronize(epoch_t *self);
+
+/**
+ * Get the number of retired pointers which are not freed yet
+ *
+ * @param[in] self - the domain
+ *
+ * @return 0 if self is NULL, number of pending pointers otherwise
+ */
+int epoch_num_pending(epoch_t *self);
+
+#ifdef __cplusplus
+} /* extern "C" */
+#endif /* __cplusplus */
+
+#endif /* CEPOCH_H_ */
@@ -0,0 +1,789 @@
+#include "cfrozen.h"
+#include "cbinary.h"
+#include <fcntl.h>
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define TREE_FROZEN_MIN_SLOTS 16
+
+#define TREE_BINARY_MAGIC "CTREEBIN"
+#define TREE_BINARY_VERSION 1
+#define TREE_BINARY_BYTE_ORDER 0x01020304u
+#define TREE_BINARY_ALIGNMENT 8
+#define TREE_BINARY_TMP_SUFFIX ".tmp"
+
+/* start of a binary snapshot, the sections follow in tree_binary_section_t order */
+typedef struct
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t byte_order; /* TREE_BINARY_BYTE_ORDER as written, files of other machines do not match */
+    int32_t num_nodes;
+    int32_t depth;
+    int32_t num_slots;
+    int32_t reserved;
+    uint64_t names_size;
+    uint64_t values_size;
+    uint64_t file_size;
+} tree_binary_header_t;
+
+typedef enum
+{
+    TREE_BINARY_PARENTS,
+    TREE_BINARY_FIRST_CHILDREN,
+    TREE_BINARY_NEXT_SIBLINGS,
+    TREE_BINARY_SUBTREE_SIZES,
+    TREE_BINARY_NAME_OFFSETS,
+    TREE_BINARY_NAME_HASHES,
+    TREE_BINARY_SLOTS,
+    TREE_BINARY_VALUE_OFFSETS,
+    TREE_BINARY_NAMES,
+    TREE_BINARY_VALUES,
+    TREE_BINARY_NUM_SECTIONS
+} tree_binary_section_t;
+
+/* values are moved, not disposed of, when the nodes they came from or went to are disposed of */
+static value_handlers_t tree_frozen_keep_values = {NULL, NULL, NULL, NULL, NULL, NULL};
+
+/* reserve size bytes aligned for any of the arrays, returns where they start */
+static size_t tree_frozen_reserve(size_t *block_size, size_t size)
+{
+    size_t offset = (*block_size + sizeof(void *) - 1) / sizeof(void *) * sizeof(void *);
+
+    *block_size = offset + size;
+    return offset;
+}
+
+/* all arrays in one block right after the structure */
+static tree_frozen_t *tree_frozen_create(
+    tree_allocator_t *allocator,
+    int num_nodes,
+    int num_slots,
+    size_t names_size)
+{
+    size_t block_size = sizeof(tree_frozen_t);
+    size_t values = tree_frozen_reserve(&block_size, num_nodes * sizeof(void *));
+    size_t value_handlers = tree_frozen_reserve(&block_size, num_nodes * sizeof(value_handlers_t *));
+    size_t parents = tree_frozen_reserve(&block_size, num_nodes * sizeof(int32_t));
+    size_t first_children = tree_frozen_reserve(&block_size, num_nodes * sizeof(int32_t));
+    size_t next_siblings = tree_frozen_reserve(&block_size, num_nodes * sizeof(int32_t));
+    size_t subtree_sizes = tree_frozen_reserve(&block_size, num_nodes * sizeof(int32_t));
+    size_t name_offsets = tree_frozen_reserve(&block_size, num_nodes * sizeof(int32_t));
+    size_t name_hashes = tree_frozen_reserve(&block_size, num_nodes * sizeof(unsigned int));
+    size_t slots = tree_frozen_reserve(&block_size, num_slots * sizeof(int32_t));
+    size_t names = tree_frozen_reserve(&block_size, names_size);
+    char *block = tree_malloc(allocator, block_size);
+    tree_frozen_t *self = (tree_frozen_t *)block;
+
+    if (block == NULL)
+    {
+        return NULL;
+    }
+
+    self->num_nodes = num_nodes;
+    self->depth = 0;
+    self->parents = (int32_t *)(block + parents);
+    self->first_children = (int32_t *)(block + first_children);
+    self->next_siblings = (int32_t *)(block + next_siblings);
+    self->subtree_sizes = (int32_t *)(block + subtree_sizes);
+    self->name_offsets = (int32_t *)(block + name_offsets);
+    self->names = block + names;
+    self->name_hashes = (unsigned int *)(block + name_hashes);
+    self->values = (void **)(block + values);
+    self->value_handlers = (value_handlers_t **)(block + value_handlers);
+    self->slots = (int32_t *)(block + slots);
+    self->num_slots = num_slots;
+    self->allocator = allocator;
+    self->value_offsets = NULL;
+    self->value_data = NULL;
+    self->mapped_handlers = NULL;
+    self->mapping = NULL;
+    self->mapping_size = 0;
+
+    memset(self->slots, 0xff, num_slots * sizeof(int32_t));
+
+    return self;
+}
+
+static void tree_frozen_put(tree_frozen_t *self, int node)
+{
+    unsigned int mask = self->num_slots - 1;
+    unsigned int i = self->name_hashes[node] & mask;
+
+    while (self->slots[i] != -1)
+    {
+        i = (i + 1) & mask;
+    }
+
+    self->slots[i] = node;
+}
+
+/* the arrays of a tree, the values are borrowed, the tree is left as is */
+static tree_frozen_t *tree_frozen_build(tree_t *tree)
+{
+    tree_frozen_t *self = NULL;
+    node_t *node = NULL;
+    size_t names_size = 0;
+    size_t name_size = 0;
+    int num_nodes = 0;
+    int num_slots = TREE_FROZEN_MIN_SLOTS;
+    int i = 0;
+    int j = 0;
+
+    num_nodes = (tree->root != NULL) ? tree->num_nodes + 1 : 0;
+
+    /* positions are the pre-order labels */
+    if ((num_nodes > 0) && !tree_update_labels(tree))
+    {
+        return NULL;
+    }
+
+    for (i = 0; i < num_nodes; ++i)
+    {
+        names_size += strlen(tree->pre_order[i]->object_name) + 1;
+    }
+
+    /* at most half full */
+    while (num_slots < 2 * num_nodes)
+    {
+        num_slots *= 2;
+    }
+
+    self = tree_frozen_create(tree->allocator, num_nodes, num_slots, names_size);
+
+    if (self == NULL)
+    {
+        return NULL;
+    }
+
+    names_size = 0;
+
+    for (i = 0; i < num_nodes; ++i)
+    {
+        node = tree->pre_order[i];
+        self->parents[i] = (node->parent != NULL) ? node->parent->pre_order : -1;
+        self->first_children[i] = (node->num_children > 0) ? node->children[0]->pre_order : -1;
+        self->next_siblings[i] = -1;
+        self->subtree_sizes[i] = node->subtree_size;
+        self->values[i] = node->value;
+        self->value_handlers[i] = node->value_handlers;
+        self->name_hashes[i] = node->name_hash;
+
+        name_size = strlen(node->object_name) + 1;
+        self->name_offsets[i] = (int32_t)names_size;
+        memcpy(self->names + names_size, node->object_name, name_size);
+        names_size += name_size;
+
+        tree_frozen_put(self, i);
+    }
+
+    /* every position is known now */
+    for (i = 0; i < num_nodes; ++i)
+    {
+        node = tree->pre_order[i];
+
+        for (j = 0; j + 1 < node->num_children; ++j)
+        {
+            self->next_siblings[node->children[j]->pre_order] = node->children[j + 1]->pre_order;
+        }
+    }
+
+    self->depth = tree_depth(tree);
+
+    return self;
+}
+
+/* unmap or free the block, the values are left alone */
+static void tree_frozen_free(tree_frozen_t *self)
+{
+    if (self->mapping != NULL)
+    {
+        munmap(self->mapping, self->mapping_size);
+    }
+
+    tree_free(self->allocator, self);
+}
+
+/* a node of tree_thaw(), a mapped tree loads the value, otherwise it moves over */
+static node_t *tree_frozen_create_node(const tree_frozen_t *self, int node)
+{
+    node_t *created = NULL;
+    void *value = NULL;
+
+    if (self->mapping == NULL)
+    {
+        return node_create(self->value_handlers[node], tree_frozen_name(self, node), self->values[node]);
+    }
+
+    if (!tree_frozen_load_value(self, node, &value))
+    {
+        return NULL;
+    }
+
+    created = node_create(self->mapped_handlers, tree_frozen_name(self, node), value);
+
+    if ((created == NULL) && (self->mapped_handlers->dispose_fun != NULL))
+    {
+        (*self->mapped_handlers->dispose_fun)(value);
+    }
+
+    return created;
+}
+
+tree_frozen_t *tree_freeze(tree_t *tree)
+{
+    tree_frozen_t *self = NULL;
+    int i = 0;
+
+    /* snapshots would see values the frozen tree owns */
+    if ((tree == NULL) || (__atomic_load_n(&tree->num_snapshots, __ATOMIC_ACQUIRE) > 0))
+    {
+        return NULL;
+    }
+
+    self = tree_frozen_build(tree);
+
+    if (self == NULL)
+    {
+        return NULL;
+    }
+
+    /* the values move over */
+    for (; i < self->num_nodes; ++i)
+    {
+        tree->pre_order[i]->value_handlers = &tree_frozen_keep_values;
+    }
+
+    tree_clear(tree);
+
+    return self;
+}
+
+int tree_thaw(tree_frozen_t *self, tree_t *tree)
+{
+    node_t **nodes = NULL;
+    const char **parent_names = NULL;
+    int i = 0;
+
+    if ((self == NULL) || (tree == NULL) || (tree->root != NULL))
+    {
+        return 0;
+    }
+
+    if (self->num_nodes == 0)
+    {
+        tree_frozen_dispose(self);
+        return 1;
+    }
+
+    nodes = tree_malloc(tree->allocator, self->num_nodes * sizeof(node_t *));
+    parent_names = tree_malloc(tree->allocator, self->num_nodes * sizeof(const char *));
+
+    for (i = 0; (nodes != NULL) && (parent_names != NULL) && (i < self->num_nodes); ++i)
+    {
+        nodes[i] = tree_frozen_create_node(self, i);
+
+        if (nodes[i] == NULL)
+        {
+            break;
+        }
+
+        parent_names[i] = (i > 0) ? self->names + self->name_offsets[self->parents[i]] : NULL;
+    }
+
+    /* failed to allocate memory or load a value, values are still ours, loaded ones are not */
+    if ((i < self->num_nodes) || (tree_build(tree, nodes, parent_names, self->num_nodes, NULL) != TREE_BUILD_OK))
+    {
+        while ((nodes != NULL) && (i-- > 0))
+        {
+            if (self->mapping == NULL)
+            {
+                nodes[i]->value_handlers = &tree_frozen_keep_values;
+            }
+
+            node_dispose(nodes[i]);
+        }
+
+        tree_free(tree->allocator, nodes);
+        tree_free(tree->allocator, parent_names);
+        return 0;
+    }
+
+    tree_free(tree->allocator, nodes);
+    tree_free(tree->allocator, parent_names);
+    tree_frozen_free(self);
+
+    return 1;
+}
+
+void tree_frozen_dispose(tree_frozen_t *self)
+{
+    int i = 0;
+
+    if (self == NULL)
+    {
+        return;
+    }
+
+    /* values of a mapped tree are in the file */
+    for (; (self->mapping == NULL) && (i < self->num_nodes); ++i)
+    {
+        if (self->value_handlers[i]->dispose_fun != NULL)
+        {
+            (*self->value_handlers[i]->dispose_fun)(self->values[i]);
+        }
+    }
+
+    tree_frozen_free(self);
+}
+
+int tree_frozen_find(const tree_frozen_t *self, const char *node_name)
+{
+    unsigned int mask = 0;
+    unsigned int hash = 0;
+    unsigned int i = 0;
+    int node = 0;
+
+    if ((self == NULL) || (node_name == NULL))
+    {
+        return -1;
+    }
+
+    mask = self->num_slots - 1;
+    hash = node_name_hash(node_name);
+
+    for (i = hash & mask; (node = self->slots[i]) != -1; i = (i + 1) & mask)
+    {
+        if ((self->name_hashes[node] == hash) && (strcmp(self->names + self->name_offsets[node], node_name) == 0))
+        {
+            return node;
+        }
+    }
+
+    /* not found */
+    return -1;
+}
+
+const char *tree_frozen_name(const tree_frozen_t *self, int node)
+{
+    if ((self == NULL) || (node < 0) || (node >= self->num_nodes))
+    {
+        return NULL;
+    }
+
+    return self->names + self->name_offsets[node];
+}
+
+int tree_frozen_is_ancestor(const tree_frozen_t *self, const char *ancestor_name, const char *descendant_name)
+{
+    int ancestor = tree_frozen_find(self, ancestor_name);
+    int descendant = tree_frozen_find(self, descendant_name);
+
+    if ((ancestor == -1) || (descendant == -1))
+    {
+        return 0;
+    }
+
+    return (ancestor <= descendant) && (descendant < ancestor + self->subtree_sizes[ancestor]);
+}
+
+int tree_frozen_for_each(const tree_frozen_t *self, int start, tree_frozen_visit_fun_t visit_fun, void *ctx)
+{
+    int end = 0;
+    int node = 0;
+
+    if ((self == NULL) || (visit_fun == NULL) || (start < 0) || (start >= self->num_nodes))
+    {
+        return -1;
+    }
+
+    end = start + self->subtree_sizes[start];
+
+    for (node = start; node < end; ++node)
+    {
+        if ((*visit_fun)(self, node, ctx) != 0)
+        {
+            return node - start + 1;
+        }
+    }
+
+    return end - start;
+}
+
+/* where the sections start, returns the size of the file */
+static uint64_t tree_binary_layout(const tree_binary_header_t *header, uint64_t *offsets)
+{
+    uint64_t num_nodes = (uint64_t)header->num_nodes;
+    uint64_t sizes[TREE_BINARY_NUM_SECTIONS];
+    uint64_t size = sizeof(tree_binary_header_t);
+    int i = 0;
+
+    sizes[TREE_BINARY_PARENTS] = num_nodes * sizeof(int32_t);
+    sizes[TREE_BINARY_FIRST_CHILDREN] = num_nodes * sizeof(int32_t);
+    sizes[TREE_BINARY_NEXT_SIBLINGS] = num_nodes * sizeof(int32_t);
+    sizes[TREE_BINARY_SUBTREE_SIZES] = num_nodes * sizeof(int32_t);
+    sizes[TREE_BINARY_NAME_OFFSETS] = num_nodes * sizeof(int32_t);
+    sizes[TREE_BINARY_NAME_HASHES] = num_nodes * sizeof(uint32_t);
+    sizes[TREE_BINARY_SLOTS] = (uint64_t)header->num_slots * sizeof(int32_t);
+    sizes[TREE_BINARY_VALUE_OFFSETS] = (num_nodes + 1) * sizeof(uint64_t);
+    sizes[TREE_BINARY_NAMES] = header->names_size;
+    sizes[TREE_BINARY_VALUES] = header->values_size;
+
+    for (; i < TREE_BINARY_NUM_SECTIONS; ++i)
+    {
+        offsets[i] = (size + TREE_BINARY_ALIGNMENT - 1) / TREE_BINARY_ALIGNMENT * TREE_BINARY_ALIGNMENT;
+        size = offsets[i] + sizes[i];
+    }
+
+    return size;
+}
+
+/* payloads one after another, value_offsets[i] is where the one of node i starts */
+static int tree_binary_measure(const tree_frozen_t *frozen, uint64_t *value_offsets)
+{
+    int size = 0;
+    int i = 0;
+
+    value_offsets[0] = 0;
+
+    for (; i < frozen->num_nodes; ++i)
+    {
+        size = value_binary_size(frozen->value_handlers[i], frozen->values[i]);
+
+        if (size < 0)
+        {
+            return 0;
+        }
+
+        value_offsets[i + 1] = value_offsets[i] + size;
+    }
+
+    return 1;
+}
+
+/* pad with zeros from position up to offset, then write the data */
+static int tree_binary_put(FILE *file, uint64_t *position, uint64_t offset, const void *data, size_t size)
+{
+    static const char zeros[TREE_BINARY_ALIGNMENT] = {0};
+    size_t padding = offset - *position;
+
+    /* data can be NULL for an empty section */
+    if ((fwrite(zeros, 1, padding, file) != padding) || ((size > 0) && (fwrite(data, 1, size, file) != size)))
+    {
+        return 0;
+    }
+
+    *position = offset + size;
+    return 1;
+}
+
+static int tree_binary_write(
+    FILE *file,
+    const tree_frozen_t *frozen,
+    const tree_binary_header_t *header,
+    const uint64_t *offsets,
+    const uint64_t *value_offsets)
+{
+    size_t num_nodes = frozen->num_nodes;
+    uint64_t position = 0;
+    char *buffer = NULL;
+    char *grown = NULL;
+    int buffer_size = 0;
+    int size = 0;
+    int i = 0;
+    int written =
+        tree_binary_put(file, &position, 0, header, sizeof(tree_binary_header_t)) &&
+        tree_binary_put(file, &position, offsets[TREE_BINARY_PARENTS], frozen->parents, num_nodes * sizeof(int32_t)) &&
+        tree_binary_put(file, &position, offsets[TREE_BINARY_FIRST_CHILDREN], frozen->first_children, num_nodes * sizeof(int32_t)) &&
+        tree_binary_put(file, &position, offsets[TREE_BINARY_NEXT_SIBLINGS], frozen->next_siblings, num_nodes * sizeof(int32_t)) &&
+        tree_binary_put(file, &position, offsets[TREE_BINARY_SUBTREE_SIZES], frozen->subtree_sizes, num_nodes * sizeof(int32_t)) &&
+        tree_binary_put(file, &position, offsets[TREE_BINARY_NAME_OFFSETS], frozen->name_offsets, num_nodes * sizeof(int32_t)) &&
+        tree_binary_put(file, &position, offsets[TREE_BINARY_NAME_HASHES], frozen->name_hashes, num_nodes * sizeof(uint32_t)) &&
+        tree_binary_put(file, &position, offsets[TREE_BINARY_SLOTS], frozen->slots, frozen->num_slots * sizeof(int32_t)) &&
+        tree_binary_put(file, &position, offsets[TREE_BINARY_VALUE_OFFSETS], value_offsets, (num_nodes + 1) * sizeof(uint64_t)) &&
+        tree_binary_put(file, &position, offsets[TREE_BINARY_NAMES], frozen->names, header->names_size) &&
+        tree_binary_put(file, &position, offsets[TREE_BINARY_VALUES], NULL, 0);
+
+    for (; written && (i < frozen->num_nodes); ++i)
+    {
+        size = (int)(value_offsets[i + 1] - value_offsets[i]);
+
+        if (size > buffer_size)
+        {
+            grown = tree_realloc(frozen->allocator, buffer, size);
+
+            if (grown == NULL)
+            {
+                written = 0;
+                break;
+            }
+
+            buffer = grown;
+            buffer_size = size;
+        }
+
+        written = value_binary_write(frozen->value_handlers[i], frozen->values[i], buffer, size) &&
+                  (fwrite(buffer, 1, size, file) == (size_t)size);
+    }
+
+    tree_free(frozen->allocator, buffer);
+
+    return written;
+}
+
+int tree_save_binary(tree_t *tree, const char *path)
+{
+    tree_binary_header_t header;
+    uint64_t offsets[TREE_BINARY_NUM_SECTIONS];
+    uint64_t *value_offsets = NULL;
+    tree_frozen_t *frozen = NULL;
+    char *tmp_path = NULL;
+    FILE *file = NULL;
+    int saved = 0;
+
+    if ((tree == NULL) || (path == NULL))
+    {
+        return 0;
+    }
+
+    frozen = tree_frozen_build(tree);
+
+    if (frozen == NULL)
+    {
+        return 0;
+    }
+
+    value_offsets = tree_malloc(tree->allocator, (frozen->num_nodes + 1) * sizeof(uint64_t));
+    tmp_path = tree_malloc(tree->allocator, strlen(path) + sizeof(TREE_BINARY_TMP_SUFFIX));
+
+    if ((value_offsets != NULL) && (tmp_path != NULL) && tree_binary_measure(frozen, value_offsets))
+    {
+        memset(&header, 0, sizeof(header));
+        memcpy(header.magic, TREE_BINARY_MAGIC, sizeof(header.magic));
+        header.version = TREE_BINARY_VERSION;
+        header.byte_order = TREE_BINARY_BYTE_ORDER;
+        header.num_nodes = frozen->num_nodes;
+        header.depth = frozen->depth;
+        header.num_slots = frozen->num_slots;
+        /* names are in pre-order, the last one ends the blob */
+        header.names_size = (frozen->num_nodes > 0) ?
+            (uint64_t)frozen->name_offsets[frozen->num_nodes - 1] + strlen(tree_frozen_name(frozen, frozen->num_nodes - 1)) + 1 : 0;
+        header.values_size = value_offsets[frozen->num_nodes];
+        header.file_size = tree_binary_layout(&header, offsets);
+
+        /* readers of path see the old file or the whole new one */
+        strcpy(tmp_path, path);
+        strcat(tmp_path, TREE_BINARY_TMP_SUFFIX);
+        file = fopen(tmp_path, "wb");
+    }
+
+    if (file != NULL)
+    {
+        saved = tree_binary_write(file, frozen, &header, offsets, value_offsets) &&
+                (fflush(file) == 0) &&
+                (fsync(fileno(file)) == 0);
+        saved = (fclose(file) == 0) && saved;
+        saved = saved && (rename(tmp_path, path) == 0) && tree_sync_dir(tree->allocator, path);
+
+        if (!saved)
+        {
+            remove(tmp_path);
+        }
+    }
+
+    tree_free(tree->allocator, value_offsets);
+    tree_free(tree->allocator, tmp_path);
+    tree_frozen_free(frozen);
+
+    return saved;
+}
+
+/*
+ * Every position, offset and size in the arrays stays in range, so that no query reads outside
+ * the mapping whatever the file holds, in one pass
+ */
+static int tree_binary_arrays_are_valid(const char *mapping, const tree_binary_header_t *header, const uint64_t *offsets)
+{
+    const int32_t *parents = (const int32_t *)(mapping + offsets[TREE_BINARY_PARENTS]);
+    const int32_t *first_children = (const int32_t *)(mapping + offsets[TREE_BINARY_FIRST_CHILDREN]);
+    const int32_t *next_siblings = (const int32_t *)(mapping + offsets[TREE_BINARY_NEXT_SIBLINGS]);
+    const int32_t *subtree_sizes = (const int32_t *)(mapping + offsets[TREE_BINARY_SUBTREE_SIZES]);
+    const int32_t *name_offsets = (const int32_t *)(mapping + offsets[TREE_BINARY_NAME_OFFSETS]);
+    const int32_t *slots = (const int32_t *)(mapping + offsets[TREE_BINARY_SLOTS]);
+    const uint64_t *value_offsets = (const uint64_t *)(mapping + offsets[TREE_BINARY_VALUE_OFFSETS]);
+    int32_t num_nodes = header->num_nodes;
+    int32_t parent = 0;
+    int64_t end = 0;
+    int num_used = 0;
+    int i = 0;
+
+    for (; i < num_nodes; ++i)
+    {
+        parent = parents[i];
+        end = (int64_t)i + subtree_sizes[i];
+
+        /* pre-order, a parent comes first and its subtree holds the one of the child */
+        if (((i == 0) ? (parent != -1) : ((parent < 0) || (parent >= i))) ||
+            (subtree_sizes[i] < 1) || (end > num_nodes) ||
+            ((i > 0) && (end > (int64_t)parent + subtree_sizes[parent])) ||
+            ((first_children[i] != -1) && ((first_children[i] <= i) || (first_children[i] >= num_nodes))) ||
+            ((next_siblings[i] != -1) && ((next_siblings[i] <= i) || (next_siblings[i] >= num_nodes))) ||
+            (name_offsets[i] < 0) || ((uint64_t)name_offsets[i] >= header->names_size) ||
+            (value_offsets[i] > value_offsets[i + 1]) || (value_offsets[i + 1] - value_offsets[i] > INT_MAX))
+        {
+            return 0;
+        }
+    }
+
+    for (i = 0; i < header->num_slots; ++i)
+    {
+        if ((slots[i] < -1) || (slots[i] >= num_nodes))
+        {
+            return 0;
+        }
+
+        num_used += (slots[i] != -1);
+    }
+
+    /* a lookup stops at a free slot */
+    return (num_used <= num_nodes) && (value_offsets[0] == 0) && ((num_nodes == 0) || (subtree_sizes[0] == num_nodes));
+}
+
+/* a file on disk is not trusted, not even one written by tree_save_binary() */
+static int tree_binary_is_valid(const char *mapping, size_t mapping_size, uint64_t *offsets)
+{
+    const tree_binary_header_t *header = (const tree_binary_header_t *)mapping;
+    const uint64_t *value_offsets = NULL;
+
+    if ((memcmp(header->magic, TREE_BINARY_MAGIC, sizeof(header->magic)) != 0) ||
+        (header->version != TREE_BINARY_VERSION) ||
+        (header->byte_order != TREE_BINARY_BYTE_ORDER) ||
+        (header->num_nodes < 0) ||
+        (header->depth < 0) ||
+        (header->depth > header->num_nodes) ||
+        (header->num_slots < TREE_FROZEN_MIN_SLOTS) ||
+        ((header->num_slots & (header->num_slots - 1)) != 0) ||
+        (header->num_slots < 2 * (int64_t)header->num_nodes) ||
+        (header->names_size > mapping_size) ||
+        (header->values_size > mapping_size) ||
+        (header->file_size != mapping_size) ||
+        (tree_binary_layout(header, offsets) != mapping_size))
+    {
+        return 0;
+    }
+
+    value_offsets = (const uint64_t *)(mapping + offsets[TREE_BINARY_VALUE_OFFSETS]);
+
+    /* names stay in their section, so do the values */
+    return ((header->names_size == 0) || (mapping[offsets[TREE_BINARY_NAMES] + header->names_size - 1] == '\0')) &&
+           (value_offsets[header->num_nodes] == header->values_size) &&
+           tree_binary_arrays_are_valid(mapping, header, offsets);
+}
+
+tree_frozen_t *tree_map_binary(const char *path, value_handlers_t *value_handlers)
+{
+    uint64_t offsets[TREE_BINARY_NUM_SECTIONS];
+    const tree_binary_header_t *header = NULL;
+    tree_frozen_t *self = NULL;
+    char *mapping = MAP_FAILED;
+    size_t mapping_size = 0;
+    struct stat status;
+    int fd = -1;
+
+    if (path == NULL)
+    {
+        return NULL;
+    }
+
+    fd = open(path, O_RDONLY);
+
+    if (fd == -1)
+    {
+        return NULL;
+    }
+
+    if ((fstat(fd, &status) == 0) && (status.st_size >= (off_t)sizeof(tree_binary_header_t)))
+    {
+        mapping_size = status.st_size;
+        mapping = mmap(NULL, mapping_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    }
+
+    /* the mapping stays */
+    close(fd);
+
+    if (mapping == MAP_FAILED)
+    {
+        return NULL;
+    }
+
+    if (tree_binary_is_valid(mapping, mapping_size, offsets))
+    {
+        self = tree_malloc(NULL, sizeof(tree_frozen_t));
+    }
+
+    if (self == NULL)
+    {
+        munmap(mapping, mapping_size);
+        return NULL;
+    }
+
+    header = (const tree_binary_header_t *)mapping;
+
+    self->num_nodes = header->num_nodes;
+    self->depth = header->depth;
+    self->parents = (int32_t *)(mapping + offsets[TREE_BINARY_PARENTS]);
+    self->first_children = (int32_t *)(mapping + offsets[TREE_BINARY_FIRST_CHILDREN]);
+    self->next_siblings = (int32_t *)(mapping + offsets[TREE_BINARY_NEXT_SIBLINGS]);
+    self->subtree_sizes = (int32_t *)(mapping + offsets[TREE_BINARY_SUBTREE_SIZES]);
+    self->name_offsets = (int32_t *)(mapping + offsets[TREE_BINARY_NAME_OFFSETS]);
+    self->names = mapping + offsets[TREE_BINARY_NAMES];
+    self->name_hashes = (unsigned int *)(mapping + offsets[TREE_BINARY_NAME_HASHES]);
+    self->values = NULL;
+    self->value_handlers = NULL;
+    self->slots = (int32_t *)(mapping + offsets[TREE_BINARY_SLOTS]);
+    self->num_slots = header->num_slots;
+    self->allocator = NULL;
+    self->value_offsets = (uint64_t *)(mapping + offsets[TREE_BINARY_VALUE_OFFSETS]);
+    self->value_data = mapping + offsets[TREE_BINARY_VALUES];
+    self->mapped_handlers = value_handlers;
+    self->mapping = mapping;
+    self->mapping_size = mapping_size;
+
+    return self;
+}
+
+const char *tree_frozen_value_data(const tree_frozen_t *self, int node, int *size)
+{
+    if ((self == NULL) || (self->mapping == NULL) || (node < 0) || (node >= self->num_nodes))
+    {
+        return NULL;
+    }
+
+    if (size != NULL)
+    {
+        *size = (int)(self->value_offsets[node + 1] - self->value_offsets[node]);
+    }
+
+    return self->value_data + self->value_offsets[node];
+}
+
+int tree_frozen_load_value(const tree_frozen_t *self, int node, void **value)
+{
+    const char *data = NULL;
+    int size = 0;
+
+    if ((self == NULL) || (value == NULL) || (self->mapped_handlers == NULL) ||
+        (self->mapped_handlers->from_binary_fun == NULL))
+    {
+        return 0;
+    }
+
+    data = tree_frozen_value_data(self, node, &size);
+
+    return (data != NULL) && (*self->mapped_handlers->from_binary_fun)(data, size, value);
+}
@@ -0,0 +1,193 @@
+#ifndef CFROZEN_H_
+#define CFROZEN_H_
+
+#include <stdint.h>
+#include "ctree.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif /* __cplusplus */
+
+/**
+ * Read-only copy of a tree as arrays indexed by pre-order position, see tree_freeze()
+ *
+ * Node i is the i-th node of a depth first walk of the tree, the root is node 0 and the subtree
+ * of node i is nodes i to i + subtree_sizes[i] - 1. Walks, lookups and ancestor checks only read
+ * these arrays, which live in one block, or in a file mapped by tree_map_binary(). All fields are
+ * read-only.
+ */
+typedef struct
+{
+    int num_nodes;
+    int depth; /**< number of levels, 0 if there are no nodes, same as tree_depth() */
+    int32_t *parents; /**< position of the parent, -1 for the root */
+    int32_t *first_children; /**< position of the first child in sibling order, -1 for leaves */
+    int32_t *next_siblings; /**< position of the next sibling, -1 for the last child */
+    int32_t *subtree_sizes; /**< number of nodes in the subtree, including the node */
+    int32_t *name_offsets; /**< name of node i is names + name_offsets[i] */
+    char *names; /**< all names one after another, each NULL terminated */
+    unsigned int *name_hashes; /**< node_name_hash() of the names */
+    void **values; /**< owned, disposed of with value_handlers, NULL if mapped */
+    value_handlers_t **value_handlers; /**< NULL if mapped */
+    int32_t *slots; /**< open addressing by name hash, positions of nodes, -1 for empty slots */
+    int num_slots; /**< power of 2 */
+    tree_allocator_t *allocator; /**< of the block, the one of the tree it was frozen from */
+    uint64_t *value_offsets; /**< if mapped, payload of node i is value_data + value_offsets[i] */
+    char *value_data; /**< if mapped, all payloads one after another, see tree_frozen_value_data() */
+    value_handlers_t *mapped_handlers; /**< if mapped, handlers of all the values, see tree_map_binary() */
+    void *mapping; /**< NULL if not mapped */
+    size_t mapping_size;
+} tree_frozen_t;
+
+/**
+ * Visitor for tree_frozen_for_each()
+ *
+ * Should return 0 to continue the walk, any other value stops it.
+ */
+typedef int (*tree_frozen_visit_fun_t)(const tree_frozen_t *frozen, int node, void *ctx);
+
+/**
+ * Move a tree into a tree_frozen_t
+ *
+ * The values move over to the frozen tree, the nodes are disposed of and the tree is left
+ * empty, see tree_clear().
+ *
+ * @param[in,out] tree - the tree to freeze, it must not have snapshots
+ *
+ * @return NULL if tree is NULL, tree has snapshots or memory cannot be allocated,
+ *         in which case the tree is left as is, the frozen tree otherwise
+ */
+tree_frozen_t *tree_freeze(tree_t *tree);
+
+/**
+ * Move a frozen tree back into a tree_t, see tree_build()
+ *
+ * A mapped tree loads every value with tree_frozen_load_value().
+ *
+ * @param[in,out] self - the frozen tree, disposed of on success
+ * @param[in,out] tree - empty tree to build
+ *
+ * @return 0 if self or tree is NULL, tree is not empty, memory cannot be allocated
+ *         or a value cannot be loaded, in which case both are left as they are, 1 otherwise
+ */
+int tree_thaw(tree_frozen_t *self, tree_t *tree);
+
+/**
+ * Dispose of a frozen tree and its values, or unmap it
+ *
+ * @param[in] self - the frozen tree, function does nothing if self is NULL
+ */
+void tree_frozen_dispose(tree_frozen_t *self);
+
+/**
+ * Find a node by name
+ *
+ * @param[in] self - the frozen tree
+ * @param[in] node_name - the name to look for
+ *
+ * @return -1 if self or node_name is NULL or there is no such node, position of the node otherwise
+ */
+int tree_frozen_find(const tree_frozen_t *self, const char *node_name);
+
+/**
+ * Get the name of a node
+ *
+ * @param[in] self - the frozen tree
+ * @param[in] node - position of the node
+ *
+ * @return NULL if self is NULL or node is out of range, the name otherwise
+ */
+const char *tree_frozen_name(const tree_frozen_t *self, int node);
+
+/**
+ * Check whether a node lies in the subtree rooted in another node, in O(1)
+ *
+ * @param[in] self - the frozen tree
+ * @param[in] ancestor_name - name of the root of the subtree
+ * @param[in] descendant_name - name of the node to look for in the subtree
+ *
+ * @return 0 if any argument is NULL or any of the nodes is not found,
+ *         1 if descendant_name node is ancestor_name node or one of its descendants,
+ *         0 otherwise
+ */
+int tree_frozen_is_ancestor(const tree_frozen_t *self, const char *ancestor_name, const char *descendant_name);
+
+/**
+ * Call a visitor for every node of a subtree in pre-order
+ *
+ * @param[in] self - the frozen tree
+ * @param[in] start - position of the root of the subtree
+ * @param[in] visit_fun - visitor, see tree_frozen_visit_fun_t
+ * @param[in] ctx - passed to visit_fun as is
+ *
+ * @return -1 if self or visit_fun is NULL or start is out of range,
+ *         number of visited nodes otherwise, including the one which stopped the walk
+ *
+ * @note A plain loop over positions, nothing to allocate and no pointers to follow
+ */
+int tree_frozen_for_each(const tree_frozen_t *self, int start, tree_frozen_visit_fun_t visit_fun, void *ctx);
+
+/**
+ * Write a tree to a binary snapshot file which tree_map_binary() can map
+ *
+ * The file holds the arrays of tree_frozen_t with offsets instead of pointers, followed by the
+ * value payloads of value_to_binary_fun_t. It is written next to path and renamed over it, so
+ * path holds either the old file or the whole new one, and the directory is synced, so the new
+ * one stays after a crash once the function returns. The file can only be mapped on machines
+ * with the same byte order.
+ *
+ * @param[in] tree - the tree to save, it is left as is
+ * @param[in] path - the file to write
+ *
+ * @return 0 if tree or path is NULL, a value has no to_binary_fun or it fails,
+ *         memory cannot be allocated or the file cannot be written, 1 otherwise
+ */
+int tree_save_binary(tree_t *tree, const char *path);
+
+/**
+ * Map a file of tree_save_binary() as a frozen tree
+ *
+ * Nothing is allocated per node, the arrays of the frozen tree point into the mapping. They are
+ * checked in one pass, so that a broken file cannot make the queries read outside of it. The
+ * values stay in the file as payloads, see tree_frozen_value_data() and tree_frozen_load_value().
+ *
+ * @param[in] path - the file to map
+ * @param[in] value_handlers - handlers of the values in the file, used to load them
+ *                             (can be NULL if they are only read as payloads)
+ *
+ * @return NULL if path is NULL, the file cannot be mapped, is not a snapshot of this machine or
+ *         a position, offset or size in it is out of range, the frozen tree otherwise, dispose of
+ *         it with tree_frozen_dispose()
+ */
+tree_frozen_t *tree_map_binary(const char *path, value_handlers_t *value_handlers);
+
+/**
+ * Get the payload of a value of a mapped tree, without copying it
+ *
+ * @param[in] self - the frozen tree
+ * @param[in] node - position of the node
+ * @param[out] size - size of the payload (can be NULL)
+ *
+ * @return NULL if self is NULL, self is not mapped or node is out of range,
+ *         the payload otherwise, valid until self is disposed of
+ */
+const char *tree_frozen_value_data(const tree_frozen_t *self, int node, int *size);
+
+/**
+ * Create a value of a mapped tree from its payload, see value_from_binary_fun_t
+ *
+ * @param[in] self - the frozen tree
+ * @param[in] node - position of the node
+ * @param[out] value - the value, which can be NULL, owned by the caller
+ *
+ * @return 0 if self or value is NULL, self is not mapped, there is no from_binary_fun, node is out
+ *         of range or from_binary_fun fails, 1 otherwise
+ */
+int tree_frozen_load_value(const tree_frozen_t *self, int node, void **value);
+
+#ifdef __cplusplus
+} /* extern "C" */
+#endif /* __cplusplus */
+
+#endif /* CFROZEN_H_ */
@@ -0,0 +1,246 @@
+#include "citer.h"
+#include <stdlib.h>
+#include <string.h>
+
+#define TREE_ITER_MIN_CAPACITY 16
+
+void tree_iter_init(tree_iter_t *self)
+{
+    if (self == NULL)
+    {
+        return;
+    }
+
+    memset(self, 0, sizeof(tree_iter_t));
+}
+
+void tree_iter_clear(tree_iter_t *self)
+{
+    if (self == NULL)
+    {
+        return;
+    }
+
+    free(self->frames);
+    memset(self, 0, sizeof(tree_iter_t));
+}
+
+/* make room for at least capacity frames, keeps the frames in use */
+static int tree_iter_reserve(tree_iter_t *self, int capacity)
+{
+    tree_iter_frame_t *new_frames = NULL;
+    int new_capacity = (self->capacity > 0) ? self->capacity : TREE_ITER_MIN_CAPACITY;
+
+    if (capacity <= self->capacity)
+    {
+        return 1;
+    }
+
+    while (new_capacity < capacity)
+    {
+        new_capacity *= 2;
+    }
+
+    new_frames = realloc(self->frames, new_capacity * sizeof(tree_iter_frame_t));
+
+    /* failed to reallocate memory */
+    if (new_frames == NULL)
+    {
+        return 0;
+    }
+
+    self->frames = new_frames;
+    self->capacity = new_capacity;
+
+    return 1;
+}
+
+static void tree_iter_push(tree_iter_t *self, node_t *node)
+{
+    self->frames[self->num_frames].node = node;
+    self->frames[self->num_frames].next_child = 0;
+    ++self->num_frames;
+}
+
+int tree_iter_start(tree_iter_t *self, node_t *start, tree_iter_mode_t mode)
+{
+    if (self == NULL)
+    {
+        return 0;
+    }
+
+    self->mode = mode;
+    self->num_frames = 0;
+    self->head = 0;
+    self->pending = NULL;
+    self->out_of_memory = 0;
+
+    if (start == NULL)
+    {
+        return 1;
+    }
+
+    /* the path from start never gets longer than its height */
+    if (!tree_iter_reserve(self, (mode == TREE_ITER_LEVEL_ORDER) ? 1 : start->height))
+    {
+        return 0;
+    }
+
+    if (mode == TREE_ITER_PRE_ORDER)
+    {
+        self->pending = start;
+    }
+    else
+    {
+        tree_iter_push(self, start);
+    }
+
+    return 1;
+}
+
+static node_t *tree_iter_next_pre_order(tree_iter_t *self)
+{
+    tree_iter_frame_t *frame = NULL;
+    node_t *node = self->pending;
+
+    if (node != NULL)
+    {
+        self->pending = NULL;
+        tree_iter_push(self, node);
+        return node;
+    }
+
+    while (self->num_frames > 0)
+    {
+        frame = &self->frames[self->num_frames - 1];
+
+        if (frame->next_child < frame->node->num_children)
+        {
+            node = frame->node->children[frame->next_child++];
+            tree_iter_push(self, node);
+            return node;
+        }
+
+        --self->num_frames;
+    }
+
+    return NULL;
+}
+
+static node_t *tree_iter_next_post_order(tree_iter_t *self)
+{
+    tree_iter_frame_t *frame = NULL;
+
+    while (self->num_frames > 0)
+    {
+        frame = &self->frames[self->num_frames - 1];
+
+        if (frame->next_child < frame->node->num_children)
+        {
+            tree_iter_push(self, frame->node->children[frame->next_child++]);
+        }
+        else
+        {
+            --self->num_frames;
+            return frame->node;
+        }
+    }
+
+    return NULL;
+}
+
+static node_t *tree_iter_next_level_order(tree_iter_t *self)
+{
+    node_t *node = NULL;
+    int i = 0;
+
+    if (self->head == self->num_frames)
+    {
+        return NULL;
+    }
+
+    node = self->frames[self->head++].node;
+
+    if (self->num_frames + node->num_children > self->capacity)
+    {
+        /* reuse the room freed at the front of the queue first */
+        memmove(
+            self->frames,
+            &self->frames[self->head],
+            (self->num_frames - self->head) * sizeof(tree_iter_frame_t));
+        self->num_frames -= self->head;
+        self->head = 0;
+
+        if (!tree_iter_reserve(self, self->num_frames + node->num_children))
+        {
+            self->out_of_memory = 1;
+            self->num_frames = 0;
+            return NULL;
+        }
+    }
+
+    for (; i < node->num_children; ++i)
+    {
+        tree_iter_push(self, node->children[i]);
+    }
+
+    return node;
+}
+
+node_t *tree_iter_next(tree_iter_t *self)
+{
+    if (self == NULL)
+    {
+        return NULL;
+    }
+
+    switch (self->mode)
+    {
+    case TREE_ITER_PRE_ORDER:
+        return tree_iter_next_pre_order(self);
+    case TREE_ITER_POST_ORDER:
+        return tree_iter_next_post_order(self);
+    case TREE_ITER_LEVEL_ORDER:
+        return tree_iter_next_level_order(self);
+    default:
+        return NULL;
+    }
+}
+
+int node_for_each(node_t *start, tree_iter_mode_t mode, tree_visit_fun_t visit_fun, void *ctx)
+{
+    tree_iter_t iter;
+    node_t *node = NULL;
+    int visited_cnt = 0;
+
+    if (visit_fun == NULL)
+    {
+        return -1;
+    }
+
+    tree_iter_init(&iter);
+
+    if (!tree_iter_start(&iter, start, mode))
+    {
+        return -1;
+    }
+
+    while ((node = tree_iter_next(&iter)) != NULL)
+    {
+        ++visited_cnt;
+
+        if ((*visit_fun)(node, ctx) != 0)
+        {
+            break;
+        }
+    }
+
+    if (iter.out_of_memory)
+    {
+        visited_cnt = -1;
+    }
+
+    tree_iter_clear(&iter);
+
+    return visited_cnt;
+}
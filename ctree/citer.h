@@ -0,0 +1,107 @@
+#ifndef CITER_H_
+#define CITER_H_
+
+#include "cnode.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif /* __cplusplus */
+
+/**
+ * Order in which tree_iter_t visits the nodes
+ */
+typedef enum
+{
+    TREE_ITER_PRE_ORDER = 0, /**< parent first, then subtrees of its children in order */
+    TREE_ITER_POST_ORDER, /**< subtrees of children in order, then their parent */
+    TREE_ITER_LEVEL_ORDER /**< breadth first, level by level */
+} tree_iter_mode_t;
+
+typedef struct
+{
+    node_t *node;
+    int next_child; /**< index of the child to descend into next */
+} tree_iter_frame_t;
+
+/**
+ * Iterator over a subtree which uses an explicit stack instead of recursion
+ *
+ * The stack (a queue in level order) is kept between walks, so an iterator which is started
+ * again does not allocate memory unless it needs more than before.
+ */
+typedef struct
+{
+    tree_iter_mode_t mode;
+    tree_iter_frame_t *frames; /**< path from start in pre- and post-order, queue in level order */
+    int num_frames; /**< stack top, or queue tail in level order */
+    int head; /**< queue head in level order */
+    int capacity;
+    node_t *pending; /**< node to be returned by the next tree_iter_next() in pre-order */
+    int out_of_memory; /**< set if the walk was cut short because the buffer could not grow */
+} tree_iter_t;
+
+/**
+ * Visitor for tree_for_each() and similar walks
+ *
+ * Should return 0 to continue the walk, any other value stops it.
+ */
+typedef int (*tree_visit_fun_t)(node_t *node, void *ctx);
+
+/**
+ * Initialize an iterator which has not walked anything yet
+ *
+ * @param[in,out] self - pointer to the iterator, function does nothing if self is NULL
+ */
+void tree_iter_init(tree_iter_t *self);
+
+/**
+ * Free the buffer of an iterator
+ *
+ * @param[in,out] self - pointer to the iterator, function does nothing if self is NULL
+ */
+void tree_iter_clear(tree_iter_t *self);
+
+/**
+ * Start a walk over the subtree rooted in a node
+ *
+ * @param[in,out] self - pointer to an initialized iterator
+ * @param[in] start - root of the subtree to walk, can be NULL for an empty walk
+ * @param[in] mode - order of the walk
+ *
+ * @return 0 if self is NULL or memory for the walk cannot be allocated, 1 otherwise
+ *
+ * @note Pre- and post-order walks reserve node_t::height frames here and never allocate
+ *       afterwards, level order walks grow the queue as needed.
+ * @warning The subtree must not change until the walk is finished.
+ */
+int tree_iter_start(tree_iter_t *self, node_t *start, tree_iter_mode_t mode);
+
+/**
+ * Get the next node of the walk
+ *
+ * @param[in,out] self - pointer to a started iterator
+ *
+ * @return NULL if self is NULL, NULL if the walk is finished or out_of_memory was set,
+ *         next node otherwise
+ */
+node_t *tree_iter_next(tree_iter_t *self);
+
+/**
+ * Call a visitor for every node of a subtree
+ *
+ * @param[in] start - root of the subtree to walk
+ * @param[in] mode - order of the walk
+ * @param[in] visit_fun - visitor, called with each node and ctx
+ * @param[in] ctx - passed to visit_fun as is
+ *
+ * @return -1 if visit_fun is NULL or memory for the walk cannot be allocated,
+ *         number of visited nodes otherwise, including the one which stopped the walk
+ */
+int node_for_each(node_t *start, tree_iter_mode_t mode, tree_visit_fun_t visit_fun, void *ctx);
+
+#ifdef __cplusplus
+} /* extern "C" */
+#endif /* __cplusplus */
+
+#endif /* CITER_H_ */
@@ -0,0 +1,924 @@
+#include "cjournal.h"
+#include "cbinary.h"
+#include "ccompact.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define TREE_JOURNAL_HEADER_SIZE 9
+#define TREE_JOURNAL_WORD_SIZE 4
+#define TREE_JOURNAL_MIN_CAPACITY 4096
+#define TREE_JOURNAL_TMP_SUFFIX ".tmp"
+
+/* the byte after the size of a record */
+typedef enum
+{
+    TREE_JOURNAL_ADD_NODE = 1, /* parent, name, value */
+    TREE_JOURNAL_ADD_TREE, /* parent, subtree */
+    TREE_JOURNAL_REMOVE_NODE, /* name */
+    TREE_JOURNAL_REMOVE_TREE, /* name */
+    TREE_JOURNAL_CHECKPOINT /* whole tree */
+} tree_journal_record_type_t;
+
+typedef struct
+{
+    char *data;
+    int size;
+    int capacity;
+} tree_journal_buffer_t;
+
+/* the magic "CTREEJNL" and the version */
+static const char tree_journal_header[TREE_JOURNAL_HEADER_SIZE] = {'C', 'T', 'R', 'E', 'E', 'J', 'N', 'L', TREE_JOURNAL_VERSION};
+
+struct tree_journal_s
+{
+    pthread_mutex_t mutex; /* protects all the other fields */
+    pthread_cond_t flushed_cond; /* signalled when a write and sync is over */
+    char *path;
+    int fd; /* opened for appending */
+    tree_journal_buffer_t pending; /* records not taken by a commit yet */
+    tree_journal_buffer_t flushing; /* records being written by a commit, outside the mutex */
+    unsigned long long num_appended; /* records appended since the journal was opened */
+    unsigned long long num_durable; /* records out of num_appended which are synced */
+    int flush_in_progress;
+    int failed;
+};
+
+/* fields of a record, see tree_journal_get_varint() */
+typedef struct
+{
+    const unsigned char *data;
+    const unsigned char *end;
+} tree_journal_cursor_t;
+
+/* runs of added nodes wait here for tree_add_nodes() */
+typedef struct
+{
+    node_t **nodes;
+    const char **parent_names;
+    int *parent_offsets; /* in names, -1 for no parent */
+    int num_nodes;
+    int capacity;
+    tree_journal_buffer_t names;
+} tree_journal_batch_t;
+
+static int tree_journal_reserve(tree_journal_buffer_t *buffer, int size)
+{
+    char *grown = NULL;
+    int capacity = (buffer->capacity > 0) ? buffer->capacity : TREE_JOURNAL_MIN_CAPACITY;
+
+    if (size > INT_MAX - buffer->size)
+    {
+        return 0;
+    }
+
+    if (buffer->size + size <= buffer->capacity)
+    {
+        return 1;
+    }
+
+    while (capacity < buffer->size + size)
+    {
+        capacity = (capacity > INT_MAX / 2) ? INT_MAX : 2 * capacity;
+    }
+
+    grown = tree_realloc(NULL, buffer->data, capacity);
+
+    if (grown == NULL)
+    {
+        return 0;
+    }
+
+    buffer->data = grown;
+    buffer->capacity = capacity;
+    return 1;
+}
+
+static int tree_journal_put(tree_journal_buffer_t *buffer, const void *data, int size)
+{
+    if (!tree_journal_reserve(buffer, size))
+    {
+        return 0;
+    }
+
+    memcpy(buffer->data + buffer->size, data, size);
+    buffer->size += size;
+    return 1;
+}
+
+static int tree_journal_put_varint(tree_journal_buffer_t *buffer, unsigned int number)
+{
+    unsigned char bytes[TREE_VARINT_MAX_SIZE];
+
+    return tree_journal_put(buffer, bytes, tree_varint_encode(number, bytes));
+}
+
+/* little endian whatever the machine */
+static void tree_journal_store_word(char *data, uint32_t word)
+{
+    int i = 0;
+
+    for (; i < TREE_JOURNAL_WORD_SIZE; ++i)
+    {
+        data[i] = (char)(word >> (8 * i));
+    }
+}
+
+static uint32_t tree_journal_load_word(const char *data)
+{
+    uint32_t word = 0;
+    int i = 0;
+
+    for (; i < TREE_JOURNAL_WORD_SIZE; ++i)
+    {
+        word |= (uint32_t)(unsigned char)data[i] << (8 * i);
+    }
+
+    return word;
+}
+
+/* 32-bit FNV-1a, like node_name_hash() but over bytes */
+static uint32_t tree_journal_checksum(const char *data, int size)
+{
+    uint32_t hash = 2166136261u;
+    int i = 0;
+
+    for (; i < size; ++i)
+    {
+        hash = (hash ^ (unsigned char)data[i]) * 16777619u;
+    }
+
+    return hash;
+}
+
+/* the size goes in front once the fields are in, see tree_journal_end() */
+static int tree_journal_begin(tree_journal_buffer_t *buffer, tree_journal_record_type_t type)
+{
+    char byte = (char)type;
+    int start = buffer->size;
+
+    if (!tree_journal_reserve(buffer, TREE_JOURNAL_WORD_SIZE))
+    {
+        return -1;
+    }
+
+    buffer->size += TREE_JOURNAL_WORD_SIZE;
+
+    return tree_journal_put(buffer, &byte, 1) ? start : -1;
+}
+
+static int tree_journal_end(tree_journal_buffer_t *buffer, int start)
+{
+    int size = buffer->size - start - TREE_JOURNAL_WORD_SIZE;
+
+    if (!tree_journal_reserve(buffer, TREE_JOURNAL_WORD_SIZE))
+    {
+        return 0;
+    }
+
+    tree_journal_store_word(buffer->data + start, (uint32_t)size);
+    tree_journal_store_word(
+        buffer->data + buffer->size,
+        tree_journal_checksum(buffer->data + start + TREE_JOURNAL_WORD_SIZE, size));
+    buffer->size += TREE_JOURNAL_WORD_SIZE;
+
+    return 1;
+}
+
+static int tree_journal_put_name(tree_journal_buffer_t *buffer, const char *name)
+{
+    int size = (int)strlen(name);
+
+    return tree_journal_put_varint(buffer, (unsigned int)size) && tree_journal_put(buffer, name, size);
+}
+
+/* 0 for no parent, so that the root of an empty tree can be told from a parent named "" */
+static int tree_journal_put_parent(tree_journal_buffer_t *buffer, const char *parent_name)
+{
+    int size = (parent_name != NULL) ? (int)strlen(parent_name) : -1;
+
+    return tree_journal_put_varint(buffer, (unsigned int)(size + 1)) &&
+           ((size <= 0) || tree_journal_put(buffer, parent_name, size));
+}
+
+static int tree_journal_put_value(tree_journal_buffer_t *buffer, node_t *node)
+{
+    int size = value_binary_size(node->value_handlers, node->value);
+
+    if ((size < 0) || !tree_journal_put_varint(buffer, (unsigned int)size) ||
+        !tree_journal_reserve(buffer, size) ||
+        !value_binary_write(node->value_handlers, node->value, buffer->data + buffer->size, size))
+    {
+        return 0;
+    }
+
+    buffer->size += size;
+    return 1;
+}
+
+/* the subtree of root, the whole tree if root is NULL */
+static int tree_journal_put_compact(tree_journal_buffer_t *buffer, tree_t *tree, node_t *root)
+{
+    int size = (root != NULL) ? tree_subtree_to_compact(tree, root->object_name, NULL, 0)
+                              : tree_to_compact(tree, NULL, 0);
+
+    if ((size == 0) || !tree_journal_reserve(buffer, size))
+    {
+        return 0;
+    }
+
+    if (((root != NULL) ? tree_subtree_to_compact(tree, root->object_name, buffer->data + buffer->size, size)
+                        : tree_to_compact(tree, buffer->data + buffer->size, size)) != size)
+    {
+        return 0;
+    }
+
+    buffer->size += size;
+    return 1;
+}
+
+/* done, or taken back and the journal failed */
+static void tree_journal_append_end(tree_journal_t *self, int start, int put)
+{
+    if (put && (start >= 0) && tree_journal_end(&self->pending, start))
+    {
+        ++self->num_appended;
+    }
+    else
+    {
+        self->pending.size = (start >= 0) ? start : self->pending.size;
+        self->failed = 1;
+    }
+
+    pthread_mutex_unlock(&self->mutex);
+}
+
+void tree_journal_record_add_node(tree_journal_t *self, node_t *node, const char *parent_node_name)
+{
+    int start = 0;
+
+    if (self == NULL)
+    {
+        return;
+    }
+
+    pthread_mutex_lock(&self->mutex);
+    start = tree_journal_begin(&self->pending, TREE_JOURNAL_ADD_NODE);
+    tree_journal_append_end(
+        self,
+        start,
+        (start >= 0) && tree_journal_put_parent(&self->pending, parent_node_name) &&
+            tree_journal_put_name(&self->pending, node->object_name) && tree_journal_put_value(&self->pending, node));
+}
+
+void tree_journal_record_add_tree(tree_journal_t *self, tree_t *tree, node_t *sub_tree_root, const char *parent_node_name)
+{
+    int start = 0;
+
+    if (self == NULL)
+    {
+        return;
+    }
+
+    pthread_mutex_lock(&self->mutex);
+    start = tree_journal_begin(&self->pending, TREE_JOURNAL_ADD_TREE);
+    tree_journal_append_end(
+        self,
+        start,
+        (start >= 0) && tree_journal_put_parent(&self->pending, parent_node_name) &&
+            tree_journal_put_compact(&self->pending, tree, sub_tree_root));
+}
+
+static void tree_journal_record_remove(tree_journal_t *self, tree_journal_record_type_t type, const char *name)
+{
+    int start = 0;
+
+    if (self == NULL)
+    {
+        return;
+    }
+
+    pthread_mutex_lock(&self->mutex);
+    start = tree_journal_begin(&self->pending, type);
+    tree_journal_append_end(self, start, (start >= 0) && tree_journal_put_name(&self->pending, name));
+}
+
+void tree_journal_record_remove_node(tree_journal_t *self, const char *node_name)
+{
+    tree_journal_record_remove(self, TREE_JOURNAL_REMOVE_NODE, node_name);
+}
+
+void tree_journal_record_remove_tree(tree_journal_t *self, const char *sub_tree_root_name)
+{
+    tree_journal_record_remove(self, TREE_JOURNAL_REMOVE_TREE, sub_tree_root_name);
+}
+
+static int tree_journal_write_all(int fd, const char *data, int size)
+{
+    ssize_t written = 0;
+
+    while (size > 0)
+    {
+        written = write(fd, data, size);
+
+        if ((written < 0) && (errno == EINTR))
+        {
+            continue;
+        }
+
+        if (written <= 0)
+        {
+            return 0;
+        }
+
+        data += written;
+        size -= (int)written;
+    }
+
+    return 1;
+}
+
+int tree_journal_commit(tree_journal_t *self)
+{
+    tree_journal_buffer_t taken;
+    unsigned long long target = 0;
+    unsigned long long upto = 0;
+    int written = 0;
+    int committed = 0;
+
+    if (self == NULL)
+    {
+        return 0;
+    }
+
+    pthread_mutex_lock(&self->mutex);
+    target = self->num_appended;
+
+    while (!self->failed && (self->num_durable < target))
+    {
+        if (self->flush_in_progress)
+        {
+            pthread_cond_wait(&self->flushed_cond, &self->mutex);
+            continue;
+        }
+
+        /* lead the next group, with the records of all the threads which wait */
+        taken = self->flushing;
+        self->flushing = self->pending;
+        self->pending = taken;
+        self->pending.size = 0;
+        upto = self->num_appended;
+        self->flush_in_progress = 1;
+        pthread_mutex_unlock(&self->mutex);
+
+        written = tree_journal_write_all(self->fd, self->flushing.data, self->flushing.size) &&
+                  (fdatasync(self->fd) == 0);
+
+        pthread_mutex_lock(&self->mutex);
+        self->flushing.size = 0;
+        self->flush_in_progress = 0;
+        self->num_durable = written ? upto : self->num_durable;
+        self->failed = self->failed || !written;
+        pthread_cond_broadcast(&self->flushed_cond);
+    }
+
+    committed = !self->failed;
+    pthread_mutex_unlock(&self->mutex);
+
+    return committed;
+}
+
+/* next record, 0 at the end of the file or at a record which was cut short or is broken */
+static int tree_journal_read(FILE *file, long long *remaining, tree_journal_buffer_t *record)
+{
+    char word[TREE_JOURNAL_WORD_SIZE];
+    uint32_t size = 0;
+
+    if ((*remaining < 2 * TREE_JOURNAL_WORD_SIZE + 1) || (fread(word, 1, sizeof(word), file) != sizeof(word)))
+    {
+        return 0;
+    }
+
+    size = tree_journal_load_word(word);
+
+    /* checked against the file before anything is allocated for it */
+    if ((size < 1) || (size > *remaining - 2 * TREE_JOURNAL_WORD_SIZE) || (size > INT_MAX))
+    {
+        return 0;
+    }
+
+    record->size = 0;
+
+    if (!tree_journal_reserve(record, (int)size) || (fread(record->data, 1, size, file) != size) ||
+        (fread(word, 1, sizeof(word), file) != sizeof(word)) ||
+        (tree_journal_load_word(word) != tree_journal_checksum(record->data, (int)size)))
+    {
+        return 0;
+    }
+
+    record->size = (int)size;
+    *remaining -= size + 2 * TREE_JOURNAL_WORD_SIZE;
+
+    return 1;
+}
+
+/* open at the first record, remaining is the size of the records */
+static FILE *tree_journal_open_file(const char *path, long long *remaining)
+{
+    char header[TREE_JOURNAL_HEADER_SIZE];
+    struct stat stat_buffer;
+    FILE *file = fopen(path, "rb");
+
+    if ((file != NULL) && (fstat(fileno(file), &stat_buffer) == 0) &&
+        (fread(header, 1, sizeof(header), file) == sizeof(header)) &&
+        (memcmp(header, tree_journal_header, sizeof(header)) == 0))
+    {
+        *remaining = (long long)stat_buffer.st_size - TREE_JOURNAL_HEADER_SIZE;
+        return file;
+    }
+
+    if (file != NULL)
+    {
+        fclose(file);
+    }
+
+    return NULL;
+}
+
+static char *tree_journal_copy_path(const char *path, const char *suffix)
+{
+    size_t path_size = strlen(path);
+    size_t suffix_size = strlen(suffix) + 1;
+    char *copy = tree_malloc(NULL, path_size + suffix_size);
+
+    if (copy != NULL)
+    {
+        memcpy(copy, path, path_size);
+        memcpy(copy + path_size, suffix, suffix_size);
+    }
+
+    return copy;
+}
+
+/* size of the valid part of the file, the header of an empty one is written first */
+static long long tree_journal_prepare(int fd, const char *path)
+{
+    tree_journal_buffer_t record = {NULL, 0, 0};
+    struct stat stat_buffer;
+    long long remaining = 0;
+    long long valid = 0;
+    FILE *file = NULL;
+
+    if (fstat(fd, &stat_buffer) != 0)
+    {
+        return -1;
+    }
+
+    if (stat_buffer.st_size == 0)
+    {
+        return (tree_journal_write_all(fd, tree_journal_header, TREE_JOURNAL_HEADER_SIZE) && (fdatasync(fd) == 0))
+                   ? TREE_JOURNAL_HEADER_SIZE
+                   : -1;
+    }
+
+    file = tree_journal_open_file(path, &remaining);
+
+    if (file == NULL)
+    {
+        return -1;
+    }
+
+    valid = (long long)stat_buffer.st_size - remaining;
+
+    while (tree_journal_read(file, &remaining, &record))
+    {
+        valid = (long long)stat_buffer.st_size - remaining;
+    }
+
+    tree_free(NULL, record.data);
+    fclose(file);
+
+    return valid;
+}
+
+tree_journal_t *tree_journal_open(const char *path)
+{
+    tree_journal_t *self = NULL;
+    long long valid = 0;
+    int fd = -1;
+
+    if (path == NULL)
+    {
+        return NULL;
+    }
+
+    self = tree_malloc(NULL, sizeof(tree_journal_t));
+    fd = open(path, O_RDWR | O_CREAT | O_APPEND, 0644);
+
+    if ((self == NULL) || (fd < 0))
+    {
+        tree_free(NULL, self);
+        close(fd);
+        return NULL;
+    }
+
+    memset(self, 0, sizeof(tree_journal_t));
+    self->fd = fd;
+    self->path = tree_journal_copy_path(path, "");
+    valid = tree_journal_prepare(fd, path);
+
+    /* a record cut short by a crash would hide the ones appended after it */
+    if ((self->path == NULL) || (valid < 0) || (ftruncate(fd, (off_t)valid) != 0))
+    {
+        tree_free(NULL, self->path);
+        tree_free(NULL, self);
+        close(fd);
+        return NULL;
+    }
+
+    pthread_mutex_init(&self->mutex, NULL);
+    pthread_cond_init(&self->flushed_cond, NULL);
+
+    return self;
+}
+
+void tree_journal_dispose(tree_journal_t *self)
+{
+    if (self == NULL)
+    {
+        return;
+    }
+
+    close(self->fd);
+    pthread_cond_destroy(&self->flushed_cond);
+    pthread_mutex_destroy(&self->mutex);
+    tree_free(NULL, self->pending.data);
+    tree_free(NULL, self->flushing.data);
+    tree_free(NULL, self->path);
+    tree_free(NULL, self);
+}
+
+int tree_journal_checkpoint(tree_journal_t *self, tree_t *tree)
+{
+    tree_journal_buffer_t file = {NULL, 0, 0};
+    char *tmp_path = NULL;
+    int start = 0;
+    int fd = -1;
+    int written = 0;
+    int renamed = 0;
+
+    if ((self == NULL) || (tree == NULL))
+    {
+        return 0;
+    }
+
+    pthread_mutex_lock(&self->mutex);
+
+    /* the commit in progress writes to the old file */
+    while (self->flush_in_progress)
+    {
+        pthread_cond_wait(&self->flushed_cond, &self->mutex);
+    }
+
+    tmp_path = tree_journal_copy_path(self->path, TREE_JOURNAL_TMP_SUFFIX);
+    written = (tmp_path != NULL) && tree_journal_put(&file, tree_journal_header, TREE_JOURNAL_HEADER_SIZE) &&
+              ((start = tree_journal_begin(&file, TREE_JOURNAL_CHECKPOINT)) >= 0) &&
+              tree_journal_put_compact(&file, tree, NULL) && tree_journal_end(&file, start);
+
+    if (written)
+    {
+        fd = open(tmp_path, O_WRONLY | O_CREAT | O_TRUNC | O_APPEND, 0644);
+        renamed = (fd >= 0) && tree_journal_write_all(fd, file.data, file.size) && (fsync(fd) == 0) &&
+                  (rename(tmp_path, self->path) == 0);
+        written = renamed && tree_sync_dir(NULL, self->path);
+    }
+
+    if (written)
+    {
+        close(self->fd);
+        self->fd = fd;
+        self->pending.size = 0;
+        self->num_durable = self->num_appended;
+        self->failed = 0;
+    }
+    else if (renamed)
+    {
+        /* the old file is gone and the copy may not survive a crash, nothing is durable now */
+        close(fd);
+        self->failed = 1;
+    }
+    else if (fd >= 0)
+    {
+        close(fd);
+        unlink(tmp_path);
+    }
+
+    pthread_mutex_unlock(&self->mutex);
+
+    tree_free(NULL, tmp_path);
+    tree_free(NULL, file.data);
+
+    return written;
+}
+
+/* up to 32 bits, 0 if the record ends or the number does not fit */
+static int tree_journal_get_varint(tree_journal_cursor_t *cursor, unsigned int *number)
+{
+    return tree_varint_decode(&cursor->data, cursor->end, number);
+}
+
+/* bytes of a name, which are not NULL terminated */
+static const char *tree_journal_get_bytes(tree_journal_cursor_t *cursor, unsigned int size)
+{
+    const char *bytes = (const char *)cursor->data;
+
+    if ((size > (unsigned int)(cursor->end - cursor->data)) || (memchr(bytes, '\0', size) != NULL))
+    {
+        return NULL;
+    }
+
+    cursor->data += size;
+    return bytes;
+}
+
+/* a name copied to buffer and NULL terminated, offset of the copy or -1 */
+static int tree_journal_get_name(tree_journal_cursor_t *cursor, tree_journal_buffer_t *buffer)
+{
+    unsigned int size = 0;
+    const char *bytes = NULL;
+    int offset = buffer->size;
+
+    if (!tree_journal_get_varint(cursor, &size) || ((bytes = tree_journal_get_bytes(cursor, size)) == NULL) ||
+        !tree_journal_put(buffer, bytes, (int)size) || !tree_journal_put(buffer, "", 1))
+    {
+        return -1;
+    }
+
+    return offset;
+}
+
+/* like tree_journal_get_name(), -2 if it fails, -1 for no parent */
+static int tree_journal_get_parent(tree_journal_cursor_t *cursor, tree_journal_buffer_t *buffer)
+{
+    unsigned int size = 0;
+    const char *bytes = NULL;
+    int offset = buffer->size;
+
+    if (!tree_journal_get_varint(cursor, &size))
+    {
+        return -2;
+    }
+
+    if (size == 0)
+    {
+        return -1;
+    }
+
+    if (((bytes = tree_journal_get_bytes(cursor, size - 1)) == NULL) ||
+        !tree_journal_put(buffer, bytes, (int)size - 1) || !tree_journal_put(buffer, "", 1))
+    {
+        return -2;
+    }
+
+    return offset;
+}
+
+static void tree_journal_batch_dispose(tree_journal_batch_t *batch)
+{
+    while (batch->num_nodes > 0)
+    {
+        node_dispose(batch->nodes[--batch->num_nodes]);
+    }
+
+    batch->names.size = 0;
+}
+
+static int tree_journal_batch_add(
+    tree_journal_batch_t *batch,
+    tree_t *tree,
+    value_handlers_t *value_handlers,
+    tree_journal_cursor_t *cursor,
+    tree_journal_buffer_t *name)
+{
+    unsigned int size = 0;
+    node_t **nodes = NULL;
+    const char **parent_names = NULL;
+    int *parent_offsets = NULL;
+    int capacity = 0;
+    int parent = 0;
+    void *value = NULL;
+    node_t *node = NULL;
+
+    if (batch->num_nodes == batch->capacity)
+    {
+        capacity = (batch->capacity > 0) ? 2 * batch->capacity : TREE_JOURNAL_MIN_CAPACITY;
+        nodes = tree_realloc(NULL, batch->nodes, capacity * sizeof(node_t *));
+        batch->nodes = (nodes != NULL) ? nodes : batch->nodes;
+        parent_names = tree_realloc(NULL, batch->parent_names, capacity * sizeof(const char *));
+        batch->parent_names = (parent_names != NULL) ? parent_names : batch->parent_names;
+        parent_offsets = tree_realloc(NULL, batch->parent_offsets, capacity * sizeof(int));
+        batch->parent_offsets = (parent_offsets != NULL) ? parent_offsets : batch->parent_offsets;
+
+        if ((nodes == NULL) || (parent_names == NULL) || (parent_offsets == NULL))
+        {
+            return 0;
+        }
+
+        batch->capacity = capacity;
+    }
+
+    name->size = 0;
+    parent = tree_journal_get_parent(cursor, &batch->names);
+
+    if ((parent == -2) || (tree_journal_get_name(cursor, name) < 0) || !tree_journal_get_varint(cursor, &size) ||
+        (size > (unsigned int)(cursor->end - cursor->data)))
+    {
+        return 0;
+    }
+
+    if (!(*value_handlers->from_binary_fun)((const char *)cursor->data, (int)size, &value))
+    {
+        return 0;
+    }
+
+    cursor->data += size;
+    node = node_create_with(tree->allocator, value_handlers, name->data, value);
+
+    if ((node == NULL) && (value_handlers->dispose_fun != NULL))
+    {
+        (*value_handlers->dispose_fun)(value);
+    }
+
+    if ((node == NULL) || (cursor->data != cursor->end))
+    {
+        node_dispose(node);
+        return 0;
+    }
+
+    batch->nodes[batch->num_nodes] = node;
+    batch->parent_offsets[batch->num_nodes++] = parent;
+
+    return 1;
+}
+
+/* all of them go in with one merge of the nodes table, see tree_add_nodes() */
+static int tree_journal_batch_flush(tree_journal_batch_t *batch, tree_t *tree)
+{
+    int num_added = 0;
+    int i = 0;
+
+    if (batch->num_nodes == 0)
+    {
+        return 1;
+    }
+
+    for (; i < batch->num_nodes; ++i)
+    {
+        batch->parent_names[i] = (batch->parent_offsets[i] >= 0) ? batch->names.data + batch->parent_offsets[i] : NULL;
+    }
+
+    num_added = tree_add_nodes(tree, batch->nodes, batch->parent_names, batch->num_nodes);
+
+    /* the ones which did not go in are still ours */
+    if (num_added != batch->num_nodes)
+    {
+        for (i = 0; i < batch->num_nodes; ++i)
+        {
+            if (tree_get_node(tree, batch->nodes[i]->object_name) != batch->nodes[i])
+            {
+                node_dispose(batch->nodes[i]);
+            }
+        }
+    }
+
+    batch->num_nodes = 0;
+    batch->names.size = 0;
+
+    return num_added == i;
+}
+
+/* a subtree in the form of tree_to_compact() goes under its parent */
+static int tree_journal_replay_add_tree(
+    tree_t *tree,
+    value_handlers_t *value_handlers,
+    tree_journal_cursor_t *cursor,
+    tree_journal_buffer_t *name)
+{
+    tree_t sub_tree;
+    int parent = 0;
+    int added = 0;
+
+    name->size = 0;
+    parent = tree_journal_get_parent(cursor, name);
+
+    tree_init(&sub_tree);
+    tree_set_allocator(&sub_tree, tree->allocator);
+
+    added = (parent != -2) &&
+            tree_from_compact(&sub_tree, value_handlers, (const char *)cursor->data, (int)(cursor->end - cursor->data)) &&
+            (tree_add_tree(tree, &sub_tree, (parent >= 0) ? name->data + parent : NULL) != NULL);
+
+    tree_clear(&sub_tree);
+
+    return added;
+}
+
+static int tree_journal_replay(
+    tree_t *tree,
+    value_handlers_t *value_handlers,
+    tree_journal_buffer_t *record,
+    tree_journal_batch_t *batch,
+    tree_journal_buffer_t *name)
+{
+    tree_journal_cursor_t cursor;
+    int type = (unsigned char)record->data[0];
+
+    cursor.data = (const unsigned char *)record->data + 1;
+    cursor.end = (const unsigned char *)record->data + record->size;
+    name->size = 0;
+
+    switch (type)
+    {
+    case TREE_JOURNAL_ADD_NODE:
+        return tree_journal_batch_add(batch, tree, value_handlers, &cursor, name);
+
+    case TREE_JOURNAL_ADD_TREE:
+        return tree_journal_batch_flush(batch, tree) && tree_journal_replay_add_tree(tree, value_handlers, &cursor, name);
+
+    case TREE_JOURNAL_REMOVE_NODE:
+        return tree_journal_batch_flush(batch, tree) && (tree_journal_get_name(&cursor, name) == 0) &&
+               (cursor.data == cursor.end) && tree_remove_node(tree, name->data);
+
+    case TREE_JOURNAL_REMOVE_TREE:
+        return tree_journal_batch_flush(batch, tree) && (tree_journal_get_name(&cursor, name) == 0) &&
+               (cursor.data == cursor.end) && (tree_remove_tree(tree, name->data) > 0);
+
+    case TREE_JOURNAL_CHECKPOINT:
+        /* everything before is in the copy */
+        tree_journal_batch_dispose(batch);
+        tree_clear(tree);
+        return tree_from_compact(tree, value_handlers, (const char *)cursor.data, (int)(cursor.end - cursor.data));
+
+    default:
+        return 0;
+    }
+}
+
+int tree_replay_journal(tree_t *tree, value_handlers_t *value_handlers, const char *path)
+{
+    tree_journal_batch_t batch;
+    tree_journal_buffer_t record = {NULL, 0, 0};
+    tree_journal_buffer_t name = {NULL, 0, 0};
+    tree_journal_t *journal = NULL;
+    long long remaining = 0;
+    FILE *file = NULL;
+    int num_applied = 0;
+
+    if ((tree == NULL) || (tree->root != NULL) || (value_handlers == NULL) ||
+        (value_handlers->from_binary_fun == NULL) || (path == NULL))
+    {
+        return -1;
+    }
+
+    file = tree_journal_open_file(path, &remaining);
+
+    if (file == NULL)
+    {
+        return -1;
+    }
+
+    memset(&batch, 0, sizeof(batch));
+
+    /* the changes are in the journal already */
+    journal = tree->journal;
+    tree->journal = NULL;
+
+    while ((num_applied >= 0) && tree_journal_read(file, &remaining, &record))
+    {
+        num_applied = tree_journal_replay(tree, value_handlers, &record, &batch, &name) ? num_applied + 1 : -1;
+    }
+
+    if ((num_applied >= 0) && !tree_journal_batch_flush(&batch, tree))
+    {
+        num_applied = -1;
+    }
+
+    tree_journal_batch_dispose(&batch);
+    tree->journal = journal;
+
+    fclose(file);
+    tree_free(NULL, batch.nodes);
+    tree_free(NULL, batch.parent_names);
+    tree_free(NULL, batch.parent_offsets);
+    tree_free(NULL, batch.names.data);
+    tree_free(NULL, record.data);
+    tree_free(NULL, name.data);
+
+    return num_applied;
+}
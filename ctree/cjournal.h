@@ -0,0 +1,113 @@
+#ifndef CJOURNAL_H_
+#define CJOURNAL_H_
+
+#include "ctree.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif /* __cplusplus */
+
+/**
+ * Version of the journal file, the byte after the magic "CTREEJNL"
+ */
+#define TREE_JOURNAL_VERSION 1
+
+/**
+ * Open a journal file to append records to, creating it if it does not exist
+ *
+ * A journal holds one record per change of a tree, see tree_set_journal(). A record is its size,
+ * its type, its fields and a checksum. Names are varint lengths followed by the bytes, values are
+ * payloads of value_to_binary_fun_t and subtrees are in the form of tree_to_compact().
+ *
+ * Records are kept in memory until tree_journal_commit() writes them. A record which was cut
+ * short by a crash is dropped from the end of the file here, so the next ones are not written
+ * after it.
+ *
+ * @param[in] path - the journal file
+ *
+ * @return NULL if path is NULL, the file cannot be opened, is not a journal or memory cannot be
+ *         allocated, the journal otherwise, dispose of it with tree_journal_dispose()
+ */
+tree_journal_t *tree_journal_open(const char *path);
+
+/**
+ * Close a journal, records which were not committed are lost
+ *
+ * @param[in] self - the journal, function does nothing if self is NULL
+ */
+void tree_journal_dispose(tree_journal_t *self);
+
+/**
+ * Write the records appended so far to the file and sync it, with group commit
+ *
+ * Can be called from any thread, also while the tree goes on changing. While one thread writes and
+ * syncs, the ones which call it in the meantime wait, then the next of them writes all their
+ * records with one more sync, so many commits share one sync.
+ *
+ * @param[in,out] self - the journal
+ *
+ * @return 0 if self is NULL, a change could not be recorded, or writing or syncing the file failed
+ *         now or before, see tree_journal_checkpoint(), 1 if all records appended before the call
+ *         are in the file and synced
+ */
+int tree_journal_commit(tree_journal_t *self);
+
+/**
+ * Start the journal over with a copy of the whole tree
+ *
+ * The new journal is written next to the file and renamed over it, so the file holds either the
+ * old records or the copy, and the directory is synced, so the copy stays after a crash once the
+ * function returns. Records not committed yet are dropped, the copy has their changes. The
+ * journal stays small this way and replaying it starts with one bulk load.
+ *
+ * @param[in,out] self - the journal
+ * @param[in] tree - the tree which records to the journal, it must not change until the
+ *                   function returns
+ *
+ * @return 0 if self or tree is NULL, a value has no to_binary_fun or it fails, memory cannot be
+ *         allocated or the file cannot be written, 1 otherwise, the journal has not failed then
+ *
+ * @note If the directory cannot be synced after the rename, the journal fails until the next
+ *       checkpoint, see tree_journal_commit()
+ */
+int tree_journal_checkpoint(tree_journal_t *self, tree_t *tree);
+
+/**
+ * Apply the records of a journal file to a tree, to recover it
+ *
+ * Runs of added nodes go to tree_add_nodes() and copies of the whole tree to tree_from_compact(),
+ * so recovery does not pay for the nodes table of the tree once per node. Records are applied up
+ * to the end of the file or to the first one cut short by a crash. A journal of the tree is not
+ * recorded to while it replays.
+ *
+ * @param[in,out] tree - empty tree to replay the changes to
+ * @param[in] value_handlers - handlers of the values of all nodes, values are created with
+ *                             value_from_binary_fun_t and can be NULL
+ * @param[in] path - the journal file
+ *
+ * @return -1 if any pointer is NULL, tree is not empty, there is no from_binary_fun, the file
+ *         cannot be read or is not a journal, a change cannot be applied or memory cannot be
+ *         allocated, the tree holds the changes applied until then, number of the records
+ *         applied otherwise
+ */
+int tree_replay_journal(tree_t *tree, value_handlers_t *value_handlers, const char *path);
+
+/**
+ * Append the record of a change, called by the tree functions of a tree with a journal
+ *
+ * A change which cannot be recorded, for instance because its value has no to_binary_fun, makes
+ * the journal fail, see tree_journal_commit().
+ *
+ * Functions do nothing if self is NULL.
+ */
+void tree_journal_record_add_node(tree_journal_t *self, node_t *node, const char *parent_node_name);
+void tree_journal_record_add_tree(tree_journal_t *self, tree_t *tree, node_t *sub_tree_root, const char *parent_node_name);
+void tree_journal_record_remove_node(tree_journal_t *self, const char *node_name);
+void tree_journal_record_remove_tree(tree_journal_t *self, const char *sub_tree_root_name);
+
+#ifdef __cplusplus
+} /* extern "C" */
+#endif /* __cplusplus */
+
+#endif /* CJOURNAL_H_ */
@@ -0,0 +1,1048 @@
+#include "cjson.h"
+#include <errno.h>
+#include <string.h>
+#include <unistd.h>
+
+#define TREE_JSON_MIN_CAPACITY 16
+
+/* output collected in one chunk, handed over to the writer when full */
+typedef struct
+{
+    char *chunk;
+    int size;
+    tree_json_write_fun_t write_fun;
+    void *ctx;
+    tree_allocator_t *allocator;
+    int failed;
+} tree_json_writer_t;
+
+static void tree_json_flush(tree_json_writer_t *writer)
+{
+    if (!writer->failed && (writer->size > 0) && ((*writer->write_fun)(writer->chunk, writer->size, writer->ctx) != 0))
+    {
+        writer->failed = 1;
+    }
+
+    writer->size = 0;
+}
+
+static void tree_json_put(tree_json_writer_t *writer, const char *data, int size)
+{
+    int part = 0;
+
+    while (!writer->failed && (size > 0))
+    {
+        if (writer->size == TREE_JSON_CHUNK_SIZE)
+        {
+            tree_json_flush(writer);
+        }
+
+        part = (size < TREE_JSON_CHUNK_SIZE - writer->size) ? size : TREE_JSON_CHUNK_SIZE - writer->size;
+        memcpy(writer->chunk + writer->size, data, part);
+        writer->size += part;
+        data += part;
+        size -= part;
+    }
+}
+
+static void tree_json_put_text(tree_json_writer_t *writer, const char *text)
+{
+    tree_json_put(writer, text, (int)strlen(text));
+}
+
+/* snprintf convention, like value_to_json_fun_t, item is what is written */
+typedef int (*tree_json_format_fun_t)(void *item, char *buffer, int buffer_size);
+
+/*
+ * Straight into the chunk, into a fresh chunk if it does not fit in what is left, or into a
+ * buffer of its own if it does not fit in a chunk at all
+ */
+static void tree_json_put_formatted(tree_json_writer_t *writer, tree_json_format_fun_t format_fun, void *item)
+{
+    char *buffer = NULL;
+    int size = 0;
+
+    if (writer->failed)
+    {
+        return;
+    }
+
+    size = (*format_fun)(item, writer->chunk + writer->size, TREE_JSON_CHUNK_SIZE - writer->size);
+
+    if ((size >= 0) && (size < TREE_JSON_CHUNK_SIZE - writer->size))
+    {
+        writer->size += size;
+        return;
+    }
+
+    if ((size >= 0) && (size < TREE_JSON_CHUNK_SIZE) && (writer->size > 0))
+    {
+        tree_json_flush(writer);
+        tree_json_put_formatted(writer, format_fun, item);
+        return;
+    }
+
+    buffer = (size >= 0) ? tree_malloc(writer->allocator, (size_t)size + 1) : NULL;
+
+    if ((buffer == NULL) || ((*format_fun)(item, buffer, size + 1) != size))
+    {
+        writer->failed = 1;
+    }
+    else
+    {
+        tree_json_put(writer, buffer, size);
+    }
+
+    tree_free(writer->allocator, buffer);
+}
+
+static int tree_json_format_name(void *item, char *buffer, int buffer_size)
+{
+    return node_json_escape(item, buffer, buffer_size);
+}
+
+/* to_json_fun is known to be there */
+static int tree_json_format_value(void *item, char *buffer, int buffer_size)
+{
+    node_t *node = item;
+
+    return (*node->value_handlers->to_json_fun)(node->value, buffer, buffer_size);
+}
+
+static int tree_json_format_line(void *item, char *buffer, int buffer_size)
+{
+    int size = node_to_json(item, buffer, buffer_size);
+
+    return (size > 0) ? size : -1;
+}
+
+/* the fields every node starts with */
+static void tree_json_put_head(tree_json_writer_t *writer, node_t *node)
+{
+    tree_json_put_text(writer, "{\"object_name\":");
+    tree_json_put_formatted(writer, tree_json_format_name, node->object_name);
+    tree_json_put_text(writer, ",\"value\":");
+
+    if (node->value_handlers->to_json_fun == NULL)
+    {
+        writer->failed = 1;
+    }
+
+    tree_json_put_formatted(writer, tree_json_format_value, node);
+}
+
+static int tree_json_write(tree_t *tree, int lines, tree_json_write_fun_t write_fun, void *ctx)
+{
+    tree_json_writer_t writer;
+    node_t *previous = NULL;
+    node_t *node = NULL;
+
+    if ((tree == NULL) || (write_fun == NULL))
+    {
+        return 0;
+    }
+
+    writer.chunk = tree_malloc(tree->allocator, TREE_JSON_CHUNK_SIZE);
+    writer.size = 0;
+    writer.write_fun = write_fun;
+    writer.ctx = ctx;
+    writer.allocator = tree->allocator;
+    writer.failed = (writer.chunk == NULL) || !tree_iter_start(&tree->scratch, tree->root, TREE_ITER_PRE_ORDER);
+
+    while (!writer.failed && ((node = tree_iter_next(&tree->scratch)) != NULL))
+    {
+        if (lines)
+        {
+            tree_json_put_formatted(&writer, tree_json_format_line, node);
+            tree_json_put(&writer, "\n", 1);
+            continue;
+        }
+
+        /* close the subtrees which ended since the previous node, a parent was just opened */
+        if (previous != NULL)
+        {
+            for (; previous != node->parent; previous = previous->parent)
+            {
+                tree_json_put_text(&writer, "]}");
+            }
+
+            if (previous->children[0] != node)
+            {
+                tree_json_put(&writer, ",", 1);
+            }
+        }
+
+        tree_json_put_head(&writer, node);
+        tree_json_put_text(&writer, ",\"children\":[");
+        previous = node;
+    }
+
+    writer.failed = writer.failed || tree->scratch.out_of_memory;
+
+    if (!lines)
+    {
+        for (; previous != NULL; previous = previous->parent)
+        {
+            tree_json_put_text(&writer, "]}");
+        }
+
+        if (tree->root == NULL)
+        {
+            tree_json_put_text(&writer, "null");
+        }
+    }
+
+    tree_json_flush(&writer);
+    tree_free(tree->allocator, writer.chunk);
+
+    return !writer.failed;
+}
+
+int tree_to_json(tree_t *tree, tree_json_write_fun_t write_fun, void *ctx)
+{
+    return tree_json_write(tree, 0, write_fun, ctx);
+}
+
+int tree_to_json_lines(tree_t *tree, tree_json_write_fun_t write_fun, void *ctx)
+{
+    return tree_json_write(tree, 1, write_fun, ctx);
+}
+
+typedef enum
+{
+    TREE_JSON_LEX_NONE,
+    TREE_JSON_LEX_STRING,
+    TREE_JSON_LEX_ESCAPE,
+    TREE_JSON_LEX_UNICODE, /* \u and code_point has num_hex_digits so far */
+    TREE_JSON_LEX_LOW_BACKSLASH, /* a high surrogate waits for \u of the low one */
+    TREE_JSON_LEX_LOW_U,
+    TREE_JSON_LEX_LITERAL /* number, true, false or null */
+} tree_json_lex_t;
+
+typedef enum
+{
+    TREE_JSON_EXPECT_VALUE,
+    TREE_JSON_EXPECT_VALUE_OR_END,
+    TREE_JSON_EXPECT_KEY,
+    TREE_JSON_EXPECT_KEY_OR_END,
+    TREE_JSON_EXPECT_COLON,
+    TREE_JSON_EXPECT_COMMA_OR_END
+} tree_json_expect_t;
+
+/* what a value means in the frame it is in */
+typedef enum
+{
+    TREE_JSON_ROLE_TOP, /* nodes or arrays of nodes, one after another */
+    TREE_JSON_ROLE_NODES, /* array of nodes */
+    TREE_JSON_ROLE_NODE,
+    TREE_JSON_ROLE_CHILDREN, /* names, or nodes whose parent is the node of the previous frame */
+    TREE_JSON_ROLE_SKIP
+} tree_json_role_t;
+
+typedef enum
+{
+    TREE_JSON_KEY_OTHER,
+    TREE_JSON_KEY_OBJECT_NAME,
+    TREE_JSON_KEY_VALUE,
+    TREE_JSON_KEY_PARENT,
+    TREE_JSON_KEY_CHILDREN
+} tree_json_key_t;
+
+typedef struct
+{
+    char type; /* '{', '[' or 0 for the top */
+    tree_json_role_t role;
+    tree_json_expect_t expect;
+    tree_json_key_t key; /* whose value comes next in an object */
+    char *name; /* of a node, owned */
+    char *parent; /* of a node, owned */
+    void *value; /* of a node, owned */
+} tree_json_frame_t;
+
+typedef struct
+{
+    char *data;
+    int size;
+    int capacity;
+} tree_json_buffer_t;
+
+struct tree_json_parser_s
+{
+    value_handlers_t *value_handlers;
+    tree_json_frame_t *frames; /* frames[0] is the top */
+    int num_frames;
+    int frames_capacity;
+    tree_json_lex_t lex;
+    unsigned int code_point;
+    unsigned int high_surrogate;
+    int num_hex_digits;
+    tree_json_buffer_t token; /* the string, decoded, or the literal */
+    tree_json_buffer_t capture; /* text of the value of a node as it is in the input */
+    int capturing;
+    int capture_base; /* number of frames when the captured value started */
+    node_t **nodes;
+    char **parent_names; /* owned */
+    int num_nodes;
+    int nodes_capacity;
+    int failed;
+};
+
+static int tree_json_grow(void **array, int *capacity, int needed, size_t item_size)
+{
+    int new_capacity = (*capacity > 0) ? *capacity : TREE_JSON_MIN_CAPACITY;
+    void *grown = NULL;
+
+    if (needed <= *capacity)
+    {
+        return 1;
+    }
+
+    while (new_capacity < needed)
+    {
+        new_capacity *= 2;
+    }
+
+    grown = tree_realloc(NULL, *array, new_capacity * item_size);
+
+    if (grown == NULL)
+    {
+        return 0;
+    }
+
+    *array = grown;
+    *capacity = new_capacity;
+    return 1;
+}
+
+static int tree_json_buffer_put(tree_json_buffer_t *buffer, char c)
+{
+    if (!tree_json_grow((void **)&buffer->data, &buffer->capacity, buffer->size + 1, 1))
+    {
+        return 0;
+    }
+
+    buffer->data[buffer->size++] = c;
+    return 1;
+}
+
+static char *tree_json_dup(const char *data, size_t size)
+{
+    char *copy = tree_malloc(NULL, size + 1);
+
+    if (copy != NULL)
+    {
+        memcpy(copy, data, size);
+        copy[size] = '\0';
+    }
+
+    return copy;
+}
+
+static int tree_json_buffer_is(const tree_json_buffer_t *buffer, const char *text)
+{
+    return ((size_t)buffer->size == strlen(text)) && (memcmp(buffer->data, text, buffer->size) == 0);
+}
+
+static void tree_json_dispose_value(tree_json_parser_t *self, void *value)
+{
+    if ((value != NULL) && (self->value_handlers->dispose_fun != NULL))
+    {
+        (*self->value_handlers->dispose_fun)(value);
+    }
+}
+
+static void tree_json_frame_clear(tree_json_parser_t *self, tree_json_frame_t *frame)
+{
+    tree_free(NULL, frame->name);
+    tree_free(NULL, frame->parent);
+    tree_json_dispose_value(self, frame->value);
+    frame->name = NULL;
+    frame->parent = NULL;
+    frame->value = NULL;
+}
+
+static tree_json_frame_t *tree_json_push(tree_json_parser_t *self, char type, tree_json_role_t role)
+{
+    tree_json_frame_t *frame = NULL;
+
+    if (!tree_json_grow((void **)&self->frames, &self->frames_capacity, self->num_frames + 1, sizeof(tree_json_frame_t)))
+    {
+        return NULL;
+    }
+
+    frame = &self->frames[self->num_frames++];
+    frame->type = type;
+    frame->role = role;
+    frame->expect = (type == '{') ? TREE_JSON_EXPECT_KEY_OR_END : TREE_JSON_EXPECT_VALUE_OR_END;
+    frame->key = TREE_JSON_KEY_OTHER;
+    frame->name = NULL;
+    frame->parent = NULL;
+    frame->value = NULL;
+
+    return frame;
+}
+
+/* past the digits at c, NULL if there are none */
+static const char *tree_json_skip_digits(const char *c, const char *end)
+{
+    const char *start = c;
+
+    while ((c < end) && (*c >= '0') && (*c <= '9'))
+    {
+        ++c;
+    }
+
+    return (c > start) ? c : NULL;
+}
+
+/* JSON number, true, false or null */
+static int tree_json_is_literal(const tree_json_buffer_t *token)
+{
+    const char *c = token->data;
+    const char *end = token->data + token->size;
+
+    if (tree_json_buffer_is(token, "true") || tree_json_buffer_is(token, "false") || tree_json_buffer_is(token, "null"))
+    {
+        return 1;
+    }
+
+    c += (c < end) && (*c == '-');
+    c = ((c < end) && (*c == '0')) ? c + 1 : tree_json_skip_digits(c, end);
+
+    if ((c != NULL) && (c < end) && (*c == '.'))
+    {
+        c = tree_json_skip_digits(c + 1, end);
+    }
+
+    if ((c != NULL) && (c < end) && ((*c == 'e') || (*c == 'E')))
+    {
+        ++c;
+        c += (c < end) && ((*c == '+') || (*c == '-'));
+        c = tree_json_skip_digits(c, end);
+    }
+
+    return c == end;
+}
+
+static int tree_json_is_literal_char(char c)
+{
+    return ((c >= '0') && (c <= '9')) || ((c >= 'a') && (c <= 'z')) || ((c >= 'A') && (c <= 'Z')) ||
+           (c == '-') || (c == '+') || (c == '.');
+}
+
+/* a value starts with c in the top frame, role is what a container starting with c would be */
+static int tree_json_begin_value(tree_json_parser_t *self, char c, tree_json_role_t *role)
+{
+    tree_json_frame_t *frame = &self->frames[self->num_frames - 1];
+    int container = (c == '{') || (c == '[');
+
+    if ((frame->expect != TREE_JSON_EXPECT_VALUE) && (frame->expect != TREE_JSON_EXPECT_VALUE_OR_END))
+    {
+        return 0;
+    }
+
+    *role = TREE_JSON_ROLE_SKIP;
+
+    if (self->capturing)
+    {
+        return 1;
+    }
+
+    switch (frame->role)
+    {
+    case TREE_JSON_ROLE_TOP:
+        *role = (c == '{') ? TREE_JSON_ROLE_NODE : TREE_JSON_ROLE_NODES;
+        return container;
+
+    case TREE_JSON_ROLE_NODES:
+        *role = TREE_JSON_ROLE_NODE;
+        return c == '{';
+
+    case TREE_JSON_ROLE_CHILDREN:
+        /* a nested node needs the name of its parent first */
+        *role = TREE_JSON_ROLE_NODE;
+        return (c == '"') || ((c == '{') && (frame[-1].name != NULL));
+
+    case TREE_JSON_ROLE_NODE:
+        switch (frame->key)
+        {
+        case TREE_JSON_KEY_VALUE:
+            self->capturing = 1;
+            self->capture_base = self->num_frames;
+            self->capture.size = 0;
+            return tree_json_buffer_put(&self->capture, c);
+
+        case TREE_JSON_KEY_OBJECT_NAME:
+            return c == '"';
+
+        case TREE_JSON_KEY_PARENT:
+            return !container;
+
+        case TREE_JSON_KEY_CHILDREN:
+            *role = TREE_JSON_ROLE_CHILDREN;
+            return c == '[';
+
+        default:
+            return 1;
+        }
+
+    default:
+        return 1;
+    }
+}
+
+/* null is NULL, anything else is up to from_json_fun */
+static int tree_json_parse_value(tree_json_parser_t *self, tree_json_frame_t *frame)
+{
+    void *value = NULL;
+
+    if (!tree_json_buffer_is(&self->capture, "null"))
+    {
+        if (self->value_handlers->from_json_fun == NULL)
+        {
+            return 0;
+        }
+
+        value = (*self->value_handlers->from_json_fun)(self->capture.data, self->capture.size);
+
+        if (value == NULL)
+        {
+            return 0;
+        }
+    }
+
+    tree_json_dispose_value(self, frame->value);
+    frame->value = value;
+    return 1;
+}
+
+/* a value in the top frame is complete */
+static int tree_json_end_value(tree_json_parser_t *self)
+{
+    tree_json_frame_t *frame = &self->frames[self->num_frames - 1];
+
+    frame->expect = (frame->role == TREE_JSON_ROLE_TOP) ? TREE_JSON_EXPECT_VALUE : TREE_JSON_EXPECT_COMMA_OR_END;
+
+    if (self->capturing && (self->num_frames == self->capture_base))
+    {
+        self->capturing = 0;
+        return tree_json_parse_value(self, frame);
+    }
+
+    return 1;
+}
+
+static tree_json_key_t tree_json_key(const tree_json_buffer_t *token)
+{
+    if (tree_json_buffer_is(token, "object_name"))
+    {
+        return TREE_JSON_KEY_OBJECT_NAME;
+    }
+
+    if (tree_json_buffer_is(token, "value"))
+    {
+        return TREE_JSON_KEY_VALUE;
+    }
+
+    if (tree_json_buffer_is(token, "parent"))
+    {
+        return TREE_JSON_KEY_PARENT;
+    }
+
+    return tree_json_buffer_is(token, "children") ? TREE_JSON_KEY_CHILDREN : TREE_JSON_KEY_OTHER;
+}
+
+/* a string or a literal is complete */
+static int tree_json_end_scalar(tree_json_parser_t *self, int is_string)
+{
+    tree_json_frame_t *frame = &self->frames[self->num_frames - 1];
+    char **field = NULL;
+
+    if (is_string && ((frame->expect == TREE_JSON_EXPECT_KEY) || (frame->expect == TREE_JSON_EXPECT_KEY_OR_END)))
+    {
+        frame->key = ((frame->role == TREE_JSON_ROLE_NODE) && !self->capturing) ? tree_json_key(&self->token) : TREE_JSON_KEY_OTHER;
+        frame->expect = TREE_JSON_EXPECT_COLON;
+        return 1;
+    }
+
+    if (!is_string && !tree_json_is_literal(&self->token))
+    {
+        return 0;
+    }
+
+    if ((frame->role == TREE_JSON_ROLE_NODE) && !self->capturing)
+    {
+        field = (frame->key == TREE_JSON_KEY_OBJECT_NAME) ? &frame->name :
+                (frame->key == TREE_JSON_KEY_PARENT) ? &frame->parent : NULL;
+    }
+
+    if (field != NULL)
+    {
+        /* parent can be null, object_name is a string for sure */
+        if (!is_string && !tree_json_buffer_is(&self->token, "null"))
+        {
+            return 0;
+        }
+
+        tree_free(NULL, *field);
+        *field = is_string ? tree_json_dup(self->token.data, self->token.size) : NULL;
+
+        if (is_string && (*field == NULL))
+        {
+            return 0;
+        }
+    }
+
+    return tree_json_end_value(self);
+}
+
+/* the node of the top frame is complete */
+static int tree_json_add_node(tree_json_parser_t *self, tree_json_frame_t *frame)
+{
+    int capacity = self->nodes_capacity;
+    node_t *node = NULL;
+
+    /* both arrays have nodes_capacity entries */
+    if ((frame->name == NULL) ||
+        !tree_json_grow((void **)&self->nodes, &capacity, self->num_nodes + 1, sizeof(node_t *)) ||
+        !tree_json_grow((void **)&self->parent_names, &self->nodes_capacity, self->num_nodes + 1, sizeof(char *)))
+    {
+        return 0;
+    }
+
+    node = node_create(self->value_handlers, frame->name, frame->value);
+
+    if (node == NULL)
+    {
+        return 0;
+    }
+
+    self->nodes[self->num_nodes] = node;
+    self->parent_names[self->num_nodes] = frame->parent;
+    ++self->num_nodes;
+
+    /* moved */
+    frame->parent = NULL;
+    frame->value = NULL;
+
+    return 1;
+}
+
+static int tree_json_code_point(tree_json_parser_t *self)
+{
+    unsigned int code_point = self->code_point;
+    char utf8[4];
+    int size = 0;
+    int i = 0;
+
+    if (self->high_surrogate != 0)
+    {
+        if ((code_point < 0xdc00) || (code_point > 0xdfff))
+        {
+            return 0;
+        }
+
+        code_point = 0x10000 + ((self->high_surrogate - 0xd800) << 10) + (code_point - 0xdc00);
+        self->high_surrogate = 0;
+    }
+    else if ((code_point >= 0xd800) && (code_point <= 0xdbff))
+    {
+        self->high_surrogate = code_point;
+        self->lex = TREE_JSON_LEX_LOW_BACKSLASH;
+        return 1;
+    }
+    else if (((code_point >= 0xdc00) && (code_point <= 0xdfff)) || (code_point == 0))
+    {
+        /* a lone low surrogate, or a name cut short */
+        return 0;
+    }
+
+    self->lex = TREE_JSON_LEX_STRING;
+
+    if (self->capturing)
+    {
+        return 1;
+    }
+
+    if (code_point < 0x80)
+    {
+        utf8[size++] = (char)code_point;
+    }
+    else if (code_point < 0x800)
+    {
+        utf8[size++] = (char)(0xc0 | (code_point >> 6));
+        utf8[size++] = (char)(0x80 | (code_point & 0x3f));
+    }
+    else if (code_point < 0x10000)
+    {
+        utf8[size++] = (char)(0xe0 | (code_point >> 12));
+        utf8[size++] = (char)(0x80 | ((code_point >> 6) & 0x3f));
+        utf8[size++] = (char)(0x80 | (code_point & 0x3f));
+    }
+    else
+    {
+        utf8[size++] = (char)(0xf0 | (code_point >> 18));
+        utf8[size++] = (char)(0x80 | ((code_point >> 12) & 0x3f));
+        utf8[size++] = (char)(0x80 | ((code_point >> 6) & 0x3f));
+        utf8[size++] = (char)(0x80 | (code_point & 0x3f));
+    }
+
+    for (; i < size; ++i)
+    {
+        if (!tree_json_buffer_put(&self->token, utf8[i]))
+        {
+            return 0;
+        }
+    }
+
+    return 1;
+}
+
+static int tree_json_escape(tree_json_parser_t *self, char c)
+{
+    const char *escapes = "\"\"\\\\//b\bf\fn\nr\rt\t";
+    const char *escape = escapes;
+
+    if (c == 'u')
+    {
+        self->lex = TREE_JSON_LEX_UNICODE;
+        self->code_point = 0;
+        self->num_hex_digits = 0;
+        return 1;
+    }
+
+    while ((*escape != '\0') && (*escape != c))
+    {
+        escape += 2;
+    }
+
+    if ((*escape == '\0') || (self->high_surrogate != 0))
+    {
+        return 0;
+    }
+
+    self->lex = TREE_JSON_LEX_STRING;
+    return self->capturing || tree_json_buffer_put(&self->token, escape[1]);
+}
+
+static int tree_json_hex_digit(tree_json_parser_t *self, char c)
+{
+    unsigned int digit = 0;
+
+    if ((c >= '0') && (c <= '9'))
+    {
+        digit = c - '0';
+    }
+    else if ((c >= 'a') && (c <= 'f'))
+    {
+        digit = c - 'a' + 10;
+    }
+    else if ((c >= 'A') && (c <= 'F'))
+    {
+        digit = c - 'A' + 10;
+    }
+    else
+    {
+        return 0;
+    }
+
+    self->code_point = self->code_point * 16 + digit;
+
+    return (++self->num_hex_digits < 4) || tree_json_code_point(self);
+}
+
+/* brackets, commas, colons and the first characters of values */
+static int tree_json_structure(tree_json_parser_t *self, char c)
+{
+    tree_json_frame_t *frame = &self->frames[self->num_frames - 1];
+    tree_json_role_t role = TREE_JSON_ROLE_SKIP;
+    int is_key = (frame->expect == TREE_JSON_EXPECT_KEY) || (frame->expect == TREE_JSON_EXPECT_KEY_OR_END);
+
+    switch (c)
+    {
+    case ' ':
+    case '\t':
+    case '\n':
+    case '\r':
+        return 1;
+
+    case '{':
+    case '[':
+        if (!tree_json_begin_value(self, c, &role) || ((frame = tree_json_push(self, c, role)) == NULL))
+        {
+            return 0;
+        }
+
+        /* a node nested in the children of another one */
+        if ((role == TREE_JSON_ROLE_NODE) && (frame[-1].role == TREE_JSON_ROLE_CHILDREN))
+        {
+            frame->parent = tree_json_dup(frame[-2].name, strlen(frame[-2].name));
+            return frame->parent != NULL;
+        }
+
+        return 1;
+
+    case '}':
+    case ']':
+        if ((frame->type != ((c == '}') ? '{' : '[')) ||
+            ((frame->expect != TREE_JSON_EXPECT_COMMA_OR_END) &&
+             (frame->expect != TREE_JSON_EXPECT_KEY_OR_END) &&
+             (frame->expect != TREE_JSON_EXPECT_VALUE_OR_END)))
+        {
+            return 0;
+        }
+
+        if ((frame->role == TREE_JSON_ROLE_NODE) && !tree_json_add_node(self, frame))
+        {
+            return 0;
+        }
+
+        tree_json_frame_clear(self, frame);
+        --self->num_frames;
+        return tree_json_end_value(self);
+
+    case ',':
+        if ((frame->expect != TREE_JSON_EXPECT_COMMA_OR_END) || (frame->role == TREE_JSON_ROLE_TOP))
+        {
+            return 0;
+        }
+
+        frame->expect = (frame->type == '{') ? TREE_JSON_EXPECT_KEY : TREE_JSON_EXPECT_VALUE;
+        return 1;
+
+    case ':':
+        if (frame->expect != TREE_JSON_EXPECT_COLON)
+        {
+            return 0;
+        }
+
+        frame->expect = TREE_JSON_EXPECT_VALUE;
+        return 1;
+
+    case '"':
+        self->lex = TREE_JSON_LEX_STRING;
+        self->token.size = 0;
+        return is_key || tree_json_begin_value(self, c, &role);
+
+    default:
+        if (!tree_json_is_literal_char(c) || (c == '+') || (c == '.') || !tree_json_begin_value(self, c, &role))
+        {
+            return 0;
+        }
+
+        self->lex = TREE_JSON_LEX_LITERAL;
+        self->token.size = 0;
+        return tree_json_buffer_put(&self->token, c);
+    }
+}
+
+static int tree_json_char(tree_json_parser_t *self, char c)
+{
+    if (self->lex == TREE_JSON_LEX_LITERAL)
+    {
+        if (tree_json_is_literal_char(c))
+        {
+            return tree_json_buffer_put(&self->token, c) &&
+                   (!self->capturing || tree_json_buffer_put(&self->capture, c));
+        }
+
+        /* c is not part of it */
+        self->lex = TREE_JSON_LEX_NONE;
+
+        if (!tree_json_end_scalar(self, 0))
+        {
+            return 0;
+        }
+    }
+
+    if (self->capturing && !tree_json_buffer_put(&self->capture, c))
+    {
+        return 0;
+    }
+
+    switch (self->lex)
+    {
+    case TREE_JSON_LEX_STRING:
+        if (c == '"')
+        {
+            self->lex = TREE_JSON_LEX_NONE;
+            return tree_json_end_scalar(self, 1);
+        }
+
+        if (c == '\\')
+        {
+            self->lex = TREE_JSON_LEX_ESCAPE;
+            return 1;
+        }
+
+        return ((unsigned char)c >= 0x20) && (self->capturing || tree_json_buffer_put(&self->token, c));
+
+    case TREE_JSON_LEX_ESCAPE:
+        return tree_json_escape(self, c);
+
+    case TREE_JSON_LEX_UNICODE:
+        return tree_json_hex_digit(self, c);
+
+    case TREE_JSON_LEX_LOW_BACKSLASH:
+        self->lex = TREE_JSON_LEX_LOW_U;
+        return c == '\\';
+
+    case TREE_JSON_LEX_LOW_U:
+        self->lex = TREE_JSON_LEX_ESCAPE;
+        return (c == 'u') && tree_json_escape(self, c);
+
+    default:
+        return tree_json_structure(self, c);
+    }
+}
+
+tree_json_parser_t *tree_json_parser_create(value_handlers_t *value_handlers)
+{
+    tree_json_parser_t *self = NULL;
+
+    if (value_handlers == NULL)
+    {
+        return NULL;
+    }
+
+    self = tree_malloc(NULL, sizeof(tree_json_parser_t));
+
+    if (self == NULL)
+    {
+        return NULL;
+    }
+
+    memset(self, 0, sizeof(tree_json_parser_t));
+    self->value_handlers = value_handlers;
+    self->lex = TREE_JSON_LEX_NONE;
+
+    if (tree_json_push(self, 0, TREE_JSON_ROLE_TOP) == NULL)
+    {
+        tree_free(NULL, self);
+        return NULL;
+    }
+
+    self->frames[0].expect = TREE_JSON_EXPECT_VALUE;
+
+    return self;
+}
+
+void tree_json_parser_dispose(tree_json_parser_t *self)
+{
+    int i = 0;
+
+    if (self == NULL)
+    {
+        return;
+    }
+
+    for (i = 0; i < self->num_frames; ++i)
+    {
+        tree_json_frame_clear(self, &self->frames[i]);
+    }
+
+    for (i = 0; i < self->num_nodes; ++i)
+    {
+        node_dispose(self->nodes[i]);
+        tree_free(NULL, self->parent_names[i]);
+    }
+
+    tree_free(NULL, self->frames);
+    tree_free(NULL, self->token.data);
+    tree_free(NULL, self->capture.data);
+    tree_free(NULL, self->nodes);
+    tree_free(NULL, self->parent_names);
+    tree_free(NULL, self);
+}
+
+int tree_json_parser_feed(tree_json_parser_t *self, const char *data, int size)
+{
+    int i = 0;
+
+    if ((self == NULL) || (data == NULL))
+    {
+        return 0;
+    }
+
+    for (; !self->failed && (i < size); ++i)
+    {
+        self->failed = !tree_json_char(self, data[i]);
+    }
+
+    return !self->failed;
+}
+
+int tree_json_parser_finish(tree_json_parser_t *self, tree_t *tree)
+{
+    int i = 0;
+
+    if ((self == NULL) || (tree == NULL) || (tree->root != NULL) || self->failed ||
+        (self->lex != TREE_JSON_LEX_NONE) || (self->num_frames != 1))
+    {
+        return 0;
+    }
+
+    if ((self->num_nodes > 0) &&
+        (tree_build(tree, self->nodes, (const char **)self->parent_names, self->num_nodes, NULL) != TREE_BUILD_OK))
+    {
+        return 0;
+    }
+
+    for (; i < self->num_nodes; ++i)
+    {
+        tree_free(NULL, self->parent_names[i]);
+    }
+
+    self->num_nodes = 0;
+
+    return 1;
+}
+
+int tree_from_json(tree_t *tree, value_handlers_t *value_handlers, const char *data, int size)
+{
+    tree_json_parser_t *parser = NULL;
+    int built = 0;
+
+    if ((tree == NULL) || (data == NULL))
+    {
+        return 0;
+    }
+
+    parser = tree_json_parser_create(value_handlers);
+    built = tree_json_parser_feed(parser, data, size) && tree_json_parser_finish(parser, tree);
+    tree_json_parser_dispose(parser);
+
+    return built;
+}
+
+int tree_from_json_fd(tree_t *tree, value_handlers_t *value_handlers, int fd)
+{
+    tree_json_parser_t *parser = NULL;
+    char *chunk = NULL;
+    ssize_t size = 0;
+    int built = 0;
+
+    if (tree == NULL)
+    {
+        return 0;
+    }
+
+    parser = tree_json_parser_create(value_handlers);
+    chunk = tree_malloc(NULL, TREE_JSON_CHUNK_SIZE);
+
+    if ((parser != NULL) && (chunk != NULL))
+    {
+        do
+        {
+            size = read(fd, chunk, TREE_JSON_CHUNK_SIZE);
+        }
+        while (((size > 0) && tree_json_parser_feed(parser, chunk, (int)size)) || ((size < 0) && (errno == EINTR)));
+
+        built = (size == 0) && tree_json_parser_finish(parser, tree);
+    }
+
+    tree_free(NULL, chunk);
+    tree_json_parser_dispose(parser);
+
+    return built;
+}
@@ -0,0 +1,146 @@
+#ifndef CJSON_H_
+#define CJSON_H_
+
+#include "ctree.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif /* __cplusplus */
+
+/**
+ * Size of the chunks tree_to_json() and tree_to_json_lines() pass to the writer
+ */
+#define TREE_JSON_CHUNK_SIZE 16384
+
+/**
+ * Writer for tree_to_json() and tree_to_json_lines()
+ *
+ * Gets the next size bytes of the output, which are not NULL terminated. Should return 0 if
+ * they were written, any other value stops the serialization.
+ */
+typedef int (*tree_json_write_fun_t)(const char *data, int size, void *ctx);
+
+/**
+ * Serialize a whole tree to JSON, streamed through a writer
+ *
+ * Every node is an object with its children nested in it, in sibling order:
+ * {"object_name":"a","value":1,"children":[{"object_name":"b","value":2,"children":[]}]}
+ * An empty tree is null. Names are escaped, values are what value_to_json_fun_t writes.
+ *
+ * The output goes to write_fun in chunks of up to TREE_JSON_CHUNK_SIZE bytes, from one buffer
+ * which is reused, so memory does not grow with the size of the tree. Only a value which does
+ * not fit in a chunk on its own gets a buffer of its size.
+ *
+ * @param[in] tree - the tree to serialize
+ * @param[in] write_fun - the writer, see tree_json_write_fun_t
+ * @param[in] ctx - passed to write_fun as is
+ *
+ * @return 0 if tree or write_fun is NULL, a value has no to_json_fun or it fails,
+ *         memory cannot be allocated or write_fun stops the serialization, 1 otherwise
+ *
+ * @warning The tree must not change until the function returns.
+ */
+int tree_to_json(tree_t *tree, tree_json_write_fun_t write_fun, void *ctx);
+
+/**
+ * Serialize a whole tree to JSON lines, one node per line in pre-order, streamed through a writer
+ *
+ * Each line has the fields node_to_json() writes for the node and ends with a new line. An
+ * empty tree writes nothing. Otherwise same as tree_to_json().
+ *
+ * @param[in] tree - the tree to serialize
+ * @param[in] write_fun - the writer, see tree_json_write_fun_t
+ * @param[in] ctx - passed to write_fun as is
+ *
+ * @return 0 if tree or write_fun is NULL, a value has no to_json_fun or it fails,
+ *         memory cannot be allocated or write_fun stops the serialization, 1 otherwise
+ *
+ * @warning The tree must not change until the function returns.
+ */
+int tree_to_json_lines(tree_t *tree, tree_json_write_fun_t write_fun, void *ctx);
+
+/**
+ * Incremental JSON parser which builds a tree, opaque, see tree_json_parser_feed()
+ */
+typedef struct tree_json_parser_s tree_json_parser_t;
+
+/**
+ * Create a parser
+ *
+ * @param[in] value_handlers - handlers of the values of all nodes, values other than null are
+ *                             parsed with value_from_json_fun_t
+ *
+ * @return NULL if value_handlers is NULL or memory cannot be allocated, the parser otherwise
+ */
+tree_json_parser_t *tree_json_parser_create(value_handlers_t *value_handlers);
+
+/**
+ * Dispose of a parser and of the nodes it has parsed and not built a tree of
+ *
+ * @param[in] self - the parser, function does nothing if self is NULL
+ */
+void tree_json_parser_dispose(tree_json_parser_t *self);
+
+/**
+ * Parse the next chunk of the input
+ *
+ * The input is any number of nodes as node_to_json() writes them, one after another or in
+ * arrays, like tree_to_json_lines() writes them. Children given as nodes instead of names are
+ * parsed too, with their parent implied, so what tree_to_json() writes is read as well. Names
+ * in "children" are not needed, "parent" tells where a node goes. A missing "value" is null,
+ * which is a NULL value, other keys are skipped.
+ *
+ * A chunk can end anywhere. Memory grows with the number of nodes and with the longest name or
+ * value, not with the size of the input.
+ *
+ * @param[in,out] self - the parser
+ * @param[in] data - the chunk, not NULL terminated
+ * @param[in] size - size of the chunk
+ *
+ * @return 0 if self or data is NULL, the input is not valid, a value cannot be parsed or memory
+ *         cannot be allocated, or one of the previous chunks failed, 1 otherwise
+ */
+int tree_json_parser_feed(tree_json_parser_t *self, const char *data, int size);
+
+/**
+ * Build a tree of the parsed nodes, see tree_build()
+ *
+ * @param[in,out] self - the parser, it has no nodes left on success
+ * @param[in,out] tree - empty tree to build
+ *
+ * @return 0 if self or tree is NULL, tree is not empty, the input failed or ends in the middle
+ *         of a node, or the nodes do not form a tree, 1 otherwise, also for no nodes at all
+ */
+int tree_json_parser_finish(tree_json_parser_t *self, tree_t *tree);
+
+/**
+ * Build a tree from JSON in a buffer, see tree_json_parser_feed()
+ *
+ * @param[in,out] tree - empty tree to build
+ * @param[in] value_handlers - handlers of the values of all nodes
+ * @param[in] data - the JSON, not NULL terminated
+ * @param[in] size - size of the JSON
+ *
+ * @return 0 if any pointer is NULL or parsing or building the tree fails, 1 otherwise
+ */
+int tree_from_json(tree_t *tree, value_handlers_t *value_handlers, const char *data, int size);
+
+/**
+ * Build a tree from JSON read from a file descriptor until its end, in chunks of
+ * TREE_JSON_CHUNK_SIZE, see tree_json_parser_feed()
+ *
+ * @param[in,out] tree - empty tree to build
+ * @param[in] value_handlers - handlers of the values of all nodes
+ * @param[in] fd - the file descriptor to read
+ *
+ * @return 0 if any pointer is NULL, reading fails or parsing or building the tree fails,
+ *         1 otherwise
+ */
+int tree_from_json_fd(tree_t *tree, value_handlers_t *value_handlers, int fd);
+
+#ifdef __cplusplus
+} /* extern "C" */
+#endif /* __cplusplus */
+
+#endif /* CJSON_H_ */
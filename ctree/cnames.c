@@ -0,0 +1,242 @@
+#include "cnames.h"
+#include <stddef.h>
+#include <string.h>
+#include "cnode.h"
+
+#define TREE_NAMES_MIN_BUCKETS 64
+
+typedef struct tree_name_s
+{
+    tree_names_t *pool;
+    struct tree_name_s *next; /* in the same bucket */
+    int num_refs;
+    unsigned int hash; /* node_name_hash() of name */
+    size_t size; /* of the whole entry */
+    char name[]; /* the handle */
+} tree_name_t;
+
+struct tree_names_s
+{
+    tree_allocator_t *allocator; /* the default one at tree_names_create() */
+    tree_name_t **buckets;
+    unsigned int num_buckets; /* power of 2 */
+    int num_names;
+    size_t num_bytes; /* of all entries */
+};
+
+static tree_name_t *tree_name_entry(const char *handle)
+{
+    return (tree_name_t *)(handle - offsetof(tree_name_t, name));
+}
+
+tree_names_t *tree_names_create(void)
+{
+    tree_allocator_t *allocator = tree_allocator_default();
+    tree_names_t *self = tree_malloc(allocator, sizeof(tree_names_t));
+
+    if (self == NULL)
+    {
+        return NULL;
+    }
+
+    self->buckets = tree_malloc(allocator, TREE_NAMES_MIN_BUCKETS * sizeof(tree_name_t *));
+
+    if (self->buckets == NULL)
+    {
+        tree_free(allocator, self);
+        return NULL;
+    }
+
+    memset(self->buckets, 0, TREE_NAMES_MIN_BUCKETS * sizeof(tree_name_t *));
+    self->allocator = allocator;
+    self->num_buckets = TREE_NAMES_MIN_BUCKETS;
+    self->num_names = 0;
+    self->num_bytes = 0;
+
+    return self;
+}
+
+void tree_names_dispose(tree_names_t *self)
+{
+    unsigned int i = 0;
+    tree_name_t *entry = NULL;
+    tree_name_t *next = NULL;
+
+    if (self == NULL)
+    {
+        return;
+    }
+
+    for (; i < self->num_buckets; ++i)
+    {
+        for (entry = self->buckets[i]; entry != NULL; entry = next)
+        {
+            next = entry->next;
+            tree_free(self->allocator, entry);
+        }
+    }
+
+    tree_free(self->allocator, self->buckets);
+    tree_free(self->allocator, self);
+}
+
+static tree_name_t *tree_names_lookup(tree_names_t *self, const char *name, unsigned int hash)
+{
+    tree_name_t *entry = self->buckets[hash & (self->num_buckets - 1)];
+
+    for (; entry != NULL; entry = entry->next)
+    {
+        if ((entry->hash == hash) && (strcmp(entry->name, name) == 0))
+        {
+            return entry;
+        }
+    }
+
+    return NULL;
+}
+
+/* double the buckets, the pool stays as it is if memory cannot be allocated */
+static void tree_names_grow(tree_names_t *self)
+{
+    unsigned int num_buckets = self->num_buckets * 2;
+    unsigned int i = 0;
+    tree_name_t **buckets = tree_malloc(self->allocator, num_buckets * sizeof(tree_name_t *));
+    tree_name_t *entry = NULL;
+    tree_name_t *next = NULL;
+
+    if (buckets == NULL)
+    {
+        return;
+    }
+
+    memset(buckets, 0, num_buckets * sizeof(tree_name_t *));
+
+    for (; i < self->num_buckets; ++i)
+    {
+        for (entry = self->buckets[i]; entry != NULL; entry = next)
+        {
+            next = entry->next;
+            entry->next = buckets[entry->hash & (num_buckets - 1)];
+            buckets[entry->hash & (num_buckets - 1)] = entry;
+        }
+    }
+
+    tree_free(self->allocator, self->buckets);
+    self->buckets = buckets;
+    self->num_buckets = num_buckets;
+}
+
+const char *tree_names_intern(tree_names_t *self, const char *name)
+{
+    unsigned int hash = 0;
+    size_t size = 0;
+    tree_name_t *entry = NULL;
+
+    if ((self == NULL) || (name == NULL))
+    {
+        return NULL;
+    }
+
+    hash = node_name_hash(name);
+    entry = tree_names_lookup(self, name, hash);
+
+    if (entry != NULL)
+    {
+        ++entry->num_refs;
+        return entry->name;
+    }
+
+    size = sizeof(tree_name_t) + strlen(name) + 1;
+    entry = tree_malloc(self->allocator, size);
+
+    if (entry == NULL)
+    {
+        return NULL;
+    }
+
+    entry->pool = self;
+    entry->num_refs = 1;
+    entry->hash = hash;
+    entry->size = size;
+    strcpy(entry->name, name);
+
+    /* at most one name per bucket on average */
+    if ((unsigned int)self->num_names >= self->num_buckets)
+    {
+        tree_names_grow(self);
+    }
+
+    entry->next = self->buckets[hash & (self->num_buckets - 1)];
+    self->buckets[hash & (self->num_buckets - 1)] = entry;
+    ++self->num_names;
+    self->num_bytes += size;
+
+    return entry->name;
+}
+
+const char *tree_names_find(tree_names_t *self, const char *name)
+{
+    tree_name_t *entry = NULL;
+
+    if ((self == NULL) || (name == NULL))
+    {
+        return NULL;
+    }
+
+    entry = tree_names_lookup(self, name, node_name_hash(name));
+
+    return (entry != NULL) ? entry->name : NULL;
+}
+
+void tree_names_release(const char *handle)
+{
+    tree_name_t *entry = NULL;
+    tree_name_t **link = NULL;
+    tree_names_t *pool = NULL;
+
+    if (handle == NULL)
+    {
+        return;
+    }
+
+    entry = tree_name_entry(handle);
+
+    if (--entry->num_refs > 0)
+    {
+        return;
+    }
+
+    pool = entry->pool;
+
+    link = &pool->buckets[entry->hash & (pool->num_buckets - 1)];
+
+    while (*link != entry)
+    {
+        link = &(*link)->next;
+    }
+
+    *link = entry->next;
+    --pool->num_names;
+    pool->num_bytes -= entry->size;
+    tree_free(pool->allocator, entry);
+}
+
+tree_names_t *tree_names_of(const char *handle)
+{
+    return (handle == NULL) ? NULL : tree_name_entry(handle)->pool;
+}
+
+int tree_names_count(tree_names_t *self)
+{
+    return (self == NULL) ? 0 : self->num_names;
+}
+
+size_t tree_names_size(tree_names_t *self)
+{
+    if (self == NULL)
+    {
+        return 0;
+    }
+
+    return sizeof(tree_names_t) + self->num_buckets * sizeof(tree_name_t *) + self->num_bytes;
+}
@@ -0,0 +1,96 @@
+#ifndef CNAMES_H_
+#define CNAMES_H_
+
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif /* __cplusplus */
+
+/**
+ * Pool of interned node names, opaque
+ *
+ * Every distinct name is stored once and reference counted, nodes from node_create_interned()
+ * share it. The string returned by tree_names_intern() is the handle of the name: it stays at
+ * the same address while referenced, so two handles from the same pool are equal if and only if
+ * they are the same pointer. Not thread safe, with an epoch it is used by the writer only,
+ * see tree_set_epoch().
+ */
+typedef struct tree_names_s tree_names_t;
+
+/**
+ * Create an empty pool
+ *
+ * @return NULL if memory cannot be allocated, new pool otherwise
+ */
+tree_names_t *tree_names_create(void);
+
+/**
+ * Free all names and the pool itself
+ *
+ * @param[in,out] self - the pool, function does nothing if self is NULL
+ *
+ * @warning Names still referenced are freed too, dispose of the nodes first.
+ */
+void tree_names_dispose(tree_names_t *self);
+
+/**
+ * Get the handle of a name and take a reference to it, the name is added if it is new
+ *
+ * @param[in,out] self - the pool
+ * @param[in] name - NULL terminated C string
+ *
+ * @return NULL if self or name is NULL or memory cannot be allocated, the handle otherwise
+ */
+const char *tree_names_intern(tree_names_t *self, const char *name);
+
+/**
+ * Get the handle of a name without taking a reference
+ *
+ * @param[in] self - the pool
+ * @param[in] name - NULL terminated C string
+ *
+ * @return NULL if self or name is NULL or the name is not in the pool, the handle otherwise
+ */
+const char *tree_names_find(tree_names_t *self, const char *name);
+
+/**
+ * Drop a reference taken by tree_names_intern(), the name is freed with the last one
+ *
+ * @param[in] handle - the handle, function does nothing if handle is NULL
+ */
+void tree_names_release(const char *handle);
+
+/**
+ * Get the pool a handle comes from
+ *
+ * @param[in] handle - the handle
+ *
+ * @return NULL if handle is NULL, the pool otherwise
+ */
+tree_names_t *tree_names_of(const char *handle);
+
+/**
+ * Get the number of distinct names in the pool
+ *
+ * @param[in] self - the pool
+ *
+ * @return 0 if self is NULL, number of names otherwise
+ */
+int tree_names_count(tree_names_t *self);
+
+/**
+ * Get the number of bytes the names take, pool overhead included
+ *
+ * @param[in] self - the pool
+ *
+ * @return 0 if self is NULL, number of bytes otherwise
+ */
+size_t tree_names_size(tree_names_t *self);
+
+#ifdef __cplusplus
+} /* extern "C" */
+#endif /* __cplusplus */
+
+#endif /* CNAMES_H_ */
@@ -3,7 +3,17 @@
 #include <stdlib.h>
 #include <string.h>
 
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define NODE_JSON_X86 1
+#else
+#define NODE_JSON_X86 0
+#endif
+
 #define NODE_REALLOC_INCREMENT 4
+#define NODE_FNV_OFFSET_BASIS 2166136261u
+#define NODE_FNV_PRIME 16777619u
+#define NODE_JSON_SCRATCH_SIZE 64
 #define NODE_DEBUG 0
 
 #if NODE_DEBUG
@@ -79,13 +89,101 @@ value_handlers_t *value_handlers_init(
     handlers->compare_fun = compare_fun;
     handlers->to_json_fun = to_json_fun;
     handlers->dispose_fun = dispose_fun;
+    handlers->to_binary_fun = NULL;
+    handlers->from_binary_fun = NULL;
+    handlers->from_json_fun = NULL;
+    return handlers;
+}
+
+value_handlers_t *value_handlers_set_binary(
+    value_handlers_t *handlers,
+    value_to_binary_fun_t to_binary_fun,
+    value_from_binary_fun_t from_binary_fun)
+{
+    if (handlers == NULL)
+    {
+        return NULL;
+    }
+
+    /* both can be NULL */
+
+    handlers->to_binary_fun = to_binary_fun;
+    handlers->from_binary_fun = from_binary_fun;
+    return handlers;
+}
+
+value_handlers_t *value_handlers_set_from_json(value_handlers_t *handlers, value_from_json_fun_t from_json_fun)
+{
+    if (handlers == NULL)
+    {
+        return NULL;
+    }
+
+    /* can be NULL */
+
+    handlers->from_json_fun = from_json_fun;
     return handlers;
 }
 
+unsigned int node_name_hash(const char *node_name)
+{
+    unsigned int hash = NODE_FNV_OFFSET_BASIS;
+
+    if (node_name == NULL)
+    {
+        return 0;
+    }
+
+    for (; *node_name != '\0'; ++node_name)
+    {
+        hash ^= (unsigned char)*node_name;
+        hash *= NODE_FNV_PRIME;
+    }
+
+    return hash;
+}
+
+/* object_name has to be set already */
+static void node_init(
+    node_t *self,
+    tree_allocator_t *allocator,
+    value_handlers_t *value_handlers,
+    void *value)
+{
+    self->name_hash = node_name_hash(self->object_name);
+
+    self->value = value;
+    self->parent = NULL;
+    self->children = NULL;
+    self->num_children = 0;
+    self->capacity = 0;
+    self->height = 1;
+    self->pre_order = 0;
+    self->subtree_size = 1;
+    self->level = 0;
+    self->value_handlers = value_handlers;
+    self->flags = 0;
+    self->added_in = 0;
+    self->removed_in = 0;
+    self->history = NULL;
+    self->allocator = allocator;
+
+    NODE_DUMP(self);
+}
+
 node_t *node_create(
     value_handlers_t *value_handlers,
     const char *node_name,
     void *value)
+{
+    return node_create_with(NULL, value_handlers, node_name, value);
+}
+
+node_t *node_create_with(
+    tree_allocator_t *allocator,
+    value_handlers_t *value_handlers,
+    const char *node_name,
+    void *value)
 {
     if ((value_handlers == NULL) || (node_name == NULL) || (strlen(node_name) == 0))
     {
@@ -94,24 +192,101 @@ node_t *node_create(
 
     /* value can be NULL */
 
-    node_t *self = malloc(sizeof(node_t));
+    allocator = (allocator != NULL) ? allocator : tree_allocator_default();
+    node_t *self = tree_malloc(allocator, sizeof(node_t));
 
     if (self == NULL)
     {
         return NULL;
     }
 
-    self->object_name = malloc(sizeof(char) * (strlen(node_name) + 1));
+    self->object_name = tree_malloc(allocator, sizeof(char) * (strlen(node_name) + 1));
+
+    if (self->object_name == NULL)
+    {
+        tree_free(allocator, self);
+        return NULL;
+    }
+
     strcpy(self->object_name, node_name);
+    node_init(self, allocator, value_handlers, value);
 
-    self->value = value;
-    self->parent = NULL;
-    self->children = NULL;
-    self->num_children = 0;
-    self->capacity = 0;
-    self->value_handlers = value_handlers;
+    return self;
+}
 
-    NODE_DUMP(self);
+node_t *node_create_in(
+    tree_arena_t *arena,
+    value_handlers_t *value_handlers,
+    const char *node_name,
+    void *value)
+{
+    node_t *self = NULL;
+    size_t name_size = 0;
+
+    if (arena == NULL)
+    {
+        return node_create(value_handlers, node_name, value);
+    }
+
+    if ((value_handlers == NULL) || (node_name == NULL) || (strlen(node_name) == 0))
+    {
+        return NULL;
+    }
+
+    /* one block for both */
+    name_size = strlen(node_name) + 1;
+    self = tree_arena_alloc(arena, sizeof(node_t) + name_size);
+
+    if (self == NULL)
+    {
+        return NULL;
+    }
+
+    self->object_name = (char *)(self + 1);
+    memcpy(self->object_name, node_name, name_size);
+    node_init(self, tree_allocator_default(), value_handlers, value);
+    self->flags = NODE_FLAG_ARENA;
+
+    return self;
+}
+
+node_t *node_create_interned(
+    tree_names_t *names,
+    value_handlers_t *value_handlers,
+    const char *node_name,
+    void *value)
+{
+    node_t *self = NULL;
+    tree_allocator_t *allocator = tree_allocator_default();
+
+    if (names == NULL)
+    {
+        return node_create(value_handlers, node_name, value);
+    }
+
+    if ((value_handlers == NULL) || (node_name == NULL) || (strlen(node_name) == 0))
+    {
+        return NULL;
+    }
+
+    self = tree_malloc(allocator, sizeof(node_t));
+
+    if (self == NULL)
+    {
+        return NULL;
+    }
+
+    /* never written to, see NODE_FLAG_INTERNED */
+    self->object_name = (char *)tree_names_intern(names, node_name);
+
+    if (self->object_name == NULL)
+    {
+        tree_free(allocator, self);
+        return NULL;
+    }
+
+    node_init(self, allocator, value_handlers, value);
+    self->flags = NODE_FLAG_INTERNED;
 
     return self;
 }
@@ -130,14 +305,130 @@ void node_dispose(node_t *self)
         (*self->value_handlers->dispose_fun)(self->value);
     }
 
-    free(self->object_name);
-    free(self->children);
-    free(self);
+    if (self->children != self->inline_children)
+    {
+        tree_free(self->allocator, self->children);
+    }
+
+    if (self->flags & NODE_FLAG_ARENA)
+    {
+        tree_arena_free(self);
+        return;
+    }
+
+    if (self->flags & NODE_FLAG_INTERNED)
+    {
+        tree_names_release(self->object_name);
+    }
+    else
+    {
+        tree_free(self->allocator, self->object_name);
+    }
+
+    tree_free(self->allocator, self);
+}
+
+int node_reserve_children(node_t *self, int capacity)
+{
+    node_t **children = NULL;
+
+    if (self == NULL)
+    {
+        return 0;
+    }
+
+    if (capacity <= self->capacity)
+    {
+        return 1;
+    }
+
+    /* no table yet */
+    if ((self->children == NULL) && (capacity <= NODE_INLINE_CHILDREN))
+    {
+        self->children = self->inline_children;
+        self->capacity = NODE_INLINE_CHILDREN;
+        return 1;
+    }
+
+    if (self->children == self->inline_children)
+    {
+        children = tree_malloc(self->allocator, capacity * sizeof(node_t *));
+
+        if (children != NULL)
+        {
+            memcpy(children, self->inline_children, self->num_children * sizeof(node_t *));
+        }
+    }
+    else
+    {
+        children = tree_realloc(self->allocator, self->children, capacity * sizeof(node_t *));
+    }
+
+    /* failed to allocate memory */
+    if (children == NULL)
+    {
+        return 0;
+    }
+
+    self->children = children;
+    self->capacity = capacity;
+    return 1;
+}
+
+/* a child of the given height was added to node */
+static void node_grow_heights(node_t *node, int child_height)
+{
+    for (; (node != NULL) && (node->height <= child_height); node = node->parent)
+    {
+        node->height = child_height + 1;
+        child_height = node->height;
+    }
+}
+
+void node_update_height(node_t *self)
+{
+    int i = 0;
+    int height = 0;
+    int old_height = 0;
+
+    for (; self != NULL; self = self->parent)
+    {
+        height = 1;
+
+        for (i = 0; i < self->num_children; ++i)
+        {
+            if (self->children[i]->height >= height)
+            {
+                height = self->children[i]->height + 1;
+            }
+        }
+
+        old_height = self->height;
+        self->height = height;
+
+        if (height == old_height)
+        {
+            break;
+        }
+
+        /* parent has a higher child anyway */
+        if ((height < old_height) && (self->parent != NULL) && (old_height + 1 < self->parent->height))
+        {
+            break;
+        }
+    }
+}
+
+int node_has_name(const node_t *self, const char *node_name, unsigned int name_hash)
+{
+    return (self->object_name == node_name) ||
+           ((self->name_hash == name_hash) && (strcmp(self->object_name, node_name) == 0));
 }
 
 node_t *node_get_child(node_t *self, const char *child_name)
 {
     int i = 0;
+    unsigned int hash = 0;
 
     if ((self == NULL) || (child_name == NULL))
     {
@@ -145,10 +436,11 @@ node_t *node_get_child(node_t *self, const char *child_name)
     }
 
     NODE_DUMP(self);
+    hash = node_name_hash(child_name);
 
     for (; i < self->num_children; ++i)
     {
-        if (strcmp(self->children[i]->object_name, child_name) == 0)
+        if (node_has_name(self->children[i], child_name, hash))
         {
             return self->children[i];
         }
@@ -169,30 +461,25 @@ node_t *node_add_child(node_t *self, node_t *new_child)
 
     NODE_DUMP(self);
 
-    if (node_get_child(self, new_child->object_name) != NULL)
-    {
-        return NULL;
-    }
-
-    if (self->capacity == self->num_children)
+    /* the hash is cached already */
+    for (; i < self->num_children; ++i)
     {
-        node_t **new_children = realloc(
-            self->children,
-            (self->capacity + NODE_REALLOC_INCREMENT) * sizeof(node_t *));
-
-        /* Failed to allocate more memory */
-        if (new_children == NULL)
+        if (node_has_name(self->children[i], new_child->object_name, new_child->name_hash))
         {
             return NULL;
         }
+    }
 
-        self->children = new_children;
-        self->capacity += NODE_REALLOC_INCREMENT;
+    /* Failed to allocate more memory */
+    if ((self->capacity == self->num_children) &&
+        !node_reserve_children(self, self->capacity + NODE_REALLOC_INCREMENT))
+    {
+        return NULL;
     }
 
     /* find place for the new one */
     /* TODO use binary search version */
-    for (; i < self->num_children; ++i)
+    for (i = 0; i < self->num_children; ++i)
     {
         cmp_result = self->value_handlers->compare_fun(new_child->value, self->children[i]->value);
 
@@ -212,6 +499,7 @@ node_t *node_add_child(node_t *self, node_t *new_child)
     self->children[i] = new_child;
     new_child->parent = self;
     ++self->num_children;
+    node_grow_heights(self, new_child->height);
 
     NODE_DUMP(self);
 
@@ -222,6 +510,8 @@ int node_remove_child(node_t *self, const char *child_name)
 {
     int i = 0;
     int j = 0;
+    int child_height = 0;
+    unsigned int hash = 0;
 
     if ((self == NULL) || (child_name == NULL) || (self->num_children == 0))
     {
@@ -229,11 +519,12 @@ int node_remove_child(node_t *self, const char *child_name)
     }
 
     NODE_DUMP(self);
+    hash = node_name_hash(child_name);
 
     /* find it */
     for (; i < self->num_children; ++i)
     {
-        if (strcmp(self->children[i]->object_name, child_name) == 0)
+        if (node_has_name(self->children[i], child_name, hash))
         {
             break;
         }
@@ -246,95 +537,336 @@ int node_remove_child(node_t *self, const char *child_name)
     }
 
     /* deallocate child memory */
+    child_height = self->children[i]->height;
     node_dispose(self->children[i]);
 
     /*
      * memmove bug - cannot shift left
      * https://github.com/fingolfin/memmove-bug/blob/master/glibc-memcpy.patch
      */
-    for (j = i; j < self->num_children; ++j)
+    for (j = i; j < self->num_children - 1; ++j)
     {
         self->children[j] = self->children[j + 1];
     }
 
     --self->num_children;
 
+    /* the removed child was one of the highest */
+    if (child_height + 1 == self->height)
+    {
+        node_update_height(self);
+    }
+
     NODE_DUMP(self);
 
     return 1;
 }
 
-#define ERROR_OR_NEXT()\
-    if (char_cnt < 0)\
-    {\
-        return 0;\
-    }\
-    \
-    if (char_cnt >= size_left)\
-    {\
-        return char_pos + char_cnt;\
-    }\
-    \
-    char_pos += char_cnt;\
-    size_left -= char_cnt;\
+/* output of node_to_json(), pos counts every character, only those which fit are written */
+typedef struct
+{
+    char *buffer;
+    int size;
+    int pos;
+} node_json_writer_t;
 
-int node_to_json(node_t *self, char *buffer, int buffer_size)
+static void node_json_put(node_json_writer_t *writer, const char *data, int size)
 {
-    int i = 0;
-    int char_pos = 0;
-    int char_cnt = 0;
-    int size_left = buffer_size;
+    int room = writer->size - 1 - writer->pos;
 
-    if ((self == NULL) || (buffer == NULL))
+    if (room > 0)
+    {
+        memcpy(writer->buffer + writer->pos, data, (size < room) ? size : room);
+    }
+
+    writer->pos += size;
+}
+
+/* length of the prefix of size bytes with nothing to escape */
+typedef size_t (*node_json_scan_fun_t)(const char *string, size_t size);
+
+static size_t node_json_scan_scalar(const char *string, size_t size)
+{
+    size_t i = 0;
+
+    while ((i < size) && (string[i] != '"') && (string[i] != '\\') && ((unsigned char)string[i] >= 0x20))
+    {
+        ++i;
+    }
+
+    return i;
+}
+
+#if NODE_JSON_X86
+
+/* 16 bytes at a time, c < 0x20 unsigned is min(c, 0x1f) == c */
+__attribute__((target("sse2")))
+static size_t node_json_scan_sse2(const char *string, size_t size)
+{
+    const __m128i quote = _mm_set1_epi8('"');
+    const __m128i backslash = _mm_set1_epi8('\\');
+    const __m128i control = _mm_set1_epi8(0x1f);
+    __m128i bytes;
+    unsigned int mask = 0;
+    size_t i = 0;
+
+    for (; i + 16 <= size; i += 16)
+    {
+        bytes = _mm_loadu_si128((const __m128i *)(string + i));
+        mask = (unsigned int)_mm_movemask_epi8(
+            _mm_or_si128(
+                _mm_or_si128(_mm_cmpeq_epi8(bytes, quote), _mm_cmpeq_epi8(bytes, backslash)),
+                _mm_cmpeq_epi8(_mm_min_epu8(bytes, control), bytes)));
+
+        if (mask != 0)
+        {
+            return i + __builtin_ctz(mask);
+        }
+    }
+
+    return i + node_json_scan_scalar(string + i, size - i);
+}
+
+/* same as node_json_scan_sse2(), 32 bytes at a time */
+__attribute__((target("avx2")))
+static size_t node_json_scan_avx2(const char *string, size_t size)
+{
+    const __m256i quote = _mm256_set1_epi8('"');
+    const __m256i backslash = _mm256_set1_epi8('\\');
+    const __m256i control = _mm256_set1_epi8(0x1f);
+    __m256i bytes;
+    unsigned int mask = 0;
+    size_t i = 0;
+
+    for (; i + 32 <= size; i += 32)
+    {
+        bytes = _mm256_loadu_si256((const __m256i *)(string + i));
+        mask = (unsigned int)_mm256_movemask_epi8(
+            _mm256_or_si256(
+                _mm256_or_si256(_mm256_cmpeq_epi8(bytes, quote), _mm256_cmpeq_epi8(bytes, backslash)),
+                _mm256_cmpeq_epi8(_mm256_min_epu8(bytes, control), bytes)));
+
+        if (mask != 0)
+        {
+            return i + __builtin_ctz(mask);
+        }
+    }
+
+    return i + node_json_scan_sse2(string + i, size - i);
+}
+
+#endif /* NODE_JSON_X86 */
+
+/* set by node_json_set_scan(), or on first use */
+static node_json_scan_fun_t g_node_json_scan;
+static node_json_scan_t g_node_json_scan_kind;
+
+node_json_scan_t node_json_set_scan(node_json_scan_t scan)
+{
+    node_json_scan_fun_t scan_fun = node_json_scan_scalar;
+    node_json_scan_t kind = NODE_JSON_SCAN_SCALAR;
+
+#if NODE_JSON_X86
+    __builtin_cpu_init();
+
+    if (((scan == NODE_JSON_SCAN_AUTO) || (scan == NODE_JSON_SCAN_AVX2)) && __builtin_cpu_supports("avx2"))
+    {
+        scan_fun = node_json_scan_avx2;
+        kind = NODE_JSON_SCAN_AVX2;
+    }
+    else if ((scan != NODE_JSON_SCAN_SCALAR) && __builtin_cpu_supports("sse2"))
+    {
+        scan_fun = node_json_scan_sse2;
+        kind = NODE_JSON_SCAN_SSE2;
+    }
+#else
+    (void)scan;
+#endif
+
+    /* a racing first use picks the same one */
+    __atomic_store_n(&g_node_json_scan_kind, kind, __ATOMIC_RELAXED);
+    __atomic_store_n(&g_node_json_scan, scan_fun, __ATOMIC_RELEASE);
+
+    return kind;
+}
+
+static node_json_scan_fun_t node_json_scan(void)
+{
+    node_json_scan_fun_t scan_fun = __atomic_load_n(&g_node_json_scan, __ATOMIC_ACQUIRE);
+
+    if (scan_fun == NULL)
+    {
+        node_json_set_scan(NODE_JSON_SCAN_AUTO);
+        scan_fun = __atomic_load_n(&g_node_json_scan, __ATOMIC_ACQUIRE);
+    }
+
+    return scan_fun;
+}
+
+/* quoted, clean runs are found by the scan and copied as they are */
+static void node_json_put_string(node_json_writer_t *writer, const char *string)
+{
+    static const char hex[] = "0123456789abcdef";
+    node_json_scan_fun_t scan_fun = node_json_scan();
+    size_t size = strlen(string);
+    size_t clean = 0;
+    char escaped[6] = {'\\', 'u', '0', '0', 0, 0};
+    char pair[2] = {'\\', 0};
+
+    node_json_put(writer, "\"", 1);
+
+    while (size > 0)
+    {
+        clean = (*scan_fun)(string, size);
+        node_json_put(writer, string, (int)clean);
+
+        if (clean == size)
+        {
+            break;
+        }
+
+        string += clean;
+
+        if ((*string == '"') || (*string == '\\'))
+        {
+            pair[1] = *string;
+            node_json_put(writer, pair, 2);
+        }
+        else
+        {
+            escaped[4] = hex[(unsigned char)*string >> 4];
+            escaped[5] = hex[(unsigned char)*string & 0xf];
+            node_json_put(writer, escaped, 6);
+        }
+
+        ++string;
+        size -= clean + 1;
+    }
+
+    node_json_put(writer, "\"", 1);
+}
+
+int node_json_escape(const char *string, char *buffer, int buffer_size)
+{
+    node_json_writer_t writer;
+
+    if (string == NULL)
     {
         return 0;
     }
 
-    char_cnt = snprintf(buffer, size_left, "{\"object_name\":\"%s\",\"value\":", self->object_name);
+    writer.buffer = buffer;
+    writer.size = (buffer != NULL) ? buffer_size : 0;
+    writer.pos = 0;
 
-    ERROR_OR_NEXT();
+    node_json_put_string(&writer, string);
 
-    if (self->value_handlers->to_json_fun == NULL)
+    if (writer.size > 0)
+    {
+        buffer[(writer.pos < writer.size) ? writer.pos : writer.size - 1] = '\0';
+    }
+
+    return writer.pos;
+}
+
+/* in place, or in a scratch buffer just to learn the size once there is no room left */
+static int node_json_put_value(node_json_writer_t *writer, node_t *node)
+{
+    char scratch[NODE_JSON_SCRATCH_SIZE];
+    int room = writer->size - writer->pos;
+    int size = (room > 0) ?
+        (*node->value_handlers->to_json_fun)(node->value, writer->buffer + writer->pos, room) :
+        (*node->value_handlers->to_json_fun)(node->value, scratch, sizeof(scratch));
+
+    if (size < 0)
     {
         return 0;
     }
 
-    char_cnt = self->value_handlers->to_json_fun(self->value, &buffer[char_pos], size_left);
+    writer->pos += size;
+    return 1;
+}
+
+/* the whole node, returns its size or -1 */
+static int node_json_write(node_t *self, char *buffer, int buffer_size)
+{
+    node_json_writer_t writer;
+    int i = 0;
+
+    if (self->value_handlers->to_json_fun == NULL)
+    {
+        return -1;
+    }
+
+    writer.buffer = buffer;
+    writer.size = buffer_size;
+    writer.pos = 0;
 
-    ERROR_OR_NEXT();
+    node_json_put(&writer, "{\"object_name\":", 15);
+    node_json_put_string(&writer, self->object_name);
+    node_json_put(&writer, ",\"value\":", 9);
+
+    if (!node_json_put_value(&writer, self))
+    {
+        return -1;
+    }
 
     if (self->parent == NULL)
     {
-        char_cnt = snprintf(&buffer[char_pos], size_left, ",\"parent\":null,\"children\":[");
+        node_json_put(&writer, ",\"parent\":null", 14);
     }
     else
     {
-        char_cnt = snprintf(
-            &buffer[char_pos],
-            size_left,
-            ",\"parent\":\"%s\",\"children\":[",
-            self->parent->object_name);
+        node_json_put(&writer, ",\"parent\":", 10);
+        node_json_put_string(&writer, self->parent->object_name);
     }
 
-    ERROR_OR_NEXT();
+    node_json_put(&writer, ",\"children\":[", 13);
 
     for (; i < self->num_children; ++i)
     {
-        char_cnt = snprintf(&buffer[char_pos], size_left, "\"%s\",", self->children[i]->object_name);
-
-        ERROR_OR_NEXT();
-
-        if (i == self->num_children - 1)
+        if (i > 0)
         {
-            /* remove last comma */
-            --char_pos;
-            ++size_left;
+            node_json_put(&writer, ",", 1);
         }
+
+        node_json_put_string(&writer, self->children[i]->object_name);
+    }
+
+    node_json_put(&writer, "]}", 2);
+
+    if (buffer_size > 0)
+    {
+        buffer[(writer.pos < buffer_size) ? writer.pos : buffer_size - 1] = '\0';
+    }
+
+    return writer.pos;
+}
+
+int node_json_size(node_t *self)
+{
+    int size = 0;
+
+    if (self == NULL)
+    {
+        return 0;
     }
 
-    char_cnt = snprintf(&buffer[char_pos], size_left, "]}");
+    size = node_json_write(self, NULL, 0);
+
+    return (size < 0) ? 0 : size;
+}
+
+int node_to_json(node_t *self, char *buffer, int buffer_size)
+{
+    int size = 0;
+
+    if ((self == NULL) || (buffer == NULL))
+    {
+        return 0;
+    }
 
-    ERROR_OR_NEXT();
+    size = node_json_write(self, buffer, buffer_size);
 
-    return char_pos;
+    return (size < 0) ? 0 : size;
 }
@@ -1,6 +1,10 @@
 #ifndef CNODE_H_
 #define CNODE_H_
 
+#include "carena.h"
+#include "callocator.h"
+#include "cnames.h"
+
 #ifdef __cplusplus
 extern "C"
 {
@@ -38,13 +42,62 @@ typedef int (*value_to_json_fun_t)(void *, char *, int);
  */
 typedef void (*value_dispose_fun_t)(void *);
 
+/**
+ * Binary serialization handler for a particular value type
+ *
+ * Such a function should write the value passed in the 1st argument as a payload of bytes to the
+ * buffer passed in the 2nd argument, of the size passed in the third argument. Follows the
+ * snprintf convention like value_to_json_fun_t: returns the size of the whole payload, even if
+ * it does not fit, or less than zero if error occurred. The payload is read back by
+ * value_from_binary_fun_t on any process of the same machine, so it must not contain pointers.
+ */
+typedef int (*value_to_binary_fun_t)(void *, char *, int);
+
+/**
+ * Binary deserialization handler for a particular value type
+ *
+ * Such a function should create a value from the payload passed in the 1st argument, of the size
+ * passed in the 2nd argument, which value_to_binary_fun_t has written, and store it in the 3rd
+ * argument. The value can be NULL, it is disposed of with value_dispose_fun_t. Should return 0 if
+ * error occurred, 1 otherwise.
+ */
+typedef int (*value_from_binary_fun_t)(const char *, int, void **);
+
+/**
+ * JSON parse handler for a particular value type
+ *
+ * Such a function should create a value from the JSON text passed in the 1st argument, of the
+ * size passed in the 2nd argument, not NULL terminated. The text is one complete JSON value other
+ * than null, as value_to_json_fun_t writes it. The value is disposed of with value_dispose_fun_t.
+ * Should return NULL if error occurred.
+ */
+typedef void *(*value_from_json_fun_t)(const char *, int);
+
 typedef struct
 {
     value_compare_fun_t compare_fun;
     value_to_json_fun_t to_json_fun;
     value_dispose_fun_t dispose_fun;
+    value_to_binary_fun_t to_binary_fun; /**< optional, see value_handlers_set_binary() */
+    value_from_binary_fun_t from_binary_fun; /**< optional, see value_handlers_set_binary() */
+    value_from_json_fun_t from_json_fun; /**< optional, see value_handlers_set_from_json() */
 } value_handlers_t;
 
+/**
+ * Node flags
+ */
+#define NODE_FLAG_MARKED 0x1u /**< scratch mark, set only while a tree operation is in progress */
+#define NODE_FLAG_ARENA 0x2u /**< node and its name live in a tree_arena_t, see node_create_in() */
+#define NODE_FLAG_INTERNED 0x4u /**< name is a handle from a tree_names_t, see node_create_interned() */
+
+/**
+ * Number of children kept in node_t itself, more go to a table of their own
+ *
+ * Four pointers take half a cache line and cover the common fan-outs of 0 to 3 children even with
+ * the NULL terminator lock-free readers need, see tree_node_children().
+ */
+#define NODE_INLINE_CHILDREN 4
+
 /**
  * Describes a tree node for a particular value type, which is determined by the value_handlers
  * field.
@@ -52,12 +105,24 @@ typedef struct
 typedef struct node_s
 {
     char *object_name;
+    unsigned int name_hash; /**< node_name_hash() of object_name, cached */
     void *value;
     struct node_s *parent;
-    struct node_s **children;
+    struct node_s **children; /**< inline_children or a table of its own */
     int num_children;
     int capacity;
+    struct node_s *inline_children[NODE_INLINE_CHILDREN];
+    int height; /**< number of levels of the subtree rooted in this node, 1 for a leaf */
+    int pre_order; /**< position in pre-order walk of the tree, see tree_t::labels_valid */
+    int subtree_size; /**< number of nodes in the subtree, see tree_t::labels_valid */
+    int level; /**< distance from the root, see tree_t::labels_valid */
     value_handlers_t *value_handlers;
+    unsigned int flags; /**< NODE_FLAG_* */
+    unsigned int added_in; /**< tree version the node was added in, see tree_snapshot() */
+    unsigned int removed_in; /**< tree version the node was removed in, 0 while in the tree */
+    struct node_history_s *history; /**< older children tables, kept for tree snapshots */
+    tree_allocator_t *allocator; /**< of the children tables, and of the node and its name unless
+                                      NODE_FLAG_ARENA or NODE_FLAG_INTERNED is set */
 } node_t;
 
 /**
@@ -69,6 +134,9 @@ typedef struct node_s
  * @param[in] dispose_fun - pointer to a function which disposes of the value (can be NULL)
  *
  * @return NULL if handlers or compare_fun is NULL, handlers otherwise
+ *
+ * @note There are no binary handlers until value_handlers_set_binary() is called and no JSON
+ *       parse handler until value_handlers_set_from_json() is called
  */
 value_handlers_t *value_handlers_init(
     value_handlers_t *handlers,
@@ -76,6 +144,39 @@ value_handlers_t *value_handlers_init(
     value_to_json_fun_t to_json_fun,
     value_dispose_fun_t dispose_fun);
 
+/**
+ * Set the binary serialization handlers of value_handlers_t, see tree_save_binary()
+ *
+ * @param[in] handlers - pointer to a structure initialized by value_handlers_init()
+ * @param[in] to_binary_fun - pointer to a function which serializes a value to bytes (can be NULL)
+ * @param[in] from_binary_fun - pointer to a function which creates a value from bytes (can be NULL)
+ *
+ * @return NULL if handlers is NULL, handlers otherwise
+ */
+value_handlers_t *value_handlers_set_binary(
+    value_handlers_t *handlers,
+    value_to_binary_fun_t to_binary_fun,
+    value_from_binary_fun_t from_binary_fun);
+
+/**
+ * Set the JSON parse handler of value_handlers_t, see tree_json_parser_feed()
+ *
+ * @param[in] handlers - pointer to a structure initialized by value_handlers_init()
+ * @param[in] from_json_fun - pointer to a function which creates a value from JSON (can be NULL)
+ *
+ * @return NULL if handlers is NULL, handlers otherwise
+ */
+value_handlers_t *value_handlers_set_from_json(value_handlers_t *handlers, value_from_json_fun_t from_json_fun);
+
+/**
+ * Calculate the hash of a node name
+ *
+ * @param[in] node_name - NULL terminated C string to hash
+ *
+ * @return 0 if node_name is NULL, 32-bit FNV-1a hash of node_name otherwise
+ */
+unsigned int node_name_hash(const char *node_name);
+
 /**
  * Allocate memory and initialize a node structure
  *
@@ -94,6 +195,62 @@ node_t *node_create(
     const char *node_name,
     void *value);
 
+/**
+ * Same as node_create() with memory from a particular allocator
+ *
+ * @param[in,out] allocator - allocator of the node, its name and its children tables,
+ *                            NULL for the default one, see tree_allocator_default()
+ * @param[in] value_handlers - pointer to a structure with handlers for a particular type of value
+ * @param[in] node_name - name of the node being created (passed as C string)
+ * @param[in] value - pointer to a value associated with the node (NULL is allowed)
+ *
+ * @return NULL if value_handlers or node_name is NULL or memory cannot be allocated,
+ *         allocated and initialized node struct pointer otherwise
+ */
+node_t *node_create_with(
+    tree_allocator_t *allocator,
+    value_handlers_t *value_handlers,
+    const char *node_name,
+    void *value);
+
+/**
+ * Create a node in an arena, the name is stored right after the node in the same block
+ *
+ * @param[in,out] arena - arena to allocate from, NULL to fall back to node_create()
+ * @param[in] value_handlers - pointer to a structure with handlers for a particular type of value
+ * @param[in] node_name - name of the node being created (passed as C string)
+ * @param[in] value - pointer to a value associated with the node (NULL is allowed)
+ *
+ * @return NULL if value_handlers or node_name is NULL or memory cannot be allocated,
+ *         allocated and initialized node struct pointer otherwise
+ *
+ * @note node_dispose() gives the block back to the arena, see tree_arena_free()
+ */
+node_t *node_create_in(
+    tree_arena_t *arena,
+    value_handlers_t *value_handlers,
+    const char *node_name,
+    void *value);
+
+/**
+ * Create a node whose name is shared with all other nodes of the same name in a pool
+ *
+ * @param[in,out] names - pool to intern the name in, NULL to fall back to node_create()
+ * @param[in] value_handlers - pointer to a structure with handlers for a particular type of value
+ * @param[in] node_name - name of the node being created (passed as C string)
+ * @param[in] value - pointer to a value associated with the node (NULL is allowed)
+ *
+ * @return NULL if value_handlers or node_name is NULL or memory cannot be allocated,
+ *         allocated and initialized node struct pointer otherwise
+ *
+ * @note object_name of the node is the handle of the name, see tree_names_intern(), and must
+ *       not be modified. Lookups with the handle itself are resolved by a pointer compare.
+ */
+node_t *node_create_interned(
+    tree_names_t *names,
+    value_handlers_t *value_handlers,
+    const char *node_name,
+    void *value);
 
 /**
  * Dispose of a node structure
@@ -106,6 +263,20 @@ node_t *node_create(
  */
 void node_dispose(node_t *self);
 
+/**
+ * Check the name of a node
+ *
+ * @param[in] self - pointer to a node structure
+ * @param[in] node_name - NULL terminated C string with the name to check
+ * @param[in] name_hash - node_name_hash() of node_name
+ *
+ * @return 1 if self is named node_name, 0 otherwise
+ *
+ * @note The same pointer matches right away and a different hash rejects right away,
+ *       strcmp() only confirms a matching hash.
+ */
+int node_has_name(const node_t *self, const char *node_name, unsigned int name_hash);
+
 /**
  * Get child of a node
  *
@@ -143,19 +314,98 @@ node_t *node_add_child(node_t *self, node_t *new_child);
  */
 int node_remove_child(node_t *self, const char *child_name);
 
+/**
+ * Make room for children of a node, the first NODE_INLINE_CHILDREN are stored in the node itself
+ *
+ * @param[in,out] self - pointer to a node structure
+ * @param[in] capacity - number of children the table should hold at least
+ *
+ * @return 0 if self is NULL or memory cannot be allocated, 1 otherwise
+ *
+ * @note Children move to a table of their own once they outgrow the inline one and never move
+ *       back, so a table handed out to lock-free readers is never written to again.
+ */
+int node_reserve_children(node_t *self, int capacity);
+
+/**
+ * Recalculate height of a node and of its ancestors after children were removed from the node
+ * without node_remove_child()
+ *
+ * @param[in] self - pointer to a node structure, function does nothing if self is NULL
+ *
+ * @note node_add_child() and node_remove_child() keep heights up to date on their own.
+ *       Recalculation stops at the first ancestor whose height does not change.
+ */
+void node_update_height(node_t *self);
+
+/**
+ * How node_json_escape() finds the characters to escape, see node_json_set_scan()
+ */
+typedef enum
+{
+    NODE_JSON_SCAN_AUTO = 0, /**< the fastest the CPU supports, the default */
+    NODE_JSON_SCAN_SCALAR, /**< byte by byte */
+    NODE_JSON_SCAN_SSE2, /**< 16 bytes at a time, x86 only */
+    NODE_JSON_SCAN_AVX2 /**< 32 bytes at a time, x86 only */
+} node_json_scan_t;
+
+/**
+ * Choose how JSON strings are scanned for characters to escape, for all threads
+ *
+ * @param[in] scan - the one to use, falls back to the next slower one the CPU supports
+ *
+ * @return the one in use from now on, never NODE_JSON_SCAN_AUTO
+ *
+ * @note Only needed to compare them, node_json_escape() picks the fastest one on first use
+ */
+node_json_scan_t node_json_set_scan(node_json_scan_t scan);
+
+/**
+ * Write a string to JSON, quoted and escaped like names in node_to_json()
+ *
+ * Quotes and backslashes are preceded by a backslash, control characters are written as
+ * \u00XX, anything else is copied as it is. The string is scanned 16 or 32 bytes at a time
+ * for characters to escape where the CPU allows it, see node_json_set_scan().
+ *
+ * @param[in] string - NULL terminated string to write
+ * @param[out] buffer - pointer to a char buffer (can be NULL if buffer_size is 0)
+ * @param[in] buffer_size - size of the char buffer
+ *
+ * @return 0 if string is NULL, number of characters of the whole quoted string otherwise,
+ *         without the terminating NULL, it has been completely written only if it is less
+ *         than buffer size, like snprintf
+ */
+int node_json_escape(const char *string, char *buffer, int buffer_size);
+
+/**
+ * Get the exact number of characters node_to_json() writes for a node
+ *
+ * @param[in] self - pointer to a node structure
+ *
+ * @return 0 if self is NULL or serialization fails, number of characters without the
+ *         terminating NULL otherwise, so a buffer of this size + 1 is enough for node_to_json()
+ *
+ * @note The value is serialized once to learn its size, into a small buffer on the stack
+ */
+int node_json_size(node_t *self);
+
 /**
  * Serialize node to JSON
  *
+ * Names are escaped: quotes and backslashes are preceded by a backslash, control characters
+ * are written as \u00XX.
+ *
  * @param[in] self - pointer to a node structure
  * @param[out] buffer - pointer to a char buffer
  * @param[in] buffer_size - size of the char buffer
  *
  * @return 0 if self or buffer is NULL
- *         0 if buffer size is too small
- *         0 if serialization failed for any other reason,
- *         number of characters written to buffer otherwise.
+ *         0 if serialization of the value failed or there is no to_json_fun,
+ *         number of characters of the whole JSON otherwise, without the terminating NULL.
  *
- * @warning It is caller's responsibility to provide sufficient buffer size.
+ * @warning Please follow the snprintf convention: Only when the returned number is less than
+ *          buffer size, the JSON string has been completely written, otherwise it is cut
+ *          short, see node_json_size().
  */
 int node_to_json(node_t *self, char *buffer, int buffer_size);
 
@@ -0,0 +1,462 @@
+#include "cparallel.h"
+#include <pthread.h>
+#include <sched.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#define TREE_DEQUE_MIN_CAPACITY 64
+
+static int g_serial_threshold = TREE_PARALLEL_SERIAL_THRESHOLD;
+
+/* owner pushes and pops the newest tasks at tail, thieves take the oldest ones at head */
+typedef struct
+{
+    pthread_mutex_t lock;
+    node_t **tasks;
+    int head;
+    int tail;
+    int capacity;
+} tree_deque_t;
+
+typedef struct tree_pool_s tree_pool_t;
+
+typedef struct
+{
+    tree_pool_t *pool;
+    int id;
+    int started; /* has its own thread, which has to be joined */
+    pthread_t thread;
+    tree_deque_t deque;
+    tree_iter_t iter; /* reserved for the whole tree height, so walks never allocate */
+    void *acc; /* reduce only */
+    int visited_cnt;
+} tree_worker_t;
+
+struct tree_pool_s
+{
+    tree_worker_t *workers;
+    int num_workers;
+    int serial_threshold;
+    tree_visit_fun_t visit_fun; /* for each only */
+    tree_reduce_fun_t reduce_fun; /* reduce only */
+    void *ctx;
+    int num_pending; /* tasks pushed and not finished yet, atomic */
+    int stop; /* set when a visitor asks to stop, atomic */
+};
+
+int tree_parallel_set_serial_threshold(int num_nodes)
+{
+    int previous = g_serial_threshold;
+
+    g_serial_threshold = (num_nodes < 1) ? TREE_PARALLEL_SERIAL_THRESHOLD : num_nodes;
+
+    return previous;
+}
+
+static int tree_deque_init(tree_deque_t *self)
+{
+    self->tasks = malloc(TREE_DEQUE_MIN_CAPACITY * sizeof(node_t *));
+
+    /* failed to allocate memory */
+    if (self->tasks == NULL)
+    {
+        return 0;
+    }
+
+    self->head = 0;
+    self->tail = 0;
+    self->capacity = TREE_DEQUE_MIN_CAPACITY;
+    pthread_mutex_init(&self->lock, NULL);
+
+    return 1;
+}
+
+static void tree_deque_dispose(tree_deque_t *self)
+{
+    if (self->tasks != NULL)
+    {
+        pthread_mutex_destroy(&self->lock);
+        free(self->tasks);
+    }
+}
+
+static int tree_deque_push(tree_deque_t *self, node_t *node)
+{
+    node_t **new_tasks = NULL;
+    int pushed = 1;
+
+    pthread_mutex_lock(&self->lock);
+
+    if (self->tail == self->capacity)
+    {
+        if (self->head > 0)
+        {
+            /* reuse the room of stolen tasks */
+            memmove(
+                self->tasks,
+                &self->tasks[self->head],
+                (self->tail - self->head) * sizeof(node_t *));
+            self->tail -= self->head;
+            self->head = 0;
+        }
+        else
+        {
+            new_tasks = realloc(self->tasks, 2 * self->capacity * sizeof(node_t *));
+
+            /* failed to reallocate memory */
+            if (new_tasks == NULL)
+            {
+                pushed = 0;
+            }
+            else
+            {
+                self->tasks = new_tasks;
+                self->capacity *= 2;
+            }
+        }
+    }
+
+    if (pushed)
+    {
+        self->tasks[self->tail++] = node;
+    }
+
+    pthread_mutex_unlock(&self->lock);
+
+    return pushed;
+}
+
+static node_t *tree_deque_pop(tree_deque_t *self, int oldest)
+{
+    node_t *node = NULL;
+
+    pthread_mutex_lock(&self->lock);
+
+    if (self->tail > self->head)
+    {
+        node = oldest ? self->tasks[self->head++] : self->tasks[--self->tail];
+
+        if (self->head == self->tail)
+        {
+            self->head = 0;
+            self->tail = 0;
+        }
+    }
+
+    pthread_mutex_unlock(&self->lock);
+
+    return node;
+}
+
+static int tree_worker_visit(tree_worker_t *self, node_t *node)
+{
+    tree_pool_t *pool = self->pool;
+
+    ++self->visited_cnt;
+
+    if (pool->reduce_fun != NULL)
+    {
+        (*pool->reduce_fun)(self->acc, node, pool->ctx);
+        return 0;
+    }
+
+    if ((*pool->visit_fun)(node, pool->ctx) != 0)
+    {
+        __atomic_store_n(&pool->stop, 1, __ATOMIC_RELAXED);
+        return 1;
+    }
+
+    return 0;
+}
+
+/* visit a whole subtree in this thread */
+static void tree_worker_walk(tree_worker_t *self, node_t *node)
+{
+    tree_iter_start(&self->iter, node, TREE_ITER_PRE_ORDER);
+
+    while ((node = tree_iter_next(&self->iter)) != NULL)
+    {
+        if (__atomic_load_n(&self->pool->stop, __ATOMIC_RELAXED) || tree_worker_visit(self, node))
+        {
+            return;
+        }
+    }
+}
+
+/* visit a subtree, sharing its large subtrees with the other threads */
+static void tree_worker_run(tree_worker_t *self, node_t *node)
+{
+    tree_pool_t *pool = self->pool;
+    node_t *child = NULL;
+    node_t *next = NULL;
+    int i = 0;
+
+    while ((node != NULL) && !__atomic_load_n(&pool->stop, __ATOMIC_RELAXED))
+    {
+        if (node->subtree_size <= pool->serial_threshold)
+        {
+            tree_worker_walk(self, node);
+            return;
+        }
+
+        if (tree_worker_visit(self, node))
+        {
+            return;
+        }
+
+        next = NULL;
+
+        /* keep one large child to continue with, so that chains do not go through the deque */
+        for (i = 0; i < node->num_children; ++i)
+        {
+            child = node->children[i];
+
+            if (child->subtree_size <= pool->serial_threshold)
+            {
+                continue;
+            }
+
+            if (next == NULL)
+            {
+                next = child;
+                continue;
+            }
+
+            __atomic_add_fetch(&pool->num_pending, 1, __ATOMIC_SEQ_CST);
+
+            /* failed to allocate memory, do it here instead */
+            if (!tree_deque_push(&self->deque, child))
+            {
+                __atomic_sub_fetch(&pool->num_pending, 1, __ATOMIC_SEQ_CST);
+                tree_worker_walk(self, child);
+            }
+        }
+
+        for (i = 0; i < node->num_children; ++i)
+        {
+            child = node->children[i];
+
+            if (child->subtree_size <= pool->serial_threshold)
+            {
+                tree_worker_walk(self, child);
+            }
+        }
+
+        node = next;
+    }
+}
+
+static node_t *tree_worker_steal(tree_worker_t *self)
+{
+    tree_pool_t *pool = self->pool;
+    node_t *node = NULL;
+    int i = 1;
+
+    for (; (i < pool->num_workers) && (node == NULL); ++i)
+    {
+        node = tree_deque_pop(&pool->workers[(self->id + i) % pool->num_workers].deque, 1);
+    }
+
+    return node;
+}
+
+static void *tree_worker_main(void *arg)
+{
+    tree_worker_t *self = arg;
+    tree_pool_t *pool = self->pool;
+    node_t *node = NULL;
+
+    for (;;)
+    {
+        node = tree_deque_pop(&self->deque, 0);
+
+        if (node == NULL)
+        {
+            node = tree_worker_steal(self);
+        }
+
+        if (node != NULL)
+        {
+            tree_worker_run(self, node);
+            __atomic_sub_fetch(&pool->num_pending, 1, __ATOMIC_SEQ_CST);
+        }
+        else if (__atomic_load_n(&pool->num_pending, __ATOMIC_SEQ_CST) == 0)
+        {
+            break;
+        }
+        else
+        {
+            sched_yield();
+        }
+    }
+
+    return NULL;
+}
+
+static void tree_pool_dispose(tree_pool_t *pool)
+{
+    int i = 0;
+
+    for (; i < pool->num_workers; ++i)
+    {
+        tree_deque_dispose(&pool->workers[i].deque);
+        tree_iter_clear(&pool->workers[i].iter);
+        free(pool->workers[i].acc);
+    }
+
+    free(pool->workers);
+}
+
+/* walk the tree with the pool, returns number of visited nodes or -1, pool needs disposing anyway */
+static int tree_pool_run(
+    tree_t *self,
+    tree_pool_t *pool,
+    int num_threads,
+    const void *identity,
+    size_t acc_size)
+{
+    tree_worker_t *worker = NULL;
+    int visited_cnt = 0;
+    int i = 0;
+
+    if (!tree_update_labels(self))
+    {
+        return -1;
+    }
+
+    if (self->root == NULL)
+    {
+        return 0;
+    }
+
+    if (num_threads <= 0)
+    {
+        num_threads = (int)sysconf(_SC_NPROCESSORS_ONLN);
+    }
+
+    pool->serial_threshold = g_serial_threshold;
+
+    /* not worth starting any threads */
+    if ((num_threads <= 1) || (self->root->subtree_size <= pool->serial_threshold))
+    {
+        num_threads = 1;
+    }
+
+    pool->workers = calloc(num_threads, sizeof(tree_worker_t));
+
+    /* failed to allocate memory */
+    if (pool->workers == NULL)
+    {
+        return -1;
+    }
+
+    for (; i < num_threads; ++i)
+    {
+        worker = &pool->workers[i];
+        worker->pool = pool;
+        worker->id = i;
+        ++pool->num_workers;
+
+        if (!tree_deque_init(&worker->deque) ||
+            !tree_iter_start(&worker->iter, self->root, TREE_ITER_PRE_ORDER))
+        {
+            return -1;
+        }
+
+        if (identity != NULL)
+        {
+            worker->acc = malloc(acc_size);
+
+            /* failed to allocate memory */
+            if (worker->acc == NULL)
+            {
+                return -1;
+            }
+
+            memcpy(worker->acc, identity, acc_size);
+        }
+    }
+
+    /* cannot fail, the deque has room */
+    tree_deque_push(&pool->workers[0].deque, self->root);
+    pool->num_pending = 1;
+
+    /* a thread which fails to start leaves an empty deque behind, the others do its share */
+    for (i = 1; i < num_threads; ++i)
+    {
+        worker = &pool->workers[i];
+        worker->started = (pthread_create(&worker->thread, NULL, tree_worker_main, worker) == 0);
+    }
+
+    tree_worker_main(&pool->workers[0]);
+
+    for (i = 0; i < num_threads; ++i)
+    {
+        worker = &pool->workers[i];
+
+        if (worker->started)
+        {
+            pthread_join(worker->thread, NULL);
+        }
+
+        visited_cnt += worker->visited_cnt;
+    }
+
+    return visited_cnt;
+}
+
+int tree_parallel_for_each(tree_t *self, tree_visit_fun_t visit_fun, void *ctx, int num_threads)
+{
+    tree_pool_t pool;
+    int visited_cnt = 0;
+
+    if ((self == NULL) || (visit_fun == NULL))
+    {
+        return -1;
+    }
+
+    memset(&pool, 0, sizeof(tree_pool_t));
+    pool.visit_fun = visit_fun;
+    pool.ctx = ctx;
+
+    visited_cnt = tree_pool_run(self, &pool, num_threads, NULL, 0);
+    tree_pool_dispose(&pool);
+
+    return visited_cnt;
+}
+
+int tree_parallel_reduce(
+    tree_t *self,
+    void *result,
+    size_t acc_size,
+    tree_reduce_fun_t reduce_fun,
+    tree_combine_fun_t combine_fun,
+    void *ctx,
+    int num_threads)
+{
+    tree_pool_t pool;
+    int succeeded = 0;
+    int i = 0;
+
+    if ((self == NULL) || (result == NULL) || (acc_size == 0) || (reduce_fun == NULL) ||
+        (combine_fun == NULL))
+    {
+        return 0;
+    }
+
+    memset(&pool, 0, sizeof(tree_pool_t));
+    pool.reduce_fun = reduce_fun;
+    pool.ctx = ctx;
+
+    succeeded = (tree_pool_run(self, &pool, num_threads, result, acc_size) >= 0);
+
+    for (; succeeded && (i < pool.num_workers); ++i)
+    {
+        (*combine_fun)(result, pool.workers[i].acc, ctx);
+    }
+
+    tree_pool_dispose(&pool);
+
+    return succeeded;
+}
@@ -0,0 +1,91 @@
+#ifndef CPARALLEL_H_
+#define CPARALLEL_H_
+
+#include <stddef.h>
+#include "ctree.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif /* __cplusplus */
+
+/**
+ * Default for tree_parallel_set_serial_threshold()
+ */
+#define TREE_PARALLEL_SERIAL_THRESHOLD 4096
+
+/**
+ * Folds a node into an accumulator of tree_parallel_reduce()
+ */
+typedef void (*tree_reduce_fun_t)(void *acc, node_t *node, void *ctx);
+
+/**
+ * Merges the other accumulator into acc, should be associative and commutative
+ */
+typedef void (*tree_combine_fun_t)(void *acc, const void *other, void *ctx);
+
+/**
+ * Set the size below which subtrees are not split any further
+ *
+ * Such subtrees are walked by one thread, and trees smaller than this are walked without
+ * starting any threads.
+ *
+ * @param[in] num_nodes - new threshold, values below 1 restore TREE_PARALLEL_SERIAL_THRESHOLD
+ *
+ * @return previous threshold
+ *
+ * @warning Not thread safe, meant to be called while no parallel walk is running
+ */
+int tree_parallel_set_serial_threshold(int num_nodes);
+
+/**
+ * Call a visitor for every node of the tree from several threads
+ *
+ * Subtrees larger than the serial threshold become tasks on per thread deques, idle threads
+ * steal the oldest (so usually the largest) tasks of the others.
+ *
+ * @param[in,out] self - the tree to walk, labelled first if needed, see tree_update_labels()
+ * @param[in] visit_fun - visitor, called concurrently and in no particular order, a non 0
+ *                        return value stops the walk as soon as all threads notice it
+ * @param[in] ctx - passed to visit_fun as is
+ * @param[in] num_threads - number of threads including the calling one, 0 or less means one
+ *                          per online CPU
+ *
+ * @return -1 if self or visit_fun is NULL or there is not enough memory to label the tree,
+ *         number of visited nodes otherwise
+ *
+ * @warning The tree must not change until the walk is finished.
+ */
+int tree_parallel_for_each(tree_t *self, tree_visit_fun_t visit_fun, void *ctx, int num_threads);
+
+/**
+ * Fold all nodes of the tree into one value using several threads
+ *
+ * Every thread folds its nodes into its own copy of *result, the copies are then combined into
+ * *result by the calling thread, so neither function needs to be thread safe on its own.
+ *
+ * @param[in,out] self - the tree to walk, see tree_parallel_for_each()
+ * @param[in,out] result - holds the identity of combine_fun on entry, the result on return
+ * @param[in] acc_size - size of *result in bytes
+ * @param[in] reduce_fun - folds a node into an accumulator
+ * @param[in] combine_fun - merges two accumulators
+ * @param[in] ctx - passed to both functions as is
+ * @param[in] num_threads - see tree_parallel_for_each()
+ *
+ * @return 0 if any of the pointers is NULL, acc_size is 0 or memory cannot be allocated,
+ *         1 otherwise
+ */
+int tree_parallel_reduce(
+    tree_t *self,
+    void *result,
+    size_t acc_size,
+    tree_reduce_fun_t reduce_fun,
+    tree_combine_fun_t combine_fun,
+    void *ctx,
+    int num_threads);
+
+#ifdef __cplusplus
+} /* extern "C" */
+#endif /* __cplusplus */
+
+#endif /* CPARALLEL_H_ */
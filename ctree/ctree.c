@@ -1,11 +1,42 @@
 #include "ctree.h"
+#include "cjournal.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
 #define TREE_REALLOC_INCREMENT 4
+#define TREE_INDEX_MIN_CAPACITY 16
+#define TREE_SNAPSHOT_STACK_INCREMENT 16
 #define TREE_DEBUG 0
 
+struct tree_index_s
+{
+    int capacity; /* number of slots, always a power of 2 */
+    int num_used;
+    int num_deleted; /* tombstones, only left behind if the tree has an epoch */
+    node_t *slots[]; /* stored with release, so that lock-free readers see initialized nodes */
+};
+
+/* slot of a removed node, lock-free readers would miss nodes if entries were shifted back */
+static node_t tree_index_deleted;
+#define TREE_INDEX_DELETED (&tree_index_deleted)
+
+/* children table of a node since some tree version, newest first */
+struct node_history_s
+{
+    unsigned int since;
+    node_t **children; /* atomic */
+    struct node_history_s *older;
+};
+
+struct tree_snapshot_s
+{
+    tree_t *tree;
+    unsigned int version; /* sees what was added in this version or before and not removed */
+    node_t *root;
+    epoch_reader_t *reader; /* the index can be replaced while it is searched */
+};
+
 #if TREE_DEBUG
 static void tree_dump(const char *func, int line, tree_t *self)
 {
@@ -69,468 +100,2576 @@ void tree_init(tree_t *self)
     }
 
     memset(self, 0, sizeof(tree_t));
+    self->allocator = tree_allocator_default();
 
     TREE_DUMP(self);
 }
 
-void tree_clear(tree_t *self)
+int tree_set_allocator(tree_t *self, tree_allocator_t *allocator)
 {
-    int i = 0;
-
-    if (self == NULL)
+    if ((self == NULL) || (self->root != NULL) || (self->nodes != NULL) || (self->index != NULL) ||
+        (self->pre_order != NULL) || (self->jumps != NULL))
     {
-        return;
+        return 0;
     }
 
-    node_dispose(self->root);
-
-    for (; i < self->num_nodes; ++i)
-    {
-        node_dispose(self->nodes[i]);
-    }
+    self->allocator = (allocator != NULL) ? allocator : tree_allocator_default();
+    return 1;
+}
 
-    free(self->nodes);
-    memset(self, 0, sizeof(tree_t));
+/* copy all fields, lock-free readers see the new index before the new root */
+static void tree_assign(tree_t *self, const tree_t *from)
+{
+    __atomic_store_n(&self->root, NULL, __ATOMIC_RELEASE);
+    __atomic_store_n(&self->index, from->index, __ATOMIC_RELEASE);
+    self->nodes = from->nodes;
+    self->num_nodes = from->num_nodes;
+    self->capacity = from->capacity;
+    self->pre_order = from->pre_order;
+    self->labels_valid = from->labels_valid;
+    self->jumps = from->jumps;
+    self->num_jump_levels = from->num_jump_levels;
+    self->jumps_valid = from->jumps_valid;
+    self->scratch = from->scratch;
+    self->epoch = from->epoch;
+    self->allocator = from->allocator;
+    self->version = from->version;
+    self->num_buried = from->num_buried;
+    self->buried_roots = from->buried_roots;
+    self->journal = from->journal;
+    __atomic_store_n(&self->root, from->root, __ATOMIC_RELEASE);
 }
 
-/* TODO use binary search version */
-static int tree_find_node_pos(tree_t *self, const char *node_name)
+/* the current children table is freed by node_dispose() */
+static void tree_free_history(node_t *node)
 {
-    int i = 0;
+    struct node_history_s *entry = node->history;
+    struct node_history_s *older = NULL;
 
-    for (; i < self->num_nodes; ++i)
+    for (; entry != NULL; entry = older)
     {
-        if ((self->nodes[i] != NULL) && strcmp(node_name, self->nodes[i]->object_name) == 0)
+        older = entry->older;
+
+        if ((entry->children != node->children) && (entry->children != node->inline_children))
         {
-            return i;
+            tree_free(node->allocator, entry->children);
         }
+
+        tree_free(node->allocator, entry);
     }
 
-    /* not found */
-    return -1;
+    node->history = NULL;
 }
 
-/* TODO use binary search version */
-static int tree_find_closest_larger(tree_t *self, const char *node_name)
+static void tree_retired_node_dispose(void *node)
 {
-    int i = 0;
+    tree_free_history(node);
+    node_dispose(node);
+}
 
-    for (; i < self->num_nodes; ++i)
+/* dispose of a node which is no longer linked, once no lock-free reader can be using it */
+static void tree_dispose_node(tree_t *self, node_t *node)
+{
+    if (self->epoch != NULL)
     {
-        if (strcmp(node_name, self->nodes[i]->object_name) < 0)
-        {
-            return i;
-        }
+        epoch_retire(self->epoch, node, tree_retired_node_dispose);
+    }
+    else
+    {
+        tree_retired_node_dispose(node);
     }
+}
 
-    /* not found */
-    return i;
+/* free a table which is no longer published, once no lock-free reader can be using it */
+static void tree_free_table(tree_t *self, tree_allocator_t *allocator, void *table)
+{
+    if (self->epoch != NULL)
+    {
+        epoch_retire_with(self->epoch, table, tree_free_with, allocator);
+    }
+    else
+    {
+        tree_free(allocator, table);
+    }
 }
 
-node_t *tree_get_node(tree_t *self, const char *node_name)
+/* snapshots can be released by other threads at any time, but only the writer takes them */
+static int tree_has_snapshots(tree_t *self)
 {
-    int pos = 0;
+    return (self->epoch != NULL) && (__atomic_load_n(&self->num_snapshots, __ATOMIC_ACQUIRE) > 0);
+}
 
-    TREE_DUMP(self);
+static void tree_invalidate_labels(tree_t *self)
+{
+    self->labels_valid = 0;
+    self->jumps_valid = 0;
+}
+
+static tree_index_t *tree_index_create(tree_t *self, int capacity)
+{
+    size_t size = sizeof(tree_index_t) + capacity * sizeof(node_t *);
+    tree_index_t *index = tree_malloc(self->allocator, size);
 
-    if ((self == NULL) || (node_name == NULL) || (self->root == NULL) || (strlen(node_name) == 0))
+    if (index == NULL)
     {
         return NULL;
     }
 
-    if (strcmp(self->root->object_name, node_name) == 0)
+    memset(index, 0, size);
+
+    index->capacity = capacity;
+    return index;
+}
+
+static node_t *tree_index_find(tree_index_t *index, const char *node_name, unsigned int hash)
+{
+    unsigned int mask = 0;
+    unsigned int i = 0;
+    node_t *node = NULL;
+
+    if (index == NULL)
     {
-        return self->root;
+        return NULL;
     }
 
-    pos = tree_find_node_pos(self, node_name);
+    mask = index->capacity - 1;
 
-    if (pos == -1)
+    /* linear probing, an empty slot terminates the probe sequence */
+    for (i = hash & mask;
+         (node = __atomic_load_n(&index->slots[i], __ATOMIC_ACQUIRE)) != NULL;
+         i = (i + 1) & mask)
     {
-        return NULL;
+        /* nodes kept for snapshots are not in the tree any more */
+        if ((node != TREE_INDEX_DELETED) && (node->name_hash == hash) &&
+            (__atomic_load_n(&node->removed_in, __ATOMIC_ACQUIRE) == 0) &&
+            node_has_name(node, node_name, hash))
+        {
+            return node;
+        }
     }
 
-    return self->nodes[pos];
+    /* not found */
+    return NULL;
 }
 
-static node_t *tree_insert_node(tree_t *self, node_t *new_node)
+/* the node with node_name which was in the tree in the given version, see tree_snapshot() */
+static node_t *tree_index_find_version(
+    tree_index_t *index,
+    const char *node_name,
+    unsigned int hash,
+    unsigned int version)
 {
-    /* find where the new node should be in the nodes table */
-    int pos = tree_find_closest_larger(self, new_node->object_name);
+    unsigned int mask = index->capacity - 1;
+    unsigned int removed_in = 0;
+    unsigned int i = 0;
+    node_t *node = NULL;
 
-    memmove(&self->nodes[pos + 1], &self->nodes[pos], (self->num_nodes - pos) * sizeof(node_t *));
-    ++self->num_nodes;
+    /* the name can be there more than once, removed and added again */
+    for (i = hash & mask;
+         (node = __atomic_load_n(&index->slots[i], __ATOMIC_ACQUIRE)) != NULL;
+         i = (i + 1) & mask)
+    {
+        if ((node == TREE_INDEX_DELETED) || (node->name_hash != hash) || (node->added_in > version))
+        {
+            continue;
+        }
 
-    /* insert the new node */
-    self->nodes[pos] = new_node;
+        removed_in = __atomic_load_n(&node->removed_in, __ATOMIC_ACQUIRE);
 
-    TREE_DUMP(self);
+        if (((removed_in == 0) || (removed_in > version)) && node_has_name(node, node_name, hash))
+        {
+            return node;
+        }
+    }
 
-    /* success */
-    return new_node;
+    /* not found */
+    return NULL;
 }
 
-static node_t **tree_grow_if_needed(tree_t *self)
+/* the index must have a free slot, see tree_index_reserve() */
+static void tree_index_put(tree_index_t *index, node_t *node)
 {
-    TREE_DUMP(self);
+    unsigned int mask = index->capacity - 1;
+    unsigned int i = node->name_hash & mask;
 
-    if (self->num_nodes < self->capacity)
+    while ((index->slots[i] != NULL) && (index->slots[i] != TREE_INDEX_DELETED))
     {
-        return self->nodes;
+        i = (i + 1) & mask;
     }
 
-    /* nodes table is too small - it needs to grow */
-    node_t **new_nodes = realloc(self->nodes, (self->capacity + TREE_REALLOC_INCREMENT) * sizeof(node_t *));
-
-    /* failed to reallocate memory */
-    if (new_nodes == NULL)
+    if (index->slots[i] == TREE_INDEX_DELETED)
     {
-        return NULL;
+        --index->num_deleted;
     }
 
-    self->nodes = new_nodes;
-    self->capacity += TREE_REALLOC_INCREMENT;
-    return self->nodes;
+    __atomic_store_n(&index->slots[i], node, __ATOMIC_RELEASE);
+    ++index->num_used;
 }
 
-node_t *tree_add_node(tree_t *self, node_t *new_node, const char *parent_node_name)
+static void tree_index_remove(tree_index_t *index, node_t *node)
 {
-    TREE_DUMP(self);
+    unsigned int mask = 0;
+    unsigned int i = 0;
+    unsigned int j = 0;
+    unsigned int home = 0;
 
-    /* invalid tree or invalid node */
-    if ((self == NULL) || (new_node == NULL))
+    if (index == NULL)
     {
-        return NULL;
+        return;
     }
 
-    /* our tree is empty */
-    if (self->root == NULL)
-    {
-        self->root = new_node;
-        self->depth = 1;
-        TREE_DUMP(self);
-        return new_node;
-    }
+    mask = index->capacity - 1;
 
-    /* our tree already contains a node with such name */
-    if (tree_get_node(self, new_node->object_name) != NULL)
+    for (i = node->name_hash & mask; index->slots[i] != node; i = (i + 1) & mask)
     {
-        return NULL;
+        /* not found */
+        if (index->slots[i] == NULL)
+        {
+            return;
+        }
     }
 
-    /* invalid parent node name */
-    if (parent_node_name == NULL)
+    /*
+     * Backward shift deletion - move entries following the hole back into it, unless that
+     * would place them before their home slot, so that no tombstones are necessary
+     */
+    for (j = (i + 1) & mask; index->slots[j] != NULL; j = (j + 1) & mask)
     {
-        return NULL;
+        home = index->slots[j]->name_hash & mask;
+
+        if ((i <= j) ? ((home <= i) || (home > j)) : ((home <= i) && (home > j)))
+        {
+            index->slots[i] = index->slots[j];
+            i = j;
+        }
     }
 
-    node_t *parent = tree_get_node(self, parent_node_name);
+    index->slots[i] = NULL;
+    --index->num_used;
+}
 
-    /* our tree does not contain such node */
-    if (parent == NULL)
-    {
-        return NULL;
-    }
+/* leave a tombstone instead of shifting entries, for trees with lock-free readers */
+static void tree_index_delete(tree_index_t *index, node_t *node)
+{
+    unsigned int mask = index->capacity - 1;
+    unsigned int i = node->name_hash & mask;
 
-    if (tree_grow_if_needed(self) == NULL)
+    while (index->slots[i] != node)
     {
-        return NULL;
+        i = (i + 1) & mask;
     }
 
-    /* add the new node to its parent */
-    node_add_child(parent, new_node);
-
-    /* invalidate depth */
-    self->depth = -1;
-
-    /* success */
-    return tree_insert_node(self, new_node);
+    __atomic_store_n(&index->slots[i], TREE_INDEX_DELETED, __ATOMIC_RELEASE);
+    --index->num_used;
+    ++index->num_deleted;
 }
 
-static void tree_remove_conflicts(tree_t *self, tree_t *other_tree)
+static void tree_index_forget(tree_t *self, node_t *node)
 {
-    int i = 0;
-
-    tree_remove_node(other_tree, self->root->object_name);
-
-    for (; i < self->num_nodes; ++i)
+    if (self->epoch != NULL)
+    {
+        tree_index_delete(self->index, node);
+    }
+    else
     {
-        tree_remove_node(other_tree, self->nodes[i]->object_name);
+        tree_index_remove(self->index, node);
     }
 }
 
-node_t *tree_add_tree(tree_t *self, tree_t *sub_tree, const char *parent_node_name)
+/*
+ * Make sure the index can hold num_nodes while staying at most half full, tombstones included.
+ * A new index is published and the old one is freed via tree_free_table().
+ */
+static tree_index_t *tree_index_reserve(tree_t *self, int num_nodes)
 {
-    node_t *parent = NULL;
-    node_t *sub_tree_root = NULL;
     int i = 0;
+    int capacity = TREE_INDEX_MIN_CAPACITY;
+    tree_index_t *index = NULL;
+    node_t *node = NULL;
 
-    /* invalid inputs */
-    if ((self == NULL) || (sub_tree == NULL) || (sub_tree->root == NULL))
-    {
-        return NULL;
-    }
-
-    /* our tree is empty - steal everything */
-    if (self->root == NULL)
+    if ((self->index != NULL) && (num_nodes + self->index->num_deleted <= self->index->capacity / 2))
     {
-        memcpy(self, sub_tree, sizeof(tree_t));
-        memset(sub_tree, 0, sizeof(tree_t));
-        return self->root;
+        return self->index;
     }
 
-    /* only allowed if our tree is empty */
-    if (parent_node_name == NULL)
+    /* buried nodes stay, see tree_bury() */
+    while (capacity / 2 < num_nodes + self->num_buried)
     {
-        return NULL;
+        capacity *= 2;
     }
 
-    parent = tree_get_node(self, parent_node_name);
+    index = tree_index_create(self, capacity);
 
-    /* no such node exists */
-    if (parent == NULL)
+    /* failed to allocate memory */
+    if (index == NULL)
     {
         return NULL;
     }
 
-    /* sub tree root name is in conflict with one of our nodes */
-    if (tree_get_node(self, sub_tree->root->object_name) != NULL)
+    if (self->index != NULL)
     {
-        return NULL;
-    }
-
-    /* Remove conflicts from sub tree */
-    tree_remove_conflicts(self, sub_tree);
+        for (; i < self->index->capacity; ++i)
+        {
+            node = self->index->slots[i];
 
-    /* steal root from sub_tree */
-    sub_tree_root = tree_add_node(self, sub_tree->root, parent->object_name);
+            if ((node != NULL) && (node != TREE_INDEX_DELETED))
+            {
+                tree_index_put(index, node);
 
-    /* steal all other nodes from sub tree */
-    for (i = 0; i < sub_tree->num_nodes; ++i)
-    {
-        if (tree_grow_if_needed(self) == NULL)
-        {
-            return NULL;
+                if (node->removed_in != 0)
+                {
+                    --index->num_used;
+                    ++index->num_deleted;
+                }
+            }
         }
 
-        tree_insert_node(self, sub_tree->nodes[i]);
+        tree_free_table(self, self->allocator, self->index);
     }
 
-    /* clear sub tree */
-    memset(sub_tree, 0, sizeof(tree_t));
+    __atomic_store_n(&self->index, index, __ATOMIC_RELEASE);
+    return index;
+}
 
-    /* invalidate depth */
-    self->depth = -1;
+/* keep a removed node in the index for snapshots which can see it, see tree_collect_garbage() */
+static void tree_bury(tree_t *self, node_t *node)
+{
+    __atomic_store_n(&node->removed_in, self->version, __ATOMIC_RELEASE);
+    --self->index->num_used;
+    ++self->index->num_deleted;
+    ++self->num_buried;
+}
 
-    /* done */
-    return sub_tree_root;
+/* roots are not in the index, snapshots have their own pointer */
+static void tree_bury_root(tree_t *self, node_t *root)
+{
+    __atomic_store_n(&root->removed_in, self->version, __ATOMIC_RELEASE);
+    root->parent = self->buried_roots;
+    self->buried_roots = root;
 }
 
-int tree_remove_node(tree_t *self, const char *node_name)
+/* dispose of removed nodes which were kept for snapshots, once there are no snapshots */
+static void tree_collect_garbage(tree_t *self)
 {
-    int i = 0;
-    int pos = 0;
     node_t *node = NULL;
+    int i = 0;
 
-    /* invalid inputs or empty tree */
-    if ((self == NULL) || (node_name == NULL) || (self->root == NULL))
+    if (((self->num_buried == 0) && (self->buried_roots == NULL)) || tree_has_snapshots(self))
     {
-        return 0;
+        return;
     }
 
-    if (strcmp(self->root->object_name, node_name) == 0)
+    for (; (self->num_buried > 0) && (i < self->index->capacity); ++i)
     {
-        /* cannot remove root if it has children */
-        if (self->root->num_children > 0)
-        {
-            return 0;
-        }
-        else
+        node = self->index->slots[i];
+
+        if ((node != NULL) && (node != TREE_INDEX_DELETED) && (node->removed_in != 0))
         {
-            tree_clear(self);
-            return 1;
+            __atomic_store_n(&self->index->slots[i], TREE_INDEX_DELETED, __ATOMIC_RELEASE);
+            tree_dispose_node(self, node);
+            --self->num_buried;
         }
     }
 
-    pos = tree_find_node_pos(self, node_name);
-
-    /* not found */
-    if (pos == -1)
+    while (self->buried_roots != NULL)
     {
-        return 0;
+        node = self->buried_roots;
+        self->buried_roots = node->parent;
+        tree_dispose_node(self, node);
     }
+}
 
-    node = self->nodes[pos];
-
-    /* attach children of removed node to its parent */
-    for (i = 0; i < node->num_children; ++i)
+/* remove a node from the index and dispose of it, or bury it if snapshots can see it */
+static void tree_discard_node(tree_t *self, node_t *node)
+{
+    if (tree_has_snapshots(self))
     {
-        node_add_child(node->parent, node->children[i]);
+        tree_bury(self, node);
     }
-
-    /*
-     * memmove bug - cannot shift left
-     * https://github.com/fingolfin/memmove-bug/blob/master/glibc-memcpy.patch
-     */
-    for (i = pos; i < self->num_nodes; ++i)
+    else
     {
-        self->nodes[i] = self->nodes[i + 1];
+        tree_index_forget(self, node);
+        tree_dispose_node(self, node);
     }
+}
 
-    /* remove the node from its parent's children and dispose of it */
-    node_remove_child(node->parent, node->object_name);
-    --self->num_nodes;
+/* move buried nodes of the old index of self to the index of a tree which replaces it */
+static void tree_index_adopt_buried(tree_index_t *index, tree_index_t *old_index)
+{
+    node_t *node = NULL;
+    int i = 0;
 
-    /* invalidate depth */
-    self->depth = -1;
+    for (; (old_index != NULL) && (i < old_index->capacity); ++i)
+    {
+        node = old_index->slots[i];
 
-    return 1;
+        if ((node != NULL) && (node != TREE_INDEX_DELETED) && (node->removed_in != 0))
+        {
+            tree_index_put(index, node);
+            --index->num_used;
+            ++index->num_deleted;
+        }
+    }
 }
 
-static int tree_mark_for_squeeze(tree_t *self, node_t *node)
+void tree_clear(tree_t *self)
 {
+    tree_t empty;
+    node_t *root = NULL;
+    node_t **nodes = NULL;
+    int num_nodes = 0;
+    tree_index_t *index = NULL;
+    int keep = 0;
     int i = 0;
-    int removed_cnt = 0;
 
-    for (; i < node->num_children; ++i)
+    if (self == NULL)
     {
-        removed_cnt += tree_mark_for_squeeze(self, node->children[i]);
+        return;
     }
 
-    self->nodes[tree_find_node_pos(self, node->object_name)] = NULL;
-    node_dispose(node);
-    ++removed_cnt;
+    /* snapshots keep all the nodes, and the index to find them */
+    keep = tree_has_snapshots(self);
 
-    return removed_cnt;
-}
+    if (!keep)
+    {
+        tree_collect_garbage(self);
+    }
 
-static void remove_child_from_list(node_t *parent, node_t *child)
-{
-    int i = 0;
-    int j = 0;
-    /* find it */
-    for (; i < parent->num_children; ++i)
+    root = self->root;
+    nodes = self->nodes;
+    num_nodes = self->num_nodes;
+    index = self->index;
+    tree_free(self->allocator, self->pre_order);
+    tree_free(self->allocator, self->jumps);
+    tree_iter_clear(&self->scratch);
+
+    /* unpublish first */
+    tree_init(&empty);
+    empty.epoch = self->epoch;
+    empty.allocator = self->allocator;
+    empty.version = self->version;
+    empty.num_buried = self->num_buried;
+    empty.buried_roots = self->buried_roots;
+    empty.journal = self->journal;
+    empty.index = keep ? index : NULL;
+    tree_assign(self, &empty);
+
+    if ((root != NULL) && keep)
+    {
+        tree_bury_root(self, root);
+    }
+    else if (root != NULL)
+    {
+        tree_dispose_node(self, root);
+    }
+
+    for (; i < num_nodes; ++i)
     {
-        if (strcmp(parent->children[i]->object_name, child->object_name) == 0)
+        if (keep)
         {
-            break;
+            tree_bury(self, nodes[i]);
+        }
+        else
+        {
+            tree_dispose_node(self, nodes[i]);
         }
     }
 
-    /*
-     * memmove bug - cannot shift left
-     * https://github.com/fingolfin/memmove-bug/blob/master/glibc-memcpy.patch
-     */
-    for (j = i; j < parent->num_children; ++j)
+    tree_free(self->allocator, nodes);
+
+    if (!keep)
     {
-        parent->children[j] = parent->children[j + 1];
+        tree_free_table(self, self->allocator, index);
     }
-
-    --parent->num_children;
 }
 
-static void tree_squeeze(tree_t *self)
+static int tree_find_closest_larger(tree_t *self, const char *node_name)
+{
+    int low = 0;
+    int high = self->num_nodes;
+    int middle = 0;
+
+    while (low < high)
+    {
+        middle = low + (high - low) / 2;
+
+        if (strcmp(node_name, self->nodes[middle]->object_name) < 0)
+        {
+            high = middle;
+        }
+        else
+        {
+            low = middle + 1;
+        }
+    }
+
+    /* num_nodes if not found */
+    return low;
+}
+
+static int tree_bsearch_node_pos(tree_t *self, const char *node_name)
+{
+    int low = 0;
+    int high = self->num_nodes - 1;
+    int middle = 0;
+    int cmp_result = 0;
+
+    while (low <= high)
+    {
+        middle = low + (high - low) / 2;
+        cmp_result = strcmp(node_name, self->nodes[middle]->object_name);
+
+        if (cmp_result == 0)
+        {
+            return middle;
+        }
+
+        if (cmp_result < 0)
+        {
+            high = middle - 1;
+        }
+        else
+        {
+            low = middle + 1;
+        }
+    }
+
+    /* not found */
+    return -1;
+}
+
+node_t *tree_get_node(tree_t *self, const char *node_name)
+{
+    node_t *root = NULL;
+    unsigned int hash = 0;
+
+    TREE_DUMP(self);
+
+    if ((self == NULL) || (node_name == NULL) || (strlen(node_name) == 0))
+    {
+        return NULL;
+    }
+
+    /* the index is published before the root, see tree_assign() */
+    root = __atomic_load_n(&self->root, __ATOMIC_ACQUIRE);
+
+    if (root == NULL)
+    {
+        return NULL;
+    }
+
+    hash = node_name_hash(node_name);
+
+    if (node_has_name(root, node_name, hash))
+    {
+        return root;
+    }
+
+    return tree_index_find(__atomic_load_n(&self->index, __ATOMIC_ACQUIRE), node_name, hash);
+}
+
+static node_t *tree_insert_node(tree_t *self, node_t *new_node)
+{
+    /* find where the new node should be in the nodes table */
+    int pos = tree_find_closest_larger(self, new_node->object_name);
+
+    memmove(&self->nodes[pos + 1], &self->nodes[pos], (self->num_nodes - pos) * sizeof(node_t *));
+    ++self->num_nodes;
+
+    /* insert the new node */
+    self->nodes[pos] = new_node;
+    tree_index_put(self->index, new_node);
+
+    TREE_DUMP(self);
+
+    /* success */
+    return new_node;
+}
+
+static int tree_round_up_capacity(int num_nodes)
+{
+    return (num_nodes + TREE_REALLOC_INCREMENT - 1) / TREE_REALLOC_INCREMENT * TREE_REALLOC_INCREMENT;
+}
+
+static node_t **tree_grow_if_needed(tree_t *self)
+{
+    TREE_DUMP(self);
+
+    if (tree_index_reserve(self, self->num_nodes + 1) == NULL)
+    {
+        return NULL;
+    }
+
+    if (self->num_nodes < self->capacity)
+    {
+        return self->nodes;
+    }
+
+    /* nodes table is too small - it needs to grow */
+    node_t **new_nodes = tree_realloc(self->allocator, self->nodes, (self->capacity + TREE_REALLOC_INCREMENT) * sizeof(node_t *));
+
+    /* failed to reallocate memory */
+    if (new_nodes == NULL)
+    {
+        return NULL;
+    }
+
+    self->nodes = new_nodes;
+    self->capacity += TREE_REALLOC_INCREMENT;
+    return self->nodes;
+}
+
+/* same order as node_add_child() keeps: by value, then by object_name */
+static int tree_compare_siblings(const void *a, const void *b)
+{
+    node_t *node_a = *(node_t * const *)a;
+    node_t *node_b = *(node_t * const *)b;
+    int cmp_result = node_a->value_handlers->compare_fun(node_a->value, node_b->value);
+
+    if (cmp_result == 0)
+    {
+        cmp_result = strcmp(node_a->object_name, node_b->object_name);
+    }
+
+    return cmp_result;
+}
+
+/* lock-free readers need NULL terminated children tables, see tree_node_children() */
+static int tree_terminate_children(node_t *node)
+{
+    /* no table yet */
+    if (node->capacity == 0)
+    {
+        return 1;
+    }
+
+    /* failed to reallocate memory */
+    if (!node_reserve_children(node, node->num_children + 1))
+    {
+        return 0;
+    }
+
+    node->children[node->num_children] = NULL;
+    return 1;
+}
+
+static int tree_terminate_all_children(tree_t *self)
+{
+    int i = 0;
+
+    if ((self->root != NULL) && !tree_terminate_children(self->root))
+    {
+        return 0;
+    }
+
+    for (; i < self->num_nodes; ++i)
+    {
+        if (!tree_terminate_children(self->nodes[i]))
+        {
+            return 0;
+        }
+    }
+
+    return 1;
+}
+
+/* drop the history of a node once no snapshot can need it */
+static void tree_forget_history(tree_t *self, node_t *node)
+{
+    struct node_history_s *entry = node->history;
+    struct node_history_s *older = NULL;
+
+    __atomic_store_n(&node->history, NULL, __ATOMIC_RELEASE);
+
+    for (; entry != NULL; entry = older)
+    {
+        older = entry->older;
+
+        if ((entry->children != node->children) && (entry->children != node->inline_children))
+        {
+            tree_free_table(self, node->allocator, entry->children);
+        }
+
+        tree_free_table(self, node->allocator, entry);
+    }
+}
+
+/* the inline table goes with the node, published tables are never inline, see node_reserve_children() */
+static void tree_free_children(tree_t *self, node_t *node)
+{
+    if (node->children != node->inline_children)
+    {
+        tree_free_table(self, node->allocator, node->children);
+    }
+}
+
+static struct node_history_s *tree_history_create(
+    tree_allocator_t *allocator,
+    unsigned int since,
+    node_t **children,
+    struct node_history_s *older)
+{
+    struct node_history_s *entry = tree_malloc(allocator, sizeof(struct node_history_s));
+
+    if (entry == NULL)
+    {
+        return NULL;
+    }
+
+    entry->since = since;
+    entry->children = children;
+    entry->older = older;
+
+    return entry;
+}
+
+/* a new children table and the history entries to remember the old one, see tree_prepare_publish() */
+typedef struct
+{
+    node_t **children;
+    int num_children;
+    int has_snapshots; /* snapshots are taken by the writer only, but any thread releases them */
+    struct node_history_s *base;
+    struct node_history_s *entry;
+} tree_publish_t;
+
+/*
+ * Allocate the history entries tree_record_children() needs for node, so that replacing its
+ * children table cannot fail later on
+ */
+static int tree_prepare_record(tree_t *self, node_t *node, tree_publish_t *publish)
+{
+    struct node_history_s *history = node->history;
+
+    publish->has_snapshots = tree_has_snapshots(self);
+    publish->base = NULL;
+    publish->entry = NULL;
+
+    /* no snapshot can see the current table, or it is replaced again before the next snapshot */
+    if (!publish->has_snapshots || ((history != NULL) && (history->since == self->version)))
+    {
+        return 1;
+    }
+
+    /* the current table has been there since before any snapshot */
+    if (history == NULL)
+    {
+        publish->base = tree_history_create(node->allocator, 0, node->children, NULL);
+
+        if (publish->base == NULL)
+        {
+            return 0;
+        }
+
+        history = publish->base;
+    }
+
+    publish->entry = tree_history_create(node->allocator, self->version, NULL, history);
+
+    if (publish->entry == NULL)
+    {
+        tree_free(node->allocator, publish->base);
+        publish->base = NULL;
+        return 0;
+    }
+
+    return 1;
+}
+
+/*
+ * Remember the children table of node which is about to be replaced by children, if snapshots
+ * can see it, or free it once lock-free readers are done with it
+ */
+static void tree_record_children(tree_t *self, node_t *node, node_t **children, tree_publish_t *publish)
+{
+    /* as seen by tree_prepare_record(), what it allocated is used even if the snapshots are gone */
+    if (!publish->has_snapshots)
+    {
+        tree_forget_history(self, node);
+        tree_free_children(self, node);
+        return;
+    }
+
+    /* replaced again before the next snapshot, no snapshot can see the current table */
+    if (publish->entry == NULL)
+    {
+        __atomic_store_n(&node->history->children, children, __ATOMIC_RELEASE);
+        tree_free_children(self, node);
+        return;
+    }
+
+    /* snapshot readers see the history before the new table, see tree_snapshot_children() */
+    publish->entry->children = children;
+    __atomic_store_n(&node->history, publish->entry, __ATOMIC_RELEASE);
+}
+
+/* allocate what tree_finish_publish() needs to give parent num_children children */
+static int tree_prepare_publish(tree_t *self, node_t *parent, int num_children, tree_publish_t *publish)
+{
+    publish->children = NULL;
+    publish->num_children = num_children;
+
+    if (num_children > 0)
+    {
+        publish->children = tree_malloc(parent->allocator, (num_children + 1) * sizeof(node_t *));
+
+        /* failed to allocate memory */
+        if (publish->children == NULL)
+        {
+            return 0;
+        }
+    }
+
+    if (!tree_prepare_record(self, parent, publish))
+    {
+        tree_free(parent->allocator, publish->children);
+        return 0;
+    }
+
+    return 1;
+}
+
+/*
+ * Replace children of parent with the new table, which lacks removed and has added merged in,
+ * in one pass. Added have to be in sibling order. Lock-free readers see either table whole.
+ */
+static void tree_finish_publish(
+    tree_t *self,
+    node_t *parent,
+    node_t *removed,
+    node_t **added,
+    int num_added,
+    tree_publish_t *publish)
+{
+    node_t **old_children = parent->children;
+    node_t **children = publish->children;
+    int num_children = publish->num_children;
+    int num_merged = 0;
+    int i = 0;
+    int j = 0;
+
+    if (num_children > 0)
+    {
+        while (num_merged < num_children)
+        {
+            if ((i < parent->num_children) && (old_children[i] == removed))
+            {
+                ++i;
+            }
+            else if ((j == num_added) ||
+                     ((i < parent->num_children) &&
+                      (tree_compare_siblings(&old_children[i], &added[j]) < 0)))
+            {
+                children[num_merged++] = old_children[i++];
+            }
+            else
+            {
+                added[j]->parent = parent;
+                children[num_merged++] = added[j++];
+            }
+        }
+
+        children[num_children] = NULL;
+    }
+
+    tree_record_children(self, parent, children, publish);
+    __atomic_store_n(&parent->children, children, __ATOMIC_RELEASE);
+
+    parent->num_children = num_children;
+    parent->capacity = (num_children > 0) ? num_children + 1 : 0;
+    node_update_height(parent);
+}
+
+/* tree_prepare_publish() and tree_finish_publish() in one go */
+static int tree_publish_children(
+    tree_t *self,
+    node_t *parent,
+    node_t *removed,
+    node_t **added,
+    int num_added)
+{
+    int num_children = parent->num_children - ((removed != NULL) ? 1 : 0) + num_added;
+    tree_publish_t publish;
+
+    if (!tree_prepare_publish(self, parent, num_children, &publish))
+    {
+        return 0;
+    }
+
+    tree_finish_publish(self, parent, removed, added, num_added, &publish);
+    return 1;
+}
+
+int tree_set_epoch(tree_t *self, epoch_t *epoch)
+{
+    if (self == NULL)
+    {
+        return 0;
+    }
+
+    if ((epoch != NULL) && !tree_terminate_all_children(self))
+    {
+        return 0;
+    }
+
+    self->epoch = epoch;
+    return 1;
+}
+
+int tree_set_journal(tree_t *self, tree_journal_t *journal)
+{
+    if (self == NULL)
+    {
+        return 0;
+    }
+
+    self->journal = journal;
+    return 1;
+}
+
+node_t **tree_node_children(node_t *node)
+{
+    if (node == NULL)
+    {
+        return NULL;
+    }
+
+    return __atomic_load_n(&node->children, __ATOMIC_ACQUIRE);
+}
+
+node_t *tree_add_node(tree_t *self, node_t *new_node, const char *parent_node_name)
+{
+    TREE_DUMP(self);
+
+    /* invalid tree or invalid node */
+    if ((self == NULL) || (new_node == NULL))
+    {
+        return NULL;
+    }
+
+    /* lock-free readers may see it as soon as it is linked */
+    if ((self->epoch != NULL) && !tree_terminate_children(new_node))
+    {
+        return NULL;
+    }
+
+    tree_collect_garbage(self);
+    new_node->added_in = self->version;
+
+    /* our tree is empty */
+    if (self->root == NULL)
+    {
+        __atomic_store_n(&self->root, new_node, __ATOMIC_RELEASE);
+        tree_journal_record_add_node(self->journal, new_node, NULL);
+        TREE_DUMP(self);
+        return new_node;
+    }
+
+    /* our tree already contains a node with such name */
+    if (tree_get_node(self, new_node->object_name) != NULL)
+    {
+        return NULL;
+    }
+
+    /* invalid parent node name */
+    if (parent_node_name == NULL)
+    {
+        return NULL;
+    }
+
+    node_t *parent = tree_get_node(self, parent_node_name);
+
+    /* our tree does not contain such node */
+    if (parent == NULL)
+    {
+        return NULL;
+    }
+
+    if (tree_grow_if_needed(self) == NULL)
+    {
+        return NULL;
+    }
+
+    /* add the new node to its parent */
+    if (self->epoch != NULL)
+    {
+        if (!tree_publish_children(self, parent, NULL, &new_node, 1))
+        {
+            return NULL;
+        }
+    }
+    else
+    {
+        node_add_child(parent, new_node);
+    }
+
+    tree_invalidate_labels(self);
+    tree_insert_node(self, new_node);
+    tree_journal_record_add_node(self->journal, new_node, parent_node_name);
+
+    /* success */
+    return new_node;
+}
+
+static int tree_compare_names(const void *a, const void *b)
+{
+    return strcmp((*(node_t * const *)a)->object_name, (*(node_t * const *)b)->object_name);
+}
+
+int tree_add_nodes(tree_t *self, node_t **nodes, const char **parent_names, int num_nodes)
+{
+    node_t **added = NULL;
+    node_t **grown = NULL;
+    node_t *parent = NULL;
+    int num_added = 0;
+    int first = 0;
+    int capacity = 0;
+    int i = 0;
+    int j = 0;
+    int k = 0;
+
+    TREE_DUMP(self);
+
+    if ((self == NULL) || (nodes == NULL) || (parent_names == NULL) || (num_nodes < 1))
+    {
+        return 0;
+    }
+
+    /* the first node of an empty tree becomes its root */
+    if (self->root == NULL)
+    {
+        if (tree_add_node(self, nodes[0], parent_names[0]) == NULL)
+        {
+            return 0;
+        }
+
+        first = 1;
+    }
+
+    tree_collect_garbage(self);
+
+    /* room for all of them, the nodes table is merged with the new nodes only once */
+    capacity = tree_round_up_capacity(self->num_nodes + num_nodes - first);
+    added = tree_malloc(self->allocator, (num_nodes - first + 1) * sizeof(node_t *));
+
+    if ((added == NULL) || (tree_index_reserve(self, self->num_nodes + num_nodes - first) == NULL))
+    {
+        tree_free(self->allocator, added);
+        return first;
+    }
+
+    if (capacity > self->capacity)
+    {
+        grown = tree_realloc(self->allocator, self->nodes, capacity * sizeof(node_t *));
+
+        if (grown == NULL)
+        {
+            tree_free(self->allocator, added);
+            return first;
+        }
+
+        self->nodes = grown;
+        self->capacity = capacity;
+    }
+
+    for (i = first; i < num_nodes; ++i)
+    {
+        /* same checks as tree_add_node(), the nodes added so far are in the index already */
+        if ((nodes[i] == NULL) || (tree_get_node(self, nodes[i]->object_name) != NULL))
+        {
+            continue;
+        }
+
+        parent = tree_get_node(self, parent_names[i]);
+
+        if ((parent == NULL) || ((self->epoch != NULL) && !tree_terminate_children(nodes[i])))
+        {
+            continue;
+        }
+
+        if (self->epoch != NULL)
+        {
+            if (!tree_publish_children(self, parent, NULL, &nodes[i], 1))
+            {
+                continue;
+            }
+        }
+        else if (node_add_child(parent, nodes[i]) == NULL)
+        {
+            continue;
+        }
+
+        nodes[i]->added_in = self->version;
+        tree_index_put(self->index, nodes[i]);
+        added[num_added++] = nodes[i];
+        tree_journal_record_add_node(self->journal, nodes[i], parent_names[i]);
+    }
+
+    qsort(added, num_added, sizeof(node_t *), tree_compare_names);
+
+    /* merge from the back, names are unique so there are no ties */
+    j = self->num_nodes - 1;
+    k = self->num_nodes + num_added - 1;
+
+    for (i = num_added - 1; i >= 0; --k)
+    {
+        if ((j >= 0) && (strcmp(self->nodes[j]->object_name, added[i]->object_name) > 0))
+        {
+            self->nodes[k] = self->nodes[j--];
+        }
+        else
+        {
+            self->nodes[k] = added[i--];
+        }
+    }
+
+    self->num_nodes += num_added;
+    tree_free(self->allocator, added);
+
+    if (num_added > 0)
+    {
+        tree_invalidate_labels(self);
+    }
+
+    TREE_DUMP(self);
+
+    return first + num_added;
+}
+
+typedef struct
+{
+    node_t *node;
+    int pos; /* position in the input of tree_build() */
+} tree_build_entry_t;
+
+static tree_build_result_t tree_build_error(tree_build_result_t result, int pos, int *error_pos)
+{
+    if (error_pos != NULL)
+    {
+        *error_pos = pos;
+    }
+
+    return result;
+}
+
+static int tree_build_compare_entries(const void *a, const void *b)
+{
+    const tree_build_entry_t *entry_a = a;
+    const tree_build_entry_t *entry_b = b;
+    int cmp_result = strcmp(entry_a->node->object_name, entry_b->node->object_name);
+
+    /* duplicates keep their input order, so that the later one is reported */
+    if (cmp_result == 0)
+    {
+        cmp_result = (entry_a->pos > entry_b->pos) - (entry_a->pos < entry_b->pos);
+    }
+
+    return cmp_result;
+}
+
+/* fill nodes of the built tree with all the input nodes except the root, sorted by object_name */
+static tree_build_result_t tree_build_sort(
+    tree_t *built,
+    node_t **nodes,
+    const char **parent_names,
+    int num_nodes,
+    int *error_pos)
+{
+    tree_build_entry_t *entries = NULL;
+    int num_entries = 0;
+    int duplicate_pos = 0;
+    int i = 0;
+
+    /* root only */
+    if (num_nodes == 1)
+    {
+        return TREE_BUILD_OK;
+    }
+
+    entries = tree_malloc(built->allocator, (num_nodes - 1) * sizeof(tree_build_entry_t));
+    built->nodes = tree_malloc(built->allocator, (num_nodes - 1) * sizeof(node_t *));
+
+    if ((entries == NULL) || (built->nodes == NULL))
+    {
+        tree_free(built->allocator, entries);
+        return TREE_BUILD_NO_MEMORY;
+    }
+
+    for (; i < num_nodes; ++i)
+    {
+        if (parent_names[i] != NULL)
+        {
+            entries[num_entries].node = nodes[i];
+            entries[num_entries].pos = i;
+            ++num_entries;
+        }
+    }
+
+    qsort(entries, num_entries, sizeof(tree_build_entry_t), tree_build_compare_entries);
+
+    for (i = 0; i < num_entries; ++i)
+    {
+        if ((i > 0) && node_has_name(entries[i - 1].node, entries[i].node->object_name, entries[i].node->name_hash))
+        {
+            duplicate_pos = entries[i].pos;
+            tree_free(built->allocator, entries);
+            return tree_build_error(TREE_BUILD_DUPLICATE, duplicate_pos, error_pos);
+        }
+
+        built->nodes[i] = entries[i].node;
+    }
+
+    built->num_nodes = num_entries;
+    built->capacity = num_entries;
+
+    tree_free(built->allocator, entries);
+    return TREE_BUILD_OK;
+}
+
+static tree_build_result_t tree_build_index(tree_t *built, node_t *root, int root_pos, int *error_pos)
+{
+    int i = 0;
+
+    if (tree_index_reserve(built, built->num_nodes) == NULL)
+    {
+        return TREE_BUILD_NO_MEMORY;
+    }
+
+    for (; i < built->num_nodes; ++i)
+    {
+        tree_index_put(built->index, built->nodes[i]);
+    }
+
+    if (tree_index_find(built->index, root->object_name, root->name_hash) != NULL)
+    {
+        return tree_build_error(TREE_BUILD_DUPLICATE, root_pos, error_pos);
+    }
+
+    return TREE_BUILD_OK;
+}
+
+static void tree_build_unlink(node_t **nodes, int num_nodes)
+{
+    int i = 0;
+
+    for (; i < num_nodes; ++i)
+    {
+        nodes[i]->parent = NULL;
+        nodes[i]->num_children = 0;
+        nodes[i]->height = 1;
+    }
+}
+
+/* attach every node to its parent, uses num_children as a counter before children are added */
+static tree_build_result_t tree_build_link(
+    tree_t *built,
+    node_t *root,
+    node_t **nodes,
+    const char **parent_names,
+    int num_nodes,
+    int *error_pos)
+{
+    node_t **parents = tree_malloc(built->allocator, num_nodes * sizeof(node_t *));
+    node_t **queue = parents;
+    node_t *node = NULL;
+    int terminator = (built->epoch != NULL) ? 1 : 0; /* see tree_node_children() */
+    int num_reached = 0;
+    int i = 0;
+    int j = 0;
+    unsigned int hash = 0;
+
+    if (parents == NULL)
+    {
+        return TREE_BUILD_NO_MEMORY;
+    }
+
+    /* resolve parents */
+    for (; i < num_nodes; ++i)
+    {
+        parents[i] = NULL;
+
+        if (parent_names[i] == NULL)
+        {
+            continue;
+        }
+
+        hash = node_name_hash(parent_names[i]);
+
+        if (node_has_name(root, parent_names[i], hash))
+        {
+            parents[i] = root;
+        }
+        else
+        {
+            parents[i] = tree_index_find(built->index, parent_names[i], hash);
+        }
+
+        if (parents[i] == NULL)
+        {
+            tree_free(built->allocator, parents);
+            return tree_build_error(TREE_BUILD_ORPHAN, i, error_pos);
+        }
+    }
+
+    /* count children of every parent */
+    for (i = 0; i < num_nodes; ++i)
+    {
+        if (parents[i] != NULL)
+        {
+            ++parents[i]->num_children;
+        }
+    }
+
+    /* allocate children tables of the exact size */
+    for (i = 0; i < num_nodes; ++i)
+    {
+        node = nodes[i];
+
+        /* failed to allocate memory */
+        if ((node->num_children > 0) && !node_reserve_children(node, node->num_children + terminator))
+        {
+            tree_build_unlink(nodes, num_nodes);
+            tree_free(built->allocator, parents);
+            return TREE_BUILD_NO_MEMORY;
+        }
+
+        node->num_children = 0;
+        node->height = 1;
+    }
+
+    /* attach children, then put them in order */
+    for (i = 0; i < num_nodes; ++i)
+    {
+        if (parents[i] != NULL)
+        {
+            parents[i]->children[parents[i]->num_children++] = nodes[i];
+            nodes[i]->parent = parents[i];
+        }
+    }
+
+    for (i = 0; i < num_nodes; ++i)
+    {
+        if (nodes[i]->num_children > 1)
+        {
+            qsort(nodes[i]->children, nodes[i]->num_children, sizeof(node_t *), tree_compare_siblings);
+        }
+
+        if (terminator && (nodes[i]->capacity > 0))
+        {
+            nodes[i]->children[nodes[i]->num_children] = NULL;
+        }
+    }
+
+    /*
+     * Parents are no longer needed, reuse the table as a queue to visit nodes in level order,
+     * nodes which are not reached are in cycles
+     */
+    queue[num_reached++] = root;
+
+    for (i = 0; i < num_reached; ++i)
+    {
+        node = queue[i];
+
+        for (j = 0; j < node->num_children; ++j)
+        {
+            queue[num_reached++] = node->children[j];
+        }
+    }
+
+    if (num_reached != num_nodes)
+    {
+        tree_free(built->allocator, parents);
+        tree_build_unlink(nodes, num_nodes);
+        return tree_build_error(TREE_BUILD_CYCLE, -1, error_pos);
+    }
+
+    /* children come after their parents in the queue */
+    for (i = num_reached - 1; i > 0; --i)
+    {
+        node = queue[i];
+
+        if (node->parent->height <= node->height)
+        {
+            node->parent->height = node->height + 1;
+        }
+    }
+
+    tree_free(built->allocator, parents);
+    return TREE_BUILD_OK;
+}
+
+tree_build_result_t tree_build(
+    tree_t *self,
+    node_t **nodes,
+    const char **parent_names,
+    int num_nodes,
+    int *error_pos)
+{
+    tree_t built;
+    tree_build_result_t result = TREE_BUILD_OK;
+    tree_index_t *old_index = NULL;
+    node_t *root = NULL;
+    int root_pos = -1;
+    int i = 0;
+
+    TREE_DUMP(self);
+
+    tree_build_error(TREE_BUILD_OK, -1, error_pos);
+
+    if ((self == NULL) || (nodes == NULL) || (parent_names == NULL) || (num_nodes < 1) ||
+        (self->root != NULL))
+    {
+        return TREE_BUILD_INVALID_ARGUMENT;
+    }
+
+    /* find the root, make sure no node is already a part of some tree */
+    for (; i < num_nodes; ++i)
+    {
+        if ((nodes[i] == NULL) || (nodes[i]->parent != NULL) || (nodes[i]->num_children > 0))
+        {
+            return tree_build_error(TREE_BUILD_INVALID_ARGUMENT, i, error_pos);
+        }
+
+        if (parent_names[i] == NULL)
+        {
+            if (root != NULL)
+            {
+                return tree_build_error(TREE_BUILD_MULTIPLE_ROOTS, i, error_pos);
+            }
+
+            root = nodes[i];
+            root_pos = i;
+        }
+    }
+
+    if (root == NULL)
+    {
+        return TREE_BUILD_NO_ROOT;
+    }
+
+    tree_collect_garbage(self);
+
+    /* nodes kept for snapshots move to the new index */
+    tree_init(&built);
+    built.epoch = self->epoch;
+    built.allocator = self->allocator;
+    built.version = self->version;
+    built.num_buried = self->num_buried;
+    built.buried_roots = self->buried_roots;
+    built.journal = self->journal;
+
+    result = tree_build_sort(&built, nodes, parent_names, num_nodes, error_pos);
+
+    if (result == TREE_BUILD_OK)
+    {
+        result = tree_build_index(&built, root, root_pos, error_pos);
+    }
+
+    if (result == TREE_BUILD_OK)
+    {
+        result = tree_build_link(&built, root, nodes, parent_names, num_nodes, error_pos);
+    }
+
+    if (result != TREE_BUILD_OK)
+    {
+        tree_free(self->allocator, built.nodes);
+        tree_free(self->allocator, built.index);
+        return result;
+    }
+
+    for (i = 0; i < num_nodes; ++i)
+    {
+        nodes[i]->added_in = built.version;
+    }
+
+    tree_index_adopt_buried(built.index, self->index);
+    old_index = self->index;
+    built.root = root;
+    tree_iter_clear(&self->scratch);
+    tree_assign(self, &built);
+    tree_free_table(self, self->allocator, old_index);
+
+    TREE_DUMP(self);
+
+    return TREE_BUILD_OK;
+}
+
+/*
+ * Children of node go to its parent, then it is disposed of. Both lists are in sibling order, so
+ * they are merged from the back into the table of the parent, which has to hold them all already,
+ * see tree_remove_node() and tree_reserve_conflicts().
+ */
+static void tree_unlink_node(node_t *node)
+{
+    node_t *parent = node->parent;
+    int num_children = parent->num_children - 1 + node->num_children;
+    int i = 0;
+    int j = 0;
+    int k = 0;
+
+    while (parent->children[i] != node)
+    {
+        ++i;
+    }
+
+    /*
+     * memmove bug - cannot shift left
+     * https://github.com/fingolfin/memmove-bug/blob/master/glibc-memcpy.patch
+     */
+    for (; i < parent->num_children - 1; ++i)
+    {
+        parent->children[i] = parent->children[i + 1];
+    }
+
+    /* the free slots are at the back, nothing is overwritten before it is moved */
+    i = parent->num_children - 2;
+    j = node->num_children - 1;
+
+    for (k = num_children - 1; j >= 0; --k)
+    {
+        if ((i >= 0) && (tree_compare_siblings(&parent->children[i], &node->children[j]) > 0))
+        {
+            parent->children[k] = parent->children[i--];
+        }
+        else
+        {
+            node->children[j]->parent = parent;
+            parent->children[k] = node->children[j--];
+        }
+    }
+
+    parent->num_children = num_children;
+    node_update_height(parent);
+    node_dispose(node);
+}
+
+/* sub tree nodes in name order, with the sub tree root spliced in at root_pos */
+static node_t *tree_sub_tree_node_at(tree_t *sub_tree, int root_pos, int pos)
+{
+    if (pos < root_pos)
+    {
+        return sub_tree->nodes[pos];
+    }
+
+    if (pos == root_pos)
+    {
+        return sub_tree->root;
+    }
+
+    return sub_tree->nodes[pos - 1];
+}
+
+/*
+ * Merge nodes tables of both trees into merged in one pass, sub tree nodes are added to the hash
+ * index, sub tree nodes in conflict with nodes of self are removed as if by tree_remove_node()
+ */
+static int tree_merge_nodes(tree_t *self, tree_t *sub_tree, node_t **merged)
+{
+    int root_pos = tree_find_closest_larger(sub_tree, sub_tree->root->object_name);
+    int num_sub_nodes = sub_tree->num_nodes + 1;
+    int num_merged = 0;
+    int cmp_result = 0;
+    int i = 0;
+    int j = 0;
+    node_t *sub_node = NULL;
+
+    while (j < num_sub_nodes)
+    {
+        sub_node = tree_sub_tree_node_at(sub_tree, root_pos, j);
+        cmp_result = (i < self->num_nodes) ?
+            strcmp(self->nodes[i]->object_name, sub_node->object_name) : 1;
+
+        if (cmp_result < 0)
+        {
+            merged[num_merged++] = self->nodes[i++];
+        }
+        else if (cmp_result > 0)
+        {
+            merged[num_merged++] = sub_node;
+            sub_node->added_in = self->version;
+            tree_index_put(self->index, sub_node);
+            ++j;
+        }
+        else
+        {
+            /* conflict, our node stays */
+            tree_unlink_node(sub_node);
+            ++j;
+        }
+    }
+
+    while (i < self->num_nodes)
+    {
+        merged[num_merged++] = self->nodes[i++];
+    }
+
+    return num_merged;
+}
+
+/*
+ * Sub tree nodes in conflict with nodes of self hand their children to their parents as they go,
+ * in any order. A table never holds more than its own children and those of the conflicts in a
+ * row below it, so it is grown to that plus num_spare beforehand and dropping the conflicts, then
+ * terminating the tables for lock-free readers with a spare slot, cannot fail.
+ */
+static int tree_reserve_conflicts(tree_t *self, tree_t *sub_tree, int num_spare)
+{
+    int *handed_up = NULL;
+    int num_handed_up = 0;
+    int num_conflicts = 0;
+    int num_children = 0;
+    int reserved = 1;
+    int i = 0;
+    node_t *node = NULL;
+
+    for (; i < sub_tree->num_nodes; ++i)
+    {
+        num_conflicts += (tree_get_node(self, sub_tree->nodes[i]->object_name) != NULL);
+    }
+
+    if ((num_conflicts == 0) && (num_spare == 0))
+    {
+        return 1;
+    }
+
+    handed_up = tree_malloc(self->allocator, (sub_tree->num_nodes + 1) * sizeof(int));
+
+    if ((handed_up == NULL) || !tree_iter_start(&sub_tree->scratch, sub_tree->root, TREE_ITER_POST_ORDER))
+    {
+        tree_free(self->allocator, handed_up);
+        return 0;
+    }
+
+    /* children come right before their parent, so their counts are on top of the stack */
+    while (reserved && ((node = tree_iter_next(&sub_tree->scratch)) != NULL))
+    {
+        num_children = node->num_children;
+
+        for (i = 0; i < node->num_children; ++i)
+        {
+            num_children += handed_up[--num_handed_up];
+        }
+
+        /* a node without a table and without children to take stays without one */
+        if ((num_children > 0) || (node->capacity > 0))
+        {
+            reserved = node_reserve_children(node, num_children + num_spare);
+        }
+
+        handed_up[num_handed_up++] = (tree_get_node(self, node->object_name) != NULL) ? num_children : 0;
+    }
+
+    tree_free(self->allocator, handed_up);
+
+    return reserved;
+}
+
+/* remove sub tree nodes in conflict with nodes of self as if by tree_remove_node() */
+static void tree_remove_conflicts(tree_t *self, tree_t *sub_tree)
+{
+    int i = sub_tree->num_nodes - 1;
+
+    /* removal shifts only the nodes which were checked already */
+    for (; i >= 0; --i)
+    {
+        if (tree_get_node(self, sub_tree->nodes[i]->object_name) != NULL)
+        {
+            tree_remove_node(sub_tree, sub_tree->nodes[i]->object_name);
+        }
+    }
+}
+
+/* all nodes of the tree are added in the current version */
+static void tree_stamp_nodes(tree_t *self)
+{
+    int i = 0;
+
+    self->root->added_in = self->version;
+
+    for (; i < self->num_nodes; ++i)
+    {
+        self->nodes[i]->added_in = self->version;
+    }
+}
+
+/* move the tables of a tree to another allocator, so that another tree can steal them */
+static int tree_copy_tables(tree_t *self, tree_allocator_t *allocator)
+{
+    node_t **nodes = NULL;
+    tree_index_t *index = NULL;
+    size_t index_size = 0;
+
+    if (self->allocator == allocator)
+    {
+        return 1;
+    }
+
+    if (self->nodes != NULL)
+    {
+        nodes = tree_malloc(allocator, self->capacity * sizeof(node_t *));
+
+        if (nodes == NULL)
+        {
+            return 0;
+        }
+
+        memcpy(nodes, self->nodes, self->num_nodes * sizeof(node_t *));
+    }
+
+    if (self->index != NULL)
+    {
+        index_size = sizeof(tree_index_t) + self->index->capacity * sizeof(node_t *);
+        index = tree_malloc(allocator, index_size);
+
+        if (index == NULL)
+        {
+            tree_free(allocator, nodes);
+            return 0;
+        }
+
+        memcpy(index, self->index, index_size);
+    }
+
+    /* labels are not worth copying */
+    tree_free(self->allocator, self->nodes);
+    tree_free(self->allocator, self->index);
+    tree_free(self->allocator, self->pre_order);
+    tree_free(self->allocator, self->jumps);
+    self->nodes = nodes;
+    self->index = index;
+    self->pre_order = NULL;
+    self->jumps = NULL;
+    self->allocator = allocator;
+    tree_invalidate_labels(self);
+
+    return 1;
+}
+
+node_t *tree_add_tree(tree_t *self, tree_t *sub_tree, const char *parent_node_name)
+{
+    tree_allocator_t *sub_tree_allocator = NULL;
+    tree_index_t *old_index = NULL;
+    node_t *parent = NULL;
+    node_t *sub_tree_root = NULL;
+    node_t **merged = NULL;
+    node_t **shrunk = NULL;
+    int num_merged = 0;
+    int capacity = 0;
+    int shrunk_capacity = 0;
+    tree_publish_t publish = {NULL, 0, 0, NULL, NULL};
+
+    /* invalid inputs */
+    if ((self == NULL) || (sub_tree == NULL) || (sub_tree->root == NULL))
+    {
+        return NULL;
+    }
+
+    tree_collect_garbage(self);
+
+    /* our tree is empty - steal everything */
+    if (self->root == NULL)
+    {
+        /* lock-free readers may see sub tree nodes as soon as the sub tree root is published */
+        if ((self->epoch != NULL) && !tree_terminate_all_children(sub_tree))
+        {
+            return NULL;
+        }
+
+        sub_tree_allocator = sub_tree->allocator;
+
+        /*
+         * nodes kept for snapshots move to the index of the sub tree, then its tables move to our
+         * allocator, the last step which can fail leaves the sub tree as it is
+         */
+        if (((self->num_buried > 0) &&
+             (tree_index_reserve(sub_tree, sub_tree->num_nodes + self->num_buried) == NULL)) ||
+            !tree_copy_tables(sub_tree, self->allocator))
+        {
+            return NULL;
+        }
+
+        sub_tree->epoch = self->epoch;
+        sub_tree->journal = self->journal;
+
+        tree_index_adopt_buried(sub_tree->index, self->index);
+        old_index = self->index;
+        sub_tree->version = self->version;
+        sub_tree->num_buried = self->num_buried;
+        sub_tree->buried_roots = self->buried_roots;
+        tree_stamp_nodes(sub_tree);
+        tree_iter_clear(&self->scratch);
+        tree_assign(self, sub_tree);
+        tree_free_table(self, self->allocator, old_index);
+        memset(sub_tree, 0, sizeof(tree_t));
+        sub_tree->allocator = sub_tree_allocator;
+        tree_journal_record_add_tree(self->journal, self, self->root, NULL);
+        return self->root;
+    }
+
+    /* only allowed if our tree is empty */
+    if (parent_node_name == NULL)
+    {
+        return NULL;
+    }
+
+    parent = tree_get_node(self, parent_node_name);
+
+    /* no such node exists */
+    if (parent == NULL)
+    {
+        return NULL;
+    }
+
+    /* sub tree root name is in conflict with one of our nodes */
+    if (tree_get_node(self, sub_tree->root->object_name) != NULL)
+    {
+        return NULL;
+    }
+
+    /* room for the case without conflicts */
+    capacity = tree_round_up_capacity(self->num_nodes + sub_tree->num_nodes + 1);
+
+    if (capacity < self->capacity)
+    {
+        capacity = self->capacity;
+    }
+
+    merged = tree_malloc(self->allocator, capacity * sizeof(node_t *));
+
+    if ((merged == NULL) ||
+        (tree_index_reserve(self, self->num_nodes + sub_tree->num_nodes + 1) == NULL))
+    {
+        tree_free(self->allocator, merged);
+        return NULL;
+    }
+
+    /*
+     * Allocate everything first, so that a failure leaves both trees as they are: the conflicts,
+     * including our root, are dropped without allocating, and the sub tree root goes into a table
+     * of the parent which is ready for it.
+     */
+    if (!tree_reserve_conflicts(self, sub_tree, (self->epoch != NULL) ? 1 : 0) ||
+        ((self->epoch != NULL) && !tree_prepare_publish(self, parent, parent->num_children + 1, &publish)) ||
+        ((self->epoch == NULL) && !node_reserve_children(parent, parent->num_children + 1)))
+    {
+        tree_free(self->allocator, merged);
+        return NULL;
+    }
+
+    /* our root is not in our nodes table, so it is not found by the merge */
+    tree_remove_node(sub_tree, self->root->object_name);
+    sub_tree_root = sub_tree->root;
+
+    if (self->epoch != NULL)
+    {
+        /* sub tree nodes which lock-free readers can see must not change, drop conflicts now */
+        tree_remove_conflicts(self, sub_tree);
+
+        /* the spare slots are there already */
+        tree_terminate_all_children(sub_tree);
+        tree_finish_publish(self, parent, NULL, &sub_tree_root, 1, &publish);
+    }
+    else
+    {
+        /* steal root from sub_tree */
+        node_add_child(parent, sub_tree_root);
+    }
+
+    /* steal all other nodes from sub tree, dropping the conflicting ones */
+    num_merged = tree_merge_nodes(self, sub_tree, merged);
+
+    /* give back what the conflicts did not use */
+    shrunk_capacity = tree_round_up_capacity(num_merged);
+
+    if (shrunk_capacity < self->capacity)
+    {
+        shrunk_capacity = self->capacity;
+    }
+
+    if (shrunk_capacity < capacity)
+    {
+        shrunk = tree_realloc(self->allocator, merged, shrunk_capacity * sizeof(node_t *));
+
+        if (shrunk != NULL)
+        {
+            merged = shrunk;
+            capacity = shrunk_capacity;
+        }
+    }
+
+    tree_free(self->allocator, self->nodes);
+    self->nodes = merged;
+    self->num_nodes = num_merged;
+    self->capacity = capacity;
+
+    tree_invalidate_labels(self);
+
+    /* clear sub tree */
+    tree_free(sub_tree->allocator, sub_tree->nodes);
+    tree_free(sub_tree->allocator, sub_tree->index);
+    tree_free(sub_tree->allocator, sub_tree->pre_order);
+    tree_free(sub_tree->allocator, sub_tree->jumps);
+    tree_iter_clear(&sub_tree->scratch);
+    sub_tree_allocator = sub_tree->allocator;
+    memset(sub_tree, 0, sizeof(tree_t));
+    sub_tree->allocator = sub_tree_allocator;
+
+    tree_journal_record_add_tree(self->journal, self, sub_tree_root, parent_node_name);
+
+    TREE_DUMP(self);
+
+    /* done */
+    return sub_tree_root;
+}
+
+int tree_remove_node(tree_t *self, const char *node_name)
+{
+    int i = 0;
+    int pos = 0;
+    node_t *node = NULL;
+
+    /* invalid inputs or empty tree */
+    if ((self == NULL) || (node_name == NULL) || (self->root == NULL))
+    {
+        return 0;
+    }
+
+    tree_collect_garbage(self);
+
+    if (node_has_name(self->root, node_name, node_name_hash(node_name)))
+    {
+        /* cannot remove root if it has children */
+        if (self->root->num_children > 0)
+        {
+            return 0;
+        }
+        else
+        {
+            tree_journal_record_remove_node(self->journal, node_name);
+            tree_clear(self);
+            return 1;
+        }
+    }
+
+    pos = tree_bsearch_node_pos(self, node_name);
+
+    /* not found */
+    if (pos == -1)
+    {
+        return 0;
+    }
+
+    node = self->nodes[pos];
+
+    /* for lock-free readers children of the node go to its parent in a new table */
+    if ((self->epoch != NULL) &&
+        !tree_publish_children(self, node->parent, node, node->children, node->num_children))
+    {
+        return 0;
+    }
+
+    /* otherwise in the table of the parent, which has to hold them all, see tree_unlink_node() */
+    if ((self->epoch == NULL) &&
+        !node_reserve_children(node->parent, node->parent->num_children - 1 + node->num_children))
+    {
+        return 0;
+    }
+
+    /* node_name may be the name of the node, which is gone below */
+    tree_journal_record_remove_node(self->journal, node_name);
+
+    /*
+     * memmove bug - cannot shift left
+     * https://github.com/fingolfin/memmove-bug/blob/master/glibc-memcpy.patch
+     */
+    for (i = pos; i < self->num_nodes - 1; ++i)
+    {
+        self->nodes[i] = self->nodes[i + 1];
+    }
+
+    /* children of the node go to its parent, then it is disposed of */
+    if (self->epoch != NULL)
+    {
+        tree_discard_node(self, node);
+    }
+    else
+    {
+        tree_index_forget(self, node);
+        tree_unlink_node(node);
+    }
+
+    --self->num_nodes;
+
+    tree_invalidate_labels(self);
+
+    return 1;
+}
+
+/* set or clear the mark, cannot fail once the walk has started, see tree_iter_start() */
+static int tree_mark_subtree(tree_t *self, node_t *node, int marked)
+{
+    if (!tree_iter_start(&self->scratch, node, TREE_ITER_PRE_ORDER))
+    {
+        return 0;
+    }
+
+    while ((node = tree_iter_next(&self->scratch)) != NULL)
+    {
+        if (marked)
+        {
+            node->flags |= NODE_FLAG_MARKED;
+        }
+        else
+        {
+            node->flags &= ~NODE_FLAG_MARKED;
+        }
+    }
+
+    return 1;
+}
+
+static void remove_child_from_list(node_t *parent, node_t *child)
+{
+    int i = 0;
+    int j = 0;
+    /* find it */
+    for (; i < parent->num_children; ++i)
+    {
+        if (parent->children[i] == child)
+        {
+            break;
+        }
+    }
+
+    /*
+     * memmove bug - cannot shift left
+     * https://github.com/fingolfin/memmove-bug/blob/master/glibc-memcpy.patch
+     */
+    for (j = i; j < parent->num_children - 1; ++j)
+    {
+        parent->children[j] = parent->children[j + 1];
+    }
+
+    --parent->num_children;
+
+    /* the removed child was one of the highest */
+    if (child->height + 1 == parent->height)
+    {
+        node_update_height(parent);
+    }
+}
+
+/* remove and dispose of all marked nodes in one pass over the nodes table */
+static int tree_sweep(tree_t *self)
+{
+    int i = 0;
+    int num_kept = 0;
+    int removed_cnt = 0;
+    node_t *node = NULL;
+
+    for (; i < self->num_nodes; ++i)
+    {
+        node = self->nodes[i];
+
+        if (node->flags & NODE_FLAG_MARKED)
+        {
+            tree_discard_node(self, node);
+        }
+        else
+        {
+            self->nodes[num_kept++] = node;
+        }
+    }
+
+    removed_cnt = self->num_nodes - num_kept;
+    self->num_nodes = num_kept;
+
+    return removed_cnt;
+}
+
+int tree_remove_tree(tree_t *self, const char *sub_tree_root_name)
+{
+    node_t *sub_tree_root = NULL;
+    int removed_cnt = 0;
+
+    /* invalid inputs or empty tree */
+    if ((self == NULL) || (sub_tree_root_name == NULL) || (self->root == NULL))
+    {
+        return 0;
+    }
+
+    tree_collect_garbage(self);
+
+    /* remove entire tree */
+    if (node_has_name(self->root, sub_tree_root_name, node_name_hash(sub_tree_root_name)))
+    {
+        removed_cnt = self->num_nodes + 1;
+        tree_journal_record_remove_tree(self->journal, sub_tree_root_name);
+        tree_clear(self);
+        return removed_cnt;
+    }
+
+    sub_tree_root = tree_get_node(self, sub_tree_root_name);
+
+    /* subtree root not found */
+    if (sub_tree_root == NULL)
+    {
+        return 0;
+    }
+
+    /* failed to allocate memory */
+    if (!tree_mark_subtree(self, sub_tree_root, 1))
+    {
+        return 0;
+    }
+
+    if (self->epoch == NULL)
+    {
+        remove_child_from_list(sub_tree_root->parent, sub_tree_root);
+    }
+    else if (!tree_publish_children(self, sub_tree_root->parent, sub_tree_root, NULL, 0))
+    {
+        /* failed to allocate memory, the walk has enough room already */
+        tree_mark_subtree(self, sub_tree_root, 0);
+        return 0;
+    }
+
+    tree_journal_record_remove_tree(self->journal, sub_tree_root_name);
+    removed_cnt = tree_sweep(self);
+
+    tree_invalidate_labels(self);
+
+    return removed_cnt;
+}
+
+int tree_depth(tree_t *self)
+{
+    if ((self == NULL) || (self->root == NULL))
+    {
+        return 0;
+    }
+
+    return self->root->height;
+}
+
+/* number nodes in pre-order and count nodes of every subtree in one pass */
+int tree_update_labels(tree_t *self)
 {
+    node_t **pre_order = NULL;
+    node_t *node = NULL;
+    int num_labeled = 0;
     int i = 0;
-    int last_non_null = -1;
 
-    /* shift left to remove all NULLs */
-    while ((i < self->num_nodes) && (last_non_null < self->num_nodes))
+    if (self == NULL)
+    {
+        return 0;
+    }
+
+    if (self->labels_valid)
+    {
+        return 1;
+    }
+
+    pre_order = tree_realloc(self->allocator, self->pre_order, (self->num_nodes + 1) * sizeof(node_t *));
+
+    /* failed to allocate memory */
+    if (pre_order == NULL)
+    {
+        return 0;
+    }
+
+    self->pre_order = pre_order;
+
+    if (!tree_iter_start(&self->scratch, self->root, TREE_ITER_PRE_ORDER))
+    {
+        return 0;
+    }
+
+    while ((node = tree_iter_next(&self->scratch)) != NULL)
     {
-        if (self->nodes[i] == NULL)
+        node->pre_order = num_labeled;
+        node->subtree_size = 1;
+        node->level = (node->parent == NULL) ? 0 : node->parent->level + 1;
+        pre_order[num_labeled++] = node;
+    }
+
+    /* descendants come after their ancestors */
+    for (i = num_labeled - 1; i > 0; --i)
+    {
+        pre_order[i]->parent->subtree_size += pre_order[i]->subtree_size;
+    }
+
+    self->labels_valid = 1;
+    return 1;
+}
+
+/* a is in the subtree of ancestor */
+static int tree_is_labeled_ancestor(node_t *ancestor, node_t *a)
+{
+    return (ancestor->pre_order <= a->pre_order) &&
+           (a->pre_order < ancestor->pre_order + ancestor->subtree_size);
+}
+
+int tree_is_ancestor(tree_t *self, const char *ancestor_name, const char *descendant_name)
+{
+    node_t *ancestor = tree_get_node(self, ancestor_name);
+    node_t *descendant = tree_get_node(self, descendant_name);
+
+    if ((ancestor == NULL) || (descendant == NULL))
+    {
+        return 0;
+    }
+
+    if (!tree_update_labels(self))
+    {
+        /* no memory for labels, walk up instead */
+        for (; descendant != NULL; descendant = descendant->parent)
         {
-            if (last_non_null == -1)
+            if (descendant == ancestor)
             {
-                last_non_null = i + 1;
+                return 1;
             }
+        }
 
-            while (last_non_null < self->num_nodes)
-            {
-                if (self->nodes[last_non_null] != NULL)
-                {
-                    break;
-                }
-
-                ++last_non_null;
-            }
+        return 0;
+    }
 
-            self->nodes[i] = self->nodes[last_non_null];
+    return tree_is_labeled_ancestor(ancestor, descendant);
+}
 
-            ++last_non_null;
-        }
+int tree_subtree_size(tree_t *self, const char *sub_tree_root_name)
+{
+    node_t *sub_tree_root = tree_get_node(self, sub_tree_root_name);
 
-        ++i;
+    if ((sub_tree_root == NULL) || !tree_update_labels(self))
+    {
+        return 0;
     }
+
+    return sub_tree_root->subtree_size;
 }
 
-int tree_remove_tree(tree_t *self, const char *sub_tree_root_name)
+/* jumps[j][i] = jumps[j - 1][jumps[j - 1][i]], level 0 holds parents */
+static int tree_update_jumps(tree_t *self)
 {
-    node_t *sub_tree_root = NULL;
-    int pos = 0;
-    int removed_cnt = 0;
+    int num_labeled = self->num_nodes + 1;
+    int num_levels = 1;
+    int *jumps = NULL;
+    int *level = NULL;
+    int *previous_level = NULL;
+    int i = 0;
+    int j = 0;
 
-    /* invalid inputs or empty tree */
-    if ((self == NULL) || (sub_tree_root_name == NULL) || (self->root == NULL))
+    if (!tree_update_labels(self))
     {
         return 0;
     }
 
-    /* remove entire tree */
-    if (strcmp(sub_tree_root_name, self->root->object_name) == 0)
+    if (self->jumps_valid)
     {
-        removed_cnt = self->num_nodes + 1;
-        tree_clear(self);
-        return removed_cnt;
+        return 1;
     }
 
-    pos = tree_find_node_pos(self, sub_tree_root_name);
+    /* enough levels to jump from the deepest node to the root */
+    while ((1 << num_levels) < self->root->height)
+    {
+        ++num_levels;
+    }
 
-    /* subtree root not found */
-    if (pos == -1)
+    jumps = tree_realloc(self->allocator, self->jumps, (size_t)num_levels * num_labeled * sizeof(int));
+
+    /* failed to allocate memory */
+    if (jumps == NULL)
     {
         return 0;
     }
 
-    sub_tree_root = self->nodes[pos];
-    remove_child_from_list(sub_tree_root->parent, sub_tree_root);
-    removed_cnt = tree_mark_for_squeeze(self, sub_tree_root);
-    tree_squeeze(self);
+    self->jumps = jumps;
+    self->num_jump_levels = num_levels;
 
-    self->num_nodes -= removed_cnt;
+    for (i = 0; i < num_labeled; ++i)
+    {
+        jumps[i] = (i == 0) ? -1 : self->pre_order[i]->parent->pre_order;
+    }
 
-    /* invalidate depth */
-    self->depth = -1;
+    for (j = 1; j < num_levels; ++j)
+    {
+        previous_level = &jumps[(size_t)(j - 1) * num_labeled];
+        level = &jumps[(size_t)j * num_labeled];
 
-    return removed_cnt;
+        for (i = 0; i < num_labeled; ++i)
+        {
+            level[i] = (previous_level[i] == -1) ? -1 : previous_level[previous_level[i]];
+        }
+    }
+
+    self->jumps_valid = 1;
+    return 1;
 }
 
-static void tree_depth_recursive(node_t *node, int *depth, int local_depth)
+static node_t *tree_lca_by_walking(node_t *a, node_t *b)
 {
-    int i = 0;
+    int level_a = 0;
+    int level_b = 0;
+    node_t *node = NULL;
 
-    if (node->num_children == 0)
+    for (node = a; node->parent != NULL; node = node->parent)
     {
-        return;
+        ++level_a;
+    }
+
+    for (node = b; node->parent != NULL; node = node->parent)
+    {
+        ++level_b;
     }
 
-    ++local_depth;
+    for (; level_a > level_b; --level_a)
+    {
+        a = a->parent;
+    }
 
-    if (*depth < local_depth)
+    for (; level_b > level_a; --level_b)
     {
-        *depth = local_depth;
+        b = b->parent;
     }
 
-    for (; i < node->num_children; ++i)
+    while (a != b)
     {
-        tree_depth_recursive(node->children[i], depth, local_depth);
+        a = a->parent;
+        b = b->parent;
     }
+
+    return a;
 }
 
-int tree_depth(tree_t *self)
+node_t *tree_lca(tree_t *self, const char *node_name_a, const char *node_name_b)
+{
+    node_t *a = tree_get_node(self, node_name_a);
+    node_t *b = tree_get_node(self, node_name_b);
+    int num_labeled = 0;
+    int jump = 0;
+    int j = 0;
+
+    if ((a == NULL) || (b == NULL))
+    {
+        return NULL;
+    }
+
+    if (!tree_update_jumps(self))
+    {
+        /* no memory for the jump table */
+        return tree_lca_by_walking(a, b);
+    }
+
+    if (tree_is_labeled_ancestor(a, b))
+    {
+        return a;
+    }
+
+    if (tree_is_labeled_ancestor(b, a))
+    {
+        return b;
+    }
+
+    num_labeled = self->num_nodes + 1;
+
+    /* go up from a as long as b is not below */
+    for (j = self->num_jump_levels - 1; j >= 0; --j)
+    {
+        jump = self->jumps[(size_t)j * num_labeled + a->pre_order];
+
+        if ((jump != -1) && !tree_is_labeled_ancestor(self->pre_order[jump], b))
+        {
+            a = self->pre_order[jump];
+        }
+    }
+
+    return a->parent;
+}
+
+node_t *tree_kth_ancestor(tree_t *self, const char *node_name, int k)
+{
+    node_t *node = tree_get_node(self, node_name);
+    int pos = 0;
+    int j = 0;
+
+    if ((node == NULL) || (k < 0))
+    {
+        return NULL;
+    }
+
+    if (!tree_update_jumps(self))
+    {
+        /* no memory for the jump table */
+        for (; (node != NULL) && (k > 0); --k)
+        {
+            node = node->parent;
+        }
+
+        return node;
+    }
+
+    if (k > node->level)
+    {
+        return NULL;
+    }
+
+    pos = node->pre_order;
+
+    for (j = 0; k > 0; ++j, k >>= 1)
+    {
+        if (k & 1)
+        {
+            pos = self->jumps[(size_t)j * (self->num_nodes + 1) + pos];
+        }
+    }
+
+    return self->pre_order[pos];
+}
+
+int tree_for_each(tree_t *self, tree_iter_mode_t mode, tree_visit_fun_t visit_fun, void *ctx)
 {
     if (self == NULL)
     {
-        return 0;
+        return -1;
+    }
+
+    return node_for_each(self->root, mode, visit_fun, ctx);
+}
+
+tree_snapshot_t *tree_snapshot(tree_t *self)
+{
+    tree_snapshot_t *snapshot = NULL;
+
+    if ((self == NULL) || (self->epoch == NULL))
+    {
+        return NULL;
+    }
+
+    tree_collect_garbage(self);
+
+    snapshot = tree_malloc(self->allocator, sizeof(tree_snapshot_t));
+
+    if (snapshot == NULL)
+    {
+        return NULL;
+    }
+
+    /* for lookups in the index, which the writer can replace */
+    snapshot->reader = epoch_register(self->epoch);
+
+    if (snapshot->reader == NULL)
+    {
+        tree_free(self->allocator, snapshot);
+        return NULL;
+    }
+
+    snapshot->tree = self;
+    snapshot->version = self->version;
+    snapshot->root = self->root;
+    __atomic_add_fetch(&self->num_snapshots, 1, __ATOMIC_RELEASE);
+
+    /* what changes from now on is not seen by the snapshot */
+    ++self->version;
+
+    return snapshot;
+}
+
+void tree_snapshot_release(tree_snapshot_t *self)
+{
+    if (self == NULL)
+    {
+        return;
+    }
+
+    epoch_unregister(self->reader);
+
+    /* pairs with tree_has_snapshots(), the writer may free what the snapshot used after this */
+    __atomic_sub_fetch(&self->tree->num_snapshots, 1, __ATOMIC_RELEASE);
+    tree_free(self->tree->allocator, self);
+}
+
+node_t *tree_snapshot_root(tree_snapshot_t *self)
+{
+    return (self == NULL) ? NULL : self->root;
+}
+
+node_t *tree_snapshot_get_node(tree_snapshot_t *self, const char *node_name)
+{
+    node_t *node = NULL;
+    unsigned int hash = 0;
+
+    if ((self == NULL) || (node_name == NULL) || (self->root == NULL))
+    {
+        return NULL;
+    }
+
+    hash = node_name_hash(node_name);
+
+    if (node_has_name(self->root, node_name, hash))
+    {
+        return self->root;
+    }
+
+    epoch_enter(self->reader);
+
+    node = tree_index_find_version(
+        __atomic_load_n(&self->tree->index, __ATOMIC_ACQUIRE),
+        node_name,
+        hash,
+        self->version);
+
+    epoch_exit(self->reader);
+
+    return node;
+}
+
+node_t **tree_snapshot_children(tree_snapshot_t *self, node_t *node)
+{
+    struct node_history_s *entry = NULL;
+    node_t **children = NULL;
+
+    if ((self == NULL) || (node == NULL))
+    {
+        return NULL;
+    }
+
+    entry = __atomic_load_n(&node->history, __ATOMIC_ACQUIRE);
+
+    /* the history is published before the table which replaces the current one */
+    if (entry == NULL)
+    {
+        children = __atomic_load_n(&node->children, __ATOMIC_ACQUIRE);
+        entry = __atomic_load_n(&node->history, __ATOMIC_ACQUIRE);
+
+        if (entry == NULL)
+        {
+            return children;
+        }
+    }
+
+    /* newest first, the base entry is there since version 0 */
+    while (entry->since > self->version)
+    {
+        entry = entry->older;
+    }
+
+    return __atomic_load_n(&entry->children, __ATOMIC_ACQUIRE);
+}
+
+int tree_snapshot_for_each(tree_snapshot_t *self, tree_visit_fun_t visit_fun, void *ctx)
+{
+    node_t ***stack = NULL;
+    node_t ***grown = NULL;
+    node_t **children = NULL;
+    node_t *node = NULL;
+    int capacity = TREE_SNAPSHOT_STACK_INCREMENT;
+    int depth = 0;
+    int num_visited = 0;
+
+    if ((self == NULL) || (visit_fun == NULL))
+    {
+        return -1;
     }
 
     if (self->root == NULL)
@@ -538,22 +2677,62 @@ int tree_depth(tree_t *self)
         return 0;
     }
 
-    if (self->num_nodes == 0)
+    /* one cursor into a NULL terminated children table per level */
+    stack = tree_malloc(self->tree->allocator, capacity * sizeof(node_t **));
+
+    if (stack == NULL)
     {
-        self->depth = 1;
-        return self->depth;
+        return -1;
     }
 
-    /* still valid */
-    if (self->depth >= 0)
+    node = self->root;
+
+    for (;;)
     {
-        return self->depth;
-    }
+        ++num_visited;
+
+        if ((*visit_fun)(node, ctx) != 0)
+        {
+            break;
+        }
+
+        children = tree_snapshot_children(self, node);
+
+        if ((children != NULL) && (*children != NULL))
+        {
+            if (depth == capacity)
+            {
+                grown = tree_realloc(self->tree->allocator, stack, (capacity + TREE_SNAPSHOT_STACK_INCREMENT) * sizeof(node_t **));
+
+                /* failed to reallocate memory */
+                if (grown == NULL)
+                {
+                    tree_free(self->tree->allocator, stack);
+                    return -1;
+                }
+
+                stack = grown;
+                capacity += TREE_SNAPSHOT_STACK_INCREMENT;
+            }
+
+            stack[depth++] = children;
+        }
 
-    self->depth = 1;
+        /* next sibling of the deepest level which has one left */
+        while ((depth > 0) && (*stack[depth - 1] == NULL))
+        {
+            --depth;
+        }
+
+        if (depth == 0)
+        {
+            break;
+        }
+
+        node = *stack[depth - 1]++;
+    }
 
-    /* need to re-calculate */
-    tree_depth_recursive(self->root, &self->depth, 1);
+    tree_free(self->tree->allocator, stack);
 
-    return self->depth;
+    return num_visited;
 }
@@ -1,6 +1,8 @@
 #ifndef CTREE_H_
 #define CTREE_H_
 
+#include "cepoch.h"
+#include "citer.h"
 #include "cnode.h"
 
 #ifdef __cplusplus
@@ -8,33 +10,146 @@ extern "C"
 {
 #endif /* __cplusplus */
 
+/**
+ * Open addressing hash table which maps object_name to node, opaque
+ */
+typedef struct tree_index_s tree_index_t;
+
+/**
+ * Log of the changes of a tree, opaque, see tree_set_journal()
+ */
+typedef struct tree_journal_s tree_journal_t;
+
 /**
  * Describes a tree of nodes, where each node has a unique object_name
  */
 typedef struct
 {
     node_t *root;
-    node_t **nodes; /**< excluding root */
+    node_t **nodes; /**< excluding root, sorted by object_name */
     int num_nodes; /**< excluding root */
     int capacity; /**< excluding root */
-    int depth; /**< -1 means invalid, call tree_depth() to re-calculate */
+    tree_index_t *index; /**< same nodes as in nodes, hashed by object_name */
+    node_t **pre_order; /**< root and nodes in pre-order, valid if labels_valid is not 0 */
+    int labels_valid; /**< 0 means invalid, node_t::pre_order, node_t::subtree_size and
+                           node_t::level are re-calculated in one pass on the next query that
+                           needs them */
+    int *jumps; /**< jumps[j * (num_nodes + 1) + i] is the pre-order number of the 2^j-th
+                     ancestor of the i-th node in pre-order or -1, valid if jumps_valid */
+    int num_jump_levels;
+    int jumps_valid; /**< 0 means invalid, re-built on the next query that needs it */
+    tree_iter_t scratch; /**< reused by the operations which walk the tree */
+    epoch_t *epoch; /**< if not NULL, removed nodes and replaced tables are retired here instead
+                         of freed, see tree_set_epoch() */
+    tree_allocator_t *allocator; /**< of the tables of the tree, see tree_set_allocator() */
+    unsigned int version; /**< advanced by every tree_snapshot() */
+    int num_snapshots; /**< not yet released, atomic */
+    int num_buried; /**< removed nodes kept in the index for snapshots */
+    node_t *buried_roots; /**< removed roots kept for snapshots, linked by node_t::parent */
+    tree_journal_t *journal; /**< if not NULL, changes are recorded here, see tree_set_journal() */
 } tree_t;
 
 /**
- * Initialize a tree_t structure to represent an empty tree
+ * Immutable view of a tree as it was when the snapshot was taken, opaque
+ */
+typedef struct tree_snapshot_s tree_snapshot_t;
+
+/**
+ * Result of tree_build()
+ */
+typedef enum
+{
+    TREE_BUILD_OK = 0,
+    TREE_BUILD_INVALID_ARGUMENT, /**< NULL input, non empty self tree or node already linked */
+    TREE_BUILD_NO_ROOT, /**< every node has a parent name */
+    TREE_BUILD_MULTIPLE_ROOTS, /**< more than one node without a parent name */
+    TREE_BUILD_DUPLICATE, /**< object_name used by more than one node */
+    TREE_BUILD_ORPHAN, /**< parent name of a node cannot be found among the nodes */
+    TREE_BUILD_CYCLE, /**< some nodes cannot be reached from the root */
+    TREE_BUILD_NO_MEMORY
+} tree_build_result_t;
+
+/**
+ * Initialize a tree_t structure to represent an empty tree, with the default allocator
  *
  * @param[in,out] self - pointer to the tree structure to initialize, function does nothing if
  *                self is NULL
  */
 void tree_init(tree_t *self);
 
+/**
+ * Set the allocator of the nodes table, the hash index and the other tables of the tree
+ *
+ * Nodes bring their own allocator, see node_create_with(). Children tables which the tree
+ * allocates for a node come from the allocator of the node.
+ *
+ * @param[in,out] self - the tree, it must not hold any memory yet
+ * @param[in] allocator - the allocator, NULL for the default one, see tree_allocator_default()
+ *
+ * @return 0 if self is NULL or the tree already holds memory, 1 otherwise
+ *
+ * @note The tree keeps the allocator over tree_clear(). A sub tree with another allocator has its
+ *       tables copied by tree_add_tree() instead of stolen.
+ */
+int tree_set_allocator(tree_t *self, tree_allocator_t *allocator);
+
 /**
  * Clear a tree_t structure, dispose of its root and all its children
  *
  * @param[in] self - pointer to the tree structure to clear, function does nothing if self is NULL
+ *
+ * @note If the tree has an epoch, the nodes are retired and the tree keeps the epoch
  */
 void tree_clear(tree_t *self);
 
+/**
+ * Record every change of the tree in a journal from now on, see cjournal.h
+ *
+ * tree_add_node(), tree_add_nodes(), tree_add_tree(), tree_remove_node() and tree_remove_tree()
+ * append a record once they have succeeded. tree_clear() and tree_build() are not recorded, a
+ * checkpoint should follow them, see tree_journal_checkpoint().
+ *
+ * @param[in,out] self - the tree
+ * @param[in] journal - the journal, NULL to stop recording
+ *
+ * @return 0 if self is NULL, 1 otherwise
+ *
+ * @note The tree keeps the journal over tree_clear(), dispose of the journal after the tree.
+ */
+int tree_set_journal(tree_t *self, tree_journal_t *journal);
+
+/**
+ * Let readers look nodes up without any lock while a single writer changes the tree
+ *
+ * From now on the writer never changes a children table or the hash index which readers can
+ * see. It builds a new one, publishes it with an atomic pointer swap and retires the old one,
+ * removed nodes are retired too. Readers call tree_get_node() and tree_node_children() between
+ * epoch_enter() and epoch_exit(), and read only object_name, name_hash and value of the nodes
+ * they get. Everything else, including the other tree functions, is for the writer only.
+ *
+ * @param[in,out] self - the tree, readers must not use it yet
+ * @param[in] epoch - reclamation domain, NULL to go back to freeing right away once there are
+ *                no readers
+ *
+ * @return 0 if self is NULL or there is not enough memory to terminate children tables,
+ *         1 otherwise
+ *
+ * @note The tree keeps the epoch over tree_clear(), dispose of the epoch after the tree.
+ */
+int tree_set_epoch(tree_t *self, epoch_t *epoch);
+
+/**
+ * Get the children of a node of a tree with an epoch, see tree_set_epoch()
+ *
+ * @param[in] node - the node
+ *
+ * @return NULL if node is NULL or has never had any children,
+ *         NULL terminated table of children in sibling order otherwise, valid until epoch_exit()
+ *
+ * @note Safe for lock-free readers, unlike node_t::children and node_t::num_children
+ */
+node_t **tree_node_children(node_t *node);
+
 /**
  * Get a node with particular name from the tree
  *
@@ -45,6 +160,8 @@ void tree_clear(tree_t *self);
  *         NULL if node_name is an empty string (ie. "")
  *         NULL if node_name was not found
  *         pointer to node with node_name if it was found
+ *
+ * @note Safe for lock-free readers if the tree has an epoch, see tree_set_epoch()
  */
 node_t *tree_get_node(tree_t *self, const char *node_name);
 
@@ -64,6 +181,46 @@ node_t *tree_get_node(tree_t *self, const char *node_name);
  */
 node_t *tree_add_node(tree_t *self, node_t *new_node, const char *parent_node_name);
 
+/**
+ * Add many nodes to the tree at once, in O(n + m log m) instead of O(n) per node
+ *
+ * Same as calling tree_add_node() for each node in order, so a node can have a parent which
+ * comes before it in nodes. The nodes table of the tree is merged with the sorted new nodes
+ * once, instead of being shifted for every node.
+ *
+ * @param[in] self - the tree to add to
+ * @param[in] nodes - array of unlinked nodes
+ * @param[in] parent_names - parent_names[i] is the name of the parent of nodes[i], ignored for
+ *                the first node if the tree is empty, it becomes the root then
+ * @param[in] num_nodes - number of entries in nodes and parent_names
+ *
+ * @return 0 if self, nodes or parent_names is NULL or memory cannot be allocated,
+ *         number of the nodes added otherwise, tree takes ownership of them, the nodes which
+ *         tree_add_node() would not add are left to the caller
+ */
+int tree_add_nodes(tree_t *self, node_t **nodes, const char **parent_names, int num_nodes);
+
+/**
+ * Build a tree from a list of nodes and the names of their parents in O(n log n)
+ *
+ * @param[in,out] self - empty tree to build
+ * @param[in] nodes - array of unlinked nodes, in any order
+ * @param[in] parent_names - parent_names[i] is the name of the parent of nodes[i], NULL for the
+ *                root, exactly one entry has to be NULL
+ * @param[in] num_nodes - number of entries in nodes and parent_names
+ * @param[out] error_pos - set to the position of an offending entry if building fails, -1 if the
+ *                failure cannot be attributed to a single entry, can be NULL
+ *
+ * @return TREE_BUILD_OK if the tree was built, self tree takes ownership of all nodes,
+ *         any other value if it failed, self tree and nodes are left untouched then
+ */
+tree_build_result_t tree_build(
+    tree_t *self,
+    node_t **nodes,
+    const char **parent_names,
+    int num_nodes,
+    int *error_pos);
+
 /**
  * Add a subtree to the tree
  *
@@ -77,6 +234,7 @@ node_t *tree_add_node(tree_t *self, node_t *new_node, const char *parent_node_na
  *         NULL if self tree is not empty and parent_node_name is NULL
  *         NULL if self tree is not empty and parent_node_name cannot be found
  *         NULL if self tree is not empty and sub_tree root name is already in the self tree
+ *         NULL if memory cannot be allocated, in which case both trees are left as they are
  *         pointer to the root of the subtree if subtree was added successfully, tree self takes
  *             ownership of all nodes of sub_tree (steals them), sub_tree is empty, any nodes
  *             of the subtree that have conflicting names with the parent tree are removed using
@@ -116,12 +274,179 @@ int tree_remove_tree(tree_t *self, const char *sub_tree_root_name);
 /**
  * Get tree depth
  *
- * @param[in] self - the tree whose depth should be calculated
+ * @param[in] self - the tree whose depth should be returned
  *
  * @return depth of the tree or 0 if the tree is empty
+ *
+ * @note O(1), heights of the nodes are kept up to date by all tree operations, see node_t::height
  */
 int tree_depth(tree_t *self);
 
+/**
+ * Check whether a node lies in the subtree rooted in another node
+ *
+ * @param[in] self - the tree to search in
+ * @param[in] ancestor_name - name of the root of the subtree
+ * @param[in] descendant_name - name of the node to look for in the subtree
+ *
+ * @return 0 if self, ancestor_name or descendant_name is NULL,
+ *         0 if any of the nodes is not found in self tree,
+ *         0 if descendant_name node is not in the subtree,
+ *         1 if descendant_name node is ancestor_name node or one of its descendants
+ *
+ * @note O(1) while the tree does not change, the first query after a change re-labels the tree
+ *       in O(n)
+ */
+int tree_is_ancestor(tree_t *self, const char *ancestor_name, const char *descendant_name);
+
+/**
+ * Re-calculate node_t::pre_order, node_t::subtree_size and node_t::level if the tree changed
+ *
+ * @param[in,out] self - the tree to label
+ *
+ * @return 0 if self is NULL or there is not enough memory to label the tree, 1 otherwise
+ *
+ * @note Queries which need the labels call it themselves, O(n) after a change, O(1) otherwise
+ */
+int tree_update_labels(tree_t *self);
+
+/**
+ * Get number of nodes in a subtree
+ *
+ * @param[in] self - the tree to search in
+ * @param[in] sub_tree_root_name - name of the root of the subtree
+ *
+ * @return 0 if self or sub_tree_root_name is NULL,
+ *         0 if node with sub_tree_root_name is not found in self tree,
+ *         0 if there is not enough memory to label the tree,
+ *         number of nodes in the subtree including its root otherwise
+ *
+ * @note O(1) while the tree does not change, see tree_is_ancestor()
+ */
+int tree_subtree_size(tree_t *self, const char *sub_tree_root_name);
+
+/**
+ * Get the lowest common ancestor of two nodes
+ *
+ * @param[in] self - the tree to search in
+ * @param[in] node_name_a - name of the first node
+ * @param[in] node_name_b - name of the second node
+ *
+ * @return NULL if self, node_name_a or node_name_b is NULL,
+ *         NULL if any of the nodes is not found in self tree,
+ *         the deepest node which has both nodes in its subtree otherwise (a node is in its own
+ *             subtree)
+ *
+ * @note O(log n) while the tree does not change, the first query after a change builds a jump
+ *       table in O(n log n)
+ */
+node_t *tree_lca(tree_t *self, const char *node_name_a, const char *node_name_b);
+
+/**
+ * Get the k-th ancestor of a node
+ *
+ * @param[in] self - the tree to search in
+ * @param[in] node_name - name of the node
+ * @param[in] k - how many levels to go up, 0 means the node itself, 1 its parent and so on
+ *
+ * @return NULL if self or node_name is NULL,
+ *         NULL if node_name is not found in self tree,
+ *         NULL if k is negative or the node does not have that many ancestors,
+ *         the k-th ancestor otherwise
+ *
+ * @note O(log n), see tree_lca()
+ */
+node_t *tree_kth_ancestor(tree_t *self, const char *node_name, int k);
+
+/**
+ * Call a visitor for every node of the tree
+ *
+ * @param[in] self - the tree to walk
+ * @param[in] mode - order of the walk
+ * @param[in] visit_fun - visitor, see tree_visit_fun_t
+ * @param[in] ctx - passed to visit_fun as is
+ *
+ * @return -1 if self or visit_fun is NULL or memory for the walk cannot be allocated,
+ *         number of visited nodes otherwise
+ *
+ * @note Does not recurse, so trees of any depth can be walked, see node_for_each()
+ */
+int tree_for_each(tree_t *self, tree_iter_mode_t mode, tree_visit_fun_t visit_fun, void *ctx);
+
+/**
+ * Take a snapshot of the tree in O(1)
+ *
+ * Nothing is copied. From now on the tree keeps what the snapshot can see: children tables
+ * which get replaced are remembered per node with the version they were replaced in, and removed
+ * nodes stay in the hash index, stamped with the version they were removed in. The writer goes
+ * on changing the tree meanwhile, while the snapshot is read from another thread. All that is
+ * kept is freed by the writer once no snapshots are left.
+ *
+ * @param[in,out] self - the tree, it needs an epoch, see tree_set_epoch()
+ *
+ * @return NULL if self is NULL, self has no epoch or memory cannot be allocated,
+ *         the snapshot otherwise, release it with tree_snapshot_release()
+ *
+ * @note Writer only. Label queries are not available for snapshots. A tree with snapshots must
+ *       not be added to another tree as a sub tree.
+ */
+tree_snapshot_t *tree_snapshot(tree_t *self);
+
+/**
+ * Release a snapshot, nodes and tables got from it must not be used any more
+ *
+ * @param[in] self - the snapshot, function does nothing if self is NULL
+ *
+ * @note Can be called from any thread, release all snapshots before the tree is cleared for good
+ */
+void tree_snapshot_release(tree_snapshot_t *self);
+
+/**
+ * Get the root of a snapshot
+ *
+ * @param[in] self - the snapshot
+ *
+ * @return NULL if self is NULL or the tree was empty, the root otherwise
+ */
+node_t *tree_snapshot_root(tree_snapshot_t *self);
+
+/**
+ * Get a node with particular name from a snapshot
+ *
+ * @param[in] self - the snapshot
+ * @param[in] node_name - the name of the node to look for
+ *
+ * @return NULL if self or node_name is NULL, NULL if node_name was not in the tree when the
+ *         snapshot was taken, pointer to the node otherwise
+ */
+node_t *tree_snapshot_get_node(tree_snapshot_t *self, const char *node_name);
+
+/**
+ * Get the children a node had when the snapshot was taken
+ *
+ * @param[in] self - the snapshot
+ * @param[in] node - a node got from the snapshot
+ *
+ * @return NULL if self or node is NULL or the node had no children then,
+ *         NULL terminated table of children in sibling order otherwise
+ *
+ * @note Only object_name and value of snapshot nodes are what they were, the other fields
+ *       belong to the writer
+ */
+node_t **tree_snapshot_children(tree_snapshot_t *self, node_t *node);
+
+/**
+ * Call a visitor for every node of a snapshot in pre-order
+ *
+ * @param[in] self - the snapshot
+ * @param[in] visit_fun - visitor, see tree_visit_fun_t
+ * @param[in] ctx - passed to visit_fun as is
+ *
+ * @return -1 if self or visit_fun is NULL or memory for the walk cannot be allocated,
+ *         number of visited nodes otherwise
+ */
+int tree_snapshot_for_each(tree_snapshot_t *self, tree_visit_fun_t visit_fun, void *ctx);
+
 #ifdef __cplusplus
 } /* extern "C" */
 #endif /* __cplusplus */
@@ -0,0 +1,375 @@
+#include <gtest/gtest.h>
+#include <cstdlib>
+#include <string>
+#include <malloc.h>
+#include "callocator.h"
+#include "cepoch.h"
+#include "cjournal.h"
+#include "ctree.h"
+#include "test-helpers.h"
+
+/* fails once the budget of allocations is used up */
+struct budget_t
+{
+    int num_left;
+};
+
+static void *budget_malloc(void *ctx, size_t size)
+{
+    budget_t *budget = static_cast<budget_t *>(ctx);
+
+    if (budget->num_left == 0)
+    {
+        return NULL;
+    }
+
+    --budget->num_left;
+    return malloc(size);
+}
+
+static void *budget_realloc(void *ctx, void *ptr, size_t size)
+{
+    budget_t *budget = static_cast<budget_t *>(ctx);
+
+    if (budget->num_left == 0)
+    {
+        return NULL;
+    }
+
+    --budget->num_left;
+    return realloc(ptr, size);
+}
+
+static void budget_free(void *, void *ptr)
+{
+    free(ptr);
+}
+
+static size_t budget_size(void *, void *ptr)
+{
+    return malloc_usable_size(ptr);
+}
+
+class callocator_test : public ::testing::Test
+{
+protected:
+    virtual void SetUp()
+    {
+        budget.num_left = -1;
+        ASSERT_EQ(&allocator, tree_allocator_init(&allocator, budget_malloc, budget_realloc, budget_free, &budget));
+        tree_allocator_set_size_fun(&allocator, budget_size);
+        tree_allocator_count(&allocator, 1);
+    }
+
+    long long num_in_use()
+    {
+        return allocator.num_allocs - allocator.num_frees;
+    }
+
+    budget_t budget;
+    tree_allocator_t allocator;
+};
+
+TEST(tree_allocator_t, init_and_default)
+{
+    tree_allocator_t allocator;
+    tree_allocator_t *std_allocator = tree_allocator_default();
+
+    EXPECT_EQ(NULL, tree_allocator_init(NULL, budget_malloc, budget_realloc, budget_free, NULL));
+    EXPECT_EQ(NULL, tree_allocator_init(&allocator, NULL, budget_realloc, budget_free, NULL));
+    EXPECT_EQ(NULL, tree_allocator_init(&allocator, budget_malloc, NULL, budget_free, NULL));
+    EXPECT_EQ(NULL, tree_allocator_init(&allocator, budget_malloc, budget_realloc, NULL, NULL));
+    EXPECT_NO_FATAL_FAILURE(tree_allocator_count(NULL, 1));
+    EXPECT_NO_FATAL_FAILURE(tree_allocator_set_size_fun(NULL, budget_size));
+    ASSERT_EQ(&allocator, tree_allocator_init(&allocator, budget_malloc, budget_realloc, budget_free, NULL));
+    EXPECT_EQ(NULL, allocator.size_fun);
+    ASSERT_NE(static_cast<tree_allocator_t *>(NULL), std_allocator);
+    EXPECT_EQ(0, std_allocator->counting);
+
+    tree_allocator_set_default(&allocator);
+    EXPECT_EQ(&allocator, tree_allocator_default());
+    tree_allocator_set_default(NULL);
+    EXPECT_EQ(std_allocator, tree_allocator_default());
+}
+
+TEST_F(callocator_test, counters)
+{
+    void *a = tree_malloc(&allocator, 10);
+    void *b = tree_realloc(&allocator, NULL, 20);
+    b = tree_realloc(&allocator, b, 30);
+
+    EXPECT_EQ(2, allocator.num_allocs);
+    EXPECT_EQ(0, allocator.num_frees);
+    EXPECT_EQ(static_cast<long long>(malloc_usable_size(a) + malloc_usable_size(b)), allocator.num_bytes);
+    EXPECT_LE(40, allocator.num_bytes);
+
+    /* bytes in use, not requested so far */
+    tree_free(&allocator, a);
+    EXPECT_EQ(static_cast<long long>(malloc_usable_size(b)), allocator.num_bytes);
+    tree_free(&allocator, b);
+    tree_free(&allocator, NULL);
+    EXPECT_EQ(2, allocator.num_frees);
+    EXPECT_EQ(0, allocator.num_bytes);
+
+    /* no sizes, no bytes */
+    tree_allocator_set_size_fun(&allocator, NULL);
+    tree_free(&allocator, tree_malloc(&allocator, 10));
+    EXPECT_EQ(0, allocator.num_bytes);
+    tree_allocator_set_size_fun(&allocator, budget_size);
+
+    /* stopped */
+    tree_allocator_count(&allocator, 0);
+    tree_free(&allocator, tree_malloc(&allocator, 10));
+    EXPECT_EQ(3, allocator.num_allocs);
+
+    /* failures are not counted */
+    tree_allocator_count(&allocator, 1);
+    budget.num_left = 0;
+    EXPECT_EQ(NULL, tree_malloc(&allocator, 10));
+    EXPECT_EQ(0, allocator.num_allocs);
+}
+
+TEST_F(callocator_test, nodes_and_trees_use_their_allocators)
+{
+    tree_t tree;
+    tree_init(&tree);
+    EXPECT_EQ(tree_allocator_default(), tree.allocator);
+    ASSERT_EQ(1, tree_set_allocator(&tree, &allocator));
+
+    node_t *a = node_create_with(&allocator, INT, "a", &_1);
+    EXPECT_EQ(&allocator, a->allocator);
+    EXPECT_EQ(2, num_in_use());
+
+    tree_add_node(&tree, a, NULL);
+    tree_add_node(&tree, node_create_with(&allocator, INT, "b", &_2), "a");
+    tree_add_node(&tree, node_create_with(&allocator, INT, "c", &_3), "a");
+    EXPECT_EQ(0, tree_set_allocator(&tree, NULL));
+    EXPECT_EQ(1, tree_is_ancestor(&tree, "a", "c"));
+
+    /* 3 nodes, 3 names, nodes table, index, labels, children of a are inline */
+    EXPECT_EQ(9, num_in_use());
+    EXPECT_LT(3 * static_cast<long long>(sizeof(node_t)), allocator.num_bytes);
+
+    tree_clear(&tree);
+    EXPECT_EQ(0, num_in_use());
+    EXPECT_EQ(0, allocator.num_bytes);
+    EXPECT_EQ(&allocator, tree.allocator);
+    EXPECT_EQ(0, tree_set_allocator(NULL, NULL));
+}
+
+TEST_F(callocator_test, out_of_budget)
+{
+    tree_t tree;
+    tree_init(&tree);
+    tree_set_allocator(&tree, &allocator);
+    tree_add_node(&tree, node_create_with(&allocator, INT, "a", &_1), NULL);
+
+    budget.num_left = 1;
+    EXPECT_EQ(NULL, node_create_with(&allocator, INT, "b", &_2));
+
+    node_t *b = node_create(INT, "b", &_2);
+    EXPECT_EQ(NULL, tree_add_node(&tree, b, "a"));
+    node_dispose(b);
+
+    budget.num_left = -1;
+    tree_clear(&tree);
+    EXPECT_EQ(0, num_in_use());
+}
+
+TEST_F(callocator_test, sub_tree_with_another_allocator)
+{
+    tree_t tree;
+    tree_t sub_tree;
+    tree_init(&tree);
+    tree_init(&sub_tree);
+    tree_set_allocator(&tree, &allocator);
+
+    node_t *x = node_create(INT, "x", &_1);
+    tree_add_node(&sub_tree, x, NULL);
+    tree_add_node(&sub_tree, node_create(INT, "y", &_2), "x");
+    tree_update_labels(&sub_tree);
+
+    /* stolen tables are copied over to our allocator */
+    EXPECT_EQ(x, tree_add_tree(&tree, &sub_tree, NULL));
+    EXPECT_EQ(tree_allocator_default(), sub_tree.allocator);
+    EXPECT_EQ(2, num_in_use());
+    EXPECT_EQ(1, tree_is_ancestor(&tree, "x", "y"));
+
+    tree_add_node(&sub_tree, node_create(INT, "z", &_3), NULL);
+    tree_add_node(&sub_tree, node_create(INT, "w", &_4), "z");
+    EXPECT_NE(static_cast<node_t *>(NULL), tree_add_tree(&tree, &sub_tree, "y"));
+    EXPECT_EQ(tree_allocator_default(), sub_tree.allocator);
+    EXPECT_EQ(3, tree.num_nodes);
+
+    tree_clear(&tree);
+    EXPECT_EQ(0, num_in_use());
+}
+
+TEST_F(callocator_test, sub_tree_stays_detached_when_it_cannot_be_stolen)
+{
+    const char *path = "callocator-test.log";
+    epoch_t *epoch = epoch_create();
+    tree_journal_t *journal = NULL;
+    tree_t tree;
+    tree_t sub_tree;
+    tree_init(&tree);
+    tree_init(&sub_tree);
+    tree_set_allocator(&tree, &allocator);
+    remove(path);
+    journal = tree_journal_open(path);
+    ASSERT_NE(static_cast<tree_journal_t *>(NULL), journal);
+    ASSERT_EQ(1, tree_set_epoch(&tree, epoch));
+    tree_set_journal(&tree, journal);
+
+    node_t *x = node_create(INT, "x", &_1);
+    tree_add_node(&sub_tree, x, NULL);
+    tree_add_node(&sub_tree, node_create(INT, "y", &_2), "x");
+
+    /* the tables of the sub tree cannot move to our allocator */
+    budget.num_left = 0;
+    EXPECT_EQ(NULL, tree_add_tree(&tree, &sub_tree, NULL));
+    EXPECT_EQ(NULL, tree.root);
+    EXPECT_EQ(x, sub_tree.root);
+    EXPECT_EQ(tree_allocator_default(), sub_tree.allocator);
+    EXPECT_EQ(NULL, sub_tree.epoch);
+    EXPECT_EQ(NULL, sub_tree.journal);
+
+    budget.num_left = -1;
+    EXPECT_EQ(x, tree_add_tree(&tree, &sub_tree, NULL));
+    EXPECT_EQ(journal, tree.journal);
+
+    tree_set_journal(&tree, NULL);
+    tree_clear(&tree);
+    tree_journal_dispose(journal);
+    epoch_synchronize(epoch);
+    epoch_dispose(epoch);
+    remove(path);
+    EXPECT_EQ(0, num_in_use());
+}
+
+TEST_F(callocator_test, sub_tree_with_conflicts_out_of_budget)
+{
+    tree_t tree;
+    tree_t sub_tree;
+    tree_init(&tree);
+    tree_init(&sub_tree);
+    tree_add_node(&tree, node_create(INT, "a", &_1), NULL);
+    tree_add_node(&tree, node_create(INT, "c", &_3), "a");
+
+    /* c is in conflict, its children do not fit next to it in the inline table of y */
+    node_t *x = node_create_with(&allocator, INT, "x", &_1);
+    node_t *y = node_create_with(&allocator, INT, "y", &_2);
+    tree_add_node(&sub_tree, x, NULL);
+    tree_add_node(&sub_tree, y, "x");
+    tree_add_node(&sub_tree, node_create_with(&allocator, INT, "c", &_3), "y");
+
+    for (int i = 0; i < NODE_INLINE_CHILDREN + 1; ++i)
+    {
+        tree_add_node(&sub_tree, node_create_with(&allocator, INT, ("c" + std::to_string(i)).c_str(), &_4), "c");
+    }
+
+    /* both trees are left as they are */
+    budget.num_left = 0;
+    EXPECT_EQ(NULL, tree_add_tree(&tree, &sub_tree, "a"));
+    EXPECT_EQ(1, tree.num_nodes);
+    EXPECT_EQ(1, tree_get_node(&tree, "a")->num_children);
+    EXPECT_EQ(x, sub_tree.root);
+    EXPECT_EQ(7, sub_tree.num_nodes);
+    EXPECT_EQ(1, y->num_children);
+
+    budget.num_left = -1;
+    EXPECT_EQ(x, tree_add_tree(&tree, &sub_tree, "a"));
+    EXPECT_EQ(8, tree.num_nodes);
+    EXPECT_EQ(NODE_INLINE_CHILDREN + 1, y->num_children);
+    EXPECT_EQ(y, tree_get_node(&tree, "c0")->parent);
+    EXPECT_EQ(&_3, tree_get_node(&tree, "c")->value);
+
+    tree_clear(&tree);
+    EXPECT_EQ(0, num_in_use());
+}
+
+TEST_F(callocator_test, sub_tree_is_left_as_it_is_when_the_parent_cannot_grow)
+{
+    for (int with_epoch = 0; with_epoch < 2; ++with_epoch)
+    {
+        epoch_t *epoch = with_epoch ? epoch_create() : NULL;
+        tree_t tree;
+        tree_t sub_tree;
+        tree_init(&tree);
+        tree_init(&sub_tree);
+        ASSERT_EQ(1, tree_set_epoch(&tree, epoch));
+
+        /* p is full, it takes the sub tree root only with a table from the budget */
+        node_t *p = node_create_with(&allocator, INT, "p", &_2);
+        tree_add_node(&tree, node_create(INT, "a", &_1), NULL);
+        tree_add_node(&tree, p, "a");
+        tree_add_node(&tree, node_create(INT, "r", &_3), "a");
+
+        for (int i = 0; i < NODE_INLINE_CHILDREN; ++i)
+        {
+            tree_add_node(&tree, node_create(INT, ("p" + std::to_string(i)).c_str(), &_5), "p");
+        }
+
+        /* r is in conflict */
+        node_t *x = node_create(INT, "x", &_1);
+        node_t *r = node_create(INT, "r", &_4);
+        tree_add_node(&sub_tree, x, NULL);
+        tree_add_node(&sub_tree, r, "x");
+        tree_add_node(&sub_tree, node_create(INT, "y", &_6), "r");
+
+        budget.num_left = 0;
+        EXPECT_EQ(NULL, tree_add_tree(&tree, &sub_tree, "p"));
+        EXPECT_EQ(NODE_INLINE_CHILDREN, p->num_children);
+        EXPECT_EQ(x, sub_tree.root);
+        EXPECT_EQ(2, sub_tree.num_nodes);
+        EXPECT_EQ(r, tree_get_node(&sub_tree, "r"));
+        EXPECT_EQ(r, tree_get_node(&sub_tree, "y")->parent);
+        EXPECT_EQ(x, r->parent);
+
+        budget.num_left = -1;
+        EXPECT_EQ(x, tree_add_tree(&tree, &sub_tree, "p"));
+        EXPECT_EQ(NODE_INLINE_CHILDREN + 1, p->num_children);
+        EXPECT_EQ(&_3, tree_get_node(&tree, "r")->value);
+        EXPECT_EQ(x, tree_get_node(&tree, "y")->parent);
+
+        tree_clear(&tree);
+
+        if (epoch != NULL)
+        {
+            epoch_synchronize(epoch);
+            epoch_dispose(epoch);
+        }
+
+        EXPECT_EQ(0, num_in_use());
+    }
+}
+
+TEST_F(callocator_test, retired_memory_goes_back_to_its_allocator)
+{
+    epoch_t *epoch = epoch_create();
+    tree_t tree;
+    tree_init(&tree);
+    tree_set_allocator(&tree, &allocator);
+    ASSERT_EQ(1, tree_set_epoch(&tree, epoch));
+
+    tree_add_node(&tree, node_create_with(&allocator, INT, "a", &_1), NULL);
+
+    for (int i = 0; i < 100; ++i)
+    {
+        tree_add_node(&tree, node_create_with(&allocator, INT, ("n" + std::to_string(i)).c_str(), &_2), "a");
+    }
+
+    EXPECT_EQ(1, tree_remove_tree(&tree, "n0"));
+    EXPECT_EQ(1, tree_remove_node(&tree, "n1"));
+    tree_clear(&tree);
+    epoch_synchronize(epoch);
+    EXPECT_EQ(0, num_in_use());
+    EXPECT_EQ(0, allocator.num_bytes);
+    epoch_dispose(epoch);
+}
+
+int main(int argc, char **argv)
+{
+    ::testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
@@ -0,0 +1,221 @@
+#include <gtest/gtest.h>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "carena.h"
+#include "cepoch.h"
+#include "ctree.h"
+#include "test-helpers.h"
+
+/* enough nodes to fill a few slabs */
+static const int NUM_NODES = 5000;
+
+static std::string node_name(int n)
+{
+    return "n" + std::to_string(n);
+}
+
+TEST(tree_arena_t, functions_on_null_self)
+{
+    EXPECT_NO_FATAL_FAILURE(tree_arena_dispose(NULL));
+    EXPECT_EQ(NULL, tree_arena_alloc(NULL, 8));
+    EXPECT_NO_FATAL_FAILURE(tree_arena_free(NULL));
+    EXPECT_EQ(0, tree_arena_num_slabs(NULL));
+}
+
+TEST(tree_arena_t, blocks_are_aligned_and_distinct)
+{
+    tree_arena_t *arena = tree_arena_create();
+    std::vector<char *> blocks;
+
+    EXPECT_EQ(NULL, tree_arena_alloc(arena, 0));
+    EXPECT_EQ(0, tree_arena_num_slabs(arena));
+
+    for (size_t size = 1; size < 200; ++size)
+    {
+        char *block = static_cast<char *>(tree_arena_alloc(arena, size));
+        ASSERT_NE(static_cast<char *>(NULL), block);
+        EXPECT_EQ(0u, reinterpret_cast<std::uintptr_t>(block) % alignof(node_t));
+        memset(block, static_cast<int>(size), size);
+        blocks.push_back(block);
+    }
+
+    for (size_t i = 0; i < blocks.size(); ++i)
+    {
+        EXPECT_EQ(static_cast<char>(i + 1), blocks[i][i]);
+    }
+
+    EXPECT_EQ(1, tree_arena_num_slabs(arena));
+    tree_arena_dispose(arena);
+}
+
+TEST(tree_arena_t, slabs_are_released_when_empty)
+{
+    tree_arena_t *arena = tree_arena_create();
+    std::vector<void *> blocks;
+
+    for (int i = 0; i < 4000; ++i)
+    {
+        blocks.push_back(tree_arena_alloc(arena, 64));
+    }
+
+    int num_slabs = tree_arena_num_slabs(arena);
+    EXPECT_LT(2, num_slabs);
+
+    /* the first slab is full and not current any more */
+    tree_arena_free(blocks[0]);
+    EXPECT_EQ(num_slabs, tree_arena_num_slabs(arena));
+
+    for (int i = 1; i < 2000; ++i)
+    {
+        tree_arena_free(blocks[i]);
+    }
+
+    EXPECT_GT(num_slabs, tree_arena_num_slabs(arena));
+
+    for (size_t i = 2000; i < blocks.size(); ++i)
+    {
+        tree_arena_free(blocks[i]);
+    }
+
+    /* the current one is kept for reuse */
+    EXPECT_EQ(1, tree_arena_num_slabs(arena));
+    tree_arena_dispose(arena);
+}
+
+TEST(tree_arena_t, big_blocks_get_own_slabs)
+{
+    tree_arena_t *arena = tree_arena_create();
+    void *small = tree_arena_alloc(arena, 16);
+    char *big = static_cast<char *>(tree_arena_alloc(arena, 1024 * 1024));
+
+    ASSERT_NE(static_cast<char *>(NULL), big);
+    memset(big, 'x', 1024 * 1024);
+    EXPECT_EQ(2, tree_arena_num_slabs(arena));
+
+    /* the small one still bumps from the same slab */
+    void *next = tree_arena_alloc(arena, 16);
+    EXPECT_GT(static_cast<char *>(next), static_cast<char *>(small));
+
+    tree_arena_free(big);
+    EXPECT_EQ(1, tree_arena_num_slabs(arena));
+    tree_arena_free(small);
+    tree_arena_free(next);
+    tree_arena_dispose(arena);
+}
+
+TEST(tree_arena_t, node_name_is_inline)
+{
+    tree_arena_t *arena = tree_arena_create();
+    node_t *node = node_create_in(arena, INT, "abc", &_1);
+
+    ASSERT_NE(static_cast<node_t *>(NULL), node);
+    EXPECT_STREQ("abc", node->object_name);
+    EXPECT_EQ(reinterpret_cast<char *>(node + 1), node->object_name);
+    EXPECT_EQ(node_name_hash("abc"), node->name_hash);
+    EXPECT_EQ(NODE_FLAG_ARENA, node->flags);
+    EXPECT_EQ(&_1, node->value);
+
+    EXPECT_EQ(NULL, node_create_in(arena, NULL, "abc", &_1));
+    EXPECT_EQ(NULL, node_create_in(arena, INT, NULL, &_1));
+    EXPECT_EQ(NULL, node_create_in(arena, INT, "", &_1));
+
+    /* falls back to node_create() */
+    node_t *plain = node_create_in(NULL, INT, "def", &_2);
+    EXPECT_STREQ("def", plain->object_name);
+    EXPECT_EQ(0u, plain->flags);
+
+    node_dispose(plain);
+    node_dispose(node);
+    EXPECT_EQ(1, tree_arena_num_slabs(arena));
+    tree_arena_dispose(arena);
+}
+
+class carena_tree_test : public ::testing::Test
+{
+protected:
+    virtual void SetUp()
+    {
+        arena = tree_arena_create();
+        tree_init(&tree);
+        tree_add_node(&tree, node_create_in(arena, INT, "root", &_1), NULL);
+        tree_add_node(&tree, node_create_in(arena, INT, "a", &_2), "root");
+        tree_add_node(&tree, node_create_in(arena, INT, "b", &_3), "root");
+
+        /* a whole sub tree in slabs of its own */
+        for (int n = 0; n < NUM_NODES; ++n)
+        {
+            tree_add_node(&tree, node_create_in(arena, INT, node_name(n).c_str(), &_4), "a");
+        }
+
+        tree_add_node(&tree, node_create_in(arena, INT, "c", &_5), "b");
+    }
+
+    virtual void TearDown()
+    {
+        tree_clear(&tree);
+        tree_arena_dispose(arena);
+    }
+
+    tree_arena_t *arena;
+    tree_t tree;
+};
+
+TEST_F(carena_tree_test, nodes_from_an_arena_form_a_tree)
+{
+    EXPECT_EQ(NUM_NODES + 3, tree.num_nodes);
+    EXPECT_EQ(tree_get_node(&tree, "a"), tree_get_node(&tree, "n42")->parent);
+    EXPECT_EQ(1, tree_is_ancestor(&tree, "root", "c"));
+    EXPECT_LT(2, tree_arena_num_slabs(arena));
+}
+
+TEST_F(carena_tree_test, remove_tree_releases_whole_slabs)
+{
+    int num_slabs = tree_arena_num_slabs(arena);
+
+    EXPECT_EQ(NUM_NODES + 1, tree_remove_tree(&tree, "a"));
+    EXPECT_GT(num_slabs - 1, tree_arena_num_slabs(arena));
+    EXPECT_EQ(1, tree_remove_node(&tree, "c"));
+    EXPECT_EQ(tree_get_node(&tree, "b"), tree_get_node(&tree, "root")->children[0]);
+}
+
+TEST_F(carena_tree_test, clear_releases_all_slabs)
+{
+    tree_clear(&tree);
+    EXPECT_EQ(1, tree_arena_num_slabs(arena));
+
+    /* and the arena is good for another tree */
+    tree_add_node(&tree, node_create_in(arena, INT, "x", &_6), NULL);
+    tree_add_node(&tree, node_create_in(arena, INT, "y", &_7), "x");
+    EXPECT_EQ(1, tree.num_nodes);
+    EXPECT_EQ(1, tree_arena_num_slabs(arena));
+}
+
+TEST_F(carena_tree_test, retired_nodes_go_back_to_the_arena)
+{
+    epoch_t *epoch = epoch_create();
+    ASSERT_EQ(1, tree_set_epoch(&tree, epoch));
+    epoch_reader_t *reader = epoch_register(epoch);
+    int num_slabs = tree_arena_num_slabs(arena);
+
+    /* nothing goes back while a reader may still use it */
+    epoch_enter(reader);
+    EXPECT_EQ(NUM_NODES + 1, tree_remove_tree(&tree, "a"));
+    EXPECT_EQ(num_slabs, tree_arena_num_slabs(arena));
+    epoch_exit(reader);
+    epoch_unregister(reader);
+
+    epoch_synchronize(epoch);
+    EXPECT_GT(num_slabs - 1, tree_arena_num_slabs(arena));
+
+    tree_clear(&tree);
+    epoch_synchronize(epoch);
+    EXPECT_EQ(1, tree_arena_num_slabs(arena));
+    epoch_dispose(epoch);
+}
+
+int main(int argc, char **argv)
+{
+    ::testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
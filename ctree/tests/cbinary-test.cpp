@@ -0,0 +1,82 @@
+#include <gtest/gtest.h>
+#include <cstring>
+#include "cbinary.h"
+#include "test-helpers.h"
+
+static unsigned int round_trip(unsigned int number, int expected_size)
+{
+    unsigned char bytes[TREE_VARINT_MAX_SIZE];
+    const unsigned char *data = bytes;
+    unsigned int decoded = 0;
+
+    EXPECT_EQ(expected_size, tree_varint_encode(number, bytes));
+    EXPECT_EQ(1, tree_varint_decode(&data, bytes + expected_size, &decoded));
+    EXPECT_EQ(bytes + expected_size, data);
+    return decoded;
+}
+
+TEST(tree_varint, round_trip)
+{
+    EXPECT_EQ(0u, round_trip(0, 1));
+    EXPECT_EQ(0x7fu, round_trip(0x7fu, 1));
+    EXPECT_EQ(0x80u, round_trip(0x80u, 2));
+    EXPECT_EQ(0x0fffffffu, round_trip(0x0fffffffu, 4));
+    EXPECT_EQ(0x10000000u, round_trip(0x10000000u, 5));
+    EXPECT_EQ(0xffffffffu, round_trip(0xffffffffu, 5));
+}
+
+TEST(tree_varint, invalid_input_is_left_as_it_is)
+{
+    const unsigned char truncated[] = {0x80u, 0x80u};
+    const unsigned char too_large[] = {0xffu, 0xffu, 0xffu, 0xffu, 0x10u};
+    const unsigned char too_long[] = {0x80u, 0x80u, 0x80u, 0x80u, 0x80u, 0x00u};
+    const unsigned char *data = NULL;
+    unsigned int number = 0;
+
+    data = truncated;
+    EXPECT_EQ(0, tree_varint_decode(&data, truncated, &number));
+    EXPECT_EQ(0, tree_varint_decode(&data, truncated + sizeof(truncated), &number));
+    EXPECT_EQ(truncated, data);
+
+    /* the 5th byte only holds the 4 highest bits */
+    data = too_large;
+    EXPECT_EQ(0, tree_varint_decode(&data, too_large + sizeof(too_large), &number));
+    EXPECT_EQ(too_large, data);
+
+    data = too_long;
+    EXPECT_EQ(0, tree_varint_decode(&data, too_long + sizeof(too_long), &number));
+    EXPECT_EQ(too_long, data);
+}
+
+TEST(value_binary, payload_of_the_measured_size)
+{
+    char buffer[sizeof(int)] = {0};
+
+    EXPECT_EQ(static_cast<int>(sizeof(int)), value_binary_size(OWNED, &_123));
+    EXPECT_EQ(1, value_binary_write(OWNED, &_123, buffer, sizeof(int)));
+    EXPECT_EQ(0, memcmp(buffer, &_123, sizeof(int)));
+
+    /* a NULL value is an empty payload */
+    EXPECT_EQ(0, value_binary_size(OWNED, NULL));
+    EXPECT_EQ(1, value_binary_write(OWNED, NULL, NULL, 0));
+
+    /* the value changed since it was measured */
+    EXPECT_EQ(0, value_binary_write(OWNED, NULL, buffer, sizeof(int)));
+
+    /* no to_binary_fun */
+    EXPECT_EQ(-1, value_binary_size(INT, &_123));
+}
+
+TEST(tree_sync_dir, directory_of_the_file)
+{
+    EXPECT_EQ(1, tree_sync_dir(NULL, "cbinary-test.bin"));
+    EXPECT_EQ(1, tree_sync_dir(NULL, "./cbinary-test.bin"));
+    EXPECT_EQ(1, tree_sync_dir(NULL, "/cbinary-test.bin"));
+    EXPECT_EQ(0, tree_sync_dir(NULL, "no-such-directory/cbinary-test.bin"));
+}
+
+int main(int argc, char **argv)
+{
+    ::testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
@@ -0,0 +1,237 @@
+#include <gtest/gtest.h>
+#include <cstring>
+#include <string>
+#include "ccompact.h"
+#include "cjson.h"
+#include "ctree.h"
+#include "test-helpers.h"
+
+static std::string to_compact(tree_t *tree)
+{
+    std::string data(tree_to_compact(tree, NULL, 0), '\0');
+    EXPECT_EQ(static_cast<int>(data.size()), tree_to_compact(tree, &data[0], data.size()));
+    return data;
+}
+
+class ccompact_test : public ::testing::Test
+{
+protected:
+    virtual void SetUp()
+    {
+        g_num_disposed = 0;
+        tree_init(&tree);
+        tree_init(&decoded);
+
+        /*
+         *           /srv
+         *          /    \
+         *   /srv/data  /srv/log
+         *      |   \
+         *      |  /srv/data/b
+         *  /srv/data/a
+         */
+        add("/srv", 1, NULL);
+        add("/srv/data", 2, "/srv");
+        add("/srv/data/a", 3, "/srv/data");
+        add("/srv/data/b", 4, "/srv/data");
+        add("/srv/log", 5, "/srv");
+    }
+
+    virtual void TearDown()
+    {
+        tree_clear(&tree);
+        tree_clear(&decoded);
+    }
+
+    void add(const char *name, int value, const char *parent)
+    {
+        tree_add_node(&tree, node_create(OWNED, name, new int(value)), parent);
+    }
+
+    tree_t tree;
+    tree_t decoded;
+};
+
+TEST(tree_to_compact, functions_on_null_arguments)
+{
+    tree_t tree;
+    char data[16] = "CTRC\x01";
+
+    tree_init(&tree);
+
+    EXPECT_EQ(0, tree_to_compact(NULL, NULL, 0));
+    EXPECT_EQ(0, tree_to_compact(&tree, NULL, 1));
+    EXPECT_EQ(0, tree_from_compact(NULL, OWNED, data, 6));
+    EXPECT_EQ(0, tree_from_compact(&tree, NULL, data, 6));
+    EXPECT_EQ(0, tree_from_compact(&tree, OWNED, NULL, 6));
+}
+
+TEST(tree_to_compact, empty_tree)
+{
+    tree_t tree;
+    char data[16];
+
+    tree_init(&tree);
+
+    ASSERT_EQ(6, tree_to_compact(&tree, data, sizeof(data)));
+    EXPECT_EQ(0, memcmp("CTRC\x01\x00", data, 6));
+    EXPECT_EQ(1, tree_from_compact(&tree, OWNED, data, 6));
+    EXPECT_EQ(NULL, tree.root);
+}
+
+TEST(tree_to_compact, names_are_front_coded_and_parents_relative)
+{
+    tree_t tree;
+    int one = 1;
+    int two = 2;
+
+    tree_init(&tree);
+    tree_add_node(&tree, node_create(OWNED, "ab", new int(one)), NULL);
+    tree_add_node(&tree, node_create(OWNED, "abc", new int(two)), "ab");
+
+    std::string expected("CTRC\x01\x02", 6);
+    expected += std::string("\x00\x00\x02" "ab\x04", 6) + std::string(reinterpret_cast<char *>(&one), sizeof(int));
+    expected += std::string("\x01\x02\x01" "c\x04", 5) + std::string(reinterpret_cast<char *>(&two), sizeof(int));
+
+    EXPECT_EQ(expected, to_compact(&tree));
+
+    tree_clear(&tree);
+}
+
+TEST_F(ccompact_test, decoding_gives_the_same_tree)
+{
+    std::string data = to_compact(&tree);
+
+    ASSERT_EQ(1, tree_from_compact(&decoded, OWNED, data.data(), data.size()));
+    EXPECT_EQ(4, decoded.num_nodes);
+    EXPECT_EQ(to_json(&tree), to_json(&decoded));
+    EXPECT_EQ(0, g_num_disposed);
+}
+
+TEST_F(ccompact_test, null_values_are_decoded)
+{
+    tree_add_node(&tree, node_create(OWNED, "/srv/log/tmp", NULL), "/srv/log");
+    std::string data = to_compact(&tree);
+
+    ASSERT_EQ(1, tree_from_compact(&decoded, OWNED, data.data(), data.size()));
+    EXPECT_EQ(5, decoded.num_nodes);
+    EXPECT_EQ(NULL, tree_get_node(&decoded, "/srv/log/tmp")->value);
+    EXPECT_EQ(to_json(&tree), to_json(&decoded));
+    EXPECT_EQ(0, g_num_disposed);
+}
+
+TEST_F(ccompact_test, long_shared_prefixes_are_not_repeated)
+{
+    /* three varints and the value size per node, then "/srv", "/data", "/a", "b" and "log" */
+    EXPECT_EQ(6 + 5 * (4 + sizeof(int)) + 4 + 5 + 2 + 1 + 3, to_compact(&tree).size());
+}
+
+TEST_F(ccompact_test, subtree_is_encoded_with_its_root_as_the_root)
+{
+    std::string data(tree_subtree_to_compact(&tree, "/srv/data", NULL, 0), '\0');
+    tree_t expected;
+
+    ASSERT_EQ(static_cast<int>(data.size()), tree_subtree_to_compact(&tree, "/srv/data", &data[0], data.size()));
+    ASSERT_EQ(1, tree_from_compact(&decoded, OWNED, data.data(), data.size()));
+
+    tree_init(&expected);
+    tree_add_node(&expected, node_create(OWNED, "/srv/data", new int(2)), NULL);
+    tree_add_node(&expected, node_create(OWNED, "/srv/data/a", new int(3)), "/srv/data");
+    tree_add_node(&expected, node_create(OWNED, "/srv/data/b", new int(4)), "/srv/data");
+    EXPECT_EQ(to_json(&expected), to_json(&decoded));
+    tree_clear(&expected);
+
+    EXPECT_EQ(0, tree_subtree_to_compact(NULL, "/srv", NULL, 0));
+    EXPECT_EQ(0, tree_subtree_to_compact(&tree, NULL, NULL, 0));
+    EXPECT_EQ(0, tree_subtree_to_compact(&tree, "/srv/tmp", NULL, 0));
+    EXPECT_EQ(to_compact(&tree).size(), static_cast<size_t>(tree_subtree_to_compact(&tree, "/srv", NULL, 0)));
+}
+
+TEST_F(ccompact_test, output_follows_the_snprintf_convention)
+{
+    std::string data = to_compact(&tree);
+    std::string partial(data.size() + 1, '#');
+
+    for (size_t size = 0; size < data.size(); ++size)
+    {
+        EXPECT_EQ(static_cast<int>(data.size()), tree_to_compact(&tree, &partial[0], size));
+        EXPECT_EQ('#', partial[data.size()]);
+    }
+}
+
+TEST_F(ccompact_test, values_without_binary_handlers_fail)
+{
+    std::string data = to_compact(&tree);
+
+    tree_add_node(&tree, node_create(INT, "/srv/tmp", &_1), "/srv");
+
+    EXPECT_EQ(0, tree_to_compact(&tree, NULL, 0));
+    EXPECT_EQ(0, tree_from_compact(&decoded, INT, data.data(), data.size()));
+}
+
+TEST_F(ccompact_test, decoding_into_a_non_empty_tree_fails)
+{
+    std::string data = to_compact(&tree);
+
+    EXPECT_EQ(0, tree_from_compact(&tree, OWNED, data.data(), data.size()));
+    EXPECT_EQ(0, g_num_disposed);
+}
+
+TEST_F(ccompact_test, truncated_input_fails)
+{
+    std::string data = to_compact(&tree);
+
+    for (size_t size = 0; size < data.size(); ++size)
+    {
+        EXPECT_EQ(0, tree_from_compact(&decoded, OWNED, data.data(), size)) << size;
+        EXPECT_EQ(NULL, decoded.root);
+    }
+
+    data += '\0';
+    EXPECT_EQ(0, tree_from_compact(&decoded, OWNED, data.data(), data.size()));
+}
+
+TEST_F(ccompact_test, broken_input_fails_and_disposes_of_the_values)
+{
+    std::string data = to_compact(&tree);
+    std::string broken;
+
+    broken = data;
+    broken[0] = 'X';
+    EXPECT_EQ(0, tree_from_compact(&decoded, OWNED, broken.data(), broken.size()));
+
+    broken = data;
+    broken[4] = TREE_COMPACT_VERSION + 1;
+    EXPECT_EQ(0, tree_from_compact(&decoded, OWNED, broken.data(), broken.size()));
+
+    /* more nodes than the input can hold */
+    broken = data;
+    broken[5] = 0x7f;
+    EXPECT_EQ(0, tree_from_compact(&decoded, OWNED, broken.data(), broken.size()));
+
+    /* the last node, "log", points to a parent past the root */
+    broken = data;
+    broken[data.size() - sizeof(int) - 1 - 3 - 3] = 5;
+    g_num_disposed = 0;
+    EXPECT_EQ(0, tree_from_compact(&decoded, OWNED, broken.data(), broken.size()));
+    EXPECT_EQ(4, g_num_disposed);
+
+    /* and to itself */
+    broken[data.size() - sizeof(int) - 1 - 3 - 3] = 0;
+    EXPECT_EQ(0, tree_from_compact(&decoded, OWNED, broken.data(), broken.size()));
+
+    /* "/srv/log" becomes "/srv/data", a duplicate */
+    broken = data;
+    broken.replace(data.size() - sizeof(int) - 1 - 3, 3, "ata");
+    broken[data.size() - sizeof(int) - 1 - 3 - 2] = 6;
+    g_num_disposed = 0;
+    EXPECT_EQ(0, tree_from_compact(&decoded, OWNED, broken.data(), broken.size()));
+    EXPECT_EQ(5, g_num_disposed);
+    EXPECT_EQ(NULL, decoded.root);
+}
+
+int main(int argc, char **argv)
+{
+    ::testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
@@ -0,0 +1,248 @@
+#include <gtest/gtest.h>
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <thread>
+#include <vector>
+#include "cconcurrent.h"
+#include "test-helpers.h"
+
+static int count_nodes(node_t *, void *ctx)
+{
+    ++*static_cast<int *>(ctx);
+    return 0;
+}
+
+static int num_writers_waiting(tree_rwlock_t *lock)
+{
+    pthread_mutex_lock(&lock->mutex);
+    int num = lock->num_writers_waiting;
+    pthread_mutex_unlock(&lock->mutex);
+    return num;
+}
+
+TEST(tree_concurrent_t, functions_on_null_self)
+{
+    EXPECT_EQ(0, tree_rwlock_init(NULL));
+    EXPECT_NO_FATAL_FAILURE(tree_rwlock_dispose(NULL));
+    EXPECT_EQ(0, tree_concurrent_init(NULL));
+    EXPECT_NO_FATAL_FAILURE(tree_concurrent_dispose(NULL));
+    EXPECT_EQ(NULL, tree_concurrent_read_lock(NULL));
+    EXPECT_NO_FATAL_FAILURE(tree_concurrent_read_unlock(NULL));
+    EXPECT_EQ(NULL, tree_concurrent_write_lock(NULL));
+    EXPECT_NO_FATAL_FAILURE(tree_concurrent_write_unlock(NULL));
+    EXPECT_EQ(NULL, tree_concurrent_get_node(NULL, "a"));
+    EXPECT_EQ(NULL, tree_concurrent_add_node(NULL, NULL, NULL));
+    EXPECT_EQ(NULL, tree_concurrent_add_tree(NULL, NULL, NULL));
+    EXPECT_EQ(0, tree_concurrent_remove_node(NULL, "a"));
+    EXPECT_EQ(0, tree_concurrent_remove_tree(NULL, "a"));
+    EXPECT_EQ(0, tree_concurrent_depth(NULL));
+    EXPECT_EQ(0, tree_concurrent_is_ancestor(NULL, "a", "a"));
+    EXPECT_EQ(0, tree_concurrent_subtree_size(NULL, "a"));
+    EXPECT_EQ(NULL, tree_concurrent_lca(NULL, "a", "a"));
+    EXPECT_EQ(NULL, tree_concurrent_kth_ancestor(NULL, "a", 0));
+    EXPECT_EQ(-1, tree_concurrent_for_each(NULL, TREE_ITER_PRE_ORDER, count_nodes, NULL));
+}
+
+//
+// a---+
+// |   |
+// b-+ e
+// | | |
+// c d f
+//
+TEST(tree_concurrent_t, operations_match_tree_t)
+{
+    tree_concurrent_t t;
+    ASSERT_EQ(1, tree_concurrent_init(&t));
+
+    node_t *a = node_create(INT, "a", &_1);
+    EXPECT_EQ(a, tree_concurrent_add_node(&t, a, NULL));
+    tree_concurrent_add_node(&t, node_create(INT, "b", &_2), "a");
+    tree_concurrent_add_node(&t, node_create(INT, "c", &_3), "b");
+    tree_concurrent_add_node(&t, node_create(INT, "d", &_4), "b");
+
+    tree_t sub_tree;
+    tree_init(&sub_tree);
+    node_t *e = node_create(INT, "e", &_5);
+    tree_add_node(&sub_tree, e, NULL);
+    tree_add_node(&sub_tree, node_create(INT, "f", &_6), "e");
+    EXPECT_EQ(e, tree_concurrent_add_tree(&t, &sub_tree, "a"));
+
+    EXPECT_EQ(a, tree_concurrent_get_node(&t, "a"));
+    EXPECT_EQ(3, tree_concurrent_depth(&t));
+    EXPECT_EQ(1, tree_concurrent_is_ancestor(&t, "a", "f"));
+    EXPECT_EQ(0, tree_concurrent_is_ancestor(&t, "b", "f"));
+    EXPECT_EQ(3, tree_concurrent_subtree_size(&t, "b"));
+    EXPECT_EQ(a, tree_concurrent_lca(&t, "c", "f"));
+    EXPECT_EQ(e, tree_concurrent_kth_ancestor(&t, "f", 1));
+
+    int cnt = 0;
+    EXPECT_EQ(6, tree_concurrent_for_each(&t, TREE_ITER_LEVEL_ORDER, count_nodes, &cnt));
+    EXPECT_EQ(6, cnt);
+
+    EXPECT_EQ(1, tree_concurrent_remove_node(&t, "e"));
+    EXPECT_EQ(a, tree_concurrent_kth_ancestor(&t, "f", 1));
+    EXPECT_EQ(3, tree_concurrent_remove_tree(&t, "b"));
+    EXPECT_EQ(2, tree_concurrent_subtree_size(&t, "a"));
+
+    tree_t *tree = tree_concurrent_read_lock(&t);
+    EXPECT_EQ(&t.tree, tree);
+    EXPECT_EQ(1, tree->num_nodes);
+    tree_concurrent_read_unlock(&t);
+
+    tree = tree_concurrent_write_lock(&t);
+    EXPECT_EQ(1, tree_remove_node(tree, "f"));
+    tree_concurrent_write_unlock(&t);
+    EXPECT_EQ(1, tree_concurrent_depth(&t));
+
+    tree_concurrent_dispose(&t);
+}
+
+TEST(tree_rwlock_t, readers_share_the_lock)
+{
+    tree_rwlock_t lock;
+    ASSERT_EQ(1, tree_rwlock_init(&lock));
+    tree_rwlock_lock_shared(&lock);
+
+    std::atomic<bool> acquired(false);
+    std::thread reader([&] {
+        tree_rwlock_lock_shared(&lock);
+        acquired = true;
+        tree_rwlock_unlock_shared(&lock);
+    });
+    reader.join();
+    EXPECT_TRUE(acquired.load());
+
+    tree_rwlock_unlock_shared(&lock);
+    tree_rwlock_dispose(&lock);
+}
+
+TEST(tree_rwlock_t, waiting_writer_goes_before_new_readers)
+{
+    tree_rwlock_t lock;
+    ASSERT_EQ(1, tree_rwlock_init(&lock));
+    tree_rwlock_lock_shared(&lock);
+
+    std::atomic<int> order(0);
+    std::atomic<int> writer_done_at(-1);
+    std::atomic<int> reader_done_at(-1);
+
+    std::thread writer([&] {
+        tree_rwlock_lock_exclusive(&lock);
+        writer_done_at = order++;
+        tree_rwlock_unlock_exclusive(&lock);
+    });
+
+    while (num_writers_waiting(&lock) == 0 && !__atomic_load_n(&lock.writer, __ATOMIC_SEQ_CST))
+    {
+        std::this_thread::yield();
+    }
+
+    std::thread reader([&] {
+        tree_rwlock_lock_shared(&lock);
+        reader_done_at = order++;
+        tree_rwlock_unlock_shared(&lock);
+    });
+
+    /* the new reader has to wait for the writer, which waits for the first reader */
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    EXPECT_EQ(-1, writer_done_at.load());
+    EXPECT_EQ(-1, reader_done_at.load());
+
+    tree_rwlock_unlock_shared(&lock);
+    writer.join();
+    reader.join();
+    EXPECT_EQ(0, writer_done_at.load());
+    EXPECT_EQ(1, reader_done_at.load());
+
+    tree_rwlock_dispose(&lock);
+}
+
+TEST(tree_concurrent_t, readers_and_writers_at_once)
+{
+    const int num_readers = 8;
+    const int num_writers = 2;
+    const int num_rounds = 2000;
+    std::vector<std::string> names;
+    std::vector<std::thread> threads;
+    std::atomic<int> num_errors(0);
+    std::atomic<bool> writers_done(false);
+    tree_concurrent_t t;
+
+    ASSERT_EQ(1, tree_concurrent_init(&t));
+    tree_concurrent_add_node(&t, node_create(INT, "root", &_1), NULL);
+
+    for (int i = 0; i < num_writers * num_rounds; ++i)
+    {
+        names.push_back("n" + std::to_string(i));
+    }
+
+    /* each writer adds a chain of 2 nodes under root in one go and removes it again */
+    for (int w = 0; w < num_writers; ++w)
+    {
+        threads.push_back(std::thread([&, w] {
+            for (int i = w * num_rounds; i < (w + 1) * num_rounds; i += 2)
+            {
+                const char *name = names[i].c_str();
+                tree_t chain;
+                tree_init(&chain);
+                tree_add_node(&chain, node_create(INT, name, &_2), NULL);
+                tree_add_node(&chain, node_create(INT, names[i + 1].c_str(), &_3), name);
+                tree_concurrent_add_tree(&t, &chain, "root");
+
+                if (tree_concurrent_remove_tree(&t, name) != 2)
+                {
+                    ++num_errors;
+                }
+            }
+        }));
+    }
+
+    for (int r = 0; r < num_readers; ++r)
+    {
+        threads.push_back(std::thread([&] {
+            while (!writers_done)
+            {
+                int cnt = 0;
+                tree_t *tree = tree_concurrent_read_lock(&t);
+
+                /* the root and whole chains only */
+                if ((tree->num_nodes % 2 != 0) || (tree_depth(tree) > 3))
+                {
+                    ++num_errors;
+                }
+
+                tree_concurrent_read_unlock(&t);
+
+                if ((tree_concurrent_for_each(&t, TREE_ITER_PRE_ORDER, count_nodes, &cnt) != cnt) ||
+                    (tree_concurrent_subtree_size(&t, "root") < 1))
+                {
+                    ++num_errors;
+                }
+            }
+        }));
+    }
+
+    for (int w = 0; w < num_writers; ++w)
+    {
+        threads[w].join();
+    }
+
+    writers_done = true;
+
+    for (int r = 0; r < num_readers; ++r)
+    {
+        threads[num_writers + r].join();
+    }
+
+    EXPECT_EQ(0, num_errors.load());
+    EXPECT_EQ(1, tree_concurrent_subtree_size(&t, "root"));
+    tree_concurrent_dispose(&t);
+}
+
+int main(int argc, char **argv)
+{
+    ::testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
@@ -0,0 +1,418 @@
+#include <gtest/gtest.h>
+#include <atomic>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+#include "cepoch.h"
+#include "ctree.h"
+#include "test-helpers.h"
+
+static int g_num_freed = 0;
+
+static void count_free(void *ptr)
+{
+    ++g_num_freed;
+    free(ptr);
+}
+
+/* ctx counts the calls */
+static void count_free_with(void *ptr, void *ctx)
+{
+    ++*static_cast<int *>(ctx);
+    free(ptr);
+}
+
+static std::string children_names(node_t *node)
+{
+    std::string names;
+    node_t **children = tree_node_children(node);
+
+    for (; (children != NULL) && (*children != NULL); ++children)
+    {
+        names += (*children)->object_name;
+    }
+
+    return names;
+}
+
+static int append_name(node_t *node, void *ctx)
+{
+    *static_cast<std::string *>(ctx) += node->object_name;
+    return 0;
+}
+
+/* tree takes ownership of the node only if it was added */
+static void add_or_dispose(tree_t *tree, const std::string &name, int *value, const char *parent_name)
+{
+    node_t *node = node_create(INT, name.c_str(), value);
+
+    if (tree_add_node(tree, node, parent_name) == NULL)
+    {
+        node_dispose(node);
+    }
+}
+
+static std::string pre_order_names(tree_t *tree)
+{
+    std::string names;
+    tree_for_each(tree, TREE_ITER_PRE_ORDER, append_name, &names);
+    return names;
+}
+
+TEST(epoch_t, functions_on_null_self)
+{
+    EXPECT_NO_FATAL_FAILURE(epoch_dispose(NULL));
+    EXPECT_EQ(NULL, epoch_register(NULL));
+    EXPECT_NO_FATAL_FAILURE(epoch_unregister(NULL));
+    EXPECT_NO_FATAL_FAILURE(epoch_enter(NULL));
+    EXPECT_NO_FATAL_FAILURE(epoch_exit(NULL));
+    EXPECT_NO_FATAL_FAILURE(epoch_retire(NULL, NULL, count_free));
+    EXPECT_NO_FATAL_FAILURE(epoch_retire_with(NULL, NULL, count_free_with, NULL));
+    EXPECT_EQ(0, epoch_reclaim(NULL));
+    EXPECT_NO_FATAL_FAILURE(epoch_synchronize(NULL));
+    EXPECT_EQ(0, epoch_num_pending(NULL));
+    EXPECT_EQ(0, tree_set_epoch(NULL, NULL));
+    EXPECT_EQ(NULL, tree_node_children(NULL));
+}
+
+TEST(epoch_t, retired_memory_outlives_readers_inside)
+{
+    epoch_t *epoch = epoch_create();
+    ASSERT_NE(static_cast<epoch_t *>(NULL), epoch);
+    epoch_reader_t *reader = epoch_register(epoch);
+    ASSERT_NE(static_cast<epoch_reader_t *>(NULL), reader);
+
+    g_num_freed = 0;
+    epoch_enter(reader);
+    epoch_retire(epoch, malloc(1), count_free);
+    EXPECT_EQ(1, epoch_num_pending(epoch));
+
+    for (int i = 0; i < 10; ++i)
+    {
+        EXPECT_EQ(0, epoch_reclaim(epoch));
+    }
+
+    EXPECT_EQ(0, g_num_freed);
+
+    epoch_exit(reader);
+    epoch_synchronize(epoch);
+    EXPECT_EQ(1, g_num_freed);
+    EXPECT_EQ(0, epoch_num_pending(epoch));
+
+    /* retired before the reader entered, so it does not have to wait for it */
+    epoch_retire(epoch, malloc(1), count_free);
+    epoch_reclaim(epoch);
+    epoch_enter(reader);
+    epoch_reclaim(epoch);
+    epoch_reclaim(epoch);
+    EXPECT_EQ(2, g_num_freed);
+    epoch_exit(reader);
+
+    epoch_unregister(reader);
+    epoch_dispose(epoch);
+}
+
+TEST(epoch_t, dispose_frees_pending_memory)
+{
+    epoch_t *epoch = epoch_create();
+    epoch_reader_t *reader = epoch_register(epoch);
+
+    g_num_freed = 0;
+    epoch_enter(reader);
+
+    /* more than what triggers reclaiming on its own */
+    for (int i = 0; i < 1000; ++i)
+    {
+        epoch_retire(epoch, malloc(1), count_free);
+    }
+
+    EXPECT_EQ(0, g_num_freed);
+    EXPECT_EQ(1000, epoch_num_pending(epoch));
+    epoch_exit(reader);
+
+    epoch_dispose(epoch);
+    EXPECT_EQ(1000, g_num_freed);
+}
+
+TEST(epoch_t, retired_with_context)
+{
+    epoch_t *epoch = epoch_create();
+    epoch_reader_t *reader = epoch_register(epoch);
+    int num_freed = 0;
+
+    epoch_enter(reader);
+    epoch_retire_with(epoch, malloc(1), count_free_with, &num_freed);
+    epoch_retire_with(epoch, &num_freed, NULL, &num_freed);
+    EXPECT_EQ(1, epoch_num_pending(epoch));
+    epoch_exit(reader);
+
+    epoch_synchronize(epoch);
+    EXPECT_EQ(1, num_freed);
+
+    epoch_unregister(reader);
+    epoch_dispose(epoch);
+}
+
+TEST(epoch_t, reader_records_are_reused)
+{
+    epoch_t *epoch = epoch_create();
+    epoch_reader_t *a = epoch_register(epoch);
+    epoch_reader_t *b = epoch_register(epoch);
+
+    EXPECT_NE(a, b);
+    epoch_unregister(a);
+    EXPECT_EQ(a, epoch_register(epoch));
+
+    epoch_dispose(epoch);
+}
+
+//
+// a---+
+// |   |
+// b-+ e
+// | | |
+// c d f
+//
+class cepoch_tree_test : public ::testing::Test
+{
+protected:
+    virtual void SetUp()
+    {
+        epoch = epoch_create();
+        tree_init(&tree);
+        tree_add_node(&tree, node_create(INT, "a", &_1), NULL);
+        tree_add_node(&tree, node_create(INT, "b", &_2), "a");
+        tree_add_node(&tree, node_create(INT, "c", &_3), "b");
+        ASSERT_EQ(1, tree_set_epoch(&tree, epoch));
+        tree_add_node(&tree, node_create(INT, "d", &_4), "b");
+        tree_add_node(&tree, node_create(INT, "e", &_5), "a");
+        tree_add_node(&tree, node_create(INT, "f", &_6), "e");
+        epoch_synchronize(epoch);
+    }
+
+    virtual void TearDown()
+    {
+        tree_clear(&tree);
+        epoch_dispose(epoch);
+    }
+
+    epoch_t *epoch;
+    tree_t tree;
+};
+
+TEST_F(cepoch_tree_test, children_tables_are_null_terminated)
+{
+    EXPECT_EQ("be", children_names(tree_get_node(&tree, "a")));
+    EXPECT_EQ("cd", children_names(tree_get_node(&tree, "b")));
+    EXPECT_EQ("", children_names(tree_get_node(&tree, "c")));
+    EXPECT_EQ("abcdef", pre_order_names(&tree));
+    EXPECT_EQ(3, tree_depth(&tree));
+}
+
+TEST_F(cepoch_tree_test, removed_nodes_are_retired)
+{
+    node_t *b = tree_get_node(&tree, "b");
+    node_t **children = tree_node_children(tree_get_node(&tree, "a"));
+
+    EXPECT_EQ(1, tree_remove_node(&tree, "b"));
+    EXPECT_EQ(NULL, tree_get_node(&tree, "b"));
+    EXPECT_EQ("cde", children_names(tree_get_node(&tree, "a")));
+    EXPECT_EQ(tree_get_node(&tree, "a"), tree_get_node(&tree, "c")->parent);
+    EXPECT_EQ(2, epoch_num_pending(epoch));
+
+    /* nothing is freed yet, readers may still use what they got */
+    EXPECT_STREQ("b", b->object_name);
+    EXPECT_EQ(b, children[0]);
+
+    EXPECT_EQ(2, tree_remove_tree(&tree, "e"));
+    EXPECT_EQ(NULL, tree_get_node(&tree, "f"));
+    EXPECT_EQ("cd", children_names(tree_get_node(&tree, "a")));
+    EXPECT_EQ(2, tree_depth(&tree));
+    EXPECT_EQ(3, tree_subtree_size(&tree, "a"));
+
+    epoch_synchronize(epoch);
+    EXPECT_EQ(0, epoch_num_pending(epoch));
+}
+
+TEST_F(cepoch_tree_test, add_tree_drops_conflicts)
+{
+    tree_t sub_tree;
+    tree_init(&sub_tree);
+    node_t *g = node_create(INT, "g", &_7);
+    tree_add_node(&sub_tree, g, NULL);
+    tree_add_node(&sub_tree, node_create(INT, "c", &_8), "g");
+    tree_add_node(&sub_tree, node_create(INT, "h", &_9), "c");
+
+    EXPECT_EQ(g, tree_add_tree(&tree, &sub_tree, "f"));
+    EXPECT_EQ(NULL, sub_tree.root);
+    EXPECT_EQ(7, tree.num_nodes);
+    EXPECT_EQ("h", children_names(g));
+    EXPECT_EQ(g, tree_get_node(&tree, "h")->parent);
+    EXPECT_EQ("abcdefgh", pre_order_names(&tree));
+    EXPECT_EQ(5, tree_depth(&tree));
+}
+
+TEST_F(cepoch_tree_test, clear_keeps_the_epoch)
+{
+    tree_clear(&tree);
+    EXPECT_EQ(epoch, tree.epoch);
+    EXPECT_EQ(NULL, tree_get_node(&tree, "a"));
+    EXPECT_EQ(7, epoch_num_pending(epoch));
+
+    node_t *nodes[] = {
+        node_create(INT, "x", &_1),
+        node_create(INT, "y", &_2),
+        node_create(INT, "z", &_3)};
+    const char *parent_names[] = {NULL, "x", "x"};
+    ASSERT_EQ(TREE_BUILD_OK, tree_build(&tree, nodes, parent_names, 3, NULL));
+    EXPECT_EQ(epoch, tree.epoch);
+    EXPECT_EQ("yz", children_names(nodes[0]));
+
+    tree_t sub_tree;
+    tree_init(&sub_tree);
+    node_t *w = node_create(INT, "w", &_4);
+    tree_add_node(&sub_tree, w, NULL);
+    tree_add_node(&sub_tree, node_create(INT, "v", &_5), "w");
+    EXPECT_EQ(3, tree_remove_tree(&tree, "x"));
+    EXPECT_EQ(w, tree_add_tree(&tree, &sub_tree, NULL));
+    EXPECT_EQ(epoch, tree.epoch);
+    EXPECT_EQ("v", children_names(tree_get_node(&tree, "w")));
+}
+
+TEST(cepoch_tree, lock_free_readers_and_a_writer)
+{
+    const int num_readers = 4;
+    const int num_fixed = 64;
+    const int num_temporary = 256;
+    const int num_rounds = 20000;
+    std::vector<std::string> fixed_names;
+    std::vector<std::string> temporary_names;
+    std::vector<std::thread> readers;
+    std::atomic<int> num_errors(0);
+    std::atomic<int> num_lookups(0);
+    std::atomic<bool> writer_done(false);
+    epoch_t *epoch = epoch_create();
+    tree_t tree;
+
+    for (int i = 0; i < num_fixed; ++i)
+    {
+        fixed_names.push_back("k" + std::to_string(i));
+    }
+
+    for (int i = 0; i < num_temporary; ++i)
+    {
+        temporary_names.push_back("t" + std::to_string(i));
+    }
+
+    tree_init(&tree);
+    ASSERT_EQ(1, tree_set_epoch(&tree, epoch));
+    tree_add_node(&tree, node_create(INT, "root", &_1), NULL);
+
+    for (int i = 0; i < num_fixed; ++i)
+    {
+        tree_add_node(&tree, node_create(INT, fixed_names[i].c_str(), &_2), "root");
+    }
+
+    for (int r = 0; r < num_readers; ++r)
+    {
+        readers.push_back(std::thread([&, r] {
+            epoch_reader_t *reader = epoch_register(epoch);
+            std::mt19937 random(r);
+
+            while (!writer_done)
+            {
+                epoch_enter(reader);
+
+                /* fixed nodes are never removed, temporary ones come and go */
+                const std::string &fixed_name = fixed_names[random() % num_fixed];
+                const std::string &temporary_name = temporary_names[random() % num_temporary];
+                node_t *fixed = tree_get_node(&tree, fixed_name.c_str());
+                node_t *temporary = tree_get_node(&tree, temporary_name.c_str());
+
+                if ((fixed == NULL) || (fixed_name != fixed->object_name) ||
+                    ((temporary != NULL) && (temporary_name != temporary->object_name)))
+                {
+                    ++num_errors;
+                }
+
+                /* whatever the writer does, tables and nodes stay readable until epoch_exit() */
+                for (node_t **child = tree_node_children(fixed); (child != NULL) && (*child != NULL); ++child)
+                {
+                    if (((*child)->object_name[0] != 't') || (*static_cast<int *>((*child)->value) < 1))
+                    {
+                        ++num_errors;
+                    }
+
+                    children_names(*child);
+                }
+
+                epoch_exit(reader);
+                ++num_lookups;
+            }
+
+            epoch_unregister(reader);
+        }));
+    }
+
+    std::mt19937 random(123);
+
+    for (int i = 0; i < num_rounds; ++i)
+    {
+        const std::string &name = temporary_names[random() % num_temporary];
+        const char *fixed_parent = fixed_names[random() % num_fixed].c_str();
+        const char *parent = (random() % 2) ? temporary_names[random() % num_temporary].c_str() : fixed_parent;
+
+        switch (random() % 4)
+        {
+        case 0:
+            add_or_dispose(&tree, name, &_3, parent);
+            break;
+        case 1:
+            tree_remove_node(&tree, name.c_str());
+            break;
+        case 2:
+        {
+            /* conflicting names are dropped, a conflicting root fails the whole sub tree */
+            tree_t sub_tree;
+            tree_init(&sub_tree);
+            add_or_dispose(&sub_tree, name, &_4, NULL);
+            add_or_dispose(&sub_tree, temporary_names[random() % num_temporary], &_5, name.c_str());
+            add_or_dispose(&sub_tree, temporary_names[random() % num_temporary], &_6, name.c_str());
+            tree_add_tree(&tree, &sub_tree, fixed_parent);
+            tree_clear(&sub_tree);
+            break;
+        }
+        default:
+            tree_remove_tree(&tree, name.c_str());
+            break;
+        }
+    }
+
+    writer_done = true;
+
+    for (int r = 0; r < num_readers; ++r)
+    {
+        readers[r].join();
+    }
+
+    EXPECT_EQ(0, num_errors.load());
+    EXPECT_LT(0, num_lookups.load());
+    EXPECT_EQ(tree.num_nodes + 1, tree_subtree_size(&tree, "root"));
+
+    for (int i = 0; i < tree.num_nodes; ++i)
+    {
+        EXPECT_EQ(tree.nodes[i], tree_get_node(&tree, tree.nodes[i]->object_name));
+    }
+
+    tree_clear(&tree);
+    epoch_synchronize(epoch);
+    EXPECT_EQ(0, epoch_num_pending(epoch));
+    epoch_dispose(epoch);
+}
+
+int main(int argc, char **argv)
+{
+    ::testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
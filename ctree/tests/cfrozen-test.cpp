@@ -0,0 +1,492 @@
+#include <gtest/gtest.h>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include "cfrozen.h"
+#include "ctree.h"
+#include "test-helpers.h"
+
+static const char *SNAPSHOT = "cfrozen-test.bin";
+
+static std::string pre_order_names(const tree_frozen_t *frozen, int start)
+{
+    std::string names;
+
+    tree_frozen_for_each(
+        frozen,
+        start,
+        [](const tree_frozen_t *f, int node, void *ctx)
+        {
+            *static_cast<std::string *>(ctx) += tree_frozen_name(f, node);
+            return 0;
+        },
+        &names);
+
+    return names;
+}
+
+static std::string pre_order_names(tree_t *tree)
+{
+    std::string names;
+
+    tree_for_each(
+        tree,
+        TREE_ITER_PRE_ORDER,
+        [](node_t *node, void *ctx)
+        {
+            *static_cast<std::string *>(ctx) += node->object_name;
+            return 0;
+        },
+        &names);
+
+    return names;
+}
+
+class cfrozen_test : public ::testing::Test
+{
+protected:
+    virtual void SetUp()
+    {
+        g_num_disposed = 0;
+        tree_init(&tree);
+
+        /*
+         *        a
+         *      /   \
+         *     b     g
+         *   / | \   |
+         *  c  e  d  h
+         *     |
+         *     f
+         */
+        add("a", 1, NULL);
+        add("b", 2, "a");
+        add("c", 3, "b");
+        add("d", 4, "b");
+        add("e", 3, "b");
+        add("f", 5, "e");
+        add("g", 6, "a");
+        add("h", 7, "g");
+    }
+
+    virtual void TearDown()
+    {
+        tree_clear(&tree);
+    }
+
+    void add(const char *name, int value, const char *parent)
+    {
+        tree_add_node(&tree, node_create(OWNED, name, new int(value)), parent);
+    }
+
+    tree_t tree;
+};
+
+TEST(tree_frozen_t, functions_on_null_self)
+{
+    EXPECT_EQ(NULL, tree_freeze(NULL));
+    EXPECT_EQ(0, tree_thaw(NULL, NULL));
+    EXPECT_NO_FATAL_FAILURE(tree_frozen_dispose(NULL));
+    EXPECT_EQ(-1, tree_frozen_find(NULL, "a"));
+    EXPECT_EQ(NULL, tree_frozen_name(NULL, 0));
+    EXPECT_EQ(0, tree_frozen_is_ancestor(NULL, "a", "b"));
+    EXPECT_EQ(-1, tree_frozen_for_each(NULL, 0, NULL, NULL));
+    EXPECT_EQ(0, tree_save_binary(NULL, SNAPSHOT));
+    EXPECT_EQ(NULL, tree_map_binary(NULL, NULL));
+    EXPECT_EQ(NULL, tree_frozen_value_data(NULL, 0, NULL));
+    EXPECT_EQ(0, tree_frozen_load_value(NULL, 0, NULL));
+}
+
+TEST_F(cfrozen_test, arrays_are_in_pre_order)
+{
+    tree_frozen_t *frozen = tree_freeze(&tree);
+
+    ASSERT_NE(static_cast<tree_frozen_t *>(NULL), frozen);
+    EXPECT_EQ(NULL, tree.root);
+    EXPECT_EQ(0, tree.num_nodes);
+    EXPECT_EQ(0, g_num_disposed);
+
+    ASSERT_EQ(8, frozen->num_nodes);
+    EXPECT_EQ(4, frozen->depth);
+    EXPECT_EQ("abcefdgh", pre_order_names(frozen, 0));
+
+    const int32_t parents[] = {-1, 0, 1, 1, 3, 1, 0, 6};
+    const int32_t first_children[] = {1, 2, -1, 4, -1, -1, 7, -1};
+    const int32_t next_siblings[] = {-1, 6, 3, 5, -1, -1, -1, -1};
+    const int32_t subtree_sizes[] = {8, 5, 1, 2, 1, 1, 2, 1};
+
+    for (int i = 0; i < frozen->num_nodes; ++i)
+    {
+        EXPECT_EQ(parents[i], frozen->parents[i]);
+        EXPECT_EQ(first_children[i], frozen->first_children[i]);
+        EXPECT_EQ(next_siblings[i], frozen->next_siblings[i]);
+        EXPECT_EQ(subtree_sizes[i], frozen->subtree_sizes[i]);
+        EXPECT_EQ(i, tree_frozen_find(frozen, tree_frozen_name(frozen, i)));
+        EXPECT_EQ(node_name_hash(tree_frozen_name(frozen, i)), frozen->name_hashes[i]);
+    }
+
+    EXPECT_EQ(5, *static_cast<int *>(frozen->values[tree_frozen_find(frozen, "f")]));
+    EXPECT_EQ(-1, tree_frozen_find(frozen, "x"));
+    EXPECT_EQ(-1, tree_frozen_find(frozen, NULL));
+    EXPECT_EQ(NULL, tree_frozen_name(frozen, 8));
+    EXPECT_EQ(NULL, tree_frozen_name(frozen, -1));
+
+    tree_frozen_dispose(frozen);
+    EXPECT_EQ(8, g_num_disposed);
+}
+
+TEST_F(cfrozen_test, queries)
+{
+    tree_frozen_t *frozen = tree_freeze(&tree);
+
+    EXPECT_EQ(1, tree_frozen_is_ancestor(frozen, "a", "h"));
+    EXPECT_EQ(1, tree_frozen_is_ancestor(frozen, "b", "f"));
+    EXPECT_EQ(1, tree_frozen_is_ancestor(frozen, "f", "f"));
+    EXPECT_EQ(0, tree_frozen_is_ancestor(frozen, "f", "b"));
+    EXPECT_EQ(0, tree_frozen_is_ancestor(frozen, "g", "d"));
+    EXPECT_EQ(0, tree_frozen_is_ancestor(frozen, "x", "a"));
+
+    EXPECT_EQ("bcefd", pre_order_names(frozen, tree_frozen_find(frozen, "b")));
+    EXPECT_EQ("h", pre_order_names(frozen, tree_frozen_find(frozen, "h")));
+    EXPECT_EQ(-1, tree_frozen_for_each(frozen, 8, [](const tree_frozen_t *, int, void *) { return 0; }, NULL));
+
+    /* stopped by the visitor */
+    EXPECT_EQ(3, tree_frozen_for_each(frozen, 0, [](const tree_frozen_t *f, int node, void *) { return f->subtree_sizes[node] == 1 ? 1 : 0; }, NULL));
+
+    /* children of b, the arrays are all it takes */
+    std::string children;
+
+    for (int child = frozen->first_children[1]; child != -1; child = frozen->next_siblings[child])
+    {
+        children += tree_frozen_name(frozen, child);
+    }
+
+    EXPECT_EQ("ced", children);
+    tree_frozen_dispose(frozen);
+}
+
+TEST_F(cfrozen_test, thaw_gives_the_same_tree)
+{
+    std::string names = pre_order_names(&tree);
+    tree_frozen_t *frozen = tree_freeze(&tree);
+
+    ASSERT_EQ(1, tree_thaw(frozen, &tree));
+    EXPECT_EQ(0, g_num_disposed);
+    EXPECT_EQ(7, tree.num_nodes);
+    EXPECT_EQ(names, pre_order_names(&tree));
+    EXPECT_EQ(4, tree_depth(&tree));
+    EXPECT_EQ(tree_get_node(&tree, "e"), tree_get_node(&tree, "f")->parent);
+    EXPECT_EQ(5, *static_cast<int *>(tree_get_node(&tree, "f")->value));
+    EXPECT_EQ(OWNED, tree_get_node(&tree, "f")->value_handlers);
+
+    /* the tree owns the values again */
+    tree_clear(&tree);
+    EXPECT_EQ(8, g_num_disposed);
+}
+
+TEST_F(cfrozen_test, thaw_into_a_non_empty_tree_fails)
+{
+    tree_t other;
+    tree_init(&other);
+    tree_add_node(&other, node_create(INT, "x", &_1), NULL);
+    tree_frozen_t *frozen = tree_freeze(&tree);
+
+    EXPECT_EQ(0, tree_thaw(frozen, &other));
+    EXPECT_EQ(0, tree_thaw(frozen, NULL));
+    EXPECT_EQ(8, frozen->num_nodes);
+    EXPECT_EQ(0, g_num_disposed);
+
+    tree_clear(&other);
+    tree_frozen_dispose(frozen);
+    EXPECT_EQ(8, g_num_disposed);
+}
+
+TEST(tree_frozen_t, empty_tree)
+{
+    tree_t tree;
+    tree_init(&tree);
+    tree_frozen_t *frozen = tree_freeze(&tree);
+
+    ASSERT_NE(static_cast<tree_frozen_t *>(NULL), frozen);
+    EXPECT_EQ(0, frozen->num_nodes);
+    EXPECT_EQ(0, frozen->depth);
+    EXPECT_EQ(-1, tree_frozen_find(frozen, "a"));
+    EXPECT_EQ(-1, tree_frozen_for_each(frozen, 0, [](const tree_frozen_t *, int, void *) { return 0; }, NULL));
+
+    EXPECT_EQ(1, tree_thaw(frozen, &tree));
+    EXPECT_EQ(NULL, tree.root);
+}
+
+TEST_F(cfrozen_test, trees_with_snapshots_are_not_frozen)
+{
+    epoch_t *epoch = epoch_create();
+    ASSERT_EQ(1, tree_set_epoch(&tree, epoch));
+    tree_snapshot_t *snapshot = tree_snapshot(&tree);
+
+    EXPECT_EQ(NULL, tree_freeze(&tree));
+    EXPECT_EQ(7, tree.num_nodes);
+
+    tree_snapshot_release(snapshot);
+
+    /* retired nodes do not take the values with them */
+    tree_frozen_t *frozen = tree_freeze(&tree);
+    ASSERT_NE(static_cast<tree_frozen_t *>(NULL), frozen);
+    epoch_synchronize(epoch);
+    EXPECT_EQ(0, g_num_disposed);
+
+    tree_frozen_dispose(frozen);
+    EXPECT_EQ(8, g_num_disposed);
+    tree_set_epoch(&tree, NULL);
+    epoch_dispose(epoch);
+}
+
+TEST_F(cfrozen_test, mapped_snapshot_answers_queries)
+{
+    ASSERT_EQ(1, tree_save_binary(&tree, SNAPSHOT));
+    EXPECT_EQ(7, tree.num_nodes);
+    EXPECT_EQ(0, g_num_disposed);
+
+    tree_frozen_t *frozen = tree_freeze(&tree);
+    tree_frozen_t *mapped = tree_map_binary(SNAPSHOT, OWNED);
+
+    ASSERT_NE(static_cast<tree_frozen_t *>(NULL), mapped);
+    ASSERT_EQ(frozen->num_nodes, mapped->num_nodes);
+    EXPECT_EQ(frozen->depth, mapped->depth);
+    EXPECT_EQ(NULL, mapped->values);
+    EXPECT_EQ(pre_order_names(frozen, 0), pre_order_names(mapped, 0));
+
+    for (int i = 0; i < mapped->num_nodes; ++i)
+    {
+        EXPECT_EQ(frozen->parents[i], mapped->parents[i]);
+        EXPECT_EQ(frozen->first_children[i], mapped->first_children[i]);
+        EXPECT_EQ(frozen->next_siblings[i], mapped->next_siblings[i]);
+        EXPECT_EQ(frozen->subtree_sizes[i], mapped->subtree_sizes[i]);
+        EXPECT_EQ(i, tree_frozen_find(mapped, tree_frozen_name(frozen, i)));
+
+        /* payloads point into the file */
+        int size = 0;
+        const char *data = tree_frozen_value_data(mapped, i, &size);
+        ASSERT_EQ(static_cast<int>(sizeof(int)), size);
+        EXPECT_EQ(0, memcmp(frozen->values[i], data, sizeof(int)));
+        EXPECT_TRUE((data >= static_cast<char *>(mapped->mapping)) &&
+                    (data < static_cast<char *>(mapped->mapping) + mapped->mapping_size));
+    }
+
+    EXPECT_EQ(1, tree_frozen_is_ancestor(mapped, "b", "f"));
+    EXPECT_EQ(0, tree_frozen_is_ancestor(mapped, "g", "d"));
+    EXPECT_EQ(-1, tree_frozen_find(mapped, "x"));
+    EXPECT_EQ(NULL, tree_frozen_value_data(mapped, 8, NULL));
+    EXPECT_EQ(NULL, tree_frozen_value_data(frozen, 0, NULL));
+
+    void *value = NULL;
+    EXPECT_EQ(0, tree_frozen_load_value(mapped, 0, NULL));
+    EXPECT_EQ(0, tree_frozen_load_value(mapped, 8, &value));
+    ASSERT_EQ(1, tree_frozen_load_value(mapped, tree_frozen_find(mapped, "f"), &value));
+    ASSERT_NE(static_cast<void *>(NULL), value);
+    EXPECT_EQ(5, *static_cast<int *>(value));
+    delete static_cast<int *>(value);
+
+    /* nothing of the file to dispose of */
+    tree_frozen_dispose(mapped);
+    EXPECT_EQ(0, g_num_disposed);
+    tree_frozen_dispose(frozen);
+    EXPECT_EQ(8, g_num_disposed);
+    remove(SNAPSHOT);
+}
+
+TEST_F(cfrozen_test, mapped_snapshot_thaws)
+{
+    std::string names = pre_order_names(&tree);
+    ASSERT_EQ(1, tree_save_binary(&tree, SNAPSHOT));
+    tree_clear(&tree);
+    EXPECT_EQ(8, g_num_disposed);
+
+    /* values cannot be loaded without handlers */
+    tree_frozen_t *mapped = tree_map_binary(SNAPSHOT, NULL);
+    ASSERT_NE(static_cast<tree_frozen_t *>(NULL), mapped);
+    void *value = NULL;
+    EXPECT_EQ(0, tree_frozen_load_value(mapped, 0, &value));
+    EXPECT_EQ(0, tree_thaw(mapped, &tree));
+    EXPECT_EQ(NULL, tree.root);
+    tree_frozen_dispose(mapped);
+
+    mapped = tree_map_binary(SNAPSHOT, OWNED);
+    ASSERT_EQ(1, tree_thaw(mapped, &tree));
+    EXPECT_EQ(7, tree.num_nodes);
+    EXPECT_EQ(names, pre_order_names(&tree));
+    EXPECT_EQ(4, tree_depth(&tree));
+    EXPECT_EQ(tree_get_node(&tree, "e"), tree_get_node(&tree, "f")->parent);
+    EXPECT_EQ(5, *static_cast<int *>(tree_get_node(&tree, "f")->value));
+    EXPECT_EQ(OWNED, tree_get_node(&tree, "f")->value_handlers);
+
+    tree_clear(&tree);
+    EXPECT_EQ(16, g_num_disposed);
+    remove(SNAPSHOT);
+}
+
+TEST_F(cfrozen_test, null_values_thaw)
+{
+    tree_add_node(&tree, node_create(OWNED, "i", NULL), "h");
+    ASSERT_EQ(1, tree_save_binary(&tree, SNAPSHOT));
+    tree_clear(&tree);
+    g_num_disposed = 0;
+
+    tree_frozen_t *mapped = tree_map_binary(SNAPSHOT, OWNED);
+    ASSERT_NE(static_cast<tree_frozen_t *>(NULL), mapped);
+    int size = -1;
+    EXPECT_NE(static_cast<const char *>(NULL), tree_frozen_value_data(mapped, tree_frozen_find(mapped, "i"), &size));
+    EXPECT_EQ(0, size);
+
+    void *value = &_1;
+    EXPECT_EQ(1, tree_frozen_load_value(mapped, tree_frozen_find(mapped, "i"), &value));
+    EXPECT_EQ(NULL, value);
+
+    ASSERT_EQ(1, tree_thaw(mapped, &tree));
+    EXPECT_EQ(8, tree.num_nodes);
+    EXPECT_EQ(NULL, tree_get_node(&tree, "i")->value);
+    EXPECT_EQ(7, *static_cast<int *>(tree_get_node(&tree, "h")->value));
+    remove(SNAPSHOT);
+}
+
+TEST_F(cfrozen_test, values_without_binary_handlers_are_not_saved)
+{
+    tree_add_node(&tree, node_create(INT, "i", &_1), "h");
+    remove(SNAPSHOT);
+
+    EXPECT_EQ(0, tree_save_binary(&tree, SNAPSHOT));
+    EXPECT_EQ(NULL, fopen(SNAPSHOT, "rb"));
+    EXPECT_EQ(8, tree.num_nodes);
+}
+
+TEST_F(cfrozen_test, snapshot_in_a_directory)
+{
+    std::string path = std::string("./") + SNAPSHOT;
+
+    ASSERT_EQ(1, tree_save_binary(&tree, path.c_str()));
+    tree_frozen_t *mapped = tree_map_binary(SNAPSHOT, OWNED);
+    ASSERT_NE(static_cast<tree_frozen_t *>(NULL), mapped);
+    EXPECT_EQ(8, mapped->num_nodes);
+    tree_frozen_dispose(mapped);
+
+    EXPECT_EQ(0, tree_save_binary(&tree, "cfrozen-test-missing/cfrozen-test.bin"));
+    remove(SNAPSHOT);
+}
+
+TEST(tree_frozen_t, empty_snapshot)
+{
+    tree_t tree;
+    tree_init(&tree);
+
+    ASSERT_EQ(1, tree_save_binary(&tree, SNAPSHOT));
+    tree_frozen_t *mapped = tree_map_binary(SNAPSHOT, NULL);
+
+    ASSERT_NE(static_cast<tree_frozen_t *>(NULL), mapped);
+    EXPECT_EQ(0, mapped->num_nodes);
+    EXPECT_EQ(-1, tree_frozen_find(mapped, "a"));
+    EXPECT_EQ(1, tree_thaw(mapped, &tree));
+    EXPECT_EQ(NULL, tree.root);
+    remove(SNAPSHOT);
+}
+
+TEST_F(cfrozen_test, broken_files_are_not_mapped)
+{
+    ASSERT_EQ(1, tree_save_binary(&tree, SNAPSHOT));
+
+    FILE *file = fopen(SNAPSHOT, "rb");
+    ASSERT_NE(static_cast<FILE *>(NULL), file);
+    std::string contents;
+    char buffer[256];
+
+    for (size_t read = 0; (read = fread(buffer, 1, sizeof(buffer), file)) > 0;)
+    {
+        contents.append(buffer, read);
+    }
+
+    fclose(file);
+
+    const char *broken = "cfrozen-test-broken.bin";
+    auto map_as = [broken](const std::string &data)
+    {
+        FILE *f = fopen(broken, "wb");
+        fwrite(data.data(), 1, data.size(), f);
+        fclose(f);
+
+        tree_frozen_t *mapped = tree_map_binary(broken, OWNED);
+        tree_frozen_dispose(mapped);
+        remove(broken);
+        return mapped != NULL;
+    };
+
+    EXPECT_TRUE(map_as(contents));
+    EXPECT_FALSE(map_as(contents.substr(0, contents.size() - 1)));
+    EXPECT_FALSE(map_as(contents.substr(0, 16)));
+    EXPECT_FALSE(map_as(""));
+    EXPECT_FALSE(map_as("X" + contents.substr(1)));
+
+    /* byte order */
+    std::string swapped = contents;
+    std::swap(swapped[12], swapped[15]);
+    EXPECT_FALSE(map_as(swapped));
+
+    EXPECT_EQ(NULL, tree_map_binary("cfrozen-test-missing.bin", OWNED));
+
+    /* arrays which point outside their sections or the tree */
+    tree_frozen_t *mapped = tree_map_binary(SNAPSHOT, OWNED);
+    ASSERT_NE(static_cast<tree_frozen_t *>(NULL), mapped);
+    const char *mapping = static_cast<const char *>(mapped->mapping);
+    auto offset_of = [mapping](const void *array, int i, size_t element_size)
+    {
+        return static_cast<size_t>(static_cast<const char *>(array) - mapping) + i * element_size;
+    };
+    auto map_with = [&contents, &map_as](size_t offset, int64_t value, size_t size)
+    {
+        std::string changed = contents;
+        changed.replace(offset, size, reinterpret_cast<const char *>(&value), size);
+        return map_as(changed);
+    };
+    auto map_with_int32 = [&map_with, &offset_of](const int32_t *array, int i, int32_t value)
+    {
+        return map_with(offset_of(array, i, sizeof(int32_t)), value, sizeof(int32_t));
+    };
+
+    /* in pre-order a b c e f d g h, "d" can go under "a" but not under "f" */
+    EXPECT_TRUE(map_with_int32(mapped->parents, 5, 0));
+    EXPECT_FALSE(map_with_int32(mapped->parents, 5, 4));
+    EXPECT_FALSE(map_with_int32(mapped->parents, 0, 0));
+    EXPECT_FALSE(map_with_int32(mapped->parents, 5, 5));
+    EXPECT_FALSE(map_with_int32(mapped->parents, 5, -1));
+    EXPECT_FALSE(map_with_int32(mapped->parents, 5, 1 << 30));
+    EXPECT_FALSE(map_with_int32(mapped->subtree_sizes, 0, 9));
+    EXPECT_FALSE(map_with_int32(mapped->subtree_sizes, 7, 2));
+    EXPECT_FALSE(map_with_int32(mapped->subtree_sizes, 7, 0));
+    EXPECT_FALSE(map_with_int32(mapped->subtree_sizes, 4, 3));
+    EXPECT_FALSE(map_with_int32(mapped->first_children, 1, 8));
+    EXPECT_FALSE(map_with_int32(mapped->first_children, 1, 1));
+    EXPECT_FALSE(map_with_int32(mapped->next_siblings, 2, -2));
+    EXPECT_FALSE(map_with_int32(mapped->name_offsets, 3, -1));
+    EXPECT_FALSE(map_with_int32(mapped->name_offsets, 3, 1 << 20));
+    EXPECT_FALSE(map_with_int32(mapped->slots, mapped->num_slots - 1, 8));
+    EXPECT_FALSE(map_with_int32(mapped->slots, 0, -2));
+
+    /* a lookup would not find a free slot */
+    std::string full = contents;
+    for (int i = 0; i < mapped->num_slots; ++i)
+    {
+        int32_t node = 0;
+        full.replace(offset_of(mapped->slots, i, sizeof(int32_t)), sizeof(node), reinterpret_cast<const char *>(&node), sizeof(node));
+    }
+    EXPECT_FALSE(map_as(full));
+
+    /* payloads out of order or past their section */
+    EXPECT_FALSE(map_with(offset_of(mapped->value_offsets, 0, sizeof(uint64_t)), 1, sizeof(uint64_t)));
+    EXPECT_FALSE(map_with(offset_of(mapped->value_offsets, 3, sizeof(uint64_t)), 100, sizeof(uint64_t)));
+
+    tree_frozen_dispose(mapped);
+    remove(SNAPSHOT);
+}
+
+int main(int argc, char **argv)
+{
+    ::testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
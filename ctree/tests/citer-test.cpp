@@ -0,0 +1,294 @@
+#include <gtest/gtest.h>
+#include <string>
+#include <vector>
+#include "citer.h"
+#include "test-helpers.h"
+
+//
+// a---+
+// |   |
+// b-+ e
+// | | |
+// c d f
+//     |
+//     g
+//
+class citer_test : public ::testing::Test
+{
+protected:
+    virtual void SetUp()
+    {
+        a = node_create(INT, "a", &_1);
+        b = node_create(INT, "b", &_2);
+        c = node_create(INT, "c", &_3);
+        d = node_create(INT, "d", &_4);
+        e = node_create(INT, "e", &_5);
+        f = node_create(INT, "f", &_6);
+        g = node_create(INT, "g", &_7);
+        node_add_child(a, b);
+        node_add_child(b, c);
+        node_add_child(b, d);
+        node_add_child(a, e);
+        node_add_child(e, f);
+        node_add_child(f, g);
+        tree_iter_init(&iter);
+    }
+
+    virtual void TearDown()
+    {
+        tree_iter_clear(&iter);
+        node_t *all[] = {a, b, c, d, e, f, g};
+
+        for (size_t i = 0; i < sizeof(all) / sizeof(all[0]); ++i)
+        {
+            node_dispose(all[i]);
+        }
+    }
+
+    std::string walk(node_t *start, tree_iter_mode_t mode)
+    {
+        std::string names;
+        node_t *node = NULL;
+
+        EXPECT_EQ(1, tree_iter_start(&iter, start, mode));
+
+        while ((node = tree_iter_next(&iter)) != NULL)
+        {
+            names += node->object_name;
+        }
+
+        EXPECT_EQ(0, iter.out_of_memory);
+        return names;
+    }
+
+    tree_iter_t iter;
+    node_t *a;
+    node_t *b;
+    node_t *c;
+    node_t *d;
+    node_t *e;
+    node_t *f;
+    node_t *g;
+};
+
+static int append_name(node_t *node, void *ctx)
+{
+    *static_cast<std::string *>(ctx) += node->object_name;
+    return 0;
+}
+
+static int stop_at_e(node_t *node, void *ctx)
+{
+    *static_cast<std::string *>(ctx) += node->object_name;
+    return strcmp(node->object_name, "e") == 0;
+}
+
+TEST(tree_iter_t, tree_iter_init__on_null_does_nothing)
+{
+    EXPECT_NO_FATAL_FAILURE(tree_iter_init(NULL));
+}
+
+TEST(tree_iter_t, tree_iter_clear__on_null_does_nothing)
+{
+    EXPECT_NO_FATAL_FAILURE(tree_iter_clear(NULL));
+}
+
+TEST(tree_iter_t, tree_iter_init)
+{
+    tree_iter_t iter;
+    tree_iter_init(&iter);
+    EXPECT_EQ(NULL, iter.frames);
+    EXPECT_EQ(0, iter.num_frames);
+    EXPECT_EQ(0, iter.capacity);
+    EXPECT_EQ(NULL, iter.pending);
+    EXPECT_EQ(0, iter.out_of_memory);
+}
+
+TEST(tree_iter_t, tree_iter_start__on_null_self_returns_0)
+{
+    EXPECT_EQ(0, tree_iter_start(NULL, NULL, TREE_ITER_PRE_ORDER));
+}
+
+TEST(tree_iter_t, tree_iter_next__on_null_self_returns_null)
+{
+    EXPECT_EQ(NULL, tree_iter_next(NULL));
+}
+
+TEST(tree_iter_t, tree_iter_next__on_null_start_returns_null)
+{
+    tree_iter_t iter;
+    tree_iter_init(&iter);
+    EXPECT_EQ(1, tree_iter_start(&iter, NULL, TREE_ITER_PRE_ORDER));
+    EXPECT_EQ(NULL, tree_iter_next(&iter));
+    EXPECT_EQ(1, tree_iter_start(&iter, NULL, TREE_ITER_POST_ORDER));
+    EXPECT_EQ(NULL, tree_iter_next(&iter));
+    EXPECT_EQ(1, tree_iter_start(&iter, NULL, TREE_ITER_LEVEL_ORDER));
+    EXPECT_EQ(NULL, tree_iter_next(&iter));
+    tree_iter_clear(&iter);
+}
+
+TEST_F(citer_test, tree_iter_next__pre_order)
+{
+    EXPECT_EQ("abcdefg", walk(a, TREE_ITER_PRE_ORDER));
+    EXPECT_EQ("efg", walk(e, TREE_ITER_PRE_ORDER));
+    EXPECT_EQ("g", walk(g, TREE_ITER_PRE_ORDER));
+}
+
+TEST_F(citer_test, tree_iter_next__post_order)
+{
+    EXPECT_EQ("cdbgfea", walk(a, TREE_ITER_POST_ORDER));
+    EXPECT_EQ("cdb", walk(b, TREE_ITER_POST_ORDER));
+    EXPECT_EQ("g", walk(g, TREE_ITER_POST_ORDER));
+}
+
+TEST_F(citer_test, tree_iter_next__level_order)
+{
+    EXPECT_EQ("abecdfg", walk(a, TREE_ITER_LEVEL_ORDER));
+    EXPECT_EQ("bcd", walk(b, TREE_ITER_LEVEL_ORDER));
+    EXPECT_EQ("g", walk(g, TREE_ITER_LEVEL_ORDER));
+}
+
+TEST_F(citer_test, tree_iter_start__reuses_the_buffer)
+{
+    EXPECT_EQ("abcdefg", walk(a, TREE_ITER_PRE_ORDER));
+    tree_iter_frame_t *frames = iter.frames;
+    int capacity = iter.capacity;
+    EXPECT_EQ("abecdfg", walk(a, TREE_ITER_LEVEL_ORDER));
+    EXPECT_EQ("cdbgfea", walk(a, TREE_ITER_POST_ORDER));
+    EXPECT_EQ(frames, iter.frames);
+    EXPECT_EQ(capacity, iter.capacity);
+}
+
+TEST_F(citer_test, tree_iter_start__restarts_an_unfinished_walk)
+{
+    EXPECT_EQ(1, tree_iter_start(&iter, a, TREE_ITER_PRE_ORDER));
+    EXPECT_EQ(a, tree_iter_next(&iter));
+    EXPECT_EQ(b, tree_iter_next(&iter));
+    EXPECT_EQ("cdbgfea", walk(a, TREE_ITER_POST_ORDER));
+}
+
+TEST_F(citer_test, node_for_each__with_invalid_inputs)
+{
+    std::string names;
+    EXPECT_EQ(-1, node_for_each(a, TREE_ITER_PRE_ORDER, NULL, &names));
+    EXPECT_EQ(0, node_for_each(NULL, TREE_ITER_PRE_ORDER, append_name, &names));
+    EXPECT_EQ("", names);
+}
+
+TEST_F(citer_test, node_for_each__visits_all_nodes)
+{
+    std::string names;
+    EXPECT_EQ(7, node_for_each(a, TREE_ITER_PRE_ORDER, append_name, &names));
+    EXPECT_EQ("abcdefg", names);
+    names.clear();
+    EXPECT_EQ(7, node_for_each(a, TREE_ITER_POST_ORDER, append_name, &names));
+    EXPECT_EQ("cdbgfea", names);
+    names.clear();
+    EXPECT_EQ(7, node_for_each(a, TREE_ITER_LEVEL_ORDER, append_name, &names));
+    EXPECT_EQ("abecdfg", names);
+}
+
+TEST_F(citer_test, node_for_each__stops_when_visitor_returns_non_0)
+{
+    std::string names;
+    EXPECT_EQ(5, node_for_each(a, TREE_ITER_PRE_ORDER, stop_at_e, &names));
+    EXPECT_EQ("abcde", names);
+    names.clear();
+    EXPECT_EQ(3, node_for_each(a, TREE_ITER_LEVEL_ORDER, stop_at_e, &names));
+    EXPECT_EQ("abe", names);
+}
+
+TEST(tree_iter_t, tree_iter_next__on_very_deep_subtree)
+{
+    const int num_nodes = 200000;
+    std::vector<node_t *> chain(num_nodes);
+    std::vector<int> values(num_nodes);
+    tree_iter_t iter;
+    int i = 0;
+
+    /* bottom up, so that adding a child does not walk up the whole chain */
+    for (i = num_nodes - 1; i >= 0; --i)
+    {
+        values[i] = i;
+        chain[i] = node_create(INT, std::to_string(i).c_str(), &values[i]);
+
+        if (i < num_nodes - 1)
+        {
+            node_add_child(chain[i], chain[i + 1]);
+        }
+    }
+
+    ASSERT_EQ(num_nodes, chain[0]->height);
+
+    tree_iter_init(&iter);
+
+    EXPECT_EQ(1, tree_iter_start(&iter, chain[0], TREE_ITER_PRE_ORDER));
+    for (i = 0; i < num_nodes; ++i)
+    {
+        ASSERT_EQ(chain[i], tree_iter_next(&iter));
+    }
+    EXPECT_EQ(NULL, tree_iter_next(&iter));
+
+    EXPECT_EQ(1, tree_iter_start(&iter, chain[0], TREE_ITER_POST_ORDER));
+    for (i = num_nodes - 1; i >= 0; --i)
+    {
+        ASSERT_EQ(chain[i], tree_iter_next(&iter));
+    }
+    EXPECT_EQ(NULL, tree_iter_next(&iter));
+
+    EXPECT_EQ(1, tree_iter_start(&iter, chain[0], TREE_ITER_LEVEL_ORDER));
+    for (i = 0; i < num_nodes; ++i)
+    {
+        ASSERT_EQ(chain[i], tree_iter_next(&iter));
+    }
+    EXPECT_EQ(NULL, tree_iter_next(&iter));
+
+    tree_iter_clear(&iter);
+
+    for (i = 0; i < num_nodes; ++i)
+    {
+        node_dispose(chain[i]);
+    }
+}
+
+TEST(tree_iter_t, tree_iter_next__level_order_on_very_wide_subtree)
+{
+    const int num_children = 5000;
+    std::vector<int> values(num_children);
+    node_t *root = node_create(INT, "root", &_1);
+    tree_iter_t iter;
+    node_t *node = NULL;
+    int i = 0;
+
+    for (i = 0; i < num_children; ++i)
+    {
+        values[i] = i;
+        node_add_child(root, node_create(INT, std::to_string(i).c_str(), &values[i]));
+    }
+
+    tree_iter_init(&iter);
+    EXPECT_EQ(1, tree_iter_start(&iter, root, TREE_ITER_LEVEL_ORDER));
+    EXPECT_EQ(root, tree_iter_next(&iter));
+
+    for (i = 0; i < num_children; ++i)
+    {
+        node = tree_iter_next(&iter);
+        ASSERT_TRUE(node != NULL);
+        ASSERT_EQ(&values[i], node->value);
+    }
+
+    EXPECT_EQ(NULL, tree_iter_next(&iter));
+    tree_iter_clear(&iter);
+
+    for (i = 0; i < num_children; ++i)
+    {
+        node_dispose(root->children[i]);
+    }
+    node_dispose(root);
+}
+
+int main(int argc, char **argv)
+{
+    ::testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
@@ -0,0 +1,400 @@
+#include <gtest/gtest.h>
+#include <cstdio>
+#include <cstring>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include <unistd.h>
+#include "cjournal.h"
+#include "cjson.h"
+#include "ctree.h"
+#include "test-helpers.h"
+
+static const char *JOURNAL = "cjournal-test.log";
+
+static long file_size(const char *path)
+{
+    FILE *file = fopen(path, "rb");
+    long size = -1;
+
+    if (file != NULL)
+    {
+        fseek(file, 0, SEEK_END);
+        size = ftell(file);
+        fclose(file);
+    }
+
+    return size;
+}
+
+class cjournal_test : public ::testing::Test
+{
+protected:
+    virtual void SetUp()
+    {
+        remove(JOURNAL);
+        journal = tree_journal_open(JOURNAL);
+        tree_init(&tree);
+        tree_init(&replayed);
+        tree_set_journal(&tree, journal);
+    }
+
+    virtual void TearDown()
+    {
+        tree_clear(&tree);
+        tree_clear(&replayed);
+        tree_journal_dispose(journal);
+        remove(JOURNAL);
+    }
+
+    node_t *add(const char *name, int value, const char *parent)
+    {
+        return tree_add_node(&tree, node_create(OWNED, name, new int(value)), parent);
+    }
+
+    /*
+     *        a
+     *      /   \
+     *     b     g
+     *   / | \   |
+     *  c  e  d  h
+     *     |
+     *     f
+     */
+    void add_all()
+    {
+        add("a", 1, NULL);
+        add("b", 2, "a");
+        add("c", 3, "b");
+        add("d", 4, "b");
+        add("e", 3, "b");
+        add("f", 5, "e");
+        add("g", 6, "a");
+        add("h", 7, "g");
+    }
+
+    tree_journal_t *journal;
+    tree_t tree;
+    tree_t replayed;
+};
+
+TEST(tree_journal_t, functions_on_null_arguments)
+{
+    tree_t tree;
+
+    tree_init(&tree);
+
+    EXPECT_EQ(NULL, tree_journal_open(NULL));
+    EXPECT_NO_FATAL_FAILURE(tree_journal_dispose(NULL));
+    EXPECT_EQ(0, tree_journal_commit(NULL));
+    EXPECT_EQ(0, tree_journal_checkpoint(NULL, &tree));
+    EXPECT_EQ(0, tree_set_journal(NULL, NULL));
+    EXPECT_EQ(-1, tree_replay_journal(NULL, OWNED, JOURNAL));
+    EXPECT_EQ(-1, tree_replay_journal(&tree, NULL, JOURNAL));
+    EXPECT_EQ(-1, tree_replay_journal(&tree, OWNED, NULL));
+    EXPECT_EQ(-1, tree_replay_journal(&tree, INT, JOURNAL));
+    EXPECT_NO_FATAL_FAILURE(tree_journal_record_add_node(NULL, NULL, NULL));
+    EXPECT_NO_FATAL_FAILURE(tree_journal_record_add_tree(NULL, NULL, NULL, NULL));
+    EXPECT_NO_FATAL_FAILURE(tree_journal_record_remove_node(NULL, NULL));
+    EXPECT_NO_FATAL_FAILURE(tree_journal_record_remove_tree(NULL, NULL));
+}
+
+TEST(tree_journal_t, files_which_are_not_journals_are_not_opened)
+{
+    FILE *file = fopen(JOURNAL, "wb");
+    tree_t tree;
+
+    tree_init(&tree);
+    fputs("{\"object_name\":\"a\"}", file);
+    fclose(file);
+
+    EXPECT_EQ(NULL, tree_journal_open(JOURNAL));
+    EXPECT_EQ(-1, tree_replay_journal(&tree, OWNED, JOURNAL));
+    EXPECT_EQ(19, file_size(JOURNAL));
+
+    remove(JOURNAL);
+    EXPECT_EQ(-1, tree_replay_journal(&tree, OWNED, JOURNAL));
+}
+
+TEST_F(cjournal_test, empty_journal_replays_nothing)
+{
+    ASSERT_NE(static_cast<tree_journal_t *>(NULL), journal);
+    EXPECT_EQ(9, file_size(JOURNAL));
+    EXPECT_EQ(0, tree_replay_journal(&replayed, OWNED, JOURNAL));
+    EXPECT_EQ(NULL, replayed.root);
+}
+
+TEST_F(cjournal_test, replay_gives_the_same_tree)
+{
+    tree_t sub_tree;
+    node_t *batch[] = { node_create(OWNED, "i", new int(8)), node_create(OWNED, "j", new int(9)) };
+    const char *batch_parents[] = { "h", "i" };
+
+    add_all();
+
+    tree_init(&sub_tree);
+    tree_add_node(&sub_tree, node_create(OWNED, "x", new int(10)), NULL);
+    tree_add_node(&sub_tree, node_create(OWNED, "y", new int(11)), "x");
+    ASSERT_NE(static_cast<node_t *>(NULL), tree_add_tree(&tree, &sub_tree, "c"));
+
+    EXPECT_EQ(2, tree_add_nodes(&tree, batch, batch_parents, 2));
+    EXPECT_EQ(1, tree_remove_node(&tree, "e"));
+    EXPECT_EQ(2, tree_remove_tree(&tree, "x"));
+    EXPECT_EQ(0, tree_remove_node(&tree, "not there"));
+    add("z", 12, "f");
+
+    ASSERT_EQ(1, tree_journal_commit(journal));
+    EXPECT_EQ(14, tree_replay_journal(&replayed, OWNED, JOURNAL));
+    EXPECT_EQ(to_json(&tree), to_json(&replayed));
+    EXPECT_EQ(NULL, replayed.journal);
+}
+
+TEST_F(cjournal_test, removing_the_root_and_adding_a_tree_to_an_empty_tree_are_replayed)
+{
+    tree_t sub_tree;
+
+    add("a", 1, NULL);
+    EXPECT_EQ(1, tree_remove_node(&tree, "a"));
+
+    tree_init(&sub_tree);
+    tree_add_node(&sub_tree, node_create(OWNED, "x", new int(10)), NULL);
+    tree_add_node(&sub_tree, node_create(OWNED, "y", new int(11)), "x");
+    ASSERT_NE(static_cast<node_t *>(NULL), tree_add_tree(&tree, &sub_tree, NULL));
+    add("z", 12, "y");
+    EXPECT_EQ(3, tree_remove_tree(&tree, "x"));
+    add("b", 2, NULL);
+
+    ASSERT_EQ(1, tree_journal_commit(journal));
+    EXPECT_EQ(6, tree_replay_journal(&replayed, OWNED, JOURNAL));
+    EXPECT_EQ(to_json(&tree), to_json(&replayed));
+}
+
+TEST_F(cjournal_test, null_values_are_replayed)
+{
+    add_all();
+    tree_add_node(&tree, node_create(OWNED, "i", NULL), "h");
+    ASSERT_EQ(1, tree_journal_commit(journal));
+
+    EXPECT_EQ(9, tree_replay_journal(&replayed, OWNED, JOURNAL));
+    EXPECT_EQ(NULL, tree_get_node(&replayed, "i")->value);
+    EXPECT_EQ(to_json(&tree), to_json(&replayed));
+    tree_clear(&replayed);
+
+    /* and are in the copy of a checkpoint */
+    ASSERT_EQ(1, tree_journal_checkpoint(journal, &tree));
+    tree_add_node(&tree, node_create(OWNED, "j", NULL), "i");
+    ASSERT_EQ(1, tree_journal_commit(journal));
+
+    EXPECT_EQ(2, tree_replay_journal(&replayed, OWNED, JOURNAL));
+    EXPECT_EQ(NULL, tree_get_node(&replayed, "j")->value);
+    EXPECT_EQ(to_json(&tree), to_json(&replayed));
+}
+
+TEST_F(cjournal_test, records_which_are_not_committed_are_lost)
+{
+    add("a", 1, NULL);
+    add("b", 2, "a");
+    ASSERT_EQ(1, tree_journal_commit(journal));
+    add("c", 3, "a");
+
+    tree_set_journal(&tree, NULL);
+    tree_journal_dispose(journal);
+    journal = NULL;
+
+    EXPECT_EQ(2, tree_replay_journal(&replayed, OWNED, JOURNAL));
+    EXPECT_EQ(1, replayed.num_nodes);
+    EXPECT_EQ(NULL, tree_get_node(&replayed, "c"));
+}
+
+TEST_F(cjournal_test, record_cut_short_is_dropped)
+{
+    long size = 0;
+
+    add_all();
+    ASSERT_EQ(1, tree_journal_commit(journal));
+    tree_journal_dispose(journal);
+
+    /* the last record, "h", loses its checksum */
+    size = file_size(JOURNAL);
+    ASSERT_EQ(0, truncate(JOURNAL, size - 2));
+    EXPECT_EQ(7, tree_replay_journal(&replayed, OWNED, JOURNAL));
+    tree_clear(&replayed);
+
+    /* and is dropped from the file, so that the next records can be replayed */
+    journal = tree_journal_open(JOURNAL);
+    ASSERT_NE(static_cast<tree_journal_t *>(NULL), journal);
+    EXPECT_GT(size - 2, file_size(JOURNAL));
+    tree_set_journal(&tree, journal);
+    add("i", 8, "g");
+    ASSERT_EQ(1, tree_journal_commit(journal));
+
+    EXPECT_EQ(8, tree_replay_journal(&replayed, OWNED, JOURNAL));
+    EXPECT_NE(static_cast<node_t *>(NULL), tree_get_node(&replayed, "i"));
+    EXPECT_EQ(NULL, tree_get_node(&replayed, "h"));
+}
+
+TEST_F(cjournal_test, broken_record_stops_the_replay)
+{
+    FILE *file = NULL;
+
+    add_all();
+    ASSERT_EQ(1, tree_journal_commit(journal));
+
+    /* the name of "b", after the header, the record of "a", the size, type and parent of "b" */
+    file = fopen(JOURNAL, "r+b");
+    ASSERT_NE(static_cast<FILE *>(NULL), file);
+    fseek(file, 9 + (4 + 1 + 1 + 2 + 1 + 4 + 4) + 4 + 1 + 2 + 1, SEEK_SET);
+    EXPECT_EQ('b', fgetc(file));
+    fseek(file, -1, SEEK_CUR);
+    fputc('B', file);
+    fclose(file);
+
+    EXPECT_EQ(1, tree_replay_journal(&replayed, OWNED, JOURNAL));
+    EXPECT_EQ(0, replayed.num_nodes);
+    EXPECT_NE(static_cast<node_t *>(NULL), tree_get_node(&replayed, "a"));
+}
+
+TEST_F(cjournal_test, replay_into_a_non_empty_tree_fails)
+{
+    add("a", 1, NULL);
+    ASSERT_EQ(1, tree_journal_commit(journal));
+
+    EXPECT_EQ(-1, tree_replay_journal(&tree, OWNED, JOURNAL));
+}
+
+TEST_F(cjournal_test, changes_which_cannot_be_applied_fail_the_replay)
+{
+    long size = 0;
+
+    add("a", 1, NULL);
+    tree_journal_record_remove_node(journal, "x");
+    add("b", 2, "a");
+    ASSERT_EQ(1, tree_journal_commit(journal));
+    size = file_size(JOURNAL);
+
+    /* and are not recorded again */
+    tree_set_journal(&replayed, journal);
+    EXPECT_EQ(-1, tree_replay_journal(&replayed, OWNED, JOURNAL));
+    EXPECT_EQ(journal, replayed.journal);
+    EXPECT_NE(static_cast<node_t *>(NULL), tree_get_node(&replayed, "a"));
+    EXPECT_EQ(NULL, tree_get_node(&replayed, "b"));
+    EXPECT_EQ(1, tree_journal_commit(journal));
+    EXPECT_EQ(size, file_size(JOURNAL));
+}
+
+TEST_F(cjournal_test, values_without_binary_handlers_fail_the_journal)
+{
+    add("a", 1, NULL);
+    tree_add_node(&tree, node_create(INT, "b", &_2), "a");
+
+    EXPECT_EQ(0, tree_journal_commit(journal));
+    EXPECT_EQ(0, tree_journal_checkpoint(journal, &tree));
+
+    EXPECT_EQ(1, tree_remove_node(&tree, "b"));
+    EXPECT_EQ(0, tree_journal_commit(journal));
+
+    /* a checkpoint starts over */
+    EXPECT_EQ(1, tree_journal_checkpoint(journal, &tree));
+    EXPECT_EQ(1, tree_journal_commit(journal));
+    EXPECT_EQ(1, tree_replay_journal(&replayed, OWNED, JOURNAL));
+    EXPECT_EQ(to_json(&tree), to_json(&replayed));
+}
+
+TEST_F(cjournal_test, checkpoint_replaces_the_records)
+{
+    std::string tmp_path = std::string(JOURNAL) + ".tmp";
+    long size = 0;
+
+    add_all();
+    ASSERT_EQ(1, tree_journal_commit(journal));
+    size = file_size(JOURNAL);
+
+    /* records not committed yet are in the copy */
+    add("i", 8, "h");
+    ASSERT_EQ(1, tree_journal_checkpoint(journal, &tree));
+    EXPECT_GT(size, file_size(JOURNAL));
+    EXPECT_EQ(-1, file_size(tmp_path.c_str()));
+
+    add("j", 9, "i");
+    EXPECT_EQ(1, tree_remove_node(&tree, "e"));
+    ASSERT_EQ(1, tree_journal_commit(journal));
+
+    EXPECT_EQ(3, tree_replay_journal(&replayed, OWNED, JOURNAL));
+    EXPECT_EQ(to_json(&tree), to_json(&replayed));
+}
+
+TEST(tree_journal_t, checkpoint_in_a_directory)
+{
+    std::string path = std::string("./") + JOURNAL;
+    tree_journal_t *journal = NULL;
+    tree_t tree;
+    tree_t replayed;
+
+    tree_init(&tree);
+    tree_init(&replayed);
+    remove(JOURNAL);
+    journal = tree_journal_open(path.c_str());
+    ASSERT_NE(static_cast<tree_journal_t *>(NULL), journal);
+    tree_set_journal(&tree, journal);
+    tree_add_node(&tree, node_create(OWNED, "a", new int(1)), NULL);
+
+    ASSERT_EQ(1, tree_journal_checkpoint(journal, &tree));
+    tree_add_node(&tree, node_create(OWNED, "b", new int(2)), "a");
+    ASSERT_EQ(1, tree_journal_commit(journal));
+    EXPECT_EQ(2, tree_replay_journal(&replayed, OWNED, JOURNAL));
+    EXPECT_EQ(to_json(&tree), to_json(&replayed));
+
+    tree_clear(&replayed);
+    tree_clear(&tree);
+    tree_journal_dispose(journal);
+    remove(JOURNAL);
+}
+
+TEST_F(cjournal_test, commits_of_many_threads_share_syncs)
+{
+    const int num_threads = 8;
+    const int num_nodes = 200;
+    std::vector<std::thread> threads;
+    std::vector<int> num_committed(num_threads, 0);
+    std::mutex tree_mutex;
+
+    add("root", 0, NULL);
+
+    for (int t = 0; t < num_threads; ++t)
+    {
+        threads.push_back(std::thread([&, t]() {
+            for (int i = 0; i < num_nodes; ++i)
+            {
+                std::string name = std::to_string(t) + "/" + std::to_string(i);
+                std::string parent = (i > 0) ? std::to_string(t) + "/" + std::to_string(i - 1) : "root";
+
+                {
+                    std::lock_guard<std::mutex> lock(tree_mutex);
+                    add(name.c_str(), i, parent.c_str());
+                }
+
+                num_committed[t] += tree_journal_commit(journal);
+            }
+        }));
+    }
+
+    for (size_t t = 0; t < threads.size(); ++t)
+    {
+        threads[t].join();
+    }
+
+    for (int t = 0; t < num_threads; ++t)
+    {
+        EXPECT_EQ(num_nodes, num_committed[t]);
+    }
+
+    EXPECT_EQ(1 + num_threads * num_nodes, tree_replay_journal(&replayed, OWNED, JOURNAL));
+    EXPECT_EQ(to_json(&tree), to_json(&replayed));
+}
+
+int main(int argc, char **argv)
+{
+    ::testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
@@ -0,0 +1,405 @@
+#include <gtest/gtest.h>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+#include "cjson.h"
+#include "ctree.h"
+#include "test-helpers.h"
+
+static std::string to_json_lines(tree_t *tree)
+{
+    std::string json;
+    EXPECT_EQ(1, tree_to_json_lines(tree, append, &json));
+    return json;
+}
+
+/* a value bigger than a chunk */
+static int big_to_json(void *value, char *buffer, int buffer_size)
+{
+    std::string json = "\"" + std::string(*static_cast<int *>(value), 'x') + "\"";
+    return snprintf(buffer, buffer_size, "%s", json.c_str());
+}
+
+static value_handlers_t g_big_handlers;
+static value_handlers_t *BIG = value_handlers_init(&g_big_handlers, int_compare, big_to_json, NULL);
+
+static void *int_from_json(const char *json, int size)
+{
+    std::string text(json, size);
+    char *end = NULL;
+    long value = strtol(text.c_str(), &end, 10);
+
+    return (*end == '\0') ? new int(static_cast<int>(value)) : NULL;
+}
+
+static value_handlers_t g_parsed_handlers;
+static value_handlers_t *PARSED = value_handlers_set_from_json(
+    value_handlers_init(&g_parsed_handlers, int_compare, int_to_json, int_delete),
+    int_from_json);
+
+/* the text of the value as it is */
+static void *text_from_json(const char *json, int size)
+{
+    return new std::string(json, size);
+}
+
+static int text_compare(void *a, void *b)
+{
+    return static_cast<std::string *>(a)->compare(*static_cast<std::string *>(b));
+}
+
+static void text_delete(void *value)
+{
+    delete static_cast<std::string *>(value);
+}
+
+static value_handlers_t g_text_handlers;
+static value_handlers_t *TEXT = value_handlers_set_from_json(
+    value_handlers_init(&g_text_handlers, text_compare, NULL, text_delete),
+    text_from_json);
+
+static int from_json(tree_t *tree, value_handlers_t *handlers, const std::string &json)
+{
+    return tree_from_json(tree, handlers, json.data(), static_cast<int>(json.size()));
+}
+
+class cjson_test : public ::testing::Test
+{
+protected:
+    virtual void SetUp()
+    {
+        tree_init(&tree);
+
+        /*
+         *        a
+         *      /   \
+         *     b     g
+         *   / | \   |
+         *  c  d  e  h
+         *        |
+         *        f
+         */
+        tree_add_node(&tree, node_create(INT, "a", &_1), NULL);
+        tree_add_node(&tree, node_create(INT, "b", &_2), "a");
+        tree_add_node(&tree, node_create(INT, "c", &_3), "b");
+        tree_add_node(&tree, node_create(INT, "d", &_4), "b");
+        tree_add_node(&tree, node_create(INT, "e", &_5), "b");
+        tree_add_node(&tree, node_create(INT, "f", &_6), "e");
+        tree_add_node(&tree, node_create(INT, "g", &_7), "a");
+        tree_add_node(&tree, node_create(INT, "h", NULL), "g");
+    }
+
+    virtual void TearDown()
+    {
+        tree_clear(&tree);
+    }
+
+    tree_t tree;
+};
+
+TEST(tree_to_json, functions_on_null_arguments)
+{
+    tree_t tree;
+    tree_init(&tree);
+
+    EXPECT_EQ(0, tree_to_json(NULL, append, NULL));
+    EXPECT_EQ(0, tree_to_json(&tree, NULL, NULL));
+    EXPECT_EQ(0, tree_to_json_lines(NULL, append, NULL));
+    EXPECT_EQ(0, tree_to_json_lines(&tree, NULL, NULL));
+}
+
+TEST(tree_to_json, empty_tree)
+{
+    tree_t tree;
+    tree_init(&tree);
+
+    EXPECT_EQ("null", to_json(&tree));
+    EXPECT_EQ("", to_json_lines(&tree));
+}
+
+TEST_F(cjson_test, tree_to_json__nests_children_in_sibling_order)
+{
+    EXPECT_EQ(
+        "{\"object_name\":\"a\",\"value\":1,\"children\":["
+            "{\"object_name\":\"b\",\"value\":2,\"children\":["
+                "{\"object_name\":\"c\",\"value\":3,\"children\":[]},"
+                "{\"object_name\":\"d\",\"value\":4,\"children\":[]},"
+                "{\"object_name\":\"e\",\"value\":5,\"children\":["
+                    "{\"object_name\":\"f\",\"value\":6,\"children\":[]}]}]},"
+            "{\"object_name\":\"g\",\"value\":7,\"children\":["
+                "{\"object_name\":\"h\",\"value\":null,\"children\":[]}]}]}",
+        to_json(&tree));
+}
+
+TEST_F(cjson_test, tree_to_json_lines__are_node_to_json_in_pre_order)
+{
+    std::string expected;
+    char buffer[256];
+
+    for (const char *name : {"a", "b", "c", "d", "e", "f", "g", "h"})
+    {
+        ASSERT_LT(node_to_json(tree_get_node(&tree, name), buffer, sizeof(buffer)), static_cast<int>(sizeof(buffer)));
+        expected += std::string(buffer) + "\n";
+    }
+
+    EXPECT_EQ(expected, to_json_lines(&tree));
+}
+
+TEST_F(cjson_test, names_are_escaped)
+{
+    tree_add_node(&tree, node_create(INT, "q\"\\\n\x01", &_8), "h");
+
+    EXPECT_NE(std::string::npos, to_json(&tree).find("{\"object_name\":\"q\\\"\\\\\\u000a\\u0001\",\"value\":8,\"children\":[]}"));
+    EXPECT_NE(std::string::npos, to_json_lines(&tree).find("\"children\":[\"q\\\"\\\\\\u000a\\u0001\"]}\n"));
+}
+
+TEST_F(cjson_test, output_bigger_than_a_chunk_comes_in_chunks)
+{
+    int sizes[] = {TREE_JSON_CHUNK_SIZE - 10, TREE_JSON_CHUNK_SIZE, 3 * TREE_JSON_CHUNK_SIZE, 1};
+    tree_add_node(&tree, node_create(BIG, "big0", &sizes[0]), "h");
+    tree_add_node(&tree, node_create(BIG, "big1", &sizes[1]), "h");
+    tree_add_node(&tree, node_create(BIG, "big2", &sizes[2]), "big1");
+    tree_add_node(&tree, node_create(BIG, "big3", &sizes[3]), "big1");
+
+    std::vector<int> chunks;
+    std::string json;
+    std::pair<std::vector<int> *, std::string *> ctx(&chunks, &json);
+    auto collect = [](const char *data, int size, void *c)
+    {
+        auto p = static_cast<std::pair<std::vector<int> *, std::string *> *>(c);
+        p->first->push_back(size);
+        p->second->append(data, size);
+        return 0;
+    };
+
+    ASSERT_EQ(1, tree_to_json(&tree, collect, &ctx));
+    EXPECT_GT(chunks.size(), 4u);
+
+    for (int size : chunks)
+    {
+        EXPECT_LE(size, TREE_JSON_CHUNK_SIZE);
+    }
+
+    /* big3 has the smaller value, big2 ends the subtrees of big1, h, g and a */
+    EXPECT_NE(
+        std::string::npos,
+        json.find(
+            "{\"object_name\":\"big3\",\"value\":\"x\",\"children\":[]},"
+            "{\"object_name\":\"big2\",\"value\":\"" + std::string(sizes[2], 'x') + "\",\"children\":[]}]}]}]}]}"));
+    EXPECT_EQ(json.size() - 10, json.find("]}]}]}]}]}"));
+}
+
+TEST_F(cjson_test, writer_stops_serialization)
+{
+    int sizes[] = {3 * TREE_JSON_CHUNK_SIZE};
+    tree_add_node(&tree, node_create(BIG, "big", &sizes[0]), "h");
+    int num_calls = 0;
+
+    auto fail_second = [](const char *, int, void *c) { return ++*static_cast<int *>(c) == 2 ? -1 : 0; };
+
+    EXPECT_EQ(0, tree_to_json(&tree, fail_second, &num_calls));
+    EXPECT_EQ(2, num_calls);
+
+    num_calls = 0;
+    EXPECT_EQ(0, tree_to_json_lines(&tree, fail_second, &num_calls));
+    EXPECT_EQ(2, num_calls);
+}
+
+TEST_F(cjson_test, values_without_to_json_fail)
+{
+    value_handlers_t handlers;
+    value_handlers_init(&handlers, int_compare, NULL, NULL);
+    tree_add_node(&tree, node_create(&handlers, "x", &_9), "h");
+    std::string json;
+
+    EXPECT_EQ(0, tree_to_json(&tree, append, &json));
+    EXPECT_EQ(0, tree_to_json_lines(&tree, append, &json));
+}
+
+TEST(tree_json_parser_t, functions_on_null_arguments)
+{
+    tree_t tree;
+    tree_init(&tree);
+    tree_json_parser_t *parser = tree_json_parser_create(PARSED);
+
+    EXPECT_EQ(NULL, tree_json_parser_create(NULL));
+    EXPECT_NO_FATAL_FAILURE(tree_json_parser_dispose(NULL));
+    EXPECT_EQ(0, tree_json_parser_feed(NULL, "{}", 2));
+    EXPECT_EQ(0, tree_json_parser_feed(parser, NULL, 0));
+    EXPECT_EQ(0, tree_json_parser_finish(NULL, &tree));
+    EXPECT_EQ(0, tree_json_parser_finish(parser, NULL));
+    EXPECT_EQ(0, tree_from_json(NULL, PARSED, "", 0));
+    EXPECT_EQ(0, tree_from_json(&tree, NULL, "", 0));
+    EXPECT_EQ(0, tree_from_json(&tree, PARSED, NULL, 0));
+    EXPECT_EQ(0, tree_from_json_fd(NULL, PARSED, 0));
+    EXPECT_EQ(0, tree_from_json_fd(&tree, PARSED, -1));
+
+    tree_json_parser_dispose(parser);
+}
+
+TEST(tree_json_parser_t, empty_input_is_an_empty_tree)
+{
+    tree_t tree;
+    tree_init(&tree);
+
+    EXPECT_EQ(1, from_json(&tree, PARSED, ""));
+    EXPECT_EQ(1, from_json(&tree, PARSED, " \n[]\n"));
+    EXPECT_EQ(NULL, tree.root);
+}
+
+TEST_F(cjson_test, tree_to_json_lines_reads_back)
+{
+    tree_t parsed;
+    tree_init(&parsed);
+    std::string json = to_json_lines(&tree);
+
+    ASSERT_EQ(1, from_json(&parsed, PARSED, json));
+    EXPECT_EQ(7, parsed.num_nodes);
+    EXPECT_EQ(json, to_json_lines(&parsed));
+    EXPECT_EQ(NULL, tree_get_node(&parsed, "h")->value);
+
+    g_num_disposed = 0;
+    tree_clear(&parsed);
+    EXPECT_EQ(8, g_num_disposed);
+}
+
+TEST_F(cjson_test, tree_to_json_reads_back)
+{
+    tree_t parsed;
+    tree_init(&parsed);
+    std::string json = to_json(&tree);
+
+    ASSERT_EQ(1, from_json(&parsed, PARSED, json));
+    EXPECT_EQ(json, to_json(&parsed));
+    EXPECT_EQ(tree_get_node(&parsed, "e"), tree_get_node(&parsed, "f")->parent);
+    tree_clear(&parsed);
+}
+
+TEST_F(cjson_test, chunks_can_end_anywhere)
+{
+    tree_add_node(&tree, node_create(INT, "\xc3\xa9\"\\\n\x01", &_8), "h");
+    tree_t parsed;
+    tree_init(&parsed);
+
+    for (int lines = 0; lines < 2; ++lines)
+    {
+        std::string json = lines ? to_json_lines(&tree) : to_json(&tree);
+        tree_json_parser_t *parser = tree_json_parser_create(PARSED);
+
+        for (char c : json)
+        {
+            ASSERT_EQ(1, tree_json_parser_feed(parser, &c, 1));
+        }
+
+        ASSERT_EQ(1, tree_json_parser_finish(parser, &parsed));
+        tree_json_parser_dispose(parser);
+        EXPECT_EQ(json, lines ? to_json_lines(&parsed) : to_json(&parsed));
+        tree_clear(&parsed);
+    }
+}
+
+TEST(tree_json_parser_t, node_to_json_objects_in_any_order)
+{
+    tree_t tree;
+    tree_init(&tree);
+
+    ASSERT_EQ(
+        1,
+        from_json(
+            &tree,
+            PARSED,
+            "[{\"parent\":\"a\",\"children\":[],\"object_name\":\"c\",\"value\":3},\n"
+            " {\"value\" : 1, \"object_name\" : \"a\", \"extra\" : {\"x\":[1,{\"y\":null}]}},\n"
+            " {\"object_name\":\"b\",\"value\":2,\"parent\":\"a\",\"children\":[\"c\"]}]\n"
+            "{\"object_name\":\"\\u00e9\\ud83d\\ude00\\/\",\"parent\":\"b\"}"));
+
+    EXPECT_EQ(3, tree.num_nodes);
+    EXPECT_EQ(1, *static_cast<int *>(tree.root->value));
+    EXPECT_EQ(tree_get_node(&tree, "a"), tree_get_node(&tree, "c")->parent);
+    EXPECT_EQ(tree_get_node(&tree, "b"), tree_get_node(&tree, "\xc3\xa9\xf0\x9f\x98\x80/")->parent);
+    EXPECT_EQ(NULL, tree_get_node(&tree, "\xc3\xa9\xf0\x9f\x98\x80/")->value);
+    tree_clear(&tree);
+}
+
+TEST(tree_json_parser_t, values_are_passed_as_they_are)
+{
+    const char *values[] = {"\"x}\\\"]\"", "{\"a\":[1,2,\"]\"],\"b\":{}}", "[ 1 , 2 ]", "-1.5e+3", "true"};
+    tree_t tree;
+    tree_init(&tree);
+    std::string json;
+
+    for (int i = 0; i < 5; ++i)
+    {
+        json += "{\"object_name\":\"" + std::to_string(i) + "\",\"value\":" + values[i] + ",\"parent\":" + (i ? "\"0\"" : "null") + "}";
+    }
+
+    ASSERT_EQ(1, from_json(&tree, TEXT, json));
+
+    for (int i = 0; i < 5; ++i)
+    {
+        EXPECT_EQ(values[i], *static_cast<std::string *>(tree_get_node(&tree, std::to_string(i).c_str())->value));
+    }
+
+    tree_clear(&tree);
+}
+
+TEST(tree_json_parser_t, invalid_input_is_rejected)
+{
+    const char *inputs[] =
+    {
+        "{", "}", "[{]", "{\"object_name\":\"a\"", "{\"object_name\":\"a\",}", "{\"object_name\" \"a\"}",
+        "{\"value\":1}", "{\"object_name\":1}", "{\"object_name\":null}", "{\"object_name\":\"a\",\"parent\":2}",
+        "{\"object_name\":\"a\",\"value\":01}", "{\"object_name\":\"a\",\"value\":1.}", "{\"object_name\":\"a\",\"value\":nul}",
+        "{\"object_name\":\"a\",\"value\":\"x\"}", "{\"object_name\":\"a\",\"value\":[1,]}", "\"a\"", "1", "{},{}",
+        "{\"object_name\":\"a\\x\"}", "{\"object_name\":\"\\ud83d\"}", "{\"object_name\":\"\\ude00\"}", "{\"object_name\":\"\\u0000\"}",
+        "{\"object_name\":\"a\n\"}", "{\"children\":[{\"object_name\":\"b\"}],\"object_name\":\"a\"}",
+        "{\"object_name\":\"a\",\"children\":[1]}", "[[]]",
+        "{\"object_name\":\"a\"}{\"object_name\":\"a\"}", "{\"object_name\":\"a\"}{\"object_name\":\"b\"}",
+        "{\"object_name\":\"a\"}{\"object_name\":\"b\",\"parent\":\"x\"}"
+    };
+    tree_t tree;
+    tree_init(&tree);
+
+    for (const char *input : inputs)
+    {
+        g_num_disposed = 0;
+        EXPECT_EQ(0, from_json(&tree, PARSED, input)) << input;
+        EXPECT_EQ(NULL, tree.root) << input;
+    }
+
+    /* the nodes parsed so far are disposed of with their values */
+    g_num_disposed = 0;
+    EXPECT_EQ(0, from_json(&tree, PARSED, "{\"object_name\":\"a\",\"value\":1}{\"object_name\":\"b\",\"value\":2}{"));
+    EXPECT_EQ(2, g_num_disposed);
+}
+
+TEST_F(cjson_test, tree_from_json_fd_reads_to_the_end)
+{
+    std::string json;
+    tree_t parsed;
+    tree_init(&parsed);
+    int sizes[] = {3 * TREE_JSON_CHUNK_SIZE};
+    tree_add_node(&tree, node_create(BIG, "big", &sizes[0]), "h");
+    ASSERT_EQ(1, tree_to_json(&tree, append, &json));
+
+    FILE *file = tmpfile();
+    ASSERT_NE(static_cast<FILE *>(NULL), file);
+    ASSERT_EQ(json.size(), fwrite(json.data(), 1, json.size(), file));
+    fflush(file);
+    rewind(file);
+
+    ASSERT_EQ(1, tree_from_json_fd(&parsed, TEXT, fileno(file)));
+    EXPECT_EQ(8, parsed.num_nodes);
+    EXPECT_EQ("\"" + std::string(sizes[0], 'x') + "\"", *static_cast<std::string *>(tree_get_node(&parsed, "big")->value));
+    EXPECT_EQ("6", *static_cast<std::string *>(tree_get_node(&parsed, "f")->value));
+
+    tree_clear(&parsed);
+    fclose(file);
+}
+
+int main(int argc, char **argv)
+{
+    ::testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
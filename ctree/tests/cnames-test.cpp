@@ -0,0 +1,159 @@
+#include <gtest/gtest.h>
+#include <string>
+#include "cnames.h"
+#include "ctree.h"
+#include "test-helpers.h"
+
+TEST(tree_names_t, functions_on_null_self)
+{
+    EXPECT_NO_FATAL_FAILURE(tree_names_dispose(NULL));
+    EXPECT_EQ(NULL, tree_names_intern(NULL, "a"));
+    EXPECT_EQ(NULL, tree_names_find(NULL, "a"));
+    EXPECT_NO_FATAL_FAILURE(tree_names_release(NULL));
+    EXPECT_EQ(NULL, tree_names_of(NULL));
+    EXPECT_EQ(0, tree_names_count(NULL));
+    EXPECT_EQ(0u, tree_names_size(NULL));
+}
+
+TEST(tree_names_t, names_are_stored_once)
+{
+    tree_names_t *names = tree_names_create();
+    std::string copy = "abc";
+
+    const char *abc = tree_names_intern(names, "abc");
+    ASSERT_NE(static_cast<const char *>(NULL), abc);
+    EXPECT_STREQ("abc", abc);
+    EXPECT_EQ(names, tree_names_of(abc));
+    EXPECT_EQ(NULL, tree_names_intern(names, NULL));
+
+    /* same handle for equal strings */
+    EXPECT_EQ(abc, tree_names_intern(names, copy.c_str()));
+    EXPECT_EQ(abc, tree_names_find(names, "abc"));
+    EXPECT_EQ(NULL, tree_names_find(names, "abd"));
+    EXPECT_NE(abc, tree_names_intern(names, "abd"));
+    EXPECT_EQ(2, tree_names_count(names));
+
+    /* two references to abc, one to abd */
+    tree_names_release(abc);
+    EXPECT_EQ(abc, tree_names_find(names, "abc"));
+    tree_names_release(abc);
+    EXPECT_EQ(NULL, tree_names_find(names, "abc"));
+    tree_names_release(tree_names_find(names, "abd"));
+    EXPECT_EQ(0, tree_names_count(names));
+
+    tree_names_dispose(names);
+}
+
+TEST(tree_names_t, handles_survive_growing)
+{
+    tree_names_t *names = tree_names_create();
+    const char *first = tree_names_intern(names, "n0");
+    size_t size = tree_names_size(names);
+
+    for (int i = 1; i < 1000; ++i)
+    {
+        tree_names_intern(names, ("n" + std::to_string(i)).c_str());
+    }
+
+    EXPECT_EQ(1000, tree_names_count(names));
+    EXPECT_LT(size, tree_names_size(names));
+    EXPECT_EQ(first, tree_names_find(names, "n0"));
+    EXPECT_STREQ("n999", tree_names_find(names, "n999"));
+
+    /* names still referenced go with the pool */
+    tree_names_dispose(names);
+}
+
+TEST(tree_names_t, nodes_share_their_names)
+{
+    tree_names_t *names = tree_names_create();
+    node_t *a = node_create_interned(names, INT, "leaf", &_1);
+    node_t *b = node_create_interned(names, INT, "leaf", &_2);
+
+    ASSERT_NE(static_cast<node_t *>(NULL), a);
+    ASSERT_NE(static_cast<node_t *>(NULL), b);
+    EXPECT_EQ(a->object_name, b->object_name);
+    EXPECT_EQ(NODE_FLAG_INTERNED, a->flags);
+    EXPECT_EQ(node_name_hash("leaf"), a->name_hash);
+    EXPECT_EQ(1, tree_names_count(names));
+
+    EXPECT_EQ(NULL, node_create_interned(names, NULL, "leaf", &_1));
+    EXPECT_EQ(NULL, node_create_interned(names, INT, NULL, &_1));
+    EXPECT_EQ(NULL, node_create_interned(names, INT, "", &_1));
+
+    /* falls back to node_create() */
+    node_t *plain = node_create_interned(NULL, INT, "leaf", &_3);
+    EXPECT_NE(a->object_name, plain->object_name);
+    EXPECT_EQ(0u, plain->flags);
+
+    node_dispose(a);
+    EXPECT_EQ(1, tree_names_count(names));
+    node_dispose(b);
+    EXPECT_EQ(0, tree_names_count(names));
+    node_dispose(plain);
+    tree_names_dispose(names);
+}
+
+TEST(tree_names_t, node_has_name)
+{
+    tree_names_t *names = tree_names_create();
+    node_t *node = node_create_interned(names, INT, "abc", &_1);
+    const char *handle = tree_names_find(names, "abc");
+
+    EXPECT_EQ(1, node_has_name(node, handle, node->name_hash));
+    EXPECT_EQ(1, node_has_name(node, "abc", node_name_hash("abc")));
+    EXPECT_EQ(0, node_has_name(node, "abd", node_name_hash("abd")));
+
+    /* a different hash rejects without comparing the strings */
+    EXPECT_EQ(0, node_has_name(node, "abc", node->name_hash + 1));
+
+    node_dispose(node);
+    tree_names_dispose(names);
+}
+
+TEST(tree_names_t, trees_of_interned_nodes)
+{
+    tree_names_t *names = tree_names_create();
+    tree_t trees[2];
+    const char *leaves[] = {"x", "y", "z"};
+
+    /* the same leaf names under different parents in different trees */
+    for (int t = 0; t < 2; ++t)
+    {
+        tree_init(&trees[t]);
+        tree_add_node(&trees[t], node_create_interned(names, INT, "root", &_1), NULL);
+        tree_add_node(&trees[t], node_create_interned(names, INT, t ? "b" : "a", &_2), "root");
+
+        for (const char *leaf : leaves)
+        {
+            tree_add_node(&trees[t], node_create_interned(names, INT, leaf, &_3), t ? "b" : "a");
+        }
+    }
+
+    EXPECT_EQ(6, tree_names_count(names));
+    EXPECT_EQ(tree_get_node(&trees[0], "x")->object_name, tree_get_node(&trees[1], "x")->object_name);
+    EXPECT_EQ(tree_get_node(&trees[0], "a"), tree_get_node(&trees[0], tree_names_find(names, "y"))->parent);
+
+    /* found by the handle right away */
+    node_t *x = node_create_interned(names, INT, "x", &_4);
+    EXPECT_EQ(NULL, node_add_child(tree_get_node(&trees[0], "a"), x));
+    node_dispose(x);
+
+    EXPECT_EQ(1, tree_remove_node(&trees[0], "a"));
+    EXPECT_EQ(tree_get_node(&trees[0], "root"), tree_get_node(&trees[0], "z")->parent);
+    EXPECT_EQ(3, tree_remove_tree(&trees[1], "x") + tree_remove_tree(&trees[1], "y") + tree_remove_tree(&trees[1], "z"));
+    /* a was in one tree only */
+    EXPECT_EQ(5, tree_names_count(names));
+
+    tree_clear(&trees[0]);
+    EXPECT_EQ(2, tree_names_count(names));
+    tree_clear(&trees[1]);
+    EXPECT_EQ(0, tree_names_count(names));
+    tree_names_dispose(names);
+}
+
+int main(int argc, char **argv)
+{
+    ::testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
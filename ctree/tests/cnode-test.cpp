@@ -1,4 +1,7 @@
 #include <gtest/gtest.h>
+#include <algorithm>
+#include <string>
+#include <vector>
 #include "cnode.h"
 #include "test-helpers.h"
 
@@ -22,6 +25,35 @@ TEST(value_handlers_t, value_handlers_init__dispose_function_and_to_json_functio
     EXPECT_EQ(NULL, h.dispose_fun);
 }
 
+TEST(value_handlers_t, value_handlers_set_binary__on_null_structure_returns_null)
+{
+    EXPECT_EQ(NULL, value_handlers_set_binary(NULL, NULL, NULL));
+}
+
+TEST(value_handlers_t, value_handlers_set_binary__binary_functions_are_optional)
+{
+    value_handlers_t h;
+    value_handlers_init(&h, int_compare, int_to_json, int_dispose);
+    EXPECT_EQ(NULL, h.to_binary_fun);
+    EXPECT_EQ(NULL, h.from_binary_fun);
+    EXPECT_EQ(&h, value_handlers_set_binary(&h, NULL, NULL));
+    EXPECT_EQ(&int_compare, h.compare_fun);
+}
+
+TEST(value_handlers_t, value_handlers_set_from_json__on_null_structure_returns_null)
+{
+    EXPECT_EQ(NULL, value_handlers_set_from_json(NULL, NULL));
+}
+
+TEST(value_handlers_t, value_handlers_set_from_json__parse_function_is_optional)
+{
+    value_handlers_t h;
+    value_handlers_init(&h, int_compare, int_to_json, int_dispose);
+    EXPECT_EQ(NULL, h.from_json_fun);
+    EXPECT_EQ(&h, value_handlers_set_from_json(&h, NULL));
+    EXPECT_EQ(&int_compare, h.compare_fun);
+}
+
 TEST(node_t, node_create__with_null_handlers_returns_null)
 {
     EXPECT_EQ(NULL, node_create(NULL, "node", &_1));
@@ -46,6 +78,27 @@ TEST(node_t, node_create__with_null_value_is_ok)
     node_dispose(node);
 }
 
+TEST(node_t, node_name_hash__of_null_is_0)
+{
+    EXPECT_EQ(0u, node_name_hash(NULL));
+}
+
+TEST(node_t, node_name_hash__is_fnv_1a)
+{
+    EXPECT_EQ(2166136261u, node_name_hash(""));
+    EXPECT_EQ(0xe40c292cu, node_name_hash("a"));
+    EXPECT_EQ(0xbf9cf968u, node_name_hash("foobar"));
+}
+
+TEST(node_t, node_create__caches_name_hash)
+{
+    node_t *node = node_create(INT, "node", NULL);
+
+    EXPECT_EQ(node_name_hash("node"), node->name_hash);
+
+    node_dispose(node);
+}
+
 TEST(node_t, node_dispose__on_null_is_safe)
 {
     EXPECT_NO_FATAL_FAILURE(node_dispose(NULL));
@@ -103,6 +156,40 @@ TEST(node_t, node_add_child__every_child_is_appended)
     node_dispose(d);
 }
 
+TEST(node_t, node_add_child__children_spill_from_the_node_to_a_table)
+{
+    /* Prepare */
+    node_t *a = node_create(INT, "a", &_1);
+    node_t *children[NODE_INLINE_CHILDREN + 1];
+    char name[] = "b";
+    /* Run */
+    for (int i = 0; i < NODE_INLINE_CHILDREN; ++i, ++name[0])
+    {
+        children[i] = node_create(INT, name, &_2);
+        EXPECT_EQ(children[i], node_add_child(a, children[i]));
+    }
+    /* Check inline */
+    EXPECT_NODE(a, "a", NULL, children, NODE_INLINE_CHILDREN, NODE_INLINE_CHILDREN, &_1);
+    EXPECT_EQ(a->inline_children, a->children);
+    /* Check spilled */
+    children[NODE_INLINE_CHILDREN] = node_create(INT, name, &_2);
+    EXPECT_EQ(children[NODE_INLINE_CHILDREN], node_add_child(a, children[NODE_INLINE_CHILDREN]));
+    EXPECT_NODE(a, "a", NULL, children, NODE_INLINE_CHILDREN + 1, NODE_INLINE_CHILDREN + 4, &_1);
+    EXPECT_NE(a->inline_children, a->children);
+    /* Check the table stays */
+    EXPECT_EQ(1, node_remove_child(a, "b"));
+    EXPECT_EQ(1, node_reserve_children(a, 2));
+    EXPECT_EQ(NODE_INLINE_CHILDREN + 4, a->capacity);
+    EXPECT_NE(a->inline_children, a->children);
+    EXPECT_EQ(0, node_reserve_children(NULL, 2));
+    /* Cleanup */
+    for (int i = 1; i <= NODE_INLINE_CHILDREN; ++i)
+    {
+        node_dispose(children[i]);
+    }
+    node_dispose(a);
+}
+
 TEST(node_t, node_add_child__every_child_is_prepended)
 {
     /* Prepare */
@@ -255,6 +342,47 @@ TEST(node_t, node_remove_child__at_various_positions)
     node_dispose(a);
 }
 
+TEST(node_t, node_height__is_kept_up_to_date)
+{
+    node_t *a = node_create(INT, "a", &_1);
+    node_t *b = node_create(INT, "b", &_2);
+    node_t *c = node_create(INT, "c", &_3);
+    node_t *d = node_create(INT, "d", &_4);
+    node_t *e = node_create(INT, "e", &_5);
+    EXPECT_EQ(1, a->height);
+    /* a - b - c, then d is added to b and e to c */
+    node_add_child(a, b);
+    EXPECT_EQ(2, a->height);
+    node_add_child(b, c);
+    EXPECT_EQ(3, a->height);
+    EXPECT_EQ(2, b->height);
+    node_add_child(b, d);
+    EXPECT_EQ(3, a->height);
+    node_add_child(c, e);
+    EXPECT_EQ(4, a->height);
+    EXPECT_EQ(3, b->height);
+    EXPECT_EQ(2, c->height);
+    /* removing a lower child changes nothing */
+    EXPECT_EQ(1, node_remove_child(b, "d"));
+    EXPECT_EQ(4, a->height);
+    EXPECT_EQ(3, b->height);
+    /* removing the highest one does */
+    EXPECT_EQ(1, node_remove_child(c, "e"));
+    EXPECT_EQ(3, a->height);
+    EXPECT_EQ(2, b->height);
+    EXPECT_EQ(1, c->height);
+    EXPECT_EQ(1, node_remove_child(b, "c"));
+    EXPECT_EQ(2, a->height);
+    EXPECT_EQ(1, b->height);
+    node_dispose(a);
+    node_dispose(b);
+}
+
+TEST(node_t, node_update_height__on_null_is_safe)
+{
+    EXPECT_NO_FATAL_FAILURE(node_update_height(NULL));
+}
+
 TEST(node_t, node_to_json__on_null_node_returns_0)
 {
     char buffer[] = "unchanged";
@@ -313,6 +441,146 @@ TEST(node_t, node_to_json__when_value_parent_and_children_are_valid_with_various
     node_dispose(d);
 }
 
+TEST(node_t, node_json_size__on_null_node_returns_0)
+{
+    EXPECT_EQ(0, node_json_size(NULL));
+}
+
+TEST(node_t, node_json_size__without_to_json_function_returns_0)
+{
+    value_handlers_t h;
+    value_handlers_init(&h, int_compare, NULL, NULL);
+    node_t *a = node_create(&h, "a", &_1);
+    char buffer[64];
+    EXPECT_EQ(0, node_json_size(a));
+    EXPECT_EQ(0, node_to_json(a, buffer, sizeof(buffer)));
+    node_dispose(a);
+}
+
+TEST(node_t, node_json_size__is_the_size_of_node_to_json_for_any_buffer_size)
+{
+    const char *expected = "{\"object_name\":\"b\",\"value\":123,\"parent\":\"a\",\"children\":[\"d\",\"c\"]}";
+    char buffer[66];
+    node_t *a = node_create(INT, "a", NULL);
+    node_t *b = node_create(INT, "b", &_123);
+    node_t *c = node_create(INT, "c", &_2);
+    node_t *d = node_create(INT, "d", &_1);
+    node_add_child(a, b);
+    node_add_child(b, c);
+    node_add_child(b, d);
+    int size = node_json_size(b);
+    EXPECT_EQ(static_cast<int>(strlen(expected)), size);
+    /* snprintf convention, the whole size no matter how much fits */
+    for (int buffer_size = 1; buffer_size <= size + 1; ++buffer_size)
+    {
+        memset(buffer, 'x', sizeof(buffer));
+        EXPECT_EQ(size, node_to_json(b, buffer, buffer_size));
+        EXPECT_EQ(std::string(expected, std::min(size, buffer_size - 1)), buffer);
+    }
+    EXPECT_EQ(size, node_to_json(b, buffer, 0));
+    node_dispose(a);
+    node_dispose(b);
+    node_dispose(c);
+    node_dispose(d);
+}
+
+TEST(node_t, node_to_json__escapes_names)
+{
+    const char *expected = "{\"object_name\":\"q\\\"\\\\\\u000a\\u001f\xc3\xa9\",\"value\":1,\"parent\":\"\\\"\",\"children\":[\"\\\\t\"]}";
+    char buffer[128];
+    node_t *a = node_create(INT, "\"", NULL);
+    node_t *b = node_create(INT, "q\"\\\n\x1f\xc3\xa9", &_1);
+    node_t *c = node_create(INT, "\\t", &_2);
+    node_add_child(a, b);
+    node_add_child(b, c);
+    EXPECT_EQ(static_cast<int>(strlen(expected)), node_json_size(b));
+    EXPECT_EQ(static_cast<int>(strlen(expected)), node_to_json(b, buffer, sizeof(buffer)));
+    EXPECT_STREQ(expected, buffer);
+    node_dispose(a);
+    node_dispose(b);
+    node_dispose(c);
+}
+
+TEST(node_t, node_json_escape__on_null_string_returns_0)
+{
+    char buffer[] = "unchanged";
+    EXPECT_EQ(0, node_json_escape(NULL, buffer, sizeof(buffer)));
+    EXPECT_STREQ("unchanged", buffer);
+}
+
+TEST(node_t, node_json_escape__follows_the_snprintf_convention)
+{
+    char buffer[16];
+    EXPECT_EQ(2, node_json_escape("", buffer, sizeof(buffer)));
+    EXPECT_STREQ("\"\"", buffer);
+    EXPECT_EQ(15, node_json_escape("a\"b\\\x7f\x1f", NULL, 0));
+    EXPECT_EQ(15, node_json_escape("a\"b\\\x7f\x1f", buffer, sizeof(buffer)));
+    EXPECT_STREQ("\"a\\\"b\\\\\x7f\\u001f\"", buffer);
+    EXPECT_EQ(15, node_json_escape("a\"b\\\x7f\x1f", buffer, 5));
+    EXPECT_STREQ("\"a\\\"", buffer);
+}
+
+TEST(node_t, node_json_escape__every_scan_gives_the_same_output)
+{
+    const node_json_scan_t scans[] = {NODE_JSON_SCAN_SCALAR, NODE_JSON_SCAN_SSE2, NODE_JSON_SCAN_AVX2};
+    std::vector<std::string> strings;
+    unsigned int seed = 42;
+
+    /* escapes at every position of a block and around block boundaries */
+    for (int size = 0; size < 100; ++size)
+    {
+        for (int escape = 0; escape <= size; ++escape)
+        {
+            std::string string(size, 'a');
+
+            if (escape < size)
+            {
+                string[escape] = "\"\\\x01\x1f"[escape % 4];
+            }
+
+            strings.push_back(string);
+        }
+    }
+
+    /* all bytes, high ones must not be taken for control characters */
+    for (int i = 0; i < 200; ++i)
+    {
+        std::string string;
+
+        for (int size = rand_r(&seed) % 80; size > 0; --size)
+        {
+            string += static_cast<char>(1 + rand_r(&seed) % 255);
+        }
+
+        strings.push_back(string);
+    }
+
+    std::vector<std::string> expected;
+
+    for (node_json_scan_t scan : scans)
+    {
+        node_json_scan_t used = node_json_set_scan(scan);
+        EXPECT_TRUE(used == scan || used < scan);
+
+        for (size_t i = 0; i < strings.size(); ++i)
+        {
+            std::vector<char> buffer(strings[i].size() * 6 + 3);
+            int size = node_json_escape(strings[i].c_str(), buffer.data(), static_cast<int>(buffer.size()));
+
+            if (scan == NODE_JSON_SCAN_SCALAR)
+            {
+                expected.push_back(std::string(buffer.data(), size));
+            }
+            else
+            {
+                EXPECT_EQ(expected[i], std::string(buffer.data(), size));
+            }
+        }
+    }
+
+    EXPECT_NE(NODE_JSON_SCAN_AUTO, node_json_set_scan(NODE_JSON_SCAN_AUTO));
+}
+
 int main(int argc, char **argv)
 {
     ::testing::InitGoogleTest(&argc, argv);
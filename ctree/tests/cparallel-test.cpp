@@ -0,0 +1,193 @@
+#include <gtest/gtest.h>
+#include <string>
+#include <vector>
+#include "cparallel.h"
+#include "test-helpers.h"
+
+class cparallel_test : public ::testing::Test
+{
+protected:
+    virtual void SetUp()
+    {
+        tree_init(&t);
+        previous_threshold = tree_parallel_set_serial_threshold(16);
+    }
+
+    virtual void TearDown()
+    {
+        tree_clear(&t);
+        tree_parallel_set_serial_threshold(previous_threshold);
+    }
+
+    /* node n is a child of node parent_of(n), node n holds value n */
+    void build(int num_nodes, int (*parent_of)(int))
+    {
+        std::vector<node_t *> nodes;
+        std::vector<const char *> parent_names;
+
+        values.resize(num_nodes);
+
+        for (int n = 0; n < num_nodes; ++n)
+        {
+            names.push_back("n" + std::to_string(n));
+        }
+
+        for (int n = 0; n < num_nodes; ++n)
+        {
+            values[n] = n;
+            nodes.push_back(node_create(INT, names[n].c_str(), &values[n]));
+            parent_names.push_back((n == 0) ? NULL : names[parent_of(n)].c_str());
+        }
+
+        ASSERT_EQ(TREE_BUILD_OK, tree_build(&t, &nodes[0], &parent_names[0], num_nodes, NULL));
+    }
+
+    tree_t t;
+    int previous_threshold;
+    std::vector<std::string> names;
+    std::vector<int> values;
+};
+
+static int binary_parent(int n)
+{
+    return (n - 1) / 2;
+}
+
+/* a spine of every 4th node, each of them has 3 leaves too */
+static int skewed_parent(int n)
+{
+    return (n % 4 == 0) ? n - 4 : n - n % 4;
+}
+
+static int count_nodes(node_t *, void *ctx)
+{
+    __atomic_add_fetch(static_cast<int *>(ctx), 1, __ATOMIC_RELAXED);
+    return 0;
+}
+
+static int stop_at_once(node_t *, void *ctx)
+{
+    __atomic_add_fetch(static_cast<int *>(ctx), 1, __ATOMIC_RELAXED);
+    return 1;
+}
+
+static void sum_values(void *acc, node_t *node, void *)
+{
+    *static_cast<long long *>(acc) += *static_cast<int *>(node->value);
+}
+
+static void add_sums(void *acc, const void *other, void *)
+{
+    *static_cast<long long *>(acc) += *static_cast<const long long *>(other);
+}
+
+TEST(tree_parallel, tree_parallel_set_serial_threshold__returns_previous_value)
+{
+    int previous = tree_parallel_set_serial_threshold(100);
+    EXPECT_EQ(100, tree_parallel_set_serial_threshold(0));
+    EXPECT_EQ(TREE_PARALLEL_SERIAL_THRESHOLD, tree_parallel_set_serial_threshold(previous));
+}
+
+TEST_F(cparallel_test, tree_parallel_for_each__with_invalid_inputs_returns_minus_1)
+{
+    int cnt = 0;
+    EXPECT_EQ(-1, tree_parallel_for_each(NULL, count_nodes, &cnt, 4));
+    EXPECT_EQ(-1, tree_parallel_for_each(&t, NULL, &cnt, 4));
+    EXPECT_EQ(0, tree_parallel_for_each(&t, count_nodes, &cnt, 4));
+    EXPECT_EQ(0, cnt);
+}
+
+TEST_F(cparallel_test, tree_parallel_reduce__with_invalid_inputs_returns_0)
+{
+    long long sum = 0;
+    EXPECT_EQ(0, tree_parallel_reduce(NULL, &sum, sizeof(sum), sum_values, add_sums, NULL, 4));
+    EXPECT_EQ(0, tree_parallel_reduce(&t, NULL, sizeof(sum), sum_values, add_sums, NULL, 4));
+    EXPECT_EQ(0, tree_parallel_reduce(&t, &sum, 0, sum_values, add_sums, NULL, 4));
+    EXPECT_EQ(0, tree_parallel_reduce(&t, &sum, sizeof(sum), NULL, add_sums, NULL, 4));
+    EXPECT_EQ(0, tree_parallel_reduce(&t, &sum, sizeof(sum), sum_values, NULL, NULL, 4));
+    EXPECT_EQ(1, tree_parallel_reduce(&t, &sum, sizeof(sum), sum_values, add_sums, NULL, 4));
+    EXPECT_EQ(0, sum);
+}
+
+TEST_F(cparallel_test, tree_parallel_for_each__visits_every_node_once)
+{
+    const int num_nodes = 50000;
+    build(num_nodes, binary_parent);
+
+    for (int num_threads = 0; num_threads <= 8; ++num_threads)
+    {
+        int cnt = 0;
+        EXPECT_EQ(num_nodes, tree_parallel_for_each(&t, count_nodes, &cnt, num_threads));
+        EXPECT_EQ(num_nodes, cnt);
+    }
+}
+
+TEST_F(cparallel_test, tree_parallel_reduce__on_balanced_tree)
+{
+    const int num_nodes = 50000;
+    build(num_nodes, binary_parent);
+
+    for (int num_threads = 0; num_threads <= 8; ++num_threads)
+    {
+        long long sum = 0;
+        EXPECT_EQ(
+            1,
+            tree_parallel_reduce(&t, &sum, sizeof(sum), sum_values, add_sums, NULL, num_threads));
+        EXPECT_EQ(1LL * num_nodes * (num_nodes - 1) / 2, sum);
+    }
+}
+
+TEST_F(cparallel_test, tree_parallel_reduce__on_skewed_tree)
+{
+    const int num_nodes = 40000;
+    build(num_nodes, skewed_parent);
+    EXPECT_EQ(num_nodes / 4 + 1, tree_depth(&t));
+
+    long long sum = 0;
+    EXPECT_EQ(1, tree_parallel_reduce(&t, &sum, sizeof(sum), sum_values, add_sums, NULL, 4));
+    EXPECT_EQ(1LL * num_nodes * (num_nodes - 1) / 2, sum);
+}
+
+TEST_F(cparallel_test, tree_parallel_for_each__below_serial_threshold)
+{
+    const int num_nodes = 1000;
+    build(num_nodes, binary_parent);
+    tree_parallel_set_serial_threshold(num_nodes);
+
+    int cnt = 0;
+    EXPECT_EQ(num_nodes, tree_parallel_for_each(&t, count_nodes, &cnt, 4));
+    EXPECT_EQ(num_nodes, cnt);
+}
+
+TEST_F(cparallel_test, tree_parallel_for_each__stops_when_visitor_returns_non_0)
+{
+    const int num_nodes = 50000;
+    build(num_nodes, binary_parent);
+
+    int cnt = 0;
+    int visited_cnt = tree_parallel_for_each(&t, stop_at_once, &cnt, 4);
+    EXPECT_EQ(cnt, visited_cnt);
+    EXPECT_GE(visited_cnt, 1);
+    EXPECT_LE(visited_cnt, 4);
+}
+
+TEST_F(cparallel_test, tree_parallel_for_each__follows_changes)
+{
+    const int num_nodes = 1000;
+    build(num_nodes, binary_parent);
+
+    int cnt = 0;
+    EXPECT_EQ(num_nodes, tree_parallel_for_each(&t, count_nodes, &cnt, 4));
+    int removed_cnt = tree_subtree_size(&t, "n1");
+    EXPECT_EQ(removed_cnt, tree_remove_tree(&t, "n1"));
+
+    cnt = 0;
+    EXPECT_EQ(t.num_nodes + 1, tree_parallel_for_each(&t, count_nodes, &cnt, 4));
+    EXPECT_EQ(t.num_nodes + 1, cnt);
+}
+
+int main(int argc, char **argv)
+{
+    ::testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
@@ -0,0 +1,399 @@
+#include <gtest/gtest.h>
+#include <atomic>
+#include <deque>
+#include <mutex>
+#include <random>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+#include "cepoch.h"
+#include "ctree.h"
+#include "test-helpers.h"
+
+static int append_name(node_t *node, void *ctx)
+{
+    *static_cast<std::string *>(ctx) += node->object_name;
+    return 0;
+}
+
+static std::string pre_order_names(tree_t *tree)
+{
+    std::string names;
+    tree_for_each(tree, TREE_ITER_PRE_ORDER, append_name, &names);
+    return names;
+}
+
+static std::string snapshot_names(tree_snapshot_t *snapshot)
+{
+    std::string names;
+    tree_snapshot_for_each(snapshot, append_name, &names);
+    return names;
+}
+
+static std::string snapshot_children_names(tree_snapshot_t *snapshot, const char *node_name)
+{
+    std::string names;
+    node_t **children = tree_snapshot_children(snapshot, tree_snapshot_get_node(snapshot, node_name));
+
+    for (; (children != NULL) && (*children != NULL); ++children)
+    {
+        names += (*children)->object_name;
+    }
+
+    return names;
+}
+
+/* tree takes ownership of the node only if it was added */
+static void add_or_dispose(tree_t *tree, const std::string &name, int *value, const char *parent_name)
+{
+    node_t *node = node_create(INT, name.c_str(), value);
+
+    if (tree_add_node(tree, node, parent_name) == NULL)
+    {
+        node_dispose(node);
+    }
+}
+
+static int stop_at_c(node_t *node, void *)
+{
+    return node->object_name[0] == 'c';
+}
+
+TEST(tree_snapshot_t, functions_on_null_self)
+{
+    tree_t tree;
+    tree_init(&tree);
+
+    EXPECT_EQ(NULL, tree_snapshot(NULL));
+    EXPECT_EQ(NULL, tree_snapshot(&tree));
+    EXPECT_NO_FATAL_FAILURE(tree_snapshot_release(NULL));
+    EXPECT_EQ(NULL, tree_snapshot_root(NULL));
+    EXPECT_EQ(NULL, tree_snapshot_get_node(NULL, "a"));
+    EXPECT_EQ(NULL, tree_snapshot_children(NULL, NULL));
+    EXPECT_EQ(-1, tree_snapshot_for_each(NULL, append_name, NULL));
+}
+
+class csnapshot_test : public ::testing::Test
+{
+protected:
+    virtual void SetUp()
+    {
+        epoch = epoch_create();
+        tree_init(&tree);
+        ASSERT_EQ(1, tree_set_epoch(&tree, epoch));
+        tree_add_node(&tree, node_create(INT, "a", &_1), NULL);
+        tree_add_node(&tree, node_create(INT, "b", &_2), "a");
+        tree_add_node(&tree, node_create(INT, "c", &_3), "b");
+        tree_add_node(&tree, node_create(INT, "d", &_4), "b");
+        tree_add_node(&tree, node_create(INT, "e", &_5), "a");
+        tree_add_node(&tree, node_create(INT, "f", &_6), "e");
+        snapshot = tree_snapshot(&tree);
+        ASSERT_NE(static_cast<tree_snapshot_t *>(NULL), snapshot);
+    }
+
+    virtual void TearDown()
+    {
+        tree_snapshot_release(snapshot);
+        tree_clear(&tree);
+        epoch_dispose(epoch);
+    }
+
+    epoch_t *epoch;
+    tree_t tree;
+    tree_snapshot_t *snapshot;
+};
+
+TEST_F(csnapshot_test, snapshot_of_an_unchanged_tree)
+{
+    EXPECT_EQ(tree.root, tree_snapshot_root(snapshot));
+    EXPECT_EQ(tree_get_node(&tree, "d"), tree_snapshot_get_node(snapshot, "d"));
+    EXPECT_EQ(NULL, tree_snapshot_get_node(snapshot, "x"));
+    EXPECT_EQ(NULL, tree_snapshot_get_node(snapshot, NULL));
+    EXPECT_EQ("be", snapshot_children_names(snapshot, "a"));
+    EXPECT_EQ("", snapshot_children_names(snapshot, "f"));
+    EXPECT_EQ("abcdef", snapshot_names(snapshot));
+    EXPECT_EQ(-1, tree_snapshot_for_each(snapshot, NULL, NULL));
+    EXPECT_EQ(3, tree_snapshot_for_each(snapshot, stop_at_c, NULL));
+}
+
+TEST_F(csnapshot_test, added_nodes_are_not_seen)
+{
+    tree_add_node(&tree, node_create(INT, "g", &_7), "c");
+    tree_add_node(&tree, node_create(INT, "h", &_8), "a");
+    tree_add_node(&tree, node_create(INT, "i", &_9), "g");
+
+    EXPECT_EQ("abcgidefh", pre_order_names(&tree));
+    EXPECT_EQ("abcdef", snapshot_names(snapshot));
+    EXPECT_EQ("be", snapshot_children_names(snapshot, "a"));
+    EXPECT_EQ(NULL, tree_snapshot_get_node(snapshot, "g"));
+    EXPECT_EQ(NULL, tree_snapshot_get_node(snapshot, "h"));
+}
+
+TEST_F(csnapshot_test, removed_nodes_are_kept)
+{
+    node_t *b = tree_get_node(&tree, "b");
+
+    EXPECT_EQ(1, tree_remove_node(&tree, "b"));
+    EXPECT_EQ(2, tree_remove_tree(&tree, "e"));
+    EXPECT_EQ(NULL, tree_get_node(&tree, "b"));
+    EXPECT_EQ(NULL, tree_get_node(&tree, "f"));
+    EXPECT_EQ("acd", pre_order_names(&tree));
+    EXPECT_EQ(3, tree.num_buried);
+
+    EXPECT_EQ(b, tree_snapshot_get_node(snapshot, "b"));
+    EXPECT_EQ("be", snapshot_children_names(snapshot, "a"));
+    EXPECT_EQ("cd", snapshot_children_names(snapshot, "b"));
+    EXPECT_EQ("abcdef", snapshot_names(snapshot));
+
+    /* retired by the writer once the snapshot is gone, b, d, e, f and replaced tables */
+    tree_snapshot_release(snapshot);
+    snapshot = NULL;
+    epoch_synchronize(epoch);
+    EXPECT_EQ(1, tree_remove_node(&tree, "d"));
+    EXPECT_EQ(0, tree.num_buried);
+    EXPECT_LE(4, epoch_num_pending(epoch));
+    EXPECT_EQ("ac", pre_order_names(&tree));
+}
+
+TEST_F(csnapshot_test, removed_names_can_be_added_again)
+{
+    node_t *c = tree_get_node(&tree, "c");
+    node_t *new_c = node_create(INT, "c", &_10);
+
+    EXPECT_EQ(1, tree_remove_node(&tree, "c"));
+    EXPECT_EQ(new_c, tree_add_node(&tree, new_c, "e"));
+
+    EXPECT_EQ(new_c, tree_get_node(&tree, "c"));
+    EXPECT_EQ(c, tree_snapshot_get_node(snapshot, "c"));
+    EXPECT_EQ("abdefc", pre_order_names(&tree));
+    EXPECT_EQ("abcdef", snapshot_names(snapshot));
+
+    tree_snapshot_t *later = tree_snapshot(&tree);
+    EXPECT_EQ(1, tree_remove_node(&tree, "c"));
+    EXPECT_EQ(new_c, tree_snapshot_get_node(later, "c"));
+    EXPECT_EQ(c, tree_snapshot_get_node(snapshot, "c"));
+    EXPECT_EQ(NULL, tree_get_node(&tree, "c"));
+    EXPECT_EQ("abdefc", snapshot_names(later));
+    tree_snapshot_release(later);
+}
+
+TEST_F(csnapshot_test, every_snapshot_sees_its_own_version)
+{
+    std::vector<tree_snapshot_t *> snapshots;
+    std::vector<std::string> names;
+
+    for (int i = 0; i < 5; ++i)
+    {
+        add_or_dispose(&tree, "x" + std::to_string(i), &_7, "a");
+        add_or_dispose(&tree, "y" + std::to_string(i), &_8, "x0");
+        names.push_back(pre_order_names(&tree));
+        snapshots.push_back(tree_snapshot(&tree));
+        tree_remove_node(&tree, "e");
+        tree_remove_node(&tree, ("x" + std::to_string(i)).c_str());
+    }
+
+    tree_snapshot_release(snapshot);
+    snapshot = NULL;
+
+    for (int i = 0; i < 5; ++i)
+    {
+        EXPECT_EQ(names[i], snapshot_names(snapshots[i]));
+        tree_snapshot_release(snapshots[i]);
+    }
+}
+
+TEST_F(csnapshot_test, snapshot_outlives_clear_and_build)
+{
+    node_t *a = tree.root;
+
+    tree_clear(&tree);
+    EXPECT_EQ(NULL, tree_get_node(&tree, "a"));
+    EXPECT_EQ(NULL, tree_get_node(&tree, "c"));
+
+    node_t *nodes[] = {
+        node_create(INT, "x", &_1),
+        node_create(INT, "c", &_2),
+        node_create(INT, "z", &_3)};
+    const char *parent_names[] = {NULL, "x", "x"};
+    ASSERT_EQ(TREE_BUILD_OK, tree_build(&tree, nodes, parent_names, 3, NULL));
+    EXPECT_EQ("xcz", pre_order_names(&tree));
+    EXPECT_EQ(nodes[1], tree_get_node(&tree, "c"));
+
+    EXPECT_EQ(a, tree_snapshot_root(snapshot));
+    EXPECT_NE(nodes[1], tree_snapshot_get_node(snapshot, "c"));
+    EXPECT_EQ(NULL, tree_snapshot_get_node(snapshot, "z"));
+    EXPECT_EQ("abcdef", snapshot_names(snapshot));
+}
+
+TEST_F(csnapshot_test, snapshot_outlives_clear_and_add_tree)
+{
+    tree_t sub_tree;
+    tree_init(&sub_tree);
+    node_t *w = node_create(INT, "w", &_4);
+    tree_add_node(&sub_tree, w, NULL);
+    tree_add_node(&sub_tree, node_create(INT, "b", &_5), "w");
+
+    EXPECT_EQ(6, tree_remove_tree(&tree, "a"));
+    EXPECT_EQ(w, tree_add_tree(&tree, &sub_tree, NULL));
+    EXPECT_EQ("wb", pre_order_names(&tree));
+    EXPECT_EQ("abcdef", snapshot_names(snapshot));
+    EXPECT_EQ("cd", snapshot_children_names(snapshot, "b"));
+
+    tree_init(&sub_tree);
+    tree_add_node(&sub_tree, node_create(INT, "v", &_6), NULL);
+    tree_add_node(&sub_tree, node_create(INT, "c", &_7), "v");
+    EXPECT_NE(static_cast<node_t *>(NULL), tree_add_tree(&tree, &sub_tree, "b"));
+    EXPECT_EQ("wbvc", pre_order_names(&tree));
+    EXPECT_EQ("abcdef", snapshot_names(snapshot));
+    EXPECT_EQ(NULL, tree_snapshot_get_node(snapshot, "v"));
+}
+
+TEST(csnapshot, snapshot_readers_and_a_writer)
+{
+    const int num_fixed = 16;
+    const int num_temporary = 64;
+    const int num_rounds = 20000;
+    std::vector<std::string> fixed_names;
+    std::vector<std::string> temporary_names;
+    std::deque<std::pair<tree_snapshot_t *, std::string> > taken;
+    std::mutex taken_mutex;
+    std::atomic<int> num_errors(0);
+    std::atomic<int> num_checked(0);
+    std::atomic<bool> writer_done(false);
+    epoch_t *epoch = epoch_create();
+    tree_t tree;
+
+    for (int i = 0; i < num_fixed; ++i)
+    {
+        fixed_names.push_back("k" + std::to_string(i));
+    }
+
+    for (int i = 0; i < num_temporary; ++i)
+    {
+        temporary_names.push_back("t" + std::to_string(i));
+    }
+
+    tree_init(&tree);
+    ASSERT_EQ(1, tree_set_epoch(&tree, epoch));
+    tree_add_node(&tree, node_create(INT, "root", &_1), NULL);
+
+    for (int i = 0; i < num_fixed; ++i)
+    {
+        tree_add_node(&tree, node_create(INT, fixed_names[i].c_str(), &_2), "root");
+    }
+
+    /* walks snapshots while the writer goes on, every one must look as when it was taken */
+    std::thread reader([&] {
+        for (;;)
+        {
+            std::pair<tree_snapshot_t *, std::string> next(NULL, "");
+            {
+                std::lock_guard<std::mutex> lock(taken_mutex);
+
+                if (!taken.empty())
+                {
+                    next = taken.front();
+                    taken.pop_front();
+                }
+            }
+
+            if (next.first == NULL)
+            {
+                if (writer_done)
+                {
+                    break;
+                }
+
+                std::this_thread::yield();
+                continue;
+            }
+
+            std::string names;
+            std::vector<node_t *> nodes;
+            tree_snapshot_for_each(next.first, [](node_t *node, void *ctx) {
+                static_cast<std::vector<node_t *> *>(ctx)->push_back(node);
+                return 0;
+            }, &nodes);
+
+            for (node_t *node : nodes)
+            {
+                names += node->object_name;
+
+                if (tree_snapshot_get_node(next.first, node->object_name) != node)
+                {
+                    ++num_errors;
+                }
+            }
+
+            if (names != next.second)
+            {
+                ++num_errors;
+            }
+
+            tree_snapshot_release(next.first);
+            ++num_checked;
+        }
+    });
+
+    std::mt19937 random(123);
+
+    for (int i = 0; i < num_rounds; ++i)
+    {
+        const std::string &name = temporary_names[random() % num_temporary];
+        const char *fixed_parent = fixed_names[random() % num_fixed].c_str();
+        const char *parent = (random() % 2) ? temporary_names[random() % num_temporary].c_str() : fixed_parent;
+
+        switch (random() % 4)
+        {
+        case 0:
+            add_or_dispose(&tree, name, &_3, parent);
+            break;
+        case 1:
+            tree_remove_node(&tree, name.c_str());
+            break;
+        case 2:
+        {
+            tree_t sub_tree;
+            tree_init(&sub_tree);
+            add_or_dispose(&sub_tree, name, &_4, NULL);
+            add_or_dispose(&sub_tree, temporary_names[random() % num_temporary], &_5, name.c_str());
+            tree_add_tree(&tree, &sub_tree, fixed_parent);
+            tree_clear(&sub_tree);
+            break;
+        }
+        default:
+            tree_remove_tree(&tree, name.c_str());
+            break;
+        }
+
+        if (i % 50 == 0)
+        {
+            std::string names = pre_order_names(&tree);
+            tree_snapshot_t *snapshot = tree_snapshot(&tree);
+            ASSERT_NE(static_cast<tree_snapshot_t *>(NULL), snapshot);
+            std::lock_guard<std::mutex> lock(taken_mutex);
+            taken.push_back(std::make_pair(snapshot, names));
+        }
+    }
+
+    writer_done = true;
+    reader.join();
+
+    EXPECT_EQ(0, num_errors.load());
+    EXPECT_EQ(num_rounds / 50, num_checked.load());
+
+    /* the next change frees all that was kept */
+    tree_remove_tree(&tree, fixed_names[0].c_str());
+    EXPECT_EQ(0, tree.num_buried);
+    EXPECT_EQ(NULL, tree.buried_roots);
+
+    tree_clear(&tree);
+    epoch_dispose(epoch);
+}
+
+int main(int argc, char **argv)
+{
+    ::testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
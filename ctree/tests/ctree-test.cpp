@@ -1,4 +1,6 @@
 #include <gtest/gtest.h>
+#include <string>
+#include <vector>
 #include "ctree.h"
 #include "test-helpers.h"
 
@@ -15,7 +17,9 @@ TEST(tree_t, tree_init)
     EXPECT_EQ(NULL, t.nodes);
     EXPECT_EQ(0, t.num_nodes);
     EXPECT_EQ(0, t.capacity);
-    EXPECT_EQ(0, t.depth);
+    EXPECT_EQ(NULL, t.index);
+    EXPECT_EQ(NULL, t.pre_order);
+    EXPECT_EQ(0, t.labels_valid);
 }
 
 TEST(tree_t, tree_clear__on_null_does_nothing)
@@ -210,6 +214,424 @@ TEST(tree_t, tree_add_node__add_many_nodes_on_various_levels)
     tree_clear(&t);
 }
 
+TEST(tree_t, tree_get_node__finds_every_node_of_a_large_tree)
+{
+    const int num_nodes = 1000;
+    char name[16];
+    tree_t t;
+    tree_init(&t);
+    EXPECT_NE(static_cast<node_t *>(NULL), tree_add_node(&t, node_create(INT, "root", &_1), NULL));
+
+    for (int i = 0; i < num_nodes; ++i)
+    {
+        snprintf(name, sizeof(name), "n%d", i);
+        node_t *node = node_create(INT, name, &_1);
+        EXPECT_EQ(node, tree_add_node(&t, node, "root"));
+    }
+
+    EXPECT_EQ(num_nodes, t.num_nodes);
+
+    /* nodes stay sorted by name */
+    for (int i = 1; i < t.num_nodes; ++i)
+    {
+        EXPECT_LT(strcmp(t.nodes[i - 1]->object_name, t.nodes[i]->object_name), 0);
+    }
+
+    for (int i = 0; i < num_nodes; ++i)
+    {
+        snprintf(name, sizeof(name), "n%d", i);
+        node_t *node = tree_get_node(&t, name);
+        ASSERT_NE(static_cast<node_t *>(NULL), node);
+        EXPECT_STREQ(name, node->object_name);
+    }
+
+    /* remove every other node, the rest must still be found */
+    for (int i = 0; i < num_nodes; i += 2)
+    {
+        snprintf(name, sizeof(name), "n%d", i);
+        EXPECT_EQ(1, tree_remove_node(&t, name));
+    }
+
+    for (int i = 0; i < num_nodes; ++i)
+    {
+        snprintf(name, sizeof(name), "n%d", i);
+
+        if (i % 2 == 0)
+        {
+            EXPECT_EQ(NULL, tree_get_node(&t, name));
+        }
+        else
+        {
+            EXPECT_NE(static_cast<node_t *>(NULL), tree_get_node(&t, name));
+        }
+    }
+
+    EXPECT_EQ(num_nodes / 2, t.num_nodes);
+    tree_clear(&t);
+}
+
+TEST(tree_t, tree_get_node__after_tree_add_tree_and_tree_remove_tree)
+{
+    tree_t t;
+    tree_t u;
+    tree_init(&t);
+    tree_init(&u);
+    node_t *a = node_create(INT, "a", &_1);
+    node_t *b = node_create(INT, "b", &_2);
+    node_t *x = node_create(INT, "x", &_3);
+    node_t *y = node_create(INT, "y", &_4);
+    tree_add_node(&t, a, NULL);
+    tree_add_node(&t, b, "a");
+    tree_add_node(&u, x, NULL);
+    tree_add_node(&u, y, "x");
+    EXPECT_EQ(x, tree_add_tree(&t, &u, "b"));
+    EXPECT_EQ(NULL, u.index);
+    EXPECT_EQ(x, tree_get_node(&t, "x"));
+    EXPECT_EQ(y, tree_get_node(&t, "y"));
+    EXPECT_EQ(2, tree_remove_tree(&t, "x"));
+    EXPECT_EQ(NULL, tree_get_node(&t, "x"));
+    EXPECT_EQ(NULL, tree_get_node(&t, "y"));
+    EXPECT_EQ(b, tree_get_node(&t, "b"));
+    tree_clear(&t);
+}
+
+TEST(tree_t, tree_build__with_invalid_arguments)
+{
+    tree_t t;
+    node_t *a = node_create(INT, "a", &_1);
+    node_t *nodes[] = { a };
+    const char *parent_names[] = { NULL };
+    int error_pos = 0;
+    tree_init(&t);
+    EXPECT_EQ(TREE_BUILD_INVALID_ARGUMENT, tree_build(NULL, nodes, parent_names, 1, &error_pos));
+    EXPECT_EQ(-1, error_pos);
+    EXPECT_EQ(TREE_BUILD_INVALID_ARGUMENT, tree_build(&t, NULL, parent_names, 1, NULL));
+    EXPECT_EQ(TREE_BUILD_INVALID_ARGUMENT, tree_build(&t, nodes, NULL, 1, NULL));
+    EXPECT_EQ(TREE_BUILD_INVALID_ARGUMENT, tree_build(&t, nodes, parent_names, 0, NULL));
+    EXPECT_TREE(&t, NULL, NULL, 0, 0);
+    tree_clear(&t);
+    node_dispose(a);
+}
+
+TEST(tree_t, tree_build__into_non_empty_tree_returns_invalid_argument)
+{
+    tree_t t;
+    node_t *a = node_create(INT, "a", &_1);
+    node_t *b = node_create(INT, "b", &_2);
+    node_t *nodes[] = { b };
+    const char *parent_names[] = { NULL };
+    tree_init(&t);
+    tree_add_node(&t, a, NULL);
+    EXPECT_EQ(TREE_BUILD_INVALID_ARGUMENT, tree_build(&t, nodes, parent_names, 1, NULL));
+    EXPECT_TREE(&t, a, NULL, 0, 0);
+    tree_clear(&t);
+    node_dispose(b);
+}
+
+TEST(tree_t, tree_build__one_node_becomes_root)
+{
+    tree_t t;
+    node_t *a = node_create(INT, "a", &_1);
+    node_t *nodes[] = { a };
+    const char *parent_names[] = { NULL };
+    tree_init(&t);
+    EXPECT_EQ(TREE_BUILD_OK, tree_build(&t, nodes, parent_names, 1, NULL));
+    EXPECT_TREE(&t, a, NULL, 0, 0);
+    EXPECT_EQ(a, tree_get_node(&t, "a"));
+    EXPECT_EQ(1, tree_depth(&t));
+    tree_clear(&t);
+}
+
+TEST(tree_t, tree_build__reports_errors_and_leaves_nodes_untouched)
+{
+    tree_t t;
+    node_t *a = node_create(INT, "a", &_1);
+    node_t *b = node_create(INT, "b", &_2);
+    node_t *c = node_create(INT, "c", &_3);
+    node_t *b_evil_twin = node_create(INT, "b", &_4);
+    int error_pos = 0;
+    tree_init(&t);
+
+    node_t *no_root[] = { a, b };
+    const char *no_root_parents[] = { "b", "a" };
+    EXPECT_EQ(TREE_BUILD_NO_ROOT, tree_build(&t, no_root, no_root_parents, 2, &error_pos));
+    EXPECT_EQ(-1, error_pos);
+
+    node_t *two_roots[] = { a, b, c };
+    const char *two_roots_parents[] = { NULL, "a", NULL };
+    EXPECT_EQ(TREE_BUILD_MULTIPLE_ROOTS, tree_build(&t, two_roots, two_roots_parents, 3, &error_pos));
+    EXPECT_EQ(2, error_pos);
+
+    node_t *duplicate[] = { a, b, c, b_evil_twin };
+    const char *duplicate_parents[] = { NULL, "a", "b", "c" };
+    EXPECT_EQ(TREE_BUILD_DUPLICATE, tree_build(&t, duplicate, duplicate_parents, 4, &error_pos));
+    EXPECT_EQ(3, error_pos);
+
+    node_t *orphan[] = { a, b, c };
+    const char *orphan_parents[] = { NULL, "a", "i don't exist" };
+    EXPECT_EQ(TREE_BUILD_ORPHAN, tree_build(&t, orphan, orphan_parents, 3, &error_pos));
+    EXPECT_EQ(2, error_pos);
+
+    node_t *cycle[] = { a, b, c };
+    const char *cycle_parents[] = { NULL, "c", "b" };
+    EXPECT_EQ(TREE_BUILD_CYCLE, tree_build(&t, cycle, cycle_parents, 3, &error_pos));
+    EXPECT_EQ(-1, error_pos);
+
+    EXPECT_TREE(&t, NULL, NULL, 0, 0);
+    EXPECT_NODE(a, "a", NULL, NULL, 0, 0, &_1);
+    EXPECT_EQ(0, b->num_children);
+    EXPECT_EQ(NULL, b->parent);
+    EXPECT_EQ(0, c->num_children);
+    EXPECT_EQ(NULL, c->parent);
+
+    /* nodes can still be used after a failure */
+    node_t *valid[] = { c, b, a };
+    const char *valid_parents[] = { "b", "a", NULL };
+    EXPECT_EQ(TREE_BUILD_OK, tree_build(&t, valid, valid_parents, 3, &error_pos));
+    EXPECT_EQ(3, tree_depth(&t));
+
+    tree_clear(&t);
+    node_dispose(b_evil_twin);
+}
+
+//
+// Same tree as in tree_add_node__add_many_nodes_on_various_levels
+//
+TEST(tree_t, tree_build__gives_the_same_tree_as_tree_add_node)
+{
+    tree_t t;
+    tree_init(&t);
+    node_t *a = node_create(INT, "a", &_1);
+    node_t *b = node_create(INT, "b", &_2);
+    node_t *c = node_create(INT, "c", &_3);
+    node_t *d = node_create(INT, "d", &_4);
+    node_t *e = node_create(INT, "e", &_3);
+    node_t *f = node_create(INT, "f", &_5);
+    node_t *g = node_create(INT, "g", &_6);
+    node_t *h = node_create(INT, "h", &_7);
+    node_t *i = node_create(INT, "i", &_9);
+    node_t *j = node_create(INT, "j", &_8);
+    node_t *k = node_create(INT, "k", &_10);
+    node_t *nodes[] =
+    {
+        k, j, i, h, g, f, e, d, c, b, a
+    };
+    const char *parent_names[] =
+    {
+        "i", "h", "h", "g", "a", "e", "b", "b", "b", "a", NULL
+    };
+    EXPECT_EQ(TREE_BUILD_OK, tree_build(&t, nodes, parent_names, 11, NULL));
+
+    /* check tree */
+    node_t *expected_nodes[] =
+    {
+        b, c, d, e, f, g, h, i, j, k
+    };
+    EXPECT_TREE(&t, a, expected_nodes, 10, 10);
+    /* check nodes, children tables of up to NODE_INLINE_CHILDREN are kept in the nodes */
+    node_t *expected_a_children[] =
+    {
+        b, g
+    };
+    EXPECT_NODE(a, "a", NULL, expected_a_children, 2, 4, &_1);
+    EXPECT_EQ(a->inline_children, a->children);
+    node_t *expected_b_children[] =
+    {
+        c, e, d
+    };
+    EXPECT_NODE(b, "b", a, expected_b_children, 3, 4, &_2);
+    EXPECT_EQ(b->inline_children, b->children);
+    EXPECT_NODE(c, "c", b, NULL, 0, 0, &_3);
+    EXPECT_NODE(d, "d", b, NULL, 0, 0, &_4);
+    node_t *expected_e_children[] =
+    {
+        f
+    };
+    EXPECT_NODE(e, "e", b, expected_e_children, 1, 4, &_3);
+    EXPECT_NODE(f, "f", e, NULL, 0, 0, &_5);
+    node_t *expected_g_children[] =
+    {
+        h
+    };
+    EXPECT_NODE(g, "g", a, expected_g_children, 1, 4, &_6);
+    node_t *expected_h_children[] =
+    {
+        j, i
+    };
+    EXPECT_NODE(h, "h", g, expected_h_children, 2, 4, &_7);
+    node_t *expected_i_children[] =
+    {
+        k
+    };
+    EXPECT_NODE(i, "i", h, expected_i_children, 1, 4, &_9);
+    EXPECT_NODE(j, "j", h, NULL, 0, 0, &_8);
+    EXPECT_NODE(k, "k", i, NULL, 0, 0, &_10);
+
+    for (int n = 0; n < 11; ++n)
+    {
+        EXPECT_EQ(nodes[n], tree_get_node(&t, nodes[n]->object_name));
+    }
+
+    EXPECT_EQ(5, tree_depth(&t));
+
+    /* the tree is an ordinary tree afterwards */
+    node_t *l = node_create(INT, "l", &_1);
+    EXPECT_EQ(l, tree_add_node(&t, l, "d"));
+    EXPECT_EQ(1, tree_remove_node(&t, "b"));
+    EXPECT_EQ(5, tree_remove_tree(&t, "g"));
+    EXPECT_EQ(5, t.num_nodes);
+    tree_clear(&t);
+}
+
+TEST(tree_t, tree_build__large_tree)
+{
+    const int num_nodes = 10000;
+    char name[16];
+    char parent_name[16];
+    std::vector<node_t *> nodes;
+    std::vector<std::string> names;
+    std::vector<const char *> parent_names;
+    tree_t t;
+    tree_init(&t);
+
+    /* node n is a child of node n / 2, listed in reverse order */
+    for (int n = num_nodes - 1; n >= 0; --n)
+    {
+        snprintf(name, sizeof(name), "n%d", n);
+        snprintf(parent_name, sizeof(parent_name), "n%d", (n - 1) / 2);
+        nodes.push_back(node_create(INT, name, &_1));
+        names.push_back(parent_name);
+    }
+
+    for (int n = 0; n < num_nodes; ++n)
+    {
+        parent_names.push_back((n == num_nodes - 1) ? NULL : names[n].c_str());
+    }
+
+    EXPECT_EQ(TREE_BUILD_OK, tree_build(&t, &nodes[0], &parent_names[0], num_nodes, NULL));
+    EXPECT_EQ(num_nodes - 1, t.num_nodes);
+    EXPECT_EQ(14, tree_depth(&t));
+
+    for (int n = 1; n < t.num_nodes; ++n)
+    {
+        EXPECT_LT(strcmp(t.nodes[n - 1]->object_name, t.nodes[n]->object_name), 0);
+    }
+
+    for (int n = 1; n < num_nodes; ++n)
+    {
+        snprintf(name, sizeof(name), "n%d", n);
+        snprintf(parent_name, sizeof(parent_name), "n%d", (n - 1) / 2);
+        node_t *node = tree_get_node(&t, name);
+        ASSERT_NE(static_cast<node_t *>(NULL), node);
+        EXPECT_STREQ(parent_name, node->parent->object_name);
+    }
+
+    tree_clear(&t);
+}
+
+TEST(tree_t, tree_add_nodes__with_invalid_arguments_returns_0)
+{
+    tree_t t;
+    node_t *a = node_create(INT, "a", &_1);
+    node_t *nodes[] = { a };
+    const char *parent_names[] = { NULL };
+    tree_init(&t);
+    EXPECT_EQ(0, tree_add_nodes(NULL, nodes, parent_names, 1));
+    EXPECT_EQ(0, tree_add_nodes(&t, NULL, parent_names, 1));
+    EXPECT_EQ(0, tree_add_nodes(&t, nodes, NULL, 1));
+    EXPECT_EQ(0, tree_add_nodes(&t, nodes, parent_names, 0));
+    EXPECT_TREE(&t, NULL, NULL, 0, 0);
+    tree_clear(&t);
+    node_dispose(a);
+}
+
+TEST(tree_t, tree_add_nodes__is_the_same_as_tree_add_node_in_order)
+{
+    tree_t t;
+    tree_init(&t);
+    node_t *a = node_create(INT, "a", &_1);
+    node_t *d = node_create(INT, "d", &_4);
+    node_t *b = node_create(INT, "b", &_2);
+    node_t *c = node_create(INT, "c", &_3);
+    node_t *e = node_create(INT, "e", &_5);
+    node_t *f = node_create(INT, "f", &_6);
+    node_t *b_evil_twin = node_create(INT, "b", &_7);
+    node_t *orphan = node_create(INT, "g", &_8);
+
+    /* the first one becomes the root, c goes under b which comes before it */
+    node_t *first[] = { d, b, c };
+    const char *first_parents[] = { NULL, "d", "b" };
+    EXPECT_EQ(3, tree_add_nodes(&t, first, first_parents, 3));
+
+    node_t *second[] = { a, b_evil_twin, f, orphan, e };
+    const char *second_parents[] = { "d", "d", "c", "i don't exist", "f" };
+    EXPECT_EQ(3, tree_add_nodes(&t, second, second_parents, 5));
+
+    node_t *nodes[] = { a, b, c, e, f };
+    node_t *d_children[] = { a, b };
+    EXPECT_TREE(&t, d, nodes, 5, 8);
+    EXPECT_NODE(d, "d", NULL, d_children, 2, NODE_INLINE_CHILDREN, &_4);
+    EXPECT_EQ(c, f->parent);
+    EXPECT_EQ(f, e->parent);
+    EXPECT_EQ(5, tree_depth(&t));
+    EXPECT_EQ(NULL, b_evil_twin->parent);
+    EXPECT_EQ(NULL, orphan->parent);
+
+    tree_clear(&t);
+    node_dispose(b_evil_twin);
+    node_dispose(orphan);
+}
+
+TEST(tree_t, tree_add_nodes__merges_into_a_large_tree)
+{
+    const int num_nodes = 10000;
+    char name[16];
+    std::vector<node_t *> nodes;
+    std::vector<std::string> names;
+    std::vector<const char *> parent_names;
+    tree_t t;
+    tree_init(&t);
+
+    /* first half one by one, then the other half in one go, node n is a child of node n / 2 */
+    for (int n = 0; n < num_nodes; ++n)
+    {
+        snprintf(name, sizeof(name), "n%d", (n - 1) / 2);
+        names.push_back(name);
+    }
+
+    for (int n = 0; n < num_nodes / 2; ++n)
+    {
+        snprintf(name, sizeof(name), "n%d", n);
+        ASSERT_NE(static_cast<node_t *>(NULL), tree_add_node(&t, node_create(INT, name, &_1), names[n].c_str()));
+    }
+
+    for (int n = num_nodes / 2; n < num_nodes; ++n)
+    {
+        snprintf(name, sizeof(name), "n%d", n);
+        nodes.push_back(node_create(INT, name, &_1));
+        parent_names.push_back(names[n].c_str());
+    }
+
+    EXPECT_EQ(num_nodes / 2, tree_add_nodes(&t, &nodes[0], &parent_names[0], nodes.size()));
+    EXPECT_EQ(num_nodes - 1, t.num_nodes);
+    EXPECT_EQ(14, tree_depth(&t));
+
+    for (int n = 1; n < t.num_nodes; ++n)
+    {
+        EXPECT_LT(strcmp(t.nodes[n - 1]->object_name, t.nodes[n]->object_name), 0);
+    }
+
+    for (int n = 1; n < num_nodes; ++n)
+    {
+        snprintf(name, sizeof(name), "n%d", n);
+        node_t *node = tree_get_node(&t, name);
+        ASSERT_NE(static_cast<node_t *>(NULL), node);
+        EXPECT_STREQ(names[n].c_str(), node->parent->object_name);
+    }
+
+    tree_clear(&t);
+}
+
 TEST(tree_t, tree_add_tree__to_null_self_returns_null)
 {
     tree_t t;
@@ -320,9 +742,6 @@ TEST(tree_t, tree_add_tree__when_subtree_root_name_is_in_conflict_with_existing_
 //
 //  node' == evil twin of node
 //
-// WARNING
-// Valgrind produces a false positive for this test case
-//
 TEST(tree_t, tree_add_tree__conflicts_are_removed_from_subtree)
 {
     tree_t t;
@@ -415,6 +834,71 @@ TEST(tree_t, tree_add_tree__conflicts_are_removed_from_subtree)
     tree_clear(&u);
 }
 
+TEST(tree_t, tree_add_tree__large_sub_tree_with_conflicts)
+{
+    const int num_nodes = 1000;
+    char name[16];
+    char parent_name[16];
+    tree_t t;
+    tree_t u;
+    tree_init(&t);
+    tree_init(&u);
+
+    /* t holds n0..n999, node n is a child of node n / 2 */
+    tree_add_node(&t, node_create(INT, "n0", &_1), NULL);
+
+    for (int n = 1; n < num_nodes; ++n)
+    {
+        snprintf(name, sizeof(name), "n%d", n);
+        snprintf(parent_name, sizeof(parent_name), "n%d", n / 2);
+        tree_add_node(&t, node_create(INT, name, &_1), parent_name);
+    }
+
+    /* u holds m0..m999 the same way, every 10th of them has a child which conflicts with t */
+    tree_add_node(&u, node_create(INT, "m0", &_2), NULL);
+
+    for (int n = 1; n < num_nodes; ++n)
+    {
+        snprintf(name, sizeof(name), "m%d", n);
+        snprintf(parent_name, sizeof(parent_name), "m%d", n / 2);
+        tree_add_node(&u, node_create(INT, name, &_2), parent_name);
+    }
+
+    for (int n = 0; n < num_nodes; n += 10)
+    {
+        snprintf(name, sizeof(name), "n%d", n);
+        snprintf(parent_name, sizeof(parent_name), "m%d", n);
+        tree_add_node(&u, node_create(INT, name, &_3), parent_name);
+    }
+
+    node_t *m0 = u.root;
+    EXPECT_EQ(m0, tree_add_tree(&t, &u, "n999"));
+    EXPECT_TREE(&u, NULL, NULL, 0, 0);
+    EXPECT_EQ(2 * num_nodes - 1, t.num_nodes);
+
+    for (int n = 0; n < t.num_nodes; ++n)
+    {
+        EXPECT_EQ(t.nodes[n], tree_get_node(&t, t.nodes[n]->object_name));
+
+        if (n > 0)
+        {
+            EXPECT_LT(strcmp(t.nodes[n - 1]->object_name, t.nodes[n]->object_name), 0);
+        }
+    }
+
+    /* our nodes won */
+    for (int n = 0; n < num_nodes; ++n)
+    {
+        snprintf(name, sizeof(name), "n%d", n);
+        EXPECT_EQ(&_1, tree_get_node(&t, name)->value);
+    }
+
+    EXPECT_EQ(tree_get_node(&t, "n999"), tree_get_node(&t, "m0")->parent);
+    EXPECT_EQ(tree_get_node(&t, "m0"), tree_get_node(&t, "m1")->parent);
+    EXPECT_EQ(2, tree_get_node(&t, "m1")->num_children);
+    tree_clear(&t);
+}
+
 TEST(tree_t, tree_remove_node__from_null_tree_returns_0)
 {
     EXPECT_EQ(0, tree_remove_node(NULL, "whatever"));
@@ -478,9 +962,6 @@ TEST(tree_t, tree_remove_node__can_remove_root_if_it_is_childless)
 //    |
 //    f
 //
-// WARNING
-// Valgrind produces a false positive here: "Invalid read of size 8"
-//
 TEST(tree_t, tree_remove_node__on_various_levels)
 {
     tree_t t;
@@ -515,7 +996,7 @@ TEST(tree_t, tree_remove_node__on_various_levels)
     {
         c, d, g, f
     };
-    EXPECT_NODE(a, "a", NULL, expected_a_children, 4, 8, &_1);
+    EXPECT_NODE(a, "a", NULL, expected_a_children, 4, 4, &_1);
     EXPECT_NODE(c, "c", a, NULL, 0, 0, &_3);
     EXPECT_NODE(d, "d", a, NULL, 0, 0, &_5);
     EXPECT_NODE(f, "f", a, NULL, 0, 0, &_7);
@@ -523,6 +1004,70 @@ TEST(tree_t, tree_remove_node__on_various_levels)
     tree_clear(&t);
 }
 
+//
+//  root: p0 .. p99, w
+//  w:    c0 .. c99
+//  c0:   x
+//
+TEST(tree_t, tree_remove_node__merges_children_into_parent_in_sibling_order)
+{
+    tree_t t;
+    tree_init(&t);
+    std::vector<int> values(200);
+    std::vector<std::string> names(200);
+    int w_value = 7;
+    int x_value = 0;
+    node_t *root = node_create(INT, "root", &_1);
+    node_t *w = node_create(INT, "w", &w_value);
+    node_t *x = node_create(INT, "x", &x_value);
+
+    EXPECT_EQ(root, tree_add_node(&t, root, NULL));
+    EXPECT_EQ(w, tree_add_node(&t, w, "root"));
+
+    /* the values of both lists interleave, some are equal and go by name */
+    for (int i = 0; i < 100; ++i)
+    {
+        values[i] = (i * 7) % 50;
+        names[i] = "p" + std::to_string(i);
+        values[100 + i] = (i * 3) % 60;
+        names[100 + i] = "c" + std::to_string(i);
+        ASSERT_NE(static_cast<node_t *>(NULL), tree_add_node(&t, node_create(INT, names[i].c_str(), &values[i]), "root"));
+        ASSERT_NE(static_cast<node_t *>(NULL), tree_add_node(&t, node_create(INT, names[100 + i].c_str(), &values[100 + i]), "w"));
+    }
+
+    EXPECT_EQ(x, tree_add_node(&t, x, "c0"));
+    EXPECT_EQ(4, root->height);
+
+    EXPECT_EQ(1, tree_remove_node(&t, "w"));
+
+    /* same as if they were added to the root one by one */
+    ASSERT_EQ(200, root->num_children);
+    EXPECT_EQ(200, root->capacity);
+    EXPECT_EQ(3, root->height);
+
+    for (int i = 0; i < root->num_children; ++i)
+    {
+        EXPECT_EQ(root, root->children[i]->parent);
+
+        if (i > 0)
+        {
+            int cmp_result = *static_cast<int *>(root->children[i - 1]->value) - *static_cast<int *>(root->children[i]->value);
+            EXPECT_TRUE((cmp_result < 0) ||
+                        ((cmp_result == 0) && (strcmp(root->children[i - 1]->object_name, root->children[i]->object_name) < 0)));
+        }
+    }
+
+    EXPECT_EQ(root, tree_get_node(&t, "c0")->parent);
+    EXPECT_EQ(NULL, tree_get_node(&t, "w"));
+    EXPECT_EQ(201, t.num_nodes);
+
+    /* a childless node only leaves its parent */
+    EXPECT_EQ(1, tree_remove_node(&t, "x"));
+    EXPECT_EQ(2, root->height);
+    EXPECT_EQ(200, root->num_children);
+    tree_clear(&t);
+}
+
 TEST(tree_t, tree_remove_tree__from_null_self_return_0)
 {
     EXPECT_EQ(0, tree_remove_tree(NULL, "whatever"));
@@ -597,6 +1142,66 @@ TEST(tree_t, tree_remove_tree__remove_sub_tree_below_root)
     tree_clear(&t);
 }
 
+TEST(tree_t, tree_remove_tree__remove_large_sub_tree_from_the_middle)
+{
+    const int num_nodes = 1000;
+    char name[16];
+    char parent_name[16];
+    tree_t t;
+    tree_init(&t);
+    tree_add_node(&t, node_create(INT, "n0", &_1), NULL);
+
+    /* node n is a child of node n / 2 */
+    for (int n = 1; n < num_nodes; ++n)
+    {
+        snprintf(name, sizeof(name), "n%d", n);
+        snprintf(parent_name, sizeof(parent_name), "n%d", n / 2);
+        tree_add_node(&t, node_create(INT, name, &_1), parent_name);
+    }
+
+    /* count nodes whose chain of ancestors goes through n3 */
+    int expected_removed = 0;
+
+    for (int n = 1; n < num_nodes; ++n)
+    {
+        int ancestor = n;
+
+        while (ancestor > 3)
+        {
+            ancestor /= 2;
+        }
+
+        if (ancestor == 3)
+        {
+            ++expected_removed;
+        }
+    }
+
+    EXPECT_EQ(expected_removed, tree_remove_tree(&t, "n3"));
+    EXPECT_EQ(num_nodes - 1 - expected_removed, t.num_nodes);
+    EXPECT_EQ(NULL, tree_get_node(&t, "n3"));
+    EXPECT_EQ(NULL, tree_get_node(&t, "n7"));
+    EXPECT_EQ(NULL, tree_get_node(&t, "n999"));
+
+    for (int n = 0; n < t.num_nodes; ++n)
+    {
+        EXPECT_EQ(0u, t.nodes[n]->flags);
+        EXPECT_EQ(t.nodes[n], tree_get_node(&t, t.nodes[n]->object_name));
+
+        if (n > 0)
+        {
+            EXPECT_LT(strcmp(t.nodes[n - 1]->object_name, t.nodes[n]->object_name), 0);
+        }
+    }
+
+    node_t *expected_n1_children[] =
+    {
+        tree_get_node(&t, "n2")
+    };
+    EXPECT_NODE(tree_get_node(&t, "n1"), "n1", t.root, expected_n1_children, 1, 4, &_1);
+    tree_clear(&t);
+}
+
 TEST(tree_t, tree_depth__for_null_self_is_0)
 {
     EXPECT_EQ(0, tree_depth(NULL));
@@ -650,6 +1255,265 @@ TEST(tree_t, tree_depth__for_deeper_tree)
     tree_clear(&t);
 }
 
+TEST(tree_t, tree_depth__follows_every_tree_operation)
+{
+    tree_t t;
+    tree_t u;
+    tree_init(&t);
+    tree_init(&u);
+    node_t *a = node_create(INT, "a", &_1);
+    node_t *b = node_create(INT, "b", &_2);
+    node_t *c = node_create(INT, "c", &_3);
+    node_t *d = node_create(INT, "d", &_4);
+    node_t *x = node_create(INT, "x", &_5);
+    node_t *y = node_create(INT, "y", &_6);
+    node_t *z = node_create(INT, "z", &_7);
+    tree_add_node(&t, a, NULL);
+    tree_add_node(&t, b, "a");
+    tree_add_node(&t, c, "b");
+    tree_add_node(&t, d, "a");
+    EXPECT_EQ(3, tree_depth(&t));
+    tree_add_node(&u, x, NULL);
+    tree_add_node(&u, y, "x");
+    tree_add_node(&u, z, "y");
+    EXPECT_EQ(3, tree_depth(&u));
+    tree_add_tree(&t, &u, "c");
+    EXPECT_EQ(6, tree_depth(&t));
+    EXPECT_EQ(5, b->height);
+    EXPECT_EQ(1, d->height);
+    EXPECT_EQ(1, tree_remove_node(&t, "x"));
+    EXPECT_EQ(5, tree_depth(&t));
+    EXPECT_EQ(2, tree_remove_tree(&t, "y"));
+    EXPECT_EQ(3, tree_depth(&t));
+    EXPECT_EQ(1, tree_remove_tree(&t, "c"));
+    EXPECT_EQ(2, tree_depth(&t));
+    EXPECT_EQ(1, b->height);
+    tree_clear(&t);
+    EXPECT_EQ(0, tree_depth(&t));
+}
+
+TEST(tree_t, tree_is_ancestor__with_invalid_inputs_returns_0)
+{
+    tree_t t;
+    tree_init(&t);
+    EXPECT_EQ(0, tree_is_ancestor(NULL, "a", "a"));
+    EXPECT_EQ(0, tree_is_ancestor(&t, "a", "a"));
+    tree_add_node(&t, node_create(INT, "a", &_1), NULL);
+    EXPECT_EQ(0, tree_is_ancestor(&t, NULL, "a"));
+    EXPECT_EQ(0, tree_is_ancestor(&t, "a", NULL));
+    EXPECT_EQ(0, tree_is_ancestor(&t, "a", "i don't exist"));
+    EXPECT_EQ(0, tree_is_ancestor(&t, "i don't exist", "a"));
+    EXPECT_EQ(1, tree_is_ancestor(&t, "a", "a"));
+    tree_clear(&t);
+}
+
+TEST(tree_t, tree_subtree_size__with_invalid_inputs_returns_0)
+{
+    tree_t t;
+    tree_init(&t);
+    EXPECT_EQ(0, tree_subtree_size(NULL, "a"));
+    EXPECT_EQ(0, tree_subtree_size(&t, "a"));
+    tree_add_node(&t, node_create(INT, "a", &_1), NULL);
+    EXPECT_EQ(0, tree_subtree_size(&t, NULL));
+    EXPECT_EQ(0, tree_subtree_size(&t, "i don't exist"));
+    EXPECT_EQ(1, tree_subtree_size(&t, "a"));
+    tree_clear(&t);
+}
+
+//
+// a---+
+// |   |
+// b-+ e
+// | | |
+// c d f
+//     |
+//     g
+//
+TEST(tree_t, tree_is_ancestor__and_tree_subtree_size__follow_changes)
+{
+    tree_t t;
+    tree_init(&t);
+    tree_add_node(&t, node_create(INT, "a", &_1), NULL);
+    tree_add_node(&t, node_create(INT, "b", &_2), "a");
+    tree_add_node(&t, node_create(INT, "c", &_3), "b");
+    tree_add_node(&t, node_create(INT, "d", &_4), "b");
+    tree_add_node(&t, node_create(INT, "e", &_5), "a");
+    tree_add_node(&t, node_create(INT, "f", &_6), "e");
+    tree_add_node(&t, node_create(INT, "g", &_7), "f");
+
+    EXPECT_EQ(1, tree_is_ancestor(&t, "a", "g"));
+    EXPECT_EQ(1, t.labels_valid);
+    EXPECT_EQ(1, tree_is_ancestor(&t, "b", "d"));
+    EXPECT_EQ(1, tree_is_ancestor(&t, "e", "g"));
+    EXPECT_EQ(1, tree_is_ancestor(&t, "f", "f"));
+    EXPECT_EQ(0, tree_is_ancestor(&t, "g", "e"));
+    EXPECT_EQ(0, tree_is_ancestor(&t, "b", "e"));
+    EXPECT_EQ(0, tree_is_ancestor(&t, "c", "d"));
+    EXPECT_EQ(0, tree_is_ancestor(&t, "b", "a"));
+    EXPECT_EQ(7, tree_subtree_size(&t, "a"));
+    EXPECT_EQ(3, tree_subtree_size(&t, "b"));
+    EXPECT_EQ(3, tree_subtree_size(&t, "e"));
+    EXPECT_EQ(1, tree_subtree_size(&t, "g"));
+
+    /* f's children go to e */
+    EXPECT_EQ(1, tree_remove_node(&t, "f"));
+    EXPECT_EQ(0, t.labels_valid);
+    EXPECT_EQ(2, tree_subtree_size(&t, "e"));
+    EXPECT_EQ(1, tree_is_ancestor(&t, "e", "g"));
+
+    tree_add_node(&t, node_create(INT, "h", &_8), "g");
+    EXPECT_EQ(1, tree_is_ancestor(&t, "g", "h"));
+    EXPECT_EQ(7, tree_subtree_size(&t, "a"));
+
+    EXPECT_EQ(3, tree_remove_tree(&t, "b"));
+    EXPECT_EQ(0, tree_is_ancestor(&t, "a", "c"));
+    EXPECT_EQ(4, tree_subtree_size(&t, "a"));
+    tree_clear(&t);
+}
+
+TEST(tree_t, tree_lca__and_tree_kth_ancestor__with_invalid_inputs_return_null)
+{
+    tree_t t;
+    tree_init(&t);
+    EXPECT_EQ(NULL, tree_lca(NULL, "a", "a"));
+    EXPECT_EQ(NULL, tree_lca(&t, "a", "a"));
+    EXPECT_EQ(NULL, tree_kth_ancestor(NULL, "a", 0));
+    EXPECT_EQ(NULL, tree_kth_ancestor(&t, "a", 0));
+    node_t *a = node_create(INT, "a", &_1);
+    tree_add_node(&t, a, NULL);
+    EXPECT_EQ(NULL, tree_lca(&t, NULL, "a"));
+    EXPECT_EQ(NULL, tree_lca(&t, "a", NULL));
+    EXPECT_EQ(NULL, tree_lca(&t, "a", "i don't exist"));
+    EXPECT_EQ(a, tree_lca(&t, "a", "a"));
+    EXPECT_EQ(NULL, tree_kth_ancestor(&t, NULL, 0));
+    EXPECT_EQ(NULL, tree_kth_ancestor(&t, "a", -1));
+    EXPECT_EQ(NULL, tree_kth_ancestor(&t, "a", 1));
+    EXPECT_EQ(a, tree_kth_ancestor(&t, "a", 0));
+    tree_clear(&t);
+}
+
+TEST(tree_t, tree_lca__and_tree_kth_ancestor__agree_with_walking_up)
+{
+    const int num_nodes = 500;
+    char name[16];
+    char parent_name[16];
+    tree_t t;
+    tree_init(&t);
+    tree_add_node(&t, node_create(INT, "n0", &_1), NULL);
+
+    /* mix of a long chain and bushy parts */
+    for (int n = 1; n < num_nodes; ++n)
+    {
+        snprintf(name, sizeof(name), "n%d", n);
+        snprintf(parent_name, sizeof(parent_name), "n%d", (n % 3 == 0) ? n - 1 : n / 3);
+        tree_add_node(&t, node_create(INT, name, &_1), parent_name);
+    }
+
+    for (int x = 0; x < num_nodes; x += 7)
+    {
+        snprintf(name, sizeof(name), "n%d", x);
+        node_t *node_x = tree_get_node(&t, name);
+
+        for (int y = 0; y < num_nodes; y += 11)
+        {
+            snprintf(parent_name, sizeof(parent_name), "n%d", y);
+            node_t *node_y = tree_get_node(&t, parent_name);
+
+            /* expected: first ancestor of x which has y in its subtree */
+            node_t *expected = node_x;
+
+            while (true)
+            {
+                node_t *node = node_y;
+
+                while ((node != NULL) && (node != expected))
+                {
+                    node = node->parent;
+                }
+
+                if (node != NULL)
+                {
+                    break;
+                }
+
+                expected = expected->parent;
+            }
+
+            EXPECT_EQ(expected, tree_lca(&t, name, parent_name));
+        }
+
+        int k = 0;
+
+        for (node_t *node = node_x; node != NULL; node = node->parent, ++k)
+        {
+            EXPECT_EQ(node, tree_kth_ancestor(&t, name, k));
+        }
+
+        EXPECT_EQ(NULL, tree_kth_ancestor(&t, name, k));
+    }
+
+    /* jump table follows changes */
+    EXPECT_EQ(1, t.jumps_valid);
+    EXPECT_EQ(1, tree_remove_node(&t, "n1"));
+    EXPECT_EQ(0, t.jumps_valid);
+    EXPECT_EQ(t.root, tree_kth_ancestor(&t, "n4", 1));
+    EXPECT_EQ(t.root, tree_lca(&t, "n4", "n2"));
+    tree_clear(&t);
+}
+
+static int count_nodes(node_t *, void *ctx)
+{
+    ++*static_cast<int *>(ctx);
+    return 0;
+}
+
+TEST(tree_t, tree_for_each__with_invalid_inputs_returns_minus_1)
+{
+    int cnt = 0;
+    tree_t t;
+    tree_init(&t);
+    EXPECT_EQ(-1, tree_for_each(NULL, TREE_ITER_PRE_ORDER, count_nodes, &cnt));
+    EXPECT_EQ(-1, tree_for_each(&t, TREE_ITER_PRE_ORDER, NULL, &cnt));
+    EXPECT_EQ(0, tree_for_each(&t, TREE_ITER_PRE_ORDER, count_nodes, &cnt));
+    EXPECT_EQ(0, cnt);
+    tree_clear(&t);
+}
+
+TEST(tree_t, operations_on_very_deep_tree)
+{
+    const int num_nodes = 200000;
+    std::vector<node_t *> nodes;
+    std::vector<std::string> names;
+    std::vector<const char *> parent_names;
+    int cnt = 0;
+    tree_t t;
+    tree_init(&t);
+
+    /* a chain, node n is the only child of node n - 1 */
+    for (int n = 0; n < num_nodes; ++n)
+    {
+        names.push_back("n" + std::to_string(n));
+    }
+
+    for (int n = 0; n < num_nodes; ++n)
+    {
+        nodes.push_back(node_create(INT, names[n].c_str(), &_1));
+        parent_names.push_back((n == 0) ? NULL : names[n - 1].c_str());
+    }
+
+    ASSERT_EQ(TREE_BUILD_OK, tree_build(&t, &nodes[0], &parent_names[0], num_nodes, NULL));
+    EXPECT_EQ(num_nodes, tree_depth(&t));
+
+    EXPECT_EQ(num_nodes, tree_for_each(&t, TREE_ITER_POST_ORDER, count_nodes, &cnt));
+    EXPECT_EQ(num_nodes, cnt);
+    EXPECT_EQ(1, tree_is_ancestor(&t, "n0", "n199999"));
+    EXPECT_EQ(num_nodes / 2, tree_subtree_size(&t, "n100000"));
+    EXPECT_EQ(num_nodes / 2, tree_remove_tree(&t, "n100000"));
+    EXPECT_EQ(num_nodes / 2, tree_depth(&t));
+    EXPECT_EQ(num_nodes / 2, tree_subtree_size(&t, "n0"));
+    tree_clear(&t);
+}
+
 int main(int argc, char **argv)
 {
     ::testing::InitGoogleTest(&argc, argv);
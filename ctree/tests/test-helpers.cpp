@@ -1,3 +1,5 @@
+#include <cstring>
+#include "cjson.h"
 #include "test-helpers.h"
 
 int int_compare(void *a, void *b)
@@ -38,8 +40,58 @@ void int_dispose(void *)
     /* does nothing */
 }
 
+void int_delete(void *value)
+{
+    ++g_num_disposed;
+    delete static_cast<int *>(value);
+}
+
+int int_to_binary(void *value, char *buffer, int buffer_size)
+{
+    int size = (value != NULL) ? sizeof(int) : 0;
+
+    if ((size > 0) && (buffer_size >= size))
+    {
+        memcpy(buffer, value, sizeof(int));
+    }
+
+    return size;
+}
+
+int int_from_binary(const char *data, int size, void **value)
+{
+    *value = NULL;
+
+    if (size == sizeof(int))
+    {
+        *value = new int;
+        memcpy(*value, data, sizeof(int));
+    }
+
+    return (size == sizeof(int)) || (size == 0);
+}
+
+int append(const char *data, int size, void *ctx)
+{
+    static_cast<std::string *>(ctx)->append(data, size);
+    return 0;
+}
+
+std::string to_json(tree_t *tree)
+{
+    std::string json;
+    EXPECT_EQ(1, tree_to_json(tree, append, &json));
+    return json;
+}
+
 value_handlers_t g_handlers;
 value_handlers_t *INT = value_handlers_init(&g_handlers, int_compare, int_to_json, int_dispose);
+value_handlers_t g_owned_handlers;
+value_handlers_t *OWNED = value_handlers_set_binary(
+    value_handlers_init(&g_owned_handlers, int_compare, int_to_json, int_delete),
+    int_to_binary,
+    int_from_binary);
+int g_num_disposed;
 int _1 = 1;
 int _2 = 2;
 int _3 = 3;
@@ -2,16 +2,25 @@
 #define TEST_HELPERS_H_
 
 #include <gtest/gtest.h>
+#include <string>
 #include "cnode.h"
+#include "ctree.h"
 
 #pragma GCC diagnostic ignored "-Wnonnull"
 
 int int_compare(void *a, void *b);
 int int_to_json(void *value, char *buffer, int buffer_size);
 void int_dispose(void *);
+void int_delete(void *value);
+int int_to_binary(void *value, char *buffer, int buffer_size); /**< a NULL value is an empty payload */
+int int_from_binary(const char *data, int size, void **value);
+int append(const char *data, int size, void *ctx);
+std::string to_json(tree_t *tree);
 
 extern value_handlers_t g_handlers;
 extern value_handlers_t *INT;
+extern value_handlers_t *OWNED; /**< values created with new, deleted by int_delete() */
+extern int g_num_disposed; /**< number of int_delete() calls */
 extern int _1;
 extern int _2;
 extern int _3;